@@ -18,7 +18,6 @@
 #pragma once
 
 #include <string>
-#include <map>
 #include <vector>
 #include <sys/types.h>
 #include <unistd.h>
@@ -47,18 +46,24 @@ public:
 	                       const Route* route,
 	                       const std::string& scriptPath);
 
+	// Start the script without waiting for it (no request body); its output
+	// arrives on outputFd (non-blocking) for parseCGIOutput(). Returns the pid or -1
+	pid_t start(const HTTP::Request& request,
+	            const Server* server,
+	            const Route* route,
+	            const std::string& scriptPath,
+	            int& outputFd);
+
+	// Parse CGI output
+	HTTP::Response parseCGIOutput(const std::string& cgiOutput);
+
 private:
-	// Environment setup
-	std::map<std::string, std::string> buildEnvironment(
-		const HTTP::Request& request,
-		const Server* server,
-		const Route* route,
-		const std::string& scriptPath
-	);
-
-	// Convert map to char** for execve
-	char** envMapToArray(const std::map<std::string, std::string>& envMap);
-	void freeEnvArray(char** env);
+	// Environment: the location's prepared block plus the request's variables
+	void buildEnvironment(const HTTP::Request& request,
+	                      const Server* server,
+	                      const Route* route,
+	                      const std::string& scriptPath,
+	                      std::string& block);
 
 	// Process management
 	struct PipeSet {
@@ -69,8 +74,8 @@ private:
 	bool createPipes(PipeSet& pipes);
 	void closePipes(PipeSet& pipes);
 
-	// Execute CGI script in child process
-	void executeChild(const std::string& cgiPath,
+	// Start the CGI process on the pipes (-1 on failure)
+	pid_t spawnChild(const std::string& cgiPath,
 	                 const std::string& scriptPath,
 	                 const PipeSet& pipes,
 	                 char** envp);
@@ -81,9 +86,6 @@ private:
 	                        pid_t childPid,
 	                        int timeoutSeconds);
 
-	// Parse CGI output
-	HTTP::Response parseCGIOutput(const std::string& cgiOutput);
-
 	// Timeout handling
 	bool waitWithTimeout(pid_t pid, int timeoutSeconds, int& status);
 
@@ -0,0 +1,133 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Cache.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:31:18 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:31:19 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Cache.hpp
+ * CGI response cache (cgi_cache): GET responses of a location kept
+ * in memory under a byte budget, keyed by method, URI (path and query) and
+ * the cgi_cache_vary request headers
+ * A response's lifetime comes from the script's Cache-Control (s-maxage,
+ * max-age) or Expires, otherwise from cgi_cache_valid; no-store, no-cache,
+ * private and Set-Cookie keep it out. A miss runs the script as part of
+ * the request: the event loop waits for it, so identical requests queued
+ * behind it find the stored response instead of starting their own. An
+ * entry past its lifetime but within stale-while-revalidate is served as
+ * is while a single refresh runs in the background (its output is polled
+ * by the event loop, see getPollFds()); a key never has two scripts running
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <poll.h>
+#include <sys/types.h>
+#include "includes/http/Response.hpp"
+#include "includes/config/CgiCacheSettings.hpp"
+#include "includes/core/Instance.hpp"
+
+namespace HTTP {
+	class Request;
+}
+
+class Server;
+class Route;
+
+namespace CGI {
+
+class Cache {
+public:
+	/**
+	 * Response to a CGI request on a location with cgi_cache on: from the
+	 * cache, or from the script (stored if it may be)
+	 * The X-Cache-Status header tells which: HIT, STALE, MISS or BYPASS
+	 */
+	HTTP::Response serve(const HTTP::Request& request, const Server* server,
+	                     const Route* route, const std::string& scriptPath);
+
+	// Set the budget in bytes (0 disables storing)
+	void setCapacity(size_t bytes);
+
+	// Background refreshes: script outputs to poll, their events, timeouts
+	void getPollFds(std::vector<struct pollfd>& fds) const;
+	void handle(int fd, short revents);
+	void tick();
+
+	// Statistics
+	size_t getSize() const;
+	size_t getHits() const;
+	size_t getStaleHits() const;
+	size_t getMisses() const;
+
+private:
+	struct Entry {
+		HTTP::Response response;
+		double storedAt;             // RequestRecord::now() (the loop's Clock
+		                             // stands still while a script runs)
+		double expires;              // Fresh until
+		double staleUntil;           // Served stale (and refreshed) until
+		size_t bytes;                // Memory used (for the budget)
+	};
+
+	struct Node {
+		std::string key;
+		Entry entry;
+	};
+
+	struct Refresh {
+		std::string key;
+		CgiCacheSettings settings;
+		pid_t pid;
+		int fd;                      // Script output (non-blocking)
+		std::string output;
+		double started;
+	};
+
+	typedef std::list<Node> NodeList;
+
+	static const int REFRESH_TIMEOUT = 30;   // Seconds, as for a script run in the request
+
+	NodeList _nodes;                                 // Most recently used first
+	std::map<std::string, NodeList::iterator> _index;   // Key -> node
+	size_t _size;                                    // Bytes currently cached
+	size_t _capacity;                                // Budget in bytes
+	size_t _hits;
+	size_t _staleHits;
+	size_t _misses;
+	std::vector<Refresh> _refreshes;                 // Running in the background
+	std::vector<pid_t> _exiting;                     // Refreshes done, child not reaped yet
+
+	static std::string makeKey(const HTTP::Request& request, const Route* route);
+	static bool lifetime(const HTTP::Response& response, const CgiCacheSettings& settings,
+	                     double& ttl, double& stale);
+	static HTTP::Response cached(const Entry& entry, double now, const char* status);
+	void store(const std::string& key, const HTTP::Response& response,
+	           const CgiCacheSettings& settings);
+	bool isRefreshing(const std::string& key) const;
+	void refresh(const std::string& key, const HTTP::Request& request, const Server* server,
+	             const Route* route, const std::string& scriptPath);
+	bool await(const std::string& key, HTTP::Response& response);
+	bool finish(size_t index, bool complete, HTTP::Response* response = NULL);
+	void remove(const std::string& key);
+	void evict(size_t needed);
+
+	Cache();
+	~Cache();
+	friend class ::Instance;
+
+	// Disable copy
+	Cache(const Cache& other);
+	Cache& operator=(const Cache& other);
+};
+
+} // namespace CGI
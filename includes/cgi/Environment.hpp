@@ -0,0 +1,58 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Environment.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:02:41 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:02:42 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Environment.hpp
+ * CGI environment blocks prepared when the configuration is loaded
+ * The variables that are the same for every request to a location
+ * (SERVER_SOFTWARE, GATEWAY_INTERFACE, SERVER_NAME, SERVER_PORT, ...) are
+ * formatted once as "NAME=value\0" entries; a request copies its location's
+ * block and appends its own variables, so building the environment costs
+ * one string and one pointer array instead of a map and a copy per variable
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "includes/core/Instance.hpp"
+
+class Config;
+class Server;
+class Route;
+
+namespace CGI {
+
+class Environment {
+public:
+	// Prepare the block of every location (ids from Config::compile())
+	void open(const Config& config);
+
+	// Block for requests to route on server (built on the spot if it wasn't prepared)
+	const std::string& get(const Server* server, const Route* route);
+
+	// Append "name=value\0"
+	static void add(std::string& block, const char* name, const std::string& value);
+
+	// Pointers to the entries of block (NULL-terminated, for execve)
+	static void index(std::string& block, std::vector<char*>& envp);
+
+private:
+	std::vector<std::string> _routes;   // By route metrics id
+	std::string _scratch;               // Location without a prepared block
+
+	static void build(const Server* server, std::string& block);
+
+	Environment();
+	friend class ::Instance;
+};
+
+} // namespace CGI
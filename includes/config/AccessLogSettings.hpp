@@ -0,0 +1,38 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLogSettings.hpp                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:40:18 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 15:40:19 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * AccessLogSettings.hpp
+ * Parâmetros de uma directiva access_log
+ * access_log <path> [formato] [buffer=64k] [flush=1s] [sample=N];
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+struct AccessLogSettings {
+	std::string path;          // Ficheiro de destino
+	std::string formatName;    // Nome do log_format (para mensagens)
+	std::string format;        // Texto do formato com $variáveis
+	bool escapeJson;           // Valores escapados para JSON (escape=json)?
+	size_t bufferSize;         // Bytes acumulados antes de escrever (0 = cada linha)
+	int flushInterval;         // Segundos máximos que uma linha fica no buffer
+	unsigned int sample;       // Registar 1 em N respostas com sucesso (1 = todas)
+
+	AccessLogSettings()
+		: escapeJson(false)
+		, bufferSize(0)
+		, flushInterval(1)
+		, sample(1) {
+	}
+};
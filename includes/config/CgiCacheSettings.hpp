@@ -0,0 +1,36 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiCacheSettings.hpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:21:07 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:21:08 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * CgiCacheSettings.hpp
+ * Cache das respostas CGI de uma location (opt-in)
+ * cgi_cache on;  cgi_cache_valid 5s;  cgi_cache_vary Accept-Language;
+ * cgi_cache_stale_while_revalidate 30s;
+ * A memória total é dada por cgi_cache_size, fora dos servers
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct CgiCacheSettings {
+	bool enabled;
+	double valid;                   // Validade quando o script não envia Cache-Control / Expires (0 = não guardar)
+	double staleWhileRevalidate;    // Depois de expirar, ainda servida enquanto é renovada (segundos)
+	std::vector<std::string> vary;  // Cabeçalhos do pedido que entram na chave
+
+	CgiCacheSettings()
+		: enabled(false)
+		, valid(0)
+		, staleWhileRevalidate(0) {
+	}
+};
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "includes/config/Server.hpp"
+#include "includes/config/MimeTypes.hpp"
 #include <string>
 #include <vector>
 
@@ -33,6 +34,45 @@ public:
 	void addServer(const Server& server);
 	const std::vector<Server>& getServers() const;
 
+	// Global settings
+	size_t getGzipCacheSize() const;
+	void setGzipCacheSize(size_t size);
+	size_t getAutoindexCacheSize() const;
+	void setAutoindexCacheSize(size_t size);
+	size_t getCgiCacheSize() const;
+	void setCgiCacheSize(size_t size);
+	const std::string& getErrorLogPath() const;
+	const std::string& getErrorLogLevel() const;
+	void setErrorLog(const std::string& path, const std::string& level);
+
+	// access_log globais (default dos servers sem access_log próprio); cada
+	// linha acrescenta um log, como no nginx
+	void addAccessLog(const AccessLogSettings& settings);
+	bool hasAccessLog() const;
+
+	// Ficheiros de access log distintos, indexados por Server::getAccessLogIds()
+	const std::vector<AccessLogSettings>& getAccessLogs() const;
+
+	// capture: bytes recebidos das conexões, para replay (vazio = desligado)
+	const std::string& getCapturePath() const;
+	unsigned int getCaptureSample() const;
+	size_t getCaptureMaxSize() const;
+	void setCapture(const std::string& path, unsigned int sample, size_t maxSize);
+
+	// types { } / default_type globais (sem bloco types: tipos por omissão)
+	void addMimeType(const std::string& type, const std::string& extension);
+	const MimeTypes& getMimeTypes() const;
+	const std::string& getDefaultType() const;
+	void setDefaultType(const std::string& type);
+
+	// limit_req_zone / limit_conn_zone (indexadas pelos limit_req / limit_conn)
+	int addLimitZone(const LimitZoneSettings& zone);
+	const std::vector<LimitZoneSettings>& getLimitZones() const;
+
+	// upstream { } e os upstreams implícitos dos proxy_pass (indexados pelas locations)
+	int addUpstream(const UpstreamSettings& upstream);
+	const std::vector<UpstreamSettings>& getUpstreams() const;
+
 	// Server lookup
 	const Server* getServer(const std::string& host, int port, const std::string& serverName = "") const;
 	const Server* getDefaultServer(const std::string& host, int port) const;
@@ -40,9 +80,26 @@ public:
 	// Validation
 	bool isValid() const;
 
+	// Compilação dos servers e dos access logs (depois de isValid())
+	void compile();
+
 	// Debug
 	void print() const;
 
 private:
 	std::vector<Server> _servers;  // Lista de todos os servers configurados
+	size_t _gzipCacheSize;         // Orçamento (bytes) da cache de variantes gzip
+	size_t _autoindexCacheSize;    // Orçamento (bytes) da cache de listagens (autoindex)
+	size_t _cgiCacheSize;          // Orçamento (bytes) da cache de respostas CGI (cgi_cache)
+	std::string _errorLogPath;     // error_log: ficheiro (vazio = stdout/stderr)
+	std::string _errorLogLevel;    // error_log: nível mínimo (vazio = default)
+	std::vector<AccessLogSettings> _accessLog;  // access_log globais
+	std::vector<AccessLogSettings> _accessLogs; // Um por ficheiro (compile())
+	std::string _capturePath;      // capture: ficheiro de destino
+	unsigned int _captureSample;   // capture: 1 em N conexões
+	size_t _captureMaxSize;        // capture: tamanho máximo do ficheiro (0 = sem limite)
+	MimeTypes _mimeTypes;          // types: extensão -> tipo (compilado em compile())
+	std::string _defaultType;      // default_type global (vazio = application/octet-stream)
+	std::vector<LimitZoneSettings> _limitZones; // Zonas dos limites por cliente
+	std::vector<UpstreamSettings> _upstreams;   // Destinos dos proxy_pass
 };
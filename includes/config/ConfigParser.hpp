@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <map>
 
 class ConfigParser {
 public:
@@ -38,21 +39,45 @@ private:
 	// Tokenization
 	std::vector<std::string> tokenize(const std::string& content);
 
+	// Substituir "include <ficheiro>;" pelos tokens do ficheiro (relativo a baseDir)
+	bool expandIncludes(std::vector<std::string>& tokens, const std::string& baseDir, int depth);
+
 	// Parsing helpers
 	bool parseServer(std::vector<std::string>& tokens, size_t& index, Server& server);
 	bool parseLocation(std::vector<std::string>& tokens, size_t& index, Route& route);
+	bool parseGlobalDirective(const std::string& directive, std::vector<std::string>& tokens,
+	                          size_t& index, Config& config);
 	bool parseServerDirective(const std::string& directive, std::vector<std::string>& tokens,
 	                          size_t& index, Server& server);
 	bool parseLocationDirective(const std::string& directive, std::vector<std::string>& tokens,
 	                           size_t& index, Route& route);
+	bool parseTypes(std::vector<std::string>& tokens, size_t& index, Config& config);
+	bool parseLogFormat(std::vector<std::string>& tokens, size_t& index);
+	bool parseAccessLog(std::vector<std::string>& tokens, size_t& index,
+	                    AccessLogSettings& settings, bool& off);
+	bool parseLimitZone(const std::string& directive, std::vector<std::string>& tokens,
+	                    size_t& index, Config& config);
+	bool parseLimitReq(std::vector<std::string>& tokens, size_t& index, LimitReqSettings& limit);
+	bool parseLimitConn(std::vector<std::string>& tokens, size_t& index, LimitConnSettings& limit);
+	bool parseLimitStatus(const std::string& directive, std::vector<std::string>& tokens,
+	                      size_t& index, int& status);
+	bool parseUpstream(std::vector<std::string>& tokens, size_t& index);
+	bool parseUpstreamServer(std::vector<std::string>& tokens, size_t& index, UpstreamPeerSettings& peer);
+	bool parseProxyPass(std::vector<std::string>& tokens, size_t& index, Route& route);
+	bool parseHostPort(const std::string& address, std::string& host, int& port);
 
 	// Utility functions
 	bool expectToken(std::vector<std::string>& tokens, size_t& index, const std::string& expected);
 	bool isNumber(const std::string& str);
 	int toInt(const std::string& str);
 	size_t toSize(const std::string& str);
+	bool toSeconds(const std::string& str, double& seconds);
 	std::string readFile(const std::string& filename);
 	void setError(const std::string& error);
 
 	std::string _error;  // Error message
+	std::map<std::string, AccessLogSettings> _logFormats; // log_format por nome (path vazio)
+	std::map<std::string, std::pair<int, bool> > _limitZones; // Zona -> (índice, é limit_req_zone?)
+	std::vector<UpstreamSettings> _upstreams;        // Passados ao Config no fim do parse
+	std::map<std::string, int> _upstreamNames;       // Nome (ou host:porta) -> índice
 };
@@ -0,0 +1,91 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LimitSettings.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:48:31 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:48:32 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * LimitSettings.hpp
+ * Limites por endereço do cliente (estilo limit_req / limit_conn do nginx)
+ * limit_req_zone $binary_remote_addr zone=<nome>:<tamanho> rate=<N>r/s;
+ * limit_conn_zone $binary_remote_addr zone=<nome>:<tamanho>;
+ * limit_req zone=<nome> [burst=N] [nodelay | delay=N];
+ * limit_conn <nome> <N>;
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Zona partilhada: tabela de tamanho fixo indexada pelo endereço do cliente
+struct LimitZoneSettings {
+	std::string name;
+	bool requests;             // limit_req_zone (senão limit_conn_zone)
+	size_t size;               // Memória da zona (bytes): fixa o número de clientes
+	unsigned long rate;        // Pedidos por 1000 segundos (só limit_req_zone)
+
+	LimitZoneSettings()
+		: requests(false)
+		, size(0)
+		, rate(0) {
+	}
+};
+
+// limit_req: token bucket com burst; acima de delay os pedidos esperam
+struct LimitReqSettings {
+	int zone;                  // Índice em Config::getLimitZones()
+	unsigned int burst;        // Pedidos em excesso aceites
+	unsigned int delay;        // Pedidos em excesso servidos sem atraso
+
+	LimitReqSettings()
+		: zone(-1)
+		, burst(0)
+		, delay(0) {
+	}
+};
+
+// limit_conn: pedidos em curso por cliente
+struct LimitConnSettings {
+	int zone;                  // Índice em Config::getLimitZones()
+	unsigned int max;
+
+	LimitConnSettings()
+		: zone(-1)
+		, max(0) {
+	}
+};
+
+// Limites de um server ou location (uma location sem limites herda os do server)
+struct LimitSettings {
+	std::vector<LimitReqSettings> requests;
+	std::vector<LimitConnSettings> connections;
+	int requestStatus;         // limit_req_status (0 = herdado, 429 por omissão)
+	int connectionStatus;      // limit_conn_status (0 = herdado, 503 por omissão)
+
+	LimitSettings()
+		: requestStatus(0)
+		, connectionStatus(0) {
+	}
+
+	bool empty() const {
+		return requests.empty() && connections.empty();
+	}
+
+	void inherit(const LimitSettings& parent) {
+		if (requests.empty())
+			requests = parent.requests;
+		if (connections.empty())
+			connections = parent.connections;
+		if (!requestStatus)
+			requestStatus = parent.requestStatus;
+		if (!connectionStatus)
+			connectionStatus = parent.connectionStatus;
+	}
+};
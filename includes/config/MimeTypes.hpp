@@ -0,0 +1,63 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MimeTypes.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:40:05 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 19:40:06 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * MimeTypes.hpp
+ * Tabela extensão -> tipo MIME (blocos types { } / include mime.types)
+ * Depois de compile() a tabela é imutável: hash aberto com sondagem linear,
+ * chaves em minúsculas e ocupação máxima de 50%. find() compara sem
+ * distinguir maiúsculas e não aloca memória.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class MimeTypes {
+public:
+	MimeTypes();
+
+	/**
+	 * Associar uma extensão (sem o ponto) a um tipo
+	 * Uma extensão repetida fica com o último tipo
+	 */
+	void add(const std::string& type, const std::string& extension);
+	bool empty() const;
+
+	// Tipos usados sem bloco types no config (os mais comuns na web)
+	void addDefaults();
+
+	// Construir a tabela de hash (depois do último add())
+	void compile();
+
+	// Tipo da extensão, NULL se não houver
+	const std::string* find(const char* extension, size_t length) const;
+
+	// Número de extensões na tabela
+	size_t size() const;
+
+private:
+	struct Slot {
+		unsigned int hash;
+		int type;                  // Índice em _types (-1 = vazio)
+		std::string extension;     // Em minúsculas
+	};
+
+	std::vector<std::pair<std::string, std::string> > _entries; // (extensão, tipo) do config
+	std::vector<std::string> _types;                             // Tipos distintos
+	std::vector<Slot> _slots;
+	size_t _mask;
+	size_t _count;
+
+	static unsigned int hash(const char* extension, size_t length);
+};
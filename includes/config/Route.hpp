@@ -17,12 +17,24 @@
  */
 #pragma once
 
+#include "includes/config/LimitSettings.hpp"
+#include "includes/config/UpstreamSettings.hpp"
+#include "includes/config/CgiCacheSettings.hpp"
 #include <string>
 #include <vector>
 #include <map>
 
 class Route {
 public:
+	// Métodos como bits (máscara compilada a partir de allow_methods)
+	enum Method {
+		METHOD_NONE   = 0,
+		METHOD_GET    = 1 << 0,
+		METHOD_POST   = 1 << 1,
+		METHOD_DELETE = 1 << 2
+	};
+	static Method methodFromString(const std::string& method);
+
 	// Constructors
 	Route();
 	Route(const std::string& path);
@@ -36,12 +48,27 @@ public:
 	const std::string& getRedirect() const;
 	const std::string& getRoot() const;
 	bool isDirectoryListingEnabled() const;
+	bool isDirectoryListingJson() const;
 	const std::vector<std::string>& getIndexFiles() const;
 	bool isCgiEnabled() const;
 	const std::string& getCgiPath() const;
 	const std::string& getCgiExtension() const;
 	bool isUploadEnabled() const;
 	const std::string& getUploadPath() const;
+	bool isGzipEnabled() const;
+	bool isGzipStaticEnabled() const;
+	size_t getGzipMinLength() const;
+	size_t getGzipMaxLength() const;
+	int getGzipCompLevel() const;
+	const std::vector<std::string>& getGzipTypes() const;
+	bool isGzipType(const std::string& contentType) const;
+	bool isStubStatus() const;
+	int getMetricsId() const;
+	const std::string& getDefaultType() const;
+	const LimitSettings& getLimits() const;
+	bool isProxy() const;
+	const ProxySettings& getProxy() const;
+	const CgiCacheSettings& getCgiCache() const;
 
 	// Setters
 	void setPath(const std::string& path);
@@ -49,12 +76,46 @@ public:
 	void setRedirect(const std::string& redirect);
 	void setRoot(const std::string& root);
 	void setDirectoryListing(bool enabled);
+	void setDirectoryListingJson(bool json);
 	void addIndexFile(const std::string& indexFile);
 	void setCgiEnabled(bool enabled);
 	void setCgiPath(const std::string& cgiPath);
 	void setCgiExtension(const std::string& extension);
 	void setUploadEnabled(bool enabled);
 	void setUploadPath(const std::string& uploadPath);
+	void setGzip(bool enabled);
+	void setGzipStatic(bool enabled);
+	void setGzipMinLength(size_t length);
+	void setGzipMaxLength(size_t length);
+	void setGzipCompLevel(int level);
+	void addGzipType(const std::string& contentType);
+	void setStubStatus(bool enabled);
+	void setMetricsId(int id);
+	void setDefaultType(const std::string& type);
+	void addLimitReq(const LimitReqSettings& limit);
+	void addLimitConn(const LimitConnSettings& limit);
+	void setLimitReqStatus(int status);
+	void setLimitConnStatus(int status);
+	void inheritLimits(const LimitSettings& server);
+	void setProxyPass(int upstream, const std::string& uri, bool hasUri);
+	void setProxyConnectTimeout(double seconds);
+	void setProxyReadTimeout(double seconds);
+	void setCgiCache(bool enabled);
+	void setCgiCacheValid(double seconds);
+	void setCgiCacheStale(double seconds);
+	void addCgiCacheVary(const std::string& header);
+
+	/**
+	 * Compilação: congela o descriptor usado em runtime pelos handlers
+	 * Máscara de métodos, extensão CGI normalizada e root absoluta
+	 * Chamado por Server::compile() depois do parse
+	 */
+	void compile();
+	bool isCompiled() const;
+	bool isMethodAllowed(Method method) const;
+	const std::string& getResolvedRoot() const;
+	bool matchesCgiExtension(const std::string& filePath) const;
+	std::string resolvePath(const std::string& requestPath) const;
 
 	// Validation
 	bool isMethodAllowed(const std::string& method) const;
@@ -69,10 +130,32 @@ private:
 	std::string _redirect;                      // Redirect URL (se configurado)
 	std::string _root;                          // Root directory para esta route
 	bool _directoryListing;                     // Directory listing enabled?
+	bool _directoryListingJson;                 // autoindex_format json (senão html)
 	std::vector<std::string> _indexFiles;       // Index files (index.html, index.php)
 	bool _cgiEnabled;                           // CGI enabled para esta route?
 	std::string _cgiPath;                       // Path do executável CGI
 	std::string _cgiExtension;                  // Extensão de ficheiros CGI (.php, .py)
 	bool _uploadEnabled;                        // Upload enabled?
 	std::string _uploadPath;                    // Directory para uploads
+	bool _gzip;                                 // Compressão gzip on-the-fly?
+	bool _gzipStatic;                           // Servir ficheiros .gz pré-comprimidos?
+	size_t _gzipMinLength;                      // Tamanho mínimo para comprimir (bytes)
+	size_t _gzipMaxLength;                      // Tamanho máximo para comprimir on-the-fly (bytes)
+	int _gzipCompLevel;                         // Nível de compressão (1-9)
+	std::vector<std::string> _gzipTypes;        // MIME types comprimíveis
+	bool _gzipTypesConfigured;                  // gzip_types definido no config?
+	bool _stubStatus;                           // Location serve as métricas (stub_status)?
+	int _metricsId;                             // Histograma de latência (Config::compile())
+	std::string _defaultType;                   // default_type (vazio = o global)
+	LimitSettings _limits;                      // limit_req / limit_conn (vazio = os do server)
+	ProxySettings _proxy;                       // proxy_pass (upstream -1 = sem proxy)
+	CgiCacheSettings _cgiCache;                 // cgi_cache (respostas CGI em memória)
+
+	// Descriptor compilado (ver compile())
+	bool _compiled;
+	unsigned _methodMask;                       // Bits de Method permitidos
+	std::string _resolvedRoot;                  // Root absoluta, sem '/' final
+	std::string _cgiExtensionKey;               // Extensão CGI sem o ponto ("py")
+
+	void setDefaultGzipTypes();
 };
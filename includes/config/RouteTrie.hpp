@@ -0,0 +1,59 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RouteTrie.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:25:50 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:25:51 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * RouteTrie.hpp
+ * Trie de segmentos de path compilada a partir das routes de um server
+ * Cada aresta é um segmento ("/api/v1" -> "", "api", "v1"), guardada numa
+ * hash table indexada por (nó pai, segmento): o match percorre o path uma
+ * vez, em O(tamanho do path), independentemente do número de routes
+ * Semântica igual ao match linear: prefixo mais longo que termina numa
+ * fronteira de segmento, com "/" como fallback
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Route;
+
+class RouteTrie {
+public:
+	RouteTrie();
+
+	// Compilar as routes (guarda índices, por isso sobrevive a cópias do Server)
+	void build(const std::vector<Route>& routes);
+
+	/**
+	 * Route com o prefixo mais longo para o path
+	 * @return: Índice em routes, ou -1 se nenhuma route (nem "/") serve
+	 */
+	int match(const std::string& path) const;
+
+private:
+	struct Edge {
+		size_t hash;
+		int parent;
+		int child;             // -1 = slot livre
+		std::string segment;
+	};
+
+	std::vector<int> _nodeRoutes;  // Route que termina em cada nó (-1 = nenhuma)
+	std::vector<Edge> _edges;      // Endereçamento aberto, capacidade potência de 2
+	size_t _edgeCount;
+	int _rootRoute;                // Route "/" (fallback)
+
+	int findChild(int node, const char* segment, size_t length) const;
+	int addChild(int node, const std::string& segment);
+	void grow();
+	static size_t hash(int node, const char* segment, size_t length);
+};
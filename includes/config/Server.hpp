@@ -18,12 +18,22 @@
 #pragma once
 
 #include "includes/config/Route.hpp"
+#include "includes/config/RouteTrie.hpp"
+#include "includes/config/AccessLogSettings.hpp"
+#include "includes/config/LimitSettings.hpp"
 #include <string>
 #include <vector>
 #include <map>
 
 class Server {
 public:
+	// access_log do server: herdado do nível global, próprio ou "off"
+	enum AccessLogMode {
+		ACCESS_LOG_INHERIT,
+		ACCESS_LOG_SET,
+		ACCESS_LOG_OFF
+	};
+
 	// Constructors
 	Server();
 	~Server();
@@ -39,6 +49,27 @@ public:
 	const std::vector<Route>& getRoutes() const;
 	bool isDefaultServer() const;
 
+	// TLS (ports declared with "listen ... ssl")
+	bool isSslPort(int port) const;
+	bool hasSsl() const;
+	const std::string& getSslCertificate() const;
+	const std::string& getSslCertificateKey() const;
+	size_t getSslSessionCache() const;
+	long getSslSessionTimeout() const;
+	bool getSslSessionTickets() const;
+
+	// Access log
+	AccessLogMode getAccessLogMode() const;
+	const std::vector<AccessLogSettings>& getAccessLogs() const;
+	const std::vector<int>& getAccessLogIds() const;   // Índices em Config::getAccessLogs()
+
+	// Tempos por fase do pedido
+	bool hasServerTiming() const;            // Header Server-Timing nas respostas?
+	double getSlowRequestThreshold() const;  // Segundos (0 = sem trace)
+
+	// limit_req / limit_conn do server (as locations sem limites herdam estes)
+	const LimitSettings& getLimits() const;
+
 	// Setters
 	void addPort(int port);
 	void setHost(const std::string& host);
@@ -47,12 +78,39 @@ public:
 	void setErrorPage(int code, const std::string& path);
 	void addRoute(const Route& route);
 	void setDefaultServer(bool isDefault);
+	void addSslPort(int port);
+	void setSslCertificate(const std::string& path);
+	void setSslCertificateKey(const std::string& path);
+	void setSslSessionCache(size_t entries);
+	void setSslSessionTimeout(long seconds);
+	void setSslSessionTickets(bool enabled);
+	void addAccessLog(const AccessLogSettings& settings);
+	void setAccessLogOff();
+	void setAccessLogIds(const std::vector<int>& ids);
+	void setServerTiming(bool enabled);
+	void setSlowRequestThreshold(double seconds);
+	void addLimitReq(const LimitReqSettings& limit);
+	void addLimitConn(const LimitConnSettings& limit);
+	void setLimitReqStatus(int status);
+	void setLimitConnStatus(int status);
+
+	/**
+	 * Compilação (depois do parse): descriptors das routes, trie de routes
+	 * e ficheiros das error pages já resolvidos pela route "/"
+	 */
+	void compile();
 
-	// Route matching
+	// Numerar as routes a partir de first (histogramas das métricas)
+	// @return: o próximo id livre
+	int assignMetricsIds(int first);
+
+	// Route matching (trie depois de compile(), linear antes disso)
 	const Route* matchRoute(const std::string& path) const;
+	const Route* matchRouteLinear(const std::string& path) const;
 
 	// Error page retrieval
 	std::string getErrorPage(int code) const;
+	const std::string* getErrorPageFile(int code) const; // NULL = página default
 
 	// Validation
 	bool isValid() const;
@@ -66,6 +124,29 @@ private:
 	std::vector<std::string> _serverNames;      // Server names (ex: example.com, www.example.com)
 	size_t _maxBodySize;                        // Tamanho máximo do body (bytes)
 	std::map<int, std::string> _errorPages;     // Error pages customizadas
+	std::map<int, std::string> _errorPageFiles; // Error pages resolvidas (compile())
 	std::vector<Route> _routes;                 // Routes/locations
+	RouteTrie _routeTrie;                       // Routes compiladas para o match
+	bool _routesCompiled;                       // _routeTrie está atualizada?
 	bool _isDefaultServer;                      // É o default server para este host:port?
+
+	// TLS
+	std::vector<int> _sslPorts;                 // Portas com "ssl" no listen
+	std::string _sslCertificate;                // Certificado (PEM, pode incluir a chain)
+	std::string _sslCertificateKey;             // Chave privada (PEM)
+	size_t _sslSessionCache;                    // Sessões guardadas para resumption (0 = off)
+	long _sslSessionTimeout;                    // Validade das sessões/tickets (segundos)
+	bool _sslSessionTickets;                    // Session tickets (RFC 5077) ativos?
+
+	// Access log
+	AccessLogMode _accessLogMode;
+	std::vector<AccessLogSettings> _accessLogs; // Só com ACCESS_LOG_SET
+	std::vector<int> _accessLogIds;             // Atribuídos por Config::compile()
+
+	// Tempos por fase
+	bool _serverTiming;                         // server_timing on?
+	double _slowRequestThreshold;               // slow_request_threshold (segundos, 0 = off)
+
+	// Limites por cliente
+	LimitSettings _limits;
 };
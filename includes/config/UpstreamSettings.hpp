@@ -0,0 +1,81 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   UpstreamSettings.hpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 17:20:04 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 17:20:05 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * UpstreamSettings.hpp
+ * Servidores de aplicação para onde o proxy_pass encaminha os pedidos
+ * upstream <nome> {
+ *     server <host>:<porta> [weight=N] [max_fails=N] [fail_timeout=10s];
+ *     least_conn;  ou  hash $remote_addr|$request_uri;
+ *     keepalive <N>;  keepalive_timeout 60s;
+ * }
+ * proxy_pass http://<host>:<porta>[/uri];  ou  proxy_pass http://<upstream>[/uri];
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Um servidor de um upstream
+struct UpstreamPeerSettings {
+	std::string host;
+	int port;
+	unsigned int weight;       // Peso no round-robin / least_conn
+	unsigned int maxFails;     // Falhas em fail_timeout até ficar em baixo (0 = nunca)
+	double failTimeout;        // Janela das falhas e tempo em baixo (segundos)
+
+	UpstreamPeerSettings()
+		: port(80)
+		, weight(1)
+		, maxFails(1)
+		, failTimeout(10) {
+	}
+};
+
+// Grupo de servidores (bloco upstream, ou implícito num proxy_pass http://host:porta)
+struct UpstreamSettings {
+	enum Balance {
+		BALANCE_ROUND_ROBIN,   // Round-robin com pesos (por omissão)
+		BALANCE_LEAST_CONN,    // Menos pedidos em curso (relativo ao peso)
+		BALANCE_HASH           // O mesmo cliente / URI vai sempre para o mesmo servidor
+	};
+
+	std::string name;
+	std::vector<UpstreamPeerSettings> peers;
+	Balance balance;
+	bool hashUri;              // hash $request_uri (senão $remote_addr)
+	unsigned int keepalive;    // Ligações inativas guardadas (0 = fechar após cada resposta)
+	double keepaliveTimeout;   // Tempo máximo de uma ligação inativa (segundos)
+
+	UpstreamSettings()
+		: balance(BALANCE_ROUND_ROBIN)
+		, hashUri(false)
+		, keepalive(32)
+		, keepaliveTimeout(60) {
+	}
+};
+
+// proxy_pass de uma location
+struct ProxySettings {
+	int upstream;              // Índice em Config::getUpstreams() (-1 = sem proxy_pass)
+	std::string uri;           // Substitui o prefixo da location (proxy_pass com /uri)
+	bool hasUri;
+	double connectTimeout;     // proxy_connect_timeout (segundos)
+	double readTimeout;        // proxy_read_timeout: entre duas leituras / escritas
+
+	ProxySettings()
+		: upstream(-1)
+		, hasUri(false)
+		, connectTimeout(60)
+		, readTimeout(60) {
+	}
+};
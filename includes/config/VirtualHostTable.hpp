@@ -0,0 +1,84 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   VirtualHostTable.hpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:02:37 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:02:38 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * VirtualHostTable.hpp
+ * Índice de server_name -> Server para um listener (host:port)
+ * Nomes exatos, wildcards à esquerda ("*.example.com", ".example.com") e à
+ * direita ("www.example.*") ficam em hash tables de endereçamento aberto,
+ * por isso o custo de um lookup depende do número de labels do Host e não
+ * do número de virtual hosts
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Server;
+
+class VirtualHostTable {
+public:
+	VirtualHostTable();
+	~VirtualHostTable();
+
+	/**
+	 * Indexar todos os servers que escutam em host:port
+	 * O primeiro server é o default (usado quando nenhum nome coincide)
+	 */
+	void build(const std::vector<Server>& servers, const std::string& host, int port);
+
+	// Registar um nome (exato ou com wildcard); o primeiro registo ganha
+	void add(const std::string& name, const Server* server);
+	void setDefault(const Server* server);
+
+	/**
+	 * Escolher o server para o valor de um Host header
+	 * Ordem: nome exato, wildcard à esquerda mais longo, wildcard à direita
+	 * mais longo, default
+	 */
+	const Server* find(const std::string& hostHeader) const;
+
+	const Server* getDefault() const;
+	size_t size() const;
+
+private:
+	// Hash table de endereçamento aberto (linear probing, load <= 1/2)
+	class NameIndex {
+	public:
+		NameIndex();
+		bool insert(const std::string& name, const Server* server);
+		const Server* find(const char* name, size_t length) const;
+		size_t size() const;
+
+	private:
+		struct Slot {
+			size_t hash;
+			std::string name;      // Vazio = slot livre
+			const Server* server;
+		};
+
+		std::vector<Slot> _slots;  // Capacidade é sempre potência de 2
+		size_t _count;
+
+		void grow();
+	};
+
+	NameIndex _exact;    // "www.example.com"
+	NameIndex _suffix;   // ".example.com" (de "*.example.com" ou ".example.com")
+	NameIndex _prefix;   // "www.example." (de "www.example.*")
+	const Server* _default;
+
+	static size_t hash(const char* data, size_t length);
+
+	// Host header -> nome em minúsculas, sem porta nem ponto final
+	static size_t normalize(const std::string& hostHeader, char* out, size_t capacity);
+};
@@ -20,6 +20,7 @@
 #include <string>
 #include <map>
 #include "includes/core/Instance.hpp"
+#include "includes/config/MimeTypes.hpp"
 
 /**
  * Classe Settings - Gerenciador de configurações do sistema
@@ -48,12 +49,29 @@ class Settings {
 		 */
 		const std::string& httpMimeType(const std::string& ext) const;
 
+		/**
+		 * Igual, sem alocar: a extensão é um pedaço do path
+		 * @param fallback: tipo quando a extensão não é conhecida
+		 *                  (default_type da location; vazio = default global)
+		 */
+		const std::string& httpMimeType(const char* ext, size_t length,
+		                                const std::string& fallback) const;
+
+		/**
+		 * Substituir os tipos MIME pelos do config (types / default_type)
+		 * Chamado no arranque, antes do event loop
+		 */
+		void setMimeTypes(const MimeTypes& types, const std::string& defaultType);
+
 	private:
 		/**
 		 * Construtor privado - apenas Instance pode criar uma instância
 		 */
 		Settings();
 
+		MimeTypes _mimeTypes;          // Tabela compilada (imutável depois do arranque)
+		std::string _defaultType;      // default_type global
+
 		// Instance é friend para poder chamar o construtor privado
 		friend class Instance;
 };
@@ -0,0 +1,187 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLog.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:40:18 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 15:40:19 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * AccessLog.hpp
+ * Per-request access log (access_log / log_format directives)
+ * Formats are compiled once into literal and variable parts; lines are
+ * collected in a buffer and written when it fills up or after the flush
+ * interval. SIGUSR1 reopens the files so logrotate can move them away
+ */
+#pragma once
+
+#include "includes/config/AccessLogSettings.hpp"
+#include <string>
+#include <vector>
+#include <ctime>
+#include <csignal>
+
+class Server;
+
+namespace HTTP {
+
+class Request;
+class Response;
+
+// What the access log (and the metrics) know about one request
+struct RequestRecord {
+	// Timestamps along the life of a request (monotonic seconds, 0 = not reached)
+	enum Phase {
+		PHASE_ACCEPT,          // Connection accepted
+		PHASE_FIRST_BYTE,      // First request byte read
+		PHASE_HEADERS,         // Request head complete
+		PHASE_BODY,            // Request body complete
+		PHASE_HANDLER_START,   // RequestHandler::handle() called
+		PHASE_HANDLER_END,     // ... and returned
+		PHASE_CGI_SPAWN,       // CGI child forked
+		PHASE_CGI_EXIT,        // CGI output collected
+		PHASE_FIRST_SENT,      // First response byte written
+		PHASE_LAST_SENT,       // Last response byte written
+		PHASE_COUNT
+	};
+
+	std::string remoteAddr;
+	std::string method;
+	std::string uri;
+	std::string protocol;
+	std::string host;
+	std::string referer;
+	std::string userAgent;
+	int status;              // 0 = no response produced
+	size_t bytesSent;        // Head + body bytes written to the client
+	size_t headerBytes;      // Size of the response head
+	double phases[PHASE_COUNT];
+	int routeId;             // Route::getMetricsId() of the matched location (-1: none)
+	bool logged;
+
+	RequestRecord();
+
+	// Take method, URI, protocol and the logged headers from a parsed request
+	void setRequest(const Request& request);
+
+	size_t bodyBytesSent() const;
+
+	// Handler returned: HANDLER_END plus the CGI phases carried by the response
+	void handled(const Response& response);
+
+	// Record a phase the first time it is reached
+	void mark(Phase phase) { if (phases[phase] == 0) phases[phase] = now(); }
+
+	// Seconds between two phases (< 0 if either was not reached)
+	double elapsed(Phase from, Phase to) const;
+
+	// First request byte to last response byte (or to now, while in flight)
+	double requestTime() const;
+
+	// Server-Timing header value: the phases known once the handler returned
+	std::string serverTiming() const;
+
+	// One-line breakdown of every phase, for the slow request trace
+	std::string breakdown() const;
+
+	// Monotonic clock, in seconds
+	static double now();
+};
+
+class AccessLog {
+public:
+	AccessLog();
+	~AccessLog();
+
+	/**
+	 * Open the file and compile the format
+	 * @return: false (with error set) on an unknown variable or open failure
+	 */
+	bool open(const AccessLogSettings& settings, std::string& error);
+
+	// Format one request; lines are written once the buffer fills up
+	void write(const RequestRecord& record);
+
+	// Write out buffered lines (now, or if the flush interval has passed)
+	void flush();
+	void tick(time_t now);
+
+	// Reopen the file under the same descriptor (after logrotate)
+	bool reopen();
+
+private:
+	enum Variable {
+		LITERAL,
+		REMOTE_ADDR,
+		REQUEST,
+		REQUEST_METHOD,
+		REQUEST_URI,
+		SERVER_PROTOCOL,
+		HOST,
+		STATUS,
+		BODY_BYTES_SENT,
+		BYTES_SENT,
+		REQUEST_TIME,
+		PHASE_TIME,            // Seconds between two phases ($time_*, $upstream_cgi_time)
+		TIME_LOCAL,
+		TIME_ISO8601,
+		MSEC,
+		HTTP_REFERER,
+		HTTP_USER_AGENT
+	};
+
+	struct Part {
+		Variable variable;
+		std::string literal;   // Text for LITERAL parts
+		RequestRecord::Phase from;  // PHASE_TIME interval
+		RequestRecord::Phase to;
+	};
+
+	AccessLogSettings _settings;
+	std::vector<Part> _parts;
+	int _fd;
+	std::string _buffer;
+	time_t _lastFlush;
+	unsigned long _successCount;   // For sample=N
+
+	// Disable copy
+	AccessLog(const AccessLog& other);
+	AccessLog& operator=(const AccessLog& other);
+
+	bool compile(const std::string& format, std::string& error);
+	void appendValue(const std::string& value);
+};
+
+// Every access log in the configuration, indexed by Server::getAccessLogIds()
+class AccessLogs {
+public:
+	AccessLogs();
+	~AccessLogs();
+
+	bool open(const std::vector<AccessLogSettings>& logs);
+
+	// Log a finished request to its server's access logs (if any), and trace
+	// it if it took longer than the server's slow_request_threshold
+	void write(const Server* server, const RequestRecord& record);
+
+	// Called from the event loop: periodic flush and pending reopen
+	void tick();
+	void flush();
+
+	// SIGUSR1 handler: only sets a flag, tick() does the reopening
+	static void requestReopen(int signal);
+
+private:
+	std::vector<AccessLog*> _logs;
+	static volatile sig_atomic_t _reopenRequested;
+
+	// Disable copy
+	AccessLogs(const AccessLogs& other);
+	AccessLogs& operator=(const AccessLogs& other);
+};
+
+} // namespace HTTP
@@ -0,0 +1,125 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   DirectoryIndex.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:02:11 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:02:12 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * DirectoryIndex.hpp
+ * Directory listings (autoindex) with a bounded cache
+ * A listing is read once (entry types from d_type, no stat() per entry),
+ * sorted by name and kept until the directory's mtime changes; pages of it
+ * are rendered as HTML or JSON into body segments of bounded size
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "includes/core/Instance.hpp"
+
+namespace HTTP {
+
+class Response;
+
+class DirectoryIndex {
+public:
+	enum Format { FORMAT_HTML, FORMAT_JSON };
+	enum Sort { SORT_NAME, SORT_TYPE };  // SORT_TYPE: directories first, each group by name
+
+	// Page of a listing (from the query string: sort, order, offset, limit)
+	struct Page {
+		Sort sort;
+		bool descending;
+		size_t offset;
+		size_t limit;
+
+		Page();
+	};
+
+	static const size_t DEFAULT_LIMIT = 1000;
+	static const size_t MAX_LIMIT = 10000;
+
+	/**
+	 * Render one page of a directory listing into the response body
+	 * @param dirPath: Directory on disk
+	 * @param fileStat: stat() of the directory (validates the cached listing)
+	 * @param requestPath: Path shown in the page (links are relative to it)
+	 * @return: false if the directory can't be read
+	 */
+	bool render(const std::string& dirPath, const struct stat& fileStat,
+	            const std::string& requestPath, Format format, const Page& page,
+	            Response& response);
+
+	/**
+	 * Set the cache budget in bytes (0 disables caching)
+	 */
+	void setCapacity(size_t bytes);
+
+	// Statistics
+	size_t getSize() const;
+	size_t getHits() const;
+	size_t getMisses() const;
+
+private:
+	// Entry names are stored back to back in Listing::names
+	struct Entry {
+		unsigned int offset;
+		unsigned int length;
+		bool directory;
+	};
+
+	struct Listing {
+		dev_t dev;
+		ino_t ino;
+		time_t mtime;
+		long mtimeNsec;
+		time_t readAt;                      // When it was read (racy if <= mtime)
+		std::string names;
+		std::vector<Entry> entries;         // Sorted by name
+		std::vector<unsigned int> byType;   // Entry indexes, directories first
+		size_t directories;                 // Directories at the front of byType
+		size_t bytes;                       // Memory used (for the budget)
+	};
+
+	struct Node {
+		std::string path;
+		Listing listing;
+	};
+
+	struct NameLess {
+		const char* names;
+
+		bool operator()(const Entry& a, const Entry& b) const;
+	};
+
+	typedef std::list<Node> NodeList;
+
+	NodeList _nodes;                                 // Most recently used first
+	std::map<std::string, NodeList::iterator> _index;   // Directory path -> node
+	size_t _size;                                    // Bytes currently cached
+	size_t _capacity;                                // Budget in bytes
+	size_t _hits;
+	size_t _misses;
+	NodeList _uncached;                              // Listing too big to cache (one request)
+
+	const Listing* find(const std::string& dirPath, const struct stat& fileStat);
+	static bool read(const std::string& dirPath, const struct stat& fileStat, Listing& listing);
+	static size_t position(const Listing& listing, const Page& page, size_t i);
+	static bool isCurrent(const Listing& listing, const struct stat& fileStat);
+	void evict(size_t needed);
+
+	DirectoryIndex();
+	friend class ::Instance;
+};
+
+} // namespace HTTP
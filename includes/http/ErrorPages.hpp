@@ -0,0 +1,57 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ErrorPages.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 20:05:18 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 20:05:19 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * ErrorPages.hpp
+ * Error responses prepared when the configuration is loaded: the built-in
+ * page for every error status, and per server the error_page files (read
+ * once). Each one is serialized up front, so an error response is a handle
+ * to a shared page (see Response::prepare()) and costs no disk read and no
+ * HTML building
+ */
+#pragma once
+
+#include "includes/http/Response.hpp"
+#include <vector>
+#include <map>
+
+class Config;
+class Server;
+
+namespace HTTP {
+
+class ErrorPages {
+public:
+	ErrorPages();
+	~ErrorPages();
+
+	// Prepare every page (again) from the configuration
+	void open(const Config& config);
+
+	/**
+	 * Error response for status on server (NULL: built-in page)
+	 * Statuses without a prepared page are built with Response::errorResponse
+	 */
+	Response get(const Server* server, int status) const;
+
+private:
+	std::vector<Response> _defaults;                        // Indexed like STATUSES
+	std::map<const Server*, std::vector<Response> > _servers; // Servers with error_page
+
+	// Disable copy (handles point into the vectors)
+	ErrorPages(const ErrorPages& other);
+	ErrorPages& operator=(const ErrorPages& other);
+
+	static int indexOf(int status);
+};
+
+} // namespace HTTP
@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   GzipCache.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 12:20:04 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 12:20:05 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * GzipCache.hpp
+ * On-the-fly gzip compression with a bounded cache of compressed variants
+ * Variants are keyed by file identity (device, inode, mtime, size), so each
+ * version of a file is compressed once and evicted least-recently-used.
+ * Hits share the cached bytes with the response (no copy per request)
+ */
+#pragma once
+
+#include <string>
+#include <map>
+#include <list>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "includes/http/SharedBuffer.hpp"
+#include "includes/core/Instance.hpp"
+
+namespace HTTP {
+
+class GzipCache {
+public:
+	/**
+	 * Look up the compressed variant of a file
+	 * @param compressed: Shares the cached bytes on a hit
+	 * @return: false on a miss
+	 */
+	bool find(const struct stat& fileStat, int level, SharedBuffer& compressed);
+
+	/**
+	 * Store a compressed variant (evicting old entries to stay in budget)
+	 */
+	void insert(const struct stat& fileStat, int level, const SharedBuffer& compressed);
+
+	/**
+	 * Set the cache budget in bytes (0 disables caching)
+	 */
+	void setCapacity(size_t bytes);
+	size_t getCapacity() const;
+
+	// Statistics
+	size_t getSize() const;
+	size_t getHits() const;
+	size_t getMisses() const;
+
+	/**
+	 * Compress a buffer into gzip format
+	 * @param level: zlib compression level (1-9)
+	 * @return: false if zlib failed
+	 */
+	static bool compress(const std::string& input, std::string& output, int level);
+
+private:
+	struct Key {
+		dev_t dev;
+		ino_t ino;
+		time_t mtime;
+		off_t size;
+		int level;
+
+		bool operator<(const Key& other) const;
+	};
+
+	struct Entry {
+		Key key;
+		SharedBuffer data;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	EntryList _entries;                          // Most recently used first
+	std::map<Key, EntryList::iterator> _index;   // Key -> entry
+	size_t _size;                                // Bytes currently cached
+	size_t _capacity;                            // Budget in bytes
+	size_t _hits;
+	size_t _misses;
+
+	static Key makeKey(const struct stat& fileStat, int level);
+	void evict(size_t needed);
+
+	GzipCache();
+	friend class ::Instance;
+};
+
+} // namespace HTTP
@@ -0,0 +1,95 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:21:40 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:21:41 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Metrics.hpp
+ * Server counters and per-location latency histograms (stub_status location)
+ * Everything is plain integers updated from the event loop: recording a
+ * request is a few increments and a bit scan, with no allocation. The
+ * histograms are sized once from the configuration. render() produces the
+ * Prometheus text exposition format
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class Config;
+
+namespace HTTP {
+
+struct RequestRecord;
+
+class Metrics {
+public:
+	// Latency buckets: 128us, 256us, ... 2^16 * 128us (~8.4s), then +Inf
+	static const int BUCKETS = 17;
+	static const unsigned long FIRST_BUCKET_US = 128;
+
+	Metrics();
+	~Metrics();
+
+	// One histogram per location, indexed by Route::getMetricsId()
+	void open(const Config& config);
+
+	// Hot path (the same completion point as the access log)
+	void recordRequest(const RequestRecord& record);
+	void connectionAccepted() { ++_accepted; }
+	void bytesIn(size_t bytes) { _bytesIn += bytes; }
+	void bytesOut(size_t bytes) { _bytesOut += bytes; }
+	void cgiSpawned() { ++_cgiSpawns; }
+	void cgiTimedOut() { ++_cgiTimeouts; }
+	void tlsHandshake(bool resumed) { ++_tlsHandshakes; _tlsResumed += resumed; }
+	void tlsFailure() { ++_tlsFailures; }
+
+	// Connections per state, counted by the event loop on each pass
+	void setConnections(size_t reading, size_t writing, size_t http2);
+
+	// Prometheus text format (version 0.0.4)
+	std::string render() const;
+
+	// Bucket for a duration in microseconds (BUCKETS = +Inf)
+	static int bucketFor(unsigned long microseconds);
+
+private:
+	struct Histogram {
+		std::string labels;               // server="...",location="..."
+		unsigned long buckets[BUCKETS + 1]; // Per bucket (not cumulative)
+		unsigned long count;
+		double sum;                       // Seconds
+
+		Histogram();
+	};
+
+	unsigned long _accepted;
+	size_t _reading;
+	size_t _writing;
+	size_t _http2;
+	unsigned long _requests[6];           // [0] = unknown, [1..5] = 1xx..5xx
+	unsigned long _bytesIn;
+	unsigned long _bytesOut;
+	unsigned long _cgiSpawns;
+	unsigned long _cgiTimeouts;
+	unsigned long _tlsHandshakes;
+	unsigned long _tlsResumed;
+	unsigned long _tlsFailures;
+	std::vector<Histogram> _histograms;
+
+	// Disable copy
+	Metrics(const Metrics& other);
+	Metrics& operator=(const Metrics& other);
+
+	static std::string escapeLabel(const std::string& value);
+};
+
+} // namespace HTTP
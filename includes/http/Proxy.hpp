@@ -0,0 +1,151 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Proxy.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:06:12 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 18:06:13 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Proxy.hpp
+ * One request relayed to a proxy_pass upstream, driven by the event loop:
+ * non-blocking connect, request forwarding, then the response head and the
+ * (de-chunked) body are handed to the client connection as they arrive.
+ * Connections come from and go back to the upstream's keep-alive pool;
+ * failures before the response head move on to the next peer
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <sys/types.h>
+
+class Route;
+
+namespace HTTP {
+
+class Request;
+
+class Proxy {
+public:
+	typedef std::vector<std::pair<std::string, std::string> > HeaderList;
+
+	/**
+	 * @param clientAddress: X-Forwarded-For / X-Real-IP, and the hash key
+	 * @param secure: Client connection uses TLS (X-Forwarded-Proto)
+	 */
+	Proxy(const Route& route, const Request& request, const std::string& clientAddress, bool secure);
+	~Proxy();
+
+	// Pick a peer and connect (false: none could be reached, see getErrorStatus())
+	bool start();
+
+	// Upstream socket and the events it waits for (-1 / 0 when none)
+	int getFd() const;
+	short getPollEvents() const;
+
+	// When the current connect / read times out (monotonic, 0 = not waiting)
+	double getDeadline() const;
+
+	// Drive the exchange: poll() events on getFd(), or the clock
+	void handleEvent(short revents);
+	void checkTimeout(double now);
+
+	// Response head, once hasHead(): end-to-end headers as received
+	bool hasHead() const;
+	int getStatus() const;
+	const HeaderList& getHeaders() const;
+
+	// HTTP/1.1 head for a client connection closed after the response
+	// (chunked: the body is re-framed by the caller)
+	void buildHead(std::string& out, bool chunked) const;
+
+	// Body length known from the head (Content-Length, or no body at all);
+	// otherwise it runs until the upstream's last chunk / close
+	bool hasKnownLength() const;
+
+	// Body bytes received and not yet passed on to the client
+	const char* data() const;
+	size_t size() const;
+	void consume(size_t bytes);
+
+	bool isComplete() const;      // Whole body received
+	bool hasFailed() const;
+
+	// 502 / 504 when no response head could be obtained; 0 once the head
+	// was passed on (the client's response can only be cut short)
+	int getErrorStatus() const;
+
+private:
+	enum State {
+		STATE_IDLE,
+		STATE_CONNECTING,
+		STATE_SENDING,
+		STATE_READING_HEAD,
+		STATE_READING_BODY,
+		STATE_DONE,
+		STATE_FAILED
+	};
+
+	enum BodyMode { BODY_NONE, BODY_LENGTH, BODY_CHUNKED, BODY_UNTIL_CLOSE };
+	enum ChunkState { CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, CHUNK_TRAILER };
+
+	static const size_t MAX_HEAD = 65536;
+	static const size_t READ_SIZE = 16384;
+	static const size_t MAX_BUFFERED = 65536;   // Body held for a slow client before reads pause
+
+	int _upstream;
+	double _connectTimeout;
+	double _readTimeout;
+	std::string _clientAddress;
+	std::string _uri;               // Request URI (hash key, logs)
+	std::string _request;           // Head and body sent to every peer tried
+	bool _idempotent;               // Safe to send again to another peer
+	bool _headRequest;              // Response has no body
+
+	std::vector<bool> _tried;       // Peers already tried for this request
+	int _peer;
+	int _fd;
+	bool _reused;                   // Connection came from the keep-alive pool
+	State _state;
+	double _deadline;
+	size_t _sent;                   // Request bytes written on this connection
+	size_t _received;               // Response bytes read on this connection
+
+	std::string _head;              // Response head being received
+	bool _headDone;                 // Status and headers known (passed on to the client)
+	int _status;
+	std::string _reason;
+	HeaderList _headers;
+	bool _keepAlive;                // Upstream connection reusable after the body
+	BodyMode _bodyMode;
+	size_t _remaining;              // Length / chunk bytes still expected
+	ChunkState _chunkState;
+	std::string _line;              // Chunk size or trailer line
+	std::string _body;
+	size_t _bodyOffset;             // Bytes of _body already consumed
+	int _errorStatus;
+
+	void buildRequest(const Route& route, const Request& request, bool secure);
+	bool connectNext();
+	void sendRequest();
+	void receive();
+	void closedEarly();
+	bool parseHead();
+	void feed(const char* data, size_t length);
+	void append(const char* data, size_t length);
+	void finish(bool reusable);
+	void fail(int status, bool peerFault);
+	bool isPaused() const;
+
+	// Disable copy
+	Proxy(const Proxy& other);
+	Proxy& operator=(const Proxy& other);
+};
+
+} // namespace HTTP
@@ -0,0 +1,122 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RateLimiter.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:48:31 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:48:32 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * RateLimiter.hpp
+ * Per-client limits: limit_req (leaky bucket with burst and delay) and
+ * limit_conn (requests in progress) zones keyed by the client's IPv4
+ * address. Each zone is a fixed array of nodes sized from its memory
+ * budget, hashed with a per-process seed and recycled least-recently-used,
+ * so a flood of (spoofed) addresses can't grow it
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <netinet/in.h>
+#include "includes/config/LimitSettings.hpp"
+
+class Config;
+
+namespace HTTP {
+
+class RateLimiter {
+public:
+	// limit_conn slots held by a request, released when it completes
+	struct Slot {
+		unsigned int zone;
+		unsigned int node;
+	};
+	typedef std::vector<Slot> Slots;
+
+	RateLimiter();
+	~RateLimiter();
+
+	// Build the zones from the configuration (again)
+	void open(const Config& config);
+
+	// Any zone configured? (no per-request work otherwise)
+	bool enabled() const;
+
+	/**
+	 * Account a request against the limit_req rules
+	 * @param delay: Set to the seconds the request must wait (0 = none)
+	 * @return: 0 to serve it, or the status to reject it with
+	 */
+	int limitRequest(const LimitSettings& limits, in_addr_t address, double& delay);
+
+	/**
+	 * Take a slot in each limit_conn zone
+	 * @return: 0 (slots filled), or the status to reject the request with
+	 */
+	int acquire(const LimitSettings& limits, in_addr_t address, Slots& slots);
+
+	// Give back the slots of a finished request
+	void release(Slots& slots);
+
+	// Statistics
+	size_t getDelayed() const;
+	size_t getRejected() const;
+
+private:
+	static const unsigned int NONE = 0xFFFFFFFFu;
+
+	struct Node {
+		in_addr_t address;
+		unsigned int hashNext;      // Next node in the same bucket
+		unsigned int prev;          // LRU list (idle nodes only)
+		unsigned int next;
+		unsigned int connections;   // limit_conn: requests in progress
+		long excess;                // limit_req: requests over the rate, x1000
+		long long last;             // limit_req: last accepted request (ms)
+	};
+
+	class Zone {
+	public:
+		Zone(const LimitZoneSettings& settings, unsigned int seed);
+
+		// Node of an address (recycling the least recently used one)
+		// @return: NONE if every node is busy (limit_conn)
+		unsigned int lookup(in_addr_t address);
+
+		void touch(unsigned int index);       // Most recently used
+		void hold(unsigned int index);        // In use: not recyclable
+		void unhold(unsigned int index);
+
+		Node& at(unsigned int index);
+		unsigned long rate() const;
+		const std::string& name() const;
+
+	private:
+		std::string _name;
+		unsigned long _rate;                  // Requests per 1000 seconds
+		unsigned int _seed;
+		unsigned int _mask;                   // Buckets - 1 (power of two)
+		std::vector<Node> _nodes;
+		std::vector<unsigned int> _buckets;
+		unsigned int _head;                   // Most recently used idle node
+		unsigned int _tail;                   // Next to recycle
+		unsigned int _free;                   // Never used nodes (chained by next)
+
+		unsigned int bucketOf(in_addr_t address) const;
+		void unlink(unsigned int index);
+		void pushFront(unsigned int index);
+		void unhash(unsigned int index);
+	};
+
+	std::vector<Zone> _zones;
+	size_t _delayed;
+	size_t _rejected;
+};
+
+} // namespace HTTP
@@ -32,6 +32,11 @@ public:
 	bool parse(const std::string& rawRequest);
 	bool isComplete() const;
 
+	// Build from already-decoded parts (HTTP/2 streams)
+	bool assign(const std::string& method, const std::string& uri, const std::string& version,
+	            const std::vector<std::pair<std::string, std::string> >& headers,
+	            const std::string& body);
+
 	// Getters
 	const std::string& getMethod() const;
 	const std::string& getUri() const;
@@ -51,10 +56,20 @@ public:
 	// Connection properties
 	bool keepAlive() const;
 
+	// Peer address of the connection (set by its owner after parsing)
+	void setRemoteAddr(const std::string& addr);
+	const std::string& getRemoteAddr() const;
+
+	// Content negotiation (Accept-Encoding, honours q=0)
+	bool acceptsEncoding(const std::string& coding) const;
+
 	// Query string helpers
 	std::map<std::string, std::string> getQueryParams() const;
 	std::string getQueryParam(const std::string& name) const;
 
+	// Percent-decoding ("+" decodes to a space)
+	static std::string urlDecode(const std::string& str);
+
 	// Form data helpers (application/x-www-form-urlencoded)
 	std::map<std::string, std::string> getFormData() const;
 	std::string getFormField(const std::string& name) const;
@@ -83,6 +98,9 @@ private:
 	// Body
 	std::string _body;
 
+	// Client
+	std::string _remoteAddr;
+
 	// Parsing state
 	bool _complete;
 	size_t _contentLength;
@@ -100,7 +118,6 @@ private:
 	void parseUri(const std::string& uri);
 	bool parseChunkedBody(const std::string& rawBody);
 	std::string decodeChunkedBody(const std::string& chunkedData);
-	std::string urlDecode(const std::string& str) const;
 	std::string toLowerCase(const std::string& str) const;
 	std::string trim(const std::string& str) const;
 };
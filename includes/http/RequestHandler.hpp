@@ -20,6 +20,7 @@
 #include "Response.hpp"
 #include "includes/config/Server.hpp"
 #include "includes/config/Route.hpp"
+#include <sys/stat.h>
 
 namespace HTTP {
 
@@ -32,8 +33,24 @@ public:
 	// Handle request
 	Response handle(const Request& request);
 
+	// Evaluate route, method and body size from the headers alone
+	// Returns false and fills rejection if the body should not be sent
+	bool acceptsBody(const Request& request, Response& rejection);
+
+	// Location matched by the last handle()/acceptsBody() (NULL if none)
+	const Route* getRoute() const;
+
+	// Multipart parsing (parts without a filename are skipped)
+	struct UploadedFile {
+		std::string filename;
+		std::string contentType;
+		std::string content;
+	};
+	static std::vector<UploadedFile> parseMultipartData(const std::string& body, const std::string& boundary);
+
 private:
 	const Server* _server;
+	const Route* _route;
 
 	// Method handlers
 	Response handleGet(const Request& request, const Route* route);
@@ -45,11 +62,26 @@ private:
 	std::string getFileExtension(const std::string& path);
 	bool fileExists(const std::string& path);
 	bool isDirectory(const std::string& path);
-	std::string readFile(const std::string& path);
-	std::string generateDirectoryListing(const std::string& path, const std::string& requestPath);
+	bool readFile(const std::string& path, std::string& content);
+	Response directoryListing(const Request& request, const Route* route, const std::string& dirPath);
 	bool hasWritePermission(const std::string& path);
 	bool hasReadPermission(const std::string& path);
+	bool isCgiScript(const std::string& filePath, const Route* route);
+	static bool isStaticExtension(const std::string& extension);
 	std::string generateETag(const std::string& filePath);
+	bool gzipVariant(const std::string& filePath, const struct stat& fileStat,
+	                 int level, SharedBuffer& compressed);
+
+	// Range requests (RFC 7233)
+	struct ByteRange {
+		off_t first;  // First byte (inclusive)
+		off_t last;   // Last byte (inclusive)
+	};
+	static const size_t MAX_RANGES = 16;
+	int parseRangeHeader(const std::string& header, off_t fileSize, std::vector<ByteRange>& ranges);
+	bool ifRangeMatches(const Request& request, const std::string& etag, time_t mtime);
+	Response serveRanges(Response& response, const std::string& filePath, off_t fileSize,
+	                     const std::string& contentType, const std::vector<ByteRange>& ranges);
 
 	// POST helpers
 	Response handleFormData(const Request& request, const Route* route);
@@ -57,15 +89,8 @@ private:
 	Response handleCGI(const Request& request, const Route* route, const std::string& scriptPath);
 	std::string saveUploadedFile(const std::string& content, const std::string& filename, const std::string& uploadDir);
 
-	// Multipart parsing
-	struct UploadedFile {
-		std::string filename;
-		std::string contentType;
-		std::string content;
-	};
-	std::vector<UploadedFile> parseMultipartData(const std::string& body, const std::string& boundary);
-
-	// Error responses
+	// Error responses (prepared pages, see ErrorPages)
+	Response errorPage(int status);
 	Response notFound(const std::string& path);
 	Response forbidden(const std::string& path);
 	Response methodNotAllowed(const std::string& method);
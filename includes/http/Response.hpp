@@ -13,17 +13,51 @@
 /**
  * Response.hpp
  * HTTP Response class - builds HTTP responses
+ *
+ * Headers are kept preformatted ("Name: value\r\n" lines in one string);
+ * Content-Length and Connection are stored as values and written by build(),
+ * which sizes the output once and appends the precomputed status line.
+ * Every response carries a Date header (Clock's once-per-second string)
+ * unless one was set explicitly
  */
 #pragma once
 
 #include <string>
-#include <map>
-#include <sstream>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <sys/types.h>
+#include "includes/http/SharedBuffer.hpp"
 
 namespace HTTP {
 
+// Well-known header names (sizeof gives the length at compile time)
+namespace HeaderName {
+	const char DATE[] = "Date";
+	const char CONTENT_TYPE[] = "Content-Type";
+	const char CONTENT_LENGTH[] = "Content-Length";
+	const char CONNECTION[] = "Connection";
+	const char TRANSFER_ENCODING[] = "Transfer-Encoding";
+	const char LAST_MODIFIED[] = "Last-Modified";
+	const char ETAG[] = "ETag";
+	const char CACHE_CONTROL[] = "Cache-Control";
+	const char LOCATION[] = "Location";
+}
+
 class Response {
 public:
+	// Body segment: either in-memory bytes or a byte range of the response file
+	struct Segment {
+		bool fromFile;        // true: [offset, offset + length) of the file
+		off_t offset;
+		size_t length;
+		std::string data;     // In-memory bytes (when !fromFile)
+		SharedBuffer shared;  // Or shared ones, not copied (when !fromFile)
+
+		// In-memory bytes, whichever holds them
+		const char* bytes() const;
+	};
+
 	// Constructor
 	Response();
 	~Response();
@@ -32,8 +66,12 @@ public:
 	void setStatus(int code);
 	void setStatus(int code, const std::string& message);
 
-	// Headers
+	// Headers (a header set twice keeps the last value)
 	void setHeader(const std::string& name, const std::string& value);
+	template <size_t N>
+	void setHeader(const char (&name)[N], const std::string& value) {
+		setHeader(name, N - 1, value.data(), value.length());
+	}
 	void setContentType(const std::string& contentType);
 	void setContentLength(size_t length);
 	void setLastModified(time_t mtime);
@@ -44,37 +82,89 @@ public:
 	void setBody(const std::string& body);
 	void appendBody(const std::string& chunk);
 
+	// File-backed body (sent zero-copy by the connection)
+	void setFile(const std::string& path);
+	void appendFileRange(off_t offset, size_t length);
+	void appendSegment(const std::string& data);
+	void appendSegment(const SharedBuffer& data);
+	bool hasFileBody() const;
+	const std::string& getFilePath() const;
+	const std::vector<Segment>& getSegments() const;
+
 	// Chunked transfer encoding
 	void setChunked(bool chunked);
-	std::string buildChunkedResponse() const;
 
 	// Connection
 	void setKeepAlive(bool keepAlive);
 
-	// Build response string
+	// When the CGI child was forked and its output collected (monotonic
+	// seconds, 0 = not a CGI response), for the request phase timing
+	void setCgiTiming(double spawned, double exited);
+	double getCgiSpawned() const;
+	double getCgiExited() const;
+
+	// Build response string (head + in-memory body, file segments excluded)
 	std::string build() const;
 
+	// Same, into out (reuses its capacity)
+	void buildInto(std::string& out) const;
+
+	/**
+	 * Prepared responses (error pages): prepare() serializes the response
+	 * once; prepared(page) is a handle that shares it and whose build only
+	 * copies the bytes and stamps the current Date. Changing a handle gives
+	 * it its own copy first. The page must outlive its handles
+	 */
+	void prepare();
+	static Response prepared(const Response& page);
+
 	// Getters
 	int getStatusCode() const;
 	const std::string& getBody() const;
+	std::string getHeader(const std::string& name) const;
+	void getHeaders(std::vector<std::pair<std::string, std::string> >& fields) const;
 
 	// Common responses
 	static Response errorResponse(int code, const std::string& message = "");
 	static Response redirect(const std::string& location, int code = 302);
 
+	// Format time as HTTP date (RFC 7231)
+	static std::string formatHttpDate(time_t time);
+
 	// Reset
 	void clear();
 
 private:
+	enum ConnectionHeader { CONNECTION_NONE, CONNECTION_KEEP_ALIVE, CONNECTION_CLOSE };
+
 	int _statusCode;
-	std::string _statusMessage;
-	std::map<std::string, std::string> _headers;
+	const char* _statusLine;            // Precomputed "HTTP/1.1 200 OK\r\n" (NULL: custom)
+	size_t _statusLineLength;
+	std::string _statusMessage;         // Custom reason phrase (when _statusLine is NULL)
+	std::string _headers;               // Preformatted "Name: value\r\n" lines
+	size_t _contentLength;
+	bool _hasContentLength;
+	ConnectionHeader _connection;
+	bool _hasDate;                      // Date set explicitly (e.g. by a CGI script)
 	std::string _body;
 	bool _chunked;
+	std::string _filePath;              // File backing the segments (if any)
+	std::vector<Segment> _segments;     // Body segments sent after the head
+	size_t _segmentsLength;             // Total bytes in _segments
+	double _cgiSpawned;                 // CGI fork time (0 = no CGI)
+	double _cgiExited;                  // CGI output collected
+	const Response* _prepared;          // Shared prepared page (handles only)
+	std::string _serialized;            // prepare(): the whole response
+	size_t _dateOffset;                 // Date value inside _serialized (npos: none)
+
+	void setHeader(const char* name, size_t nameLength, const char* value, size_t valueLength);
+	size_t findHeader(const char* name, size_t nameLength) const;
+	void appendHead(std::string& out) const;
+	size_t headLength() const;
+	void detach();
 
 	// Get status message for code
 	std::string getStatusMessage(int code) const;
-	std::string formatHttpDate(time_t time) const;
 };
 
 } // namespace HTTP
@@ -20,6 +20,8 @@
 #include "includes/config/Config.hpp"
 #include "includes/network/Socket.hpp"
 #include "includes/network/Connection.hpp"
+#include "includes/network/TlsContext.hpp"
+#include "includes/config/VirtualHostTable.hpp"
 #include <string>
 #include <vector>
 #include <map>
@@ -64,10 +66,17 @@ namespace HTTP {
 	private:
 		Config _config;                           // Server configuration
 		std::vector<Socket*> _listeningSockets;   // Listening sockets
+		std::map<int, TlsContext*> _tlsContexts;  // TLS listeners (listening fd -> context)
+		std::map<int, VirtualHostTable> _virtualHosts; // Listening fd -> server_name index
 		std::map<int, Connection*> _connections;  // Active connections (fd -> Connection)
 		std::vector<struct pollfd> _pollFds;      // Poll file descriptors
 		bool _running;                            // Is server running?
 		time_t _timeout;                          // Connection timeout (seconds)
+		double _nextResume;                       // Earliest delayed request (monotonic, 0 = none)
+		size_t _upstreamStart;                    // First proxy_pass upstream entry in _pollFds
+		std::vector<int> _upstreamOwners;         // Client fd of each upstream entry
+		double _nextUpstreamTimeout;              // Earliest upstream connect / read timeout (0 = none)
+		size_t _refreshStart;                     // First cgi_cache refresh entry in _pollFds
 
 		// Setup
 		bool setupListeningSockets();
@@ -83,6 +92,9 @@ namespace HTTP {
 		void handleClientSocket(int fd, short revents);
 		void acceptNewConnection(Socket* listenSocket);
 		void closeConnection(int fd);
+		void resumeDelayedConnections();
+		void handleUpstreamSocket(size_t index, short revents);
+		void expireUpstreams();
 
 		// Cleanup
 		void cleanupTimedOutConnections();
@@ -0,0 +1,52 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   SharedBuffer.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:20:05 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:20:06 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * SharedBuffer.hpp
+ * Immutable bytes shared by reference count
+ * Lets a cache hand the same buffer to many responses without copying it:
+ * an entry evicted while responses still send it stays alive until the last
+ * of them is done. Not thread-safe (only the event loop uses it)
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace HTTP {
+
+class SharedBuffer {
+public:
+	SharedBuffer();
+	SharedBuffer(const SharedBuffer& other);
+	SharedBuffer& operator=(const SharedBuffer& other);
+	~SharedBuffer();
+
+	// Take over the bytes of data (leaves it empty, no copy)
+	void adopt(std::string& data);
+
+	const char* data() const;
+	size_t size() const;
+	bool empty() const;
+
+private:
+	struct Block {
+		std::string bytes;
+		size_t refs;
+	};
+
+	Block* _block;   // NULL when empty
+
+	void release();
+};
+
+} // namespace HTTP
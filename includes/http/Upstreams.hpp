@@ -0,0 +1,126 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Upstreams.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 17:41:27 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 17:41:28 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Upstreams.hpp
+ * Runtime state of the proxy_pass upstreams: resolved peers, load balancing
+ * (weighted round-robin, least connections or hash), passive health checks
+ * (max_fails within fail_timeout takes a peer out for fail_timeout) and a
+ * pool of idle keep-alive connections per upstream
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <netinet/in.h>
+#include "includes/config/UpstreamSettings.hpp"
+
+class Config;
+
+namespace HTTP {
+
+class Upstreams {
+public:
+	Upstreams();
+	~Upstreams();
+
+	// Resolve the peers of every upstream (closes the idle connections)
+	// @return: false if a peer's host can't be resolved
+	bool open(const Config& config);
+
+	/**
+	 * Choose a peer for a request
+	 * @param clientAddress, uri: Keys for hash balancing
+	 * @param tried: Peers already tried for this request (skipped)
+	 * @return: peer index, or -1 if none is left (all tried or down)
+	 */
+	int select(int upstream, const std::string& clientAddress, const std::string& uri,
+	           const std::vector<bool>& tried);
+
+	/**
+	 * Connection to a peer: an idle kept-alive one if there is one still
+	 * open, otherwise a new non-blocking connect()
+	 * @param reused: Set when the connection came from the idle pool
+	 * @return: socket, or -1 if connect() failed right away
+	 */
+	int connect(int upstream, int peer, bool& reused);
+
+	// The request on a connection is over: keep it idle for the next one, or close it
+	void release(int upstream, int peer, int fd, bool keepAlive);
+
+	// Passive health check: a failed / successful exchange with a peer
+	void failed(int upstream, int peer);
+	void succeeded(int upstream, int peer);
+
+	const std::string& getName(int upstream) const;
+	bool keepsAlive(int upstream) const;     // keepalive > 0
+	size_t getPeerCount(int upstream) const;
+	const std::string& getPeerName(int upstream, int peer) const;
+
+	// Close the idle connections past keepalive_timeout (once per second)
+	void tick();
+
+	// Statistics
+	size_t getConnects() const;   // New connections
+	size_t getReused() const;     // Taken from the keep-alive pool
+	size_t getFailures() const;
+
+private:
+	struct Peer {
+		std::string name;          // host:port (logs)
+		struct sockaddr_in addr;
+		unsigned int weight;
+		unsigned int maxFails;
+		double failTimeout;
+		int currentWeight;         // Smooth weighted round-robin
+		unsigned int active;       // Requests in progress
+		unsigned int fails;        // Failures since failedAt - fail_timeout
+		double failedAt;
+		double downUntil;          // Not selected before (monotonic seconds)
+	};
+
+	struct Idle {
+		int fd;
+		int peer;
+		double since;
+	};
+
+	struct Upstream {
+		std::string name;
+		UpstreamSettings::Balance balance;
+		bool hashUri;              // hash $request_uri (else $remote_addr)
+		unsigned int keepalive;
+		double keepaliveTimeout;
+		std::vector<Peer> peers;
+		std::list<Idle> idle;      // Most recently released first
+	};
+
+	std::vector<Upstream> _upstreams;
+	double _lastTick;
+	size_t _connects;
+	size_t _reused;
+	size_t _failures;
+
+	bool isAvailable(const Upstream& upstream, const Peer& peer, double now) const;
+	int selectRoundRobin(Upstream& upstream, const std::vector<bool>& tried, double now);
+	int selectLeastConn(Upstream& upstream, const std::vector<bool>& tried, double now);
+	int selectHash(Upstream& upstream, const std::string& key, const std::vector<bool>& tried,
+	               double now);
+	void closeIdle();
+
+	// Disable copy
+	Upstreams(const Upstreams& other);
+	Upstreams& operator=(const Upstreams& other);
+};
+
+} // namespace HTTP
@@ -0,0 +1,73 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Hpack.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:05:12 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 13:05:13 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Hpack.hpp
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ * The decoder supports the full format (dynamic table, Huffman strings);
+ * the encoder uses static-table indexing and plain literals only, so it
+ * never has to track the peer's table
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+namespace HTTP2 {
+
+typedef std::pair<std::string, std::string> Header;
+typedef std::vector<Header> HeaderList;
+
+class HpackDecoder {
+public:
+	HpackDecoder();
+
+	/**
+	 * Decode a complete header block (HEADERS + CONTINUATION payloads)
+	 * @return: false on a compression error (fatal for the connection)
+	 */
+	bool decode(const std::string& block, HeaderList& headers);
+
+	// Upper bound for the dynamic table (our SETTINGS_HEADER_TABLE_SIZE)
+	void setMaxTableSize(size_t size);
+
+private:
+	std::deque<Header> _table;   // Dynamic table, newest entry first
+	size_t _tableSize;           // Current size (RFC 7541 section 4.1)
+	size_t _tableCapacity;       // Size set by the last table size update
+	size_t _maxTableSize;        // Limit the peer may not exceed
+
+	// Bound on the decoded header list, against decompression bombs
+	static const size_t MAX_HEADER_LIST_SIZE = 65536;
+
+	bool lookup(size_t index, Header& header) const;
+	void insert(const Header& header);
+	void evict(size_t capacity);
+};
+
+class HpackEncoder {
+public:
+	/**
+	 * Append the encoded header block for `headers` to `block`
+	 * Names must already be lowercase
+	 */
+	void encode(const HeaderList& headers, std::string& block) const;
+};
+
+// Primitive representations (RFC 7541 section 5)
+bool decodeInteger(const unsigned char*& pos, const unsigned char* end, int prefixBits, size_t& value);
+void encodeInteger(std::string& out, unsigned char firstByte, int prefixBits, size_t value);
+bool huffmanDecode(const unsigned char* data, size_t length, std::string& out);
+
+} // namespace HTTP2
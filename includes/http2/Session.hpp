@@ -0,0 +1,224 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Session.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:05:12 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 13:05:13 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Session.hpp
+ * HTTP/2 connection state (RFC 7540): framing, SETTINGS, flow control and
+ * stream multiplexing. Every stream is served through RequestHandler like
+ * an HTTP/1.1 request; response bodies are framed lazily as DATA so file
+ * ranges are read only when the peer's flow-control windows allow it
+ */
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <poll.h>
+#include "includes/http2/Hpack.hpp"
+#include "includes/http/Request.hpp"
+#include "includes/http/Response.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/RateLimiter.hpp"
+#include "includes/http/Proxy.hpp"
+
+// Forward declarations
+class Server;
+class Route;
+class VirtualHostTable;
+
+namespace HTTP2 {
+
+class Session {
+public:
+	Session(int fd, const VirtualHostTable* virtualHosts, const std::string& clientHost,
+	        in_addr_t clientAddress, bool secure);
+	~Session();
+
+	// Client connection preface (RFC 7540 section 3.5)
+	static const char PREFACE[];
+	static const size_t PREFACE_LENGTH = 24;
+
+	/**
+	 * Does this HTTP/1.1 request ask to switch to h2c? (RFC 7540 section 3.2)
+	 * Only bodiless requests are upgraded, the body would need HTTP/1.1 framing
+	 */
+	static bool isUpgradeRequest(const HTTP::Request& request);
+
+	/**
+	 * Take over a connection after an "Upgrade: h2c" request
+	 * Queues the 101 response and serves the request as stream 1
+	 */
+	void upgrade(const HTTP::Request& request);
+
+	// Process bytes read from the socket
+	void receive(const char* data, size_t length);
+
+	// Outgoing bytes (framed from pending stream data on demand)
+	const std::string& pending();
+	void consume(size_t bytes);
+	bool wantsWrite() const;
+
+	// Session ended (GOAWAY) and everything has been flushed
+	bool isFinished() const;
+
+	// proxy_pass upstream sockets of the streams (see Connection)
+	void getUpstreamPollFds(std::vector<struct pollfd>& fds) const;
+	void handleUpstream(int fd, short revents);
+	double getUpstreamDeadline() const;
+	void checkUpstreamTimeouts(double now);
+
+private:
+	// Frame types (RFC 7540 section 6)
+	enum FrameType {
+		DATA = 0x0,
+		HEADERS = 0x1,
+		PRIORITY = 0x2,
+		RST_STREAM = 0x3,
+		SETTINGS = 0x4,
+		PUSH_PROMISE = 0x5,
+		PING = 0x6,
+		GOAWAY = 0x7,
+		WINDOW_UPDATE = 0x8,
+		CONTINUATION = 0x9
+	};
+
+	// Frame flags
+	enum {
+		FLAG_END_STREAM = 0x1,
+		FLAG_ACK = 0x1,
+		FLAG_END_HEADERS = 0x4,
+		FLAG_PADDED = 0x8,
+		FLAG_PRIORITY = 0x20
+	};
+
+	// Error codes (RFC 7540 section 7)
+	enum ErrorCode {
+		NO_ERROR = 0x0,
+		PROTOCOL_ERROR = 0x1,
+		INTERNAL_ERROR = 0x2,
+		FLOW_CONTROL_ERROR = 0x3,
+		STREAM_CLOSED = 0x5,
+		FRAME_SIZE_ERROR = 0x6,
+		REFUSED_STREAM = 0x7,
+		COMPRESSION_ERROR = 0x9,
+		ENHANCE_YOUR_CALM = 0xb
+	};
+
+	struct Stream {
+		unsigned int id;
+		bool remoteClosed;       // END_STREAM received
+		bool endStreamPending;   // END_STREAM on a HEADERS still awaiting CONTINUATION
+		bool trailers;           // Current header block is a trailer section
+		int pendingReset;        // RST_STREAM code to send once the block is decoded (-1: none)
+		bool responding;         // Response queued, body still being framed
+		bool discardBody;        // Answered early, further DATA is dropped
+		std::string headerBlock; // HEADERS + CONTINUATION fragments
+		HeaderList headers;
+		std::string body;
+		const Server* server;    // Virtual host, chosen once the headers are in
+		long sendWindow;         // Peer's flow-control window for this stream
+		size_t recvUnacked;      // Received bytes not yet returned via WINDOW_UPDATE
+
+		// Response body
+		std::vector<HTTP::Response::Segment> segments;
+		size_t segmentIndex;
+		size_t segmentOffset;
+		int fileFd;
+
+		HTTP::RequestRecord record; // Access log data
+		HTTP::RateLimiter::Slots limitSlots; // limit_conn slots, released with the stream
+		HTTP::Proxy* proxy;         // proxy_pass exchange (body relayed as it arrives)
+
+		Stream(unsigned int streamId, long window);
+	};
+
+	int _fd;                          // Socket, for log messages only
+	const VirtualHostTable* _virtualHosts;
+	std::string _clientHost;          // Peer address, for the access log
+	in_addr_t _clientAddress;         // Peer address, for limit_req / limit_conn
+	bool _secure;                     // Over TLS (X-Forwarded-Proto of proxied requests)
+
+	std::string _in;                  // Unprocessed input
+	std::string _out;                 // Framed output not yet sent
+
+	bool _prefaceReceived;
+	bool _settingsSent;               // Server preface already queued
+	bool _settingsReceived;           // First frame must be SETTINGS
+	bool _goawaySent;
+	bool _goawayReceived;
+
+	std::map<unsigned int, Stream*> _streams;
+	unsigned int _lastStreamId;       // Highest client stream opened
+	unsigned int _continuationStream; // Stream expecting CONTINUATION (0 = none)
+	unsigned int _lastServed;         // Round-robin cursor for DATA framing
+
+	long _connSendWindow;             // Peer's connection-level window
+	long _peerInitialWindow;          // Peer's SETTINGS_INITIAL_WINDOW_SIZE
+	size_t _peerMaxFrameSize;         // Peer's SETTINGS_MAX_FRAME_SIZE
+	size_t _connRecvUnacked;          // Connection bytes not yet acknowledged
+
+	HpackDecoder _decoder;
+	HpackEncoder _encoder;
+
+	// Our settings
+	static const unsigned int MAX_CONCURRENT_STREAMS = 512;
+	static const long INITIAL_WINDOW_SIZE = 1048576;
+	static const long CONNECTION_WINDOW_SIZE = 16777216;
+	static const size_t MAX_FRAME_SIZE = 16384;
+	static const size_t MAX_HEADER_BLOCK = 65536;
+	static const size_t OUTPUT_HIGH_WATER = 262144;
+
+	// Disable copy
+	Session(const Session& other);
+	Session& operator=(const Session& other);
+
+	// Frame processing (false: connection error, GOAWAY already queued)
+	bool processFrame(int type, int flags, unsigned int streamId, const std::string& payload);
+	bool handleHeaders(int flags, unsigned int streamId, const std::string& payload);
+	bool handleContinuation(int flags, unsigned int streamId, const std::string& payload);
+	bool handleData(int flags, unsigned int streamId, const std::string& payload);
+	bool handleSettings(int flags, unsigned int streamId, const std::string& payload);
+	bool handleWindowUpdate(unsigned int streamId, const std::string& payload);
+	bool handleRstStream(unsigned int streamId, const std::string& payload);
+	bool applySettings(const std::string& payload);
+	bool finishHeaderBlock(Stream* stream);
+	bool connectionError(ErrorCode code, const char* reason);
+	static bool stripPadding(std::string& payload, int flags, size_t prefix);
+
+	// Streams
+	Stream* findStream(unsigned int streamId);
+	void closeStream(unsigned int streamId);
+	void resetStream(unsigned int streamId, ErrorCode code);
+	void completeStream(Stream* stream);
+	void dispatch(Stream* stream);
+	void serve(Stream* stream, const HTTP::Request& request);
+	void respond(Stream* stream, const HTTP::Response& response);
+	void writeHeaders(Stream* stream, int status,
+	                  const std::vector<std::pair<std::string, std::string> >& fields, bool endStream);
+	void startProxy(Stream* stream, const HTTP::Request& request, const Route& route);
+	void proxyProgress(Stream* stream);
+	bool buildRequest(const Stream* stream, HTTP::Request& request) const;
+	const Server* selectServer(const std::string& host) const;
+
+	// Output
+	void writeFrame(int type, int flags, unsigned int streamId, const std::string& payload);
+	void writeSettings();
+	void writeWindowUpdate(unsigned int streamId, size_t increment);
+	void acknowledgeData(Stream* stream, size_t length);
+	void produceData();
+	bool writeData(Stream* stream);
+	bool writeProxyData(Stream* stream);
+	bool hasSendableData() const;
+	static bool hasDataReady(const Stream* stream);
+};
+
+} // namespace HTTP2
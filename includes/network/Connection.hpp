@@ -18,13 +18,22 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include "includes/http/Request.hpp"
 #include "includes/http/Response.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/RateLimiter.hpp"
+#include "includes/http/Proxy.hpp"
+#include "includes/http2/Session.hpp"
+#include "includes/network/TlsContext.hpp"
 
 // Forward declarations
 class Server;
+class Route;
+class VirtualHostTable;
 
 class Connection {
 public:
@@ -32,12 +41,15 @@ public:
 	enum State {
 		READING_REQUEST,   // Reading HTTP request from client
 		PROCESSING,        // Processing request (e.g., CGI)
+		DELAYED,           // Request held back by limit_req until getResumeTime()
+		PROXYING,          // Waiting for / relaying a proxy_pass upstream response
 		WRITING_RESPONSE,  // Writing HTTP response to client
 		CLOSING            // Connection should be closed
 	};
 
 	// Constructors
-	Connection(int fd, const struct sockaddr_in& addr, const Server* server);
+	Connection(int fd, const struct sockaddr_in& addr, const VirtualHostTable* virtualHosts,
+	           TlsContext* tls = NULL);
 	~Connection();
 
 	// I/O operations
@@ -47,6 +59,8 @@ public:
 	// State management
 	State getState() const;
 	void setState(State state);
+	short getPollEvents() const;
+	bool isHttp2() const;
 
 	// Getters
 	int getFd() const;
@@ -58,6 +72,16 @@ public:
 	// Timeout check
 	bool isTimedOut(time_t timeout) const;
 
+	// Delayed request (limit_req): monotonic time to serve it, and serving it
+	double getResumeTime() const;
+	void resume();
+
+	// proxy_pass upstream sockets: poll entries, events, earliest timeout
+	void getUpstreamPollFds(std::vector<struct pollfd>& fds) const;
+	void handleUpstream(int fd, short revents);
+	double getUpstreamDeadline() const;
+	void checkUpstreamTimeouts(double now);
+
 	// Buffer management
 	const std::string& getRequestBuffer() const;
 	void clearRequestBuffer();
@@ -67,7 +91,9 @@ private:
 	struct sockaddr_in _addr;     // Client address
 	std::string _clientHost;      // Client host string
 	int _clientPort;              // Client port
-	const Server* _server;        // Associated server configuration
+	const VirtualHostTable* _virtualHosts; // Listener's server_name index
+	const Server* _server;        // Server for the current request (default until Host is seen)
+	bool _serverSelected;         // Host header already looked up?
 
 	State _state;                 // Current connection state
 	time_t _lastActivity;         // Last activity timestamp
@@ -76,8 +102,34 @@ private:
 	std::string _responseBuffer;  // Buffer for outgoing response
 	size_t _responseOffset;       // Offset for partial writes
 
+	// File-backed body sent after _responseBuffer (sendfile)
+	std::vector<HTTP::Response::Segment> _segments;
+	size_t _segmentIndex;         // Segment currently being written
+	size_t _segmentOffset;        // Bytes of that segment already written
+	int _fileFd;                  // Open response file (-1 if none)
+
 	bool _keepAlive;              // Keep-alive connection?
 	bool _shouldClose;            // Should close after response?
+	bool _continueHandled;        // Expect: 100-continue already answered?
+
+	HTTP2::Session* _http2;       // HTTP/2 session (NULL while speaking HTTP/1.1)
+	HTTP::RequestRecord _record;  // Access log data for the HTTP/1.1 request
+
+	TlsContext* _tls;             // Listener's TLS context (NULL for plain TCP)
+	SSL* _ssl;                    // TLS state for this connection
+	bool _tlsEstablished;         // Handshake finished?
+	bool _tlsWantWrite;           // Handshake waits for the socket to be writable
+
+	unsigned long _captureId;     // TrafficCapture id (0 = not recorded)
+
+	// limit_req / limit_conn
+	bool _limitChecked;           // limit_req already accounted for this request
+	double _resumeAt;             // DELAYED until (monotonic seconds)
+	HTTP::RateLimiter::Slots _limitSlots; // limit_conn slots held until the connection closes
+
+	HTTP::Proxy* _proxy;          // proxy_pass exchange (NULL when not proxying)
+	bool _proxyHeadQueued;        // Upstream response head copied to _responseBuffer
+	bool _proxyChunked;           // Body of unknown length re-framed as chunks
 
 	// Disable copy
 	Connection(const Connection& other);
@@ -85,4 +137,21 @@ private:
 
 	// Helper methods
 	void updateActivity();
+	void processRequest();
+	bool applyLimits(const HTTP::Request& request);
+	void startProxy(const HTTP::Request& request, const Route& route);
+	void proxyProgress();
+	bool writeProxy();
+	void queueResponse(const HTTP::Response& response);
+	bool writeSegments();
+	void logRequest();
+	void closeResponseFile();
+	bool handleExpectContinue(size_t bodyStartPos);
+	void selectServer(const std::string& headers);
+	bool detectHttp2Preface();
+	bool writeHttp2();
+	bool continueHandshake();
+	ssize_t receiveBytes(char* buffer, size_t size);
+	ssize_t sendBytes(const char* data, size_t size);
+	ssize_t sendFileRange(off_t offset, size_t length);
 };
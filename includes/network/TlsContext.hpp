@@ -0,0 +1,70 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TlsContext.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:40:21 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 13:40:22 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * TlsContext.hpp
+ * OpenSSL context for one TLS listening socket
+ * Holds the certificate, the server-side session cache and ticket keys
+ * (so returning clients skip the full handshake), enables kernel TLS when
+ * available, and counts handshakes for rate monitoring
+ */
+#pragma once
+
+#include <string>
+#include <openssl/ssl.h>
+
+class Server;
+
+class TlsContext {
+public:
+	TlsContext();
+	~TlsContext();
+
+	/**
+	 * Load the server's certificate/key and session settings
+	 * @return: false if OpenSSL rejected the configuration
+	 */
+	bool init(const Server& server);
+
+	/**
+	 * Create the TLS state for an accepted socket (server side)
+	 * @return: NULL on failure
+	 */
+	SSL* createSession(int fd) const;
+
+	// Handshake accounting
+	void recordHandshake(bool resumed);
+	void recordFailure();
+	size_t getHandshakes() const;
+	size_t getResumed() const;
+	size_t getFailures() const;
+
+	// Is kernel TLS offload (SSL_sendfile) active for this connection?
+	static bool usesKtlsSend(SSL* ssl);
+
+	// Last OpenSSL error as text (clears the error queue)
+	static std::string lastError();
+
+private:
+	SSL_CTX* _ctx;
+	size_t _handshakes;   // Completed handshakes (full + resumed)
+	size_t _resumed;      // Handshakes that resumed a session
+	size_t _failures;     // Failed handshakes
+
+	// ALPN: prefer h2, fall back to http/1.1
+	static int selectAlpn(SSL* ssl, const unsigned char** out, unsigned char* outLength,
+	                      const unsigned char* in, unsigned int inLength, void* arg);
+
+	// Disable copy
+	TlsContext(const TlsContext& other);
+	TlsContext& operator=(const TlsContext& other);
+};
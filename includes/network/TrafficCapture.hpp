@@ -0,0 +1,81 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TrafficCapture.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:30:11 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 18:30:12 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * TrafficCapture.hpp
+ * Records the bytes clients send (capture directive) for replay with
+ * tests/bench/replay. Disabled, a connection costs one inline check when
+ * accepted and one integer test per read. Enabled, 1 in "sample"
+ * connections is recorded into a buffer that is written out once it fills
+ * up or every second
+ *
+ * File format: the 8-byte magic "WSCAP001", then records of
+ *   type (1 byte), microseconds since the previous record (varint),
+ *   connection id (varint), and by type:
+ *   'O' connection opened: local port (varint), TLS flag (1 byte)
+ *   'D' bytes received:    length (varint), the bytes (decrypted for TLS)
+ *   'C' connection closed
+ * Varints are unsigned LEB128 (7 bits per byte, low bits first)
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <ctime>
+
+class TrafficCapture {
+public:
+	static const char MAGIC[];
+	static const size_t MAGIC_LENGTH = 8;
+
+	TrafficCapture();
+	~TrafficCapture();
+
+	/**
+	 * Start capturing into path (truncated)
+	 * @param sample: record 1 in N connections
+	 * @param maxSize: stop once the file reaches this size (0 = no limit)
+	 */
+	bool open(const std::string& path, unsigned int sample, size_t maxSize);
+
+	// New connection: its capture id, 0 when it is not recorded
+	unsigned long begin(int fd, bool tls) { return _fd < 0 ? 0 : start(fd, tls); }
+
+	// Only called for connections with a capture id
+	void data(unsigned long id, const char* bytes, size_t length);
+	void end(unsigned long id);
+
+	// Called from the event loop: write out records older than a second
+	void tick();
+	void flush();
+
+private:
+	int _fd;
+	unsigned int _sample;
+	size_t _maxSize;
+	size_t _written;             // Bytes already in the file
+	unsigned long _accepted;     // Connections seen (for sampling)
+	unsigned long _nextId;
+	unsigned long long _last;    // Time of the previous record (microseconds)
+	std::string _buffer;
+	time_t _lastFlush;
+
+	// Disable copy
+	TrafficCapture(const TrafficCapture& other);
+	TrafficCapture& operator=(const TrafficCapture& other);
+
+	unsigned long start(int fd, bool tls);
+	bool record(char type, unsigned long id, size_t extra);
+	void putVarint(unsigned long long value);
+	void stop(const char* reason);
+	static unsigned long long now();
+};
@@ -0,0 +1,91 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AsyncLog.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:02:11 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 15:02:12 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * AsyncLog.hpp
+ * Escrita assíncrona dos logs.
+ * Os registos já formatados são copiados para um ring buffer lock-free (um
+ * produtor, um consumidor), marcados com o canal (stdout/stderr); uma thread
+ * de fundo esvazia o ring pela ordem em que foram registados, juntando os
+ * registos seguidos do mesmo canal num só writev. A thread dorme até o ring
+ * deixar de estar vazio (um byte num pipe a acorda). Com o ring cheio o
+ * registo é descartado e contado, o event loop nunca fica bloqueado à espera
+ * do terminal ou do disco.
+ * Antes de startAsync() (e nos processos filho depois de fork) a escrita é
+ * síncrona.
+ */
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+
+namespace Logger {
+
+	/**
+	 * Ring buffer SPSC de registos (cabeçalho: canal e tamanho)
+	 * O produtor só avança _head, o consumidor só avança _tail
+	 */
+	class RingBuffer {
+		public:
+			// Capacidade arredondada para potência de 2
+			explicit RingBuffer(size_t capacity);
+			~RingBuffer();
+
+			// Produtor: copia o registo inteiro ou nada (false = sem espaço)
+			// wasEmpty: o consumidor já tinha lido tudo (é preciso acordá-lo)
+			bool push(int channel, const char* data, size_t length, bool& wasEmpty);
+
+			// Consumidor: escreve os registos por ordem, cada um no fd do seu canal
+			size_t drain(const int* fds);
+
+			// Consumidor: nada por ler (depois de drain(), antes de dormir)
+			bool empty() const;
+
+		private:
+			static const size_t HEADER = 5;	// Canal (1 byte) + tamanho (4 bytes)
+			static const int MAX_IOV = 64;
+
+			char* _data;
+			size_t _capacity;
+			size_t _mask;
+			size_t _head;	// Próximo byte a escrever (produtor)
+			size_t _tail;	// Próximo byte a ler (consumidor)
+
+			void copyIn(size_t position, const char* data, size_t length);
+			void copyOut(size_t position, char* data, size_t length) const;
+
+			RingBuffer(const RingBuffer& other);
+			RingBuffer& operator=(const RingBuffer& other);
+	};
+
+	/**
+	 * Arrancar a thread de escrita
+	 * @param capacity: Tamanho do ring (partilhado por stdout e stderr) em bytes
+	 * @return: false se a thread não pôde ser criada (continua síncrono)
+	 */
+	bool startAsync(size_t capacity = 1 << 20);
+
+	// Parar a thread e escrever tudo o que ficou no ring
+	void stopAsync();
+
+	bool isAsync();
+
+	// Registos descartados por falta de espaço no ring
+	unsigned long droppedRecords();
+
+	// Entregar bytes de um registo (ring em modo assíncrono, write() caso contrário)
+	// fd é o canal lógico (stdout/stderr); redirectOutput() muda o destino real
+	void writeRecord(int fd, const char* data, size_t length);
+
+	// Enviar os dois canais para fd (chamar antes de startAsync())
+	void redirectOutput(int fd);
+}
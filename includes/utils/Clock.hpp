@@ -0,0 +1,62 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Clock.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:10:42 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 19:10:43 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Clock.hpp
+ * Relógio do event loop.
+ * O tempo (monotónico e real) é lido uma vez por iteração do loop com
+ * update(); o resto do servidor usa esse valor em vez de chamar time().
+ * As datas formatadas (header Date, timestamps dos logs) são geradas no
+ * máximo uma vez por segundo e partilhadas por todas as respostas e linhas
+ * de log. Antes do primeiro update() o relógio é lido na primeira consulta.
+ */
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+
+namespace Clock {
+
+	// Ler o relógio (início de cada iteração do event loop)
+	void update();
+
+	// Segundos desde a epoch, na última atualização
+	time_t now();
+
+	// Milissegundos desde a epoch ($msec)
+	unsigned long long nowMilliseconds();
+
+	// Segundos monotónicos (não saltam com acertos da hora)
+	double monotonic();
+
+	// Data HTTP atual ("Mon, 19 Oct 2026 15:02:11 GMT", header Date)
+	const char* httpDate();
+
+	// Tamanho fixo de uma data HTTP
+	const size_t HTTP_DATE_LENGTH = 29;
+
+	/**
+	 * Data HTTP de outro instante (Last-Modified)
+	 * Guarda a última conversão: o mesmo ficheiro servido várias vezes
+	 * não volta a passar por gmtime. Válida até à chamada seguinte
+	 */
+	const char* httpDate(time_t time);
+
+	// Timestamp do error_log ("Mon Oct 19 15:02:11 2026")
+	const char* logTime();
+
+	// $time_local ("19/Oct/2026:15:40:18 +0000")
+	const char* timeLocal();
+
+	// $time_iso8601 ("2026-10-19T15:40:18+00:00")
+	const char* timeIso8601();
+}
@@ -15,10 +15,15 @@
  * Basic logging utility.
  * Supports different log levels and output formats.
  * If you want a parameter highlighted, use Logger::param("your parameter") method.
+ * Log through the LOG_* macros: when a level is below the threshold the
+ * operands after << are never evaluated. Building with -DWEBSERV_NO_DEBUG_LOG
+ * (make NO_DEBUG_LOG=1) removes debug logging from the binary.
  */
 #pragma once
 
 #include "includes/webserv.hpp"
+#include "includes/utils/AsyncLog.hpp"
+#include <streambuf>
 
 // Colors
 #define RESET	"\033[39m"
@@ -40,6 +45,38 @@
 #define WHITE	"\033[97m"
 
 namespace Logger {
+	// Níveis de log, por ordem de gravidade (error_log / -l)
+	enum Level {
+		LEVEL_DEBUG = 0,
+		LEVEL_INFO,
+		LEVEL_WARN,
+		LEVEL_ERROR
+	};
+
+	// Nível mínimo que é escrito (default: debug)
+	extern Level threshold;
+
+	void setLevel(Level level);
+
+	/**
+	 * Converter o nome de um nível ("debug", "info", "notice", "warn", "error", "crit")
+	 * @return: false se o nome não for conhecido
+	 */
+	bool parseLevel(const std::string& name, Level& level);
+
+	/**
+	 * Redirecionar todos os logs para um ficheiro (directiva error_log)
+	 * Sem terminal, os códigos de cor deixam de ser escritos
+	 * @return: false se o ficheiro não puder ser aberto
+	 */
+	bool setLogFile(const std::string& path);
+
+	// Reabrir o ficheiro do error_log (SIGUSR1, depois do logrotate)
+	bool reopenLogFile();
+
+	// Cores ANSI ativas (stdout num terminal ou sem error_log)
+	extern bool colors;
+
 
 	/**
 	 * Função template para formatar parâmetros com cor de destaque
@@ -49,7 +86,10 @@ namespace Logger {
 	template<typename T>
 	std::string param(const T& value) {
 		std::stringstream ss;
-		ss << ORANGE << value << RESET;
+		if (colors)
+			ss << ORANGE << value << RESET;
+		else
+			ss << value;
 		return ss.str();
 	}
 
@@ -62,31 +102,62 @@ namespace Logger {
 		return param(std::strerror(errno));
 	}
 
+	/**
+	 * RecordBuffer - streambuf que acumula um registo de log
+	 * sync() (chamado por std::endl/std::flush) entrega o registo completo
+	 * ao writer assíncrono, numa só operação
+	 */
+	class RecordBuffer : public std::streambuf {
+		private:
+			static const size_t INLINE_SIZE = 1024;
+
+			int fd;						// Descritor de destino (stdout ou stderr)
+			char area[INLINE_SIZE];		// Registos curtos não alocam
+			std::string spill;			// Continuação de registos longos
+
+		public:
+			explicit RecordBuffer(int fd);
+
+			int getFd() const;
+
+			// Descartar um registo começado e nunca terminado
+			void reset();
+
+		protected:
+			virtual int overflow(int c);
+			virtual int sync();
+	};
+
 	/**
 	 * Classe Stream - Responsável por gerenciar diferentes tipos de log
 	 * Cada instância representa um nível de log diferente (info, debug, warning, etc.)
 	 * Permite formatação personalizada com cores e cabeçalhos
+	 * Cada linha é formatada num RecordBuffer e só é escrita em std::endl
 	 */
 	class Stream {
 		private:
 			std::string header;		// Cabeçalho do log (ex: "[INFO]", "[ERROR]")
-			std::ostream& out;		// Stream de saída (geralmente std::cout ou std::cerr)
 			std::string color;		// Cor associada a este tipo de log
+			Level level;			// Nível deste tipo de log
 			bool enabled;			// Se este tipo de log está habilitado
-			std::stringstream vstream;	// Stream virtual para quando o log está desabilitado
+			RecordBuffer buffer;	// Registo em construção
+			std::ostream record;	// Stream sobre buffer
+			std::ostream disabled;	// Stream sem streambuf: ignora tudo o que recebe
 
 		public:
 			/**
 			 * Construtor com stream de saída personalizada
-			 * @param out: Stream de saída (ex: std::cout, std::cerr)
+			 * @param out: Stream de saída (std::cerr escreve no stderr, o resto no stdout)
 			 * @param header: Texto do cabeçalho do log
 			 * @param color: Código de cor ANSI para este tipo de log
+			 * @param level: Nível comparado com o threshold
 			 * @param enabled: Se este logger está ativo
 			 */
 			 Stream(
 				std::ostream& out,
 				const std::string& header,
 				const std::string& color,
+				Level level,
 				bool enabled = true
 			 );
 
@@ -94,11 +165,13 @@ namespace Logger {
 			 * Construtor usando std::cout como saída padrão
 			 * @param header: Texto do cabeçalho do log
 			 * @param color: Código de cor ANSI para este tipo de log
+			 * @param level: Nível comparado com o threshold
 			 * @param enabled: Se este logger está ativo
 			 */
 			 Stream(
 				const std::string& header,
 				const std::string& color,
+				Level level,
 				bool enabled = true
 			 );
 
@@ -114,16 +187,20 @@ namespace Logger {
 			/**
 			 * Operador de inserção (<<) - usado para escrever no log
 			 * @param value: Valor a ser logado (qualquer tipo que suporte <<)
-			 * @return: Referência para o stream de saída
-			 * Se o logger estiver desabilitado, usa um stream virtual (sem saída)
+			 * @return: Referência para o stream do registo
+			 * Se o logger estiver desabilitado, devolve um stream sem saída
 			 */
+			// Este stream escreve com o threshold atual?
+			bool isEnabled() const {
+				return this->enabled && this->level >= threshold;
+			}
+
 			template<typename T>
 			std::ostream& operator<<(const T& value) {
-				if (!this->enabled) {
-					this->vstream.clear();
-					return this->vstream;
-				};
-				return this->out << this->buildHeader() << " " << value;
+				if (!this->isEnabled())
+					return this->disabled;
+				this->writeHeader();
+				return this->record << value;
 			}
 
 			/**
@@ -139,17 +216,10 @@ namespace Logger {
 
 			private:
 			/**
-			 * Constrói o cabeçalho completo do log
-			 * Inclui timestamp, cor e texto do cabeçalho
-			 * @return: String formatada do cabeçalho
-			 */
-			std::string buildHeader() const;
-
-			/**
-			 * Obtém timestamp atual formatado
-			 * @return: String com data/hora atual
+			 * Começa um registo novo com o cabeçalho
+			 * Inclui timestamp (cache por segundo), cor e texto do cabeçalho
 			 */
-			std::string getTime() const;
+			void writeHeader();
 	};
 
 	// Instâncias pré-definidas de loggers para diferentes níveis
@@ -164,3 +234,23 @@ namespace Logger {
 	extern Stream child;	// Logger especial para processos filho
 }
 
+/**
+ * Macros de log: LOG_INFO << "x: " << x << std::endl;
+ * Se o nível estiver abaixo do threshold, nada depois de << é avaliado
+ * (o "if ... ; else" mantém o macro seguro dentro de if/else sem chavetas)
+ */
+#define LOG_STREAM(stream)	if (!Logger::stream.isEnabled()) ; else Logger::stream
+
+#ifdef WEBSERV_NO_DEBUG_LOG
+# define LOG_DEBUG			if (true) ; else Logger::debug
+# define LOG_DEBUG_ENABLED	false
+#else
+# define LOG_DEBUG			LOG_STREAM(debug)
+# define LOG_DEBUG_ENABLED	Logger::debug.isEnabled()
+#endif
+
+#define LOG_INFO			LOG_STREAM(info)
+#define LOG_SUCCESS			LOG_STREAM(success)
+#define LOG_WARNING			LOG_STREAM(warning)
+#define LOG_ERROR			LOG_STREAM(error)
+#define LOG_CHILD			LOG_STREAM(child)
@@ -31,8 +31,24 @@
 #include "includes/config/Config.hpp"
 #include "includes/config/Server.hpp"
 #include "includes/config/Route.hpp"
+#include "includes/config/RouteTrie.hpp"
 #include "includes/config/ConfigParser.hpp"
+#include "includes/config/VirtualHostTable.hpp"
 #include "includes/network/Socket.hpp"
 #include "includes/network/Connection.hpp"
+#include "includes/network/TlsContext.hpp"
+#include "includes/network/TrafficCapture.hpp"
 #include "includes/http/ServerManager.hpp"
+#include "includes/http/GzipCache.hpp"
+#include "includes/http/DirectoryIndex.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/http/ErrorPages.hpp"
+#include "includes/http/RateLimiter.hpp"
+#include "includes/http/Upstreams.hpp"
+#include "includes/http/Proxy.hpp"
+#include "includes/http2/Hpack.hpp"
+#include "includes/http2/Session.hpp"
 #include "includes/cgi/CGIExecutor.hpp"
+#include "includes/cgi/Environment.hpp"
+#include "includes/cgi/Cache.hpp"
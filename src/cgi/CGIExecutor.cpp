@@ -15,23 +15,37 @@
  * Implementation of CGI Executor
  */
 #include "includes/cgi/CGIExecutor.hpp"
+#include "includes/cgi/Environment.hpp"
 #include "includes/http/Request.hpp"
 #include "includes/http/Response.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/core/Instance.hpp"
 #include "includes/config/Server.hpp"
 #include "includes/config/Route.hpp"
 #include "includes/utils/Logger.hpp"
 #include "includes/core/Settings.hpp"
 #include <sys/types.h>
 #include <sys/wait.h>
-#include <sys/select.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
 #include <signal.h>
 #include <cstdlib>
 #include <cstring>
+#include <strings.h>
+#include <cerrno>
 #include <sstream>
 #include <algorithm>
 
+// posix_spawn() can chdir the child itself with glibc 2.29+ and macOS;
+// elsewhere the child is started with vfork()
+#if (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))) \
+	|| defined(__APPLE__)
+# define CGI_SPAWN_CHDIR
+#endif
+
 namespace CGI {
 
 // Constructor
@@ -47,182 +61,151 @@ HTTP::Response Executor::execute(const HTTP::Request& request,
                                  const Server* server,
                                  const Route* route,
                                  const std::string& scriptPath) {
-	Logger::info << "Executing CGI script: " << scriptPath << std::endl;
+	LOG_INFO << "Executing CGI script: " << scriptPath << std::endl;
 
 	// Build environment variables
-	std::map<std::string, std::string> envMap = buildEnvironment(request, server, route, scriptPath);
-	char** envp = envMapToArray(envMap);
+	std::string environment;
+	buildEnvironment(request, server, route, scriptPath, environment);
+	std::vector<char*> envp;
+	Environment::index(environment, envp);
 
 	// Create pipes for stdin/stdout
 	PipeSet pipes;
 	if (!createPipes(pipes)) {
-		freeEnvArray(envp);
 		return HTTP::Response::errorResponse(500, "Failed to create pipes for CGI");
 	}
 
-	// Fork process
-	pid_t pid = fork();
+	// Start the child (no fork(): its cost grows with the server's memory)
+	double spawned = HTTP::RequestRecord::now();
+	pid_t pid = spawnChild(route->getCgiPath(), scriptPath, pipes, &envp[0]);
 	if (pid < 0) {
-		// Fork failed
-		Logger::error << "Failed to fork for CGI execution" << std::endl;
 		closePipes(pipes);
-		freeEnvArray(envp);
-		return HTTP::Response::errorResponse(500, "Failed to fork CGI process");
-	}
-
-	if (pid == 0) {
-		// Child process
-		executeChild(route->getCgiPath(), scriptPath, pipes, envp);
-		// If executeChild returns, something went wrong
-		exit(1);
+		return HTTP::Response::errorResponse(500, "Failed to start CGI process");
 	}
 
-	// Parent process
-	freeEnvArray(envp);
+	Instance::Get<HTTP::Metrics>()->cgiSpawned();
 
 	// Handle parent I/O with timeout (default 30 seconds)
 	std::string cgiOutput = handleParent(pipes, request.getBody(), pid, 30);
 
 	// Parse CGI output and build response
-	return parseCGIOutput(cgiOutput);
+	HTTP::Response response = parseCGIOutput(cgiOutput);
+	response.setCgiTiming(spawned, HTTP::RequestRecord::now());
+	return response;
 }
 
-// Build environment variables for CGI
-std::map<std::string, std::string> Executor::buildEnvironment(
-	const HTTP::Request& request,
-	const Server* server,
-	const Route* /* route */,
-	const std::string& scriptPath) {
-
-	std::map<std::string, std::string> env;
+// Start the script for a caller that collects the output itself (cgi_cache
+// refreshes, see CGI::Cache)
+pid_t Executor::start(const HTTP::Request& request,
+                      const Server* server,
+                      const Route* route,
+                      const std::string& scriptPath,
+                      int& outputFd) {
+	std::string environment;
+	buildEnvironment(request, server, route, scriptPath, environment);
+	std::vector<char*> envp;
+	Environment::index(environment, envp);
 
-	// Required CGI variables (RFC 3875)
-	env["REQUEST_METHOD"] = request.getMethod();
-	env["SERVER_PROTOCOL"] = request.getVersion();
-
-	// Server information
-	const std::vector<int>& ports = server->getPorts();
-	std::ostringstream portStr;
-	if (!ports.empty()) {
-		portStr << ports[0]; // Use first port
-	} else {
-		portStr << "8080"; // Default
+	PipeSet pipes;
+	if (!createPipes(pipes)) {
+		return -1;
 	}
-	env["SERVER_PORT"] = portStr.str();
+	pid_t pid = spawnChild(route->getCgiPath(), scriptPath, pipes, &envp[0]);
 
-	const std::vector<std::string>& serverNames = server->getServerNames();
-	if (!serverNames.empty()) {
-		env["SERVER_NAME"] = serverNames[0]; // Use first server name
-	} else {
-		env["SERVER_NAME"] = server->getHost();
+	// No body: the script sees EOF on stdin right away
+	close(pipes.stdinPipe[0]);
+	close(pipes.stdinPipe[1]);
+	close(pipes.stdoutPipe[1]);
+	if (pid < 0) {
+		close(pipes.stdoutPipe[0]);
+		return -1;
 	}
+	Instance::Get<HTTP::Metrics>()->cgiSpawned();
+
+	int flags = fcntl(pipes.stdoutPipe[0], F_GETFL, 0);
+	fcntl(pipes.stdoutPipe[0], F_SETFL, flags | O_NONBLOCK);
+	fcntl(pipes.stdoutPipe[0], F_SETFD, FD_CLOEXEC);
+	outputFd = pipes.stdoutPipe[0];
+	return pid;
+}
 
-	env["SERVER_SOFTWARE"] = "webserv/1.0";
+// Build environment variables for CGI: the location's static ones are
+// prepared (see CGI::Environment), only the request's are added here
+void Executor::buildEnvironment(const HTTP::Request& request,
+                                const Server* server,
+                                const Route* route,
+                                const std::string& scriptPath,
+                                std::string& block) {
+	block = Instance::Get<Environment>()->get(server, route);
 
-	// Gateway interface version
-	env["GATEWAY_INTERFACE"] = "CGI/1.1";
+	// Required CGI variables (RFC 3875)
+	Environment::add(block, "REQUEST_METHOD", request.getMethod());
+	Environment::add(block, "SERVER_PROTOCOL", request.getVersion());
 
 	// Request URI and query string
-	env["REQUEST_URI"] = request.getUri();
+	Environment::add(block, "REQUEST_URI", request.getUri());
+	Environment::add(block, "QUERY_STRING", request.getQuery());
 
-	if (!request.getQuery().empty()) {
-		env["QUERY_STRING"] = request.getQuery();
-	} else {
-		env["QUERY_STRING"] = "";
-	}
+	// Client (no reverse lookup: REMOTE_HOST is the address, RFC 3875 4.1.9)
+	Environment::add(block, "REMOTE_ADDR", request.getRemoteAddr());
+	Environment::add(block, "REMOTE_HOST", request.getRemoteAddr());
 
 	// Script information (CRITICAL for CGI as per subject)
 	// PATH_INFO = full path to script (not the URL path)
-	env["SCRIPT_FILENAME"] = scriptPath;
-	env["SCRIPT_NAME"] = getScriptName(scriptPath);
-	env["PATH_INFO"] = getPathInfo(request.getPath(), scriptPath);
-	env["PATH_TRANSLATED"] = scriptPath;
+	Environment::add(block, "SCRIPT_FILENAME", scriptPath);
+	Environment::add(block, "SCRIPT_NAME", getScriptName(scriptPath));
+	Environment::add(block, "PATH_INFO", getPathInfo(request.getPath(), scriptPath));
+	Environment::add(block, "PATH_TRANSLATED", scriptPath);
 
 	// Content information
 	if (request.hasHeader("Content-Type")) {
-		env["CONTENT_TYPE"] = request.getContentType();
+		Environment::add(block, "CONTENT_TYPE", request.getContentType());
 	}
 
-	if (request.hasHeader("Content-Length")) {
-		std::ostringstream lenStr;
-		lenStr << request.getContentLength();
-		env["CONTENT_LENGTH"] = lenStr.str();
-	} else {
-		env["CONTENT_LENGTH"] = "0";
-	}
+	std::ostringstream lenStr;
+	lenStr << (request.hasHeader("Content-Length") ? request.getContentLength() : 0);
+	Environment::add(block, "CONTENT_LENGTH", lenStr.str());
 
 	// HTTP headers (convert to HTTP_* format)
 	// All headers from request should be passed as HTTP_HEADER_NAME
 	const std::map<std::string, std::string>& headers = request.getHeaders();
 	for (std::map<std::string, std::string>::const_iterator it = headers.begin();
 	     it != headers.end(); ++it) {
-		std::string headerName = it->first;
+		const std::string& headerName = it->first;
+
+		// Skip Content-Type and Content-Length (already set)
+		if (strcasecmp(headerName.c_str(), "Content-Type") == 0 ||
+		    strcasecmp(headerName.c_str(), "Content-Length") == 0) {
+			continue;
+		}
 
 		// Convert to uppercase and replace - with _
-		std::string envName = "HTTP_";
+		block += "HTTP_";
 		for (size_t i = 0; i < headerName.length(); ++i) {
 			char c = headerName[i];
 			if (c == '-') {
-				envName += '_';
+				block += '_';
 			} else if (c >= 'a' && c <= 'z') {
-				envName += (c - 32); // Convert to uppercase
-			} else if (c >= 'A' && c <= 'Z') {
-				envName += c;
+				block += (c - 32); // Convert to uppercase
 			} else {
-				envName += c;
+				block += c;
 			}
 		}
-
-		// Skip Content-Type and Content-Length (already set)
-		if (envName != "HTTP_CONTENT_TYPE" && envName != "HTTP_CONTENT_LENGTH") {
-			env[envName] = it->second;
-		}
-	}
-
-	// Remote information (client)
-	// We don't have remote addr in current implementation, use placeholder
-	env["REMOTE_ADDR"] = "127.0.0.1";
-	env["REMOTE_HOST"] = "localhost";
-
-	return env;
-}
-
-// Convert environment map to array for execve
-char** Executor::envMapToArray(const std::map<std::string, std::string>& envMap) {
-	// Allocate array (size + 1 for NULL terminator)
-	char** envp = new char*[envMap.size() + 1];
-	size_t i = 0;
-
-	for (std::map<std::string, std::string>::const_iterator it = envMap.begin();
-	     it != envMap.end(); ++it, ++i) {
-		std::string envStr = it->first + "=" + it->second;
-		envp[i] = new char[envStr.length() + 1];
-		std::strcpy(envp[i], envStr.c_str());
-	}
-
-	envp[i] = NULL; // NULL terminator
-	return envp;
-}
-
-// Free environment array
-void Executor::freeEnvArray(char** env) {
-	if (!env) return;
-
-	for (size_t i = 0; env[i] != NULL; ++i) {
-		delete[] env[i];
+		block += '=';
+		block += it->second;
+		block += '\0';
 	}
-	delete[] env;
 }
 
 // Create pipes for CGI I/O
 bool Executor::createPipes(PipeSet& pipes) {
 	if (pipe(pipes.stdinPipe) < 0) {
-		Logger::error << "Failed to create stdin pipe" << std::endl;
+		LOG_ERROR << "Failed to create stdin pipe" << std::endl;
 		return false;
 	}
 
 	if (pipe(pipes.stdoutPipe) < 0) {
-		Logger::error << "Failed to create stdout pipe" << std::endl;
+		LOG_ERROR << "Failed to create stdout pipe" << std::endl;
 		close(pipes.stdinPipe[0]);
 		close(pipes.stdinPipe[1]);
 		return false;
@@ -239,53 +222,71 @@ void Executor::closePipes(PipeSet& pipes) {
 	close(pipes.stdoutPipe[1]);
 }
 
-// Execute CGI script in child process
-void Executor::executeChild(const std::string& cgiPath,
+// Start the interpreter on the script, with stdin / stdout on the pipes and
+// the script's directory (required by subject) as working directory.
+// posix_spawn() / vfork() share the server's memory until execve instead of
+// copying its page tables like fork(), so the cost doesn't grow with it
+pid_t Executor::spawnChild(const std::string& cgiPath,
                            const std::string& scriptPath,
                            const PipeSet& pipes,
                            char** envp) {
-	// Redirect stdin
-	dup2(pipes.stdinPipe[0], STDIN_FILENO);
-
-	// Redirect stdout
-	dup2(pipes.stdoutPipe[1], STDOUT_FILENO);
-
-	// Close all pipe file descriptors (we have dups now)
-	close(pipes.stdinPipe[0]);
-	close(pipes.stdinPipe[1]);
-	close(pipes.stdoutPipe[0]);
-	close(pipes.stdoutPipe[1]);
-
-	// Change to script directory (required by subject)
 	std::string scriptDir;
-	std::string scriptFilename;
+	std::string scriptFilename = scriptPath;
 
 	size_t lastSlash = scriptPath.find_last_of('/');
 	if (lastSlash != std::string::npos) {
-		scriptDir = scriptPath.substr(0, lastSlash);
+		scriptDir = (lastSlash == 0) ? "/" : scriptPath.substr(0, lastSlash);
 		scriptFilename = scriptPath.substr(lastSlash + 1);
-
-		if (chdir(scriptDir.c_str()) < 0) {
-			Logger::error << "Failed to chdir to: " << scriptDir << std::endl;
-			exit(1);
-		}
-	} else {
-		scriptFilename = scriptPath;
 	}
 
-	// Prepare arguments for execve
 	// argv[0] = cgi executable, argv[1] = script filename (NOT full path), argv[2] = NULL
 	char* argv[3];
 	argv[0] = const_cast<char*>(cgiPath.c_str());
 	argv[1] = const_cast<char*>(scriptFilename.c_str()); // Just filename after chdir
 	argv[2] = NULL;
 
-	// Execute CGI
-	execve(cgiPath.c_str(), argv, envp);
+#ifdef CGI_SPAWN_CHDIR
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, pipes.stdinPipe[0], STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, pipes.stdoutPipe[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, pipes.stdinPipe[0]);
+	posix_spawn_file_actions_addclose(&actions, pipes.stdinPipe[1]);
+	posix_spawn_file_actions_addclose(&actions, pipes.stdoutPipe[0]);
+	posix_spawn_file_actions_addclose(&actions, pipes.stdoutPipe[1]);
+	if (!scriptDir.empty()) {
+		posix_spawn_file_actions_addchdir_np(&actions, scriptDir.c_str());
+	}
 
-	// If we get here, execve failed
-	Logger::error << "execve failed for CGI: " << cgiPath << std::endl;
-	exit(1);
+	pid_t pid;
+	int error = posix_spawn(&pid, cgiPath.c_str(), &actions, NULL, argv, envp);
+	posix_spawn_file_actions_destroy(&actions);
+	if (error != 0) {
+		LOG_ERROR << "Failed to start CGI " << cgiPath << " for " << scriptPath << ": "
+		          << std::strerror(error) << std::endl;
+		return -1;
+	}
+	return pid;
+#else
+	pid_t pid = vfork();
+	if (pid == 0) {
+		// Shares the parent's memory: only system calls until execve
+		dup2(pipes.stdinPipe[0], STDIN_FILENO);
+		dup2(pipes.stdoutPipe[1], STDOUT_FILENO);
+		close(pipes.stdinPipe[0]);
+		close(pipes.stdinPipe[1]);
+		close(pipes.stdoutPipe[0]);
+		close(pipes.stdoutPipe[1]);
+		if (scriptDir.empty() || chdir(scriptDir.c_str()) == 0) {
+			execve(cgiPath.c_str(), argv, envp);
+		}
+		_exit(127);
+	}
+	if (pid < 0) {
+		LOG_ERROR << "Failed to start CGI " << cgiPath << ": " << Logger::errstr() << std::endl;
+	}
+	return pid;
+#endif
 }
 
 // Handle parent process I/O
@@ -308,7 +309,7 @@ std::string Executor::handleParent(const PipeSet& pipes,
 			ssize_t n = write(pipes.stdinPipe[1], requestBody.c_str() + written,
 			                 requestBody.length() - written);
 			if (n <= 0) {
-				Logger::warning << "Failed to write to CGI stdin" << std::endl;
+				LOG_WARNING << "Failed to write to CGI stdin" << std::endl;
 				break;
 			}
 			written += n;
@@ -318,41 +319,55 @@ std::string Executor::handleParent(const PipeSet& pipes,
 	// Close stdin pipe (signal EOF to child)
 	close(pipes.stdinPipe[1]);
 
-	// Read output from child with timeout
+	// Read output from child with timeout (poll() wakes up as soon as the
+	// script writes or exits); the loop's Clock stands still while we block
 	std::string output;
-	time_t startTime = time(NULL);
+	double deadline = HTTP::RequestRecord::now() + timeoutSeconds;
+	int status = 0;
+	bool reaped = false;
 
+	char buffer[4096];
 	while (true) {
 		// Check timeout
-		if (difftime(time(NULL), startTime) > timeoutSeconds) {
-			Logger::warning << "CGI timeout - killing process" << std::endl;
+		int remaining = static_cast<int>((deadline - HTTP::RequestRecord::now()) * 1000);
+		if (remaining <= 0) {
+			LOG_WARNING << "CGI timeout - killing process" << std::endl;
+			Instance::Get<HTTP::Metrics>()->cgiTimedOut();
 			kill(childPid, SIGKILL);
 			waitpid(childPid, NULL, 0);
 			close(pipes.stdoutPipe[0]);
 			return ""; // Timeout
 		}
 
-		// Try to read
-		char buffer[4096];
-		ssize_t n = read(pipes.stdoutPipe[0], buffer, sizeof(buffer));
+		// Wait for output; every 100ms, check whether the child exited
+		// (a process it left behind may keep the pipe open)
+		struct pollfd pfd;
+		pfd.fd = pipes.stdoutPipe[0];
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, std::min(remaining, 100)) <= 0) {
+			if (waitpid(childPid, &status, WNOHANG) > 0) {
+				// Child exited: collect what it wrote after the last poll,
+				// without waiting on a process it left holding the pipe
+				reaped = true;
+				ssize_t n;
+				while ((n = read(pipes.stdoutPipe[0], buffer, sizeof(buffer))) > 0 ||
+				       (n < 0 && errno == EINTR)) {
+					if (n > 0) {
+						output.append(buffer, n);
+					}
+				}
+				break;
+			}
+			continue;
+		}
 
+		ssize_t n = read(pipes.stdoutPipe[0], buffer, sizeof(buffer));
 		if (n > 0) {
 			output.append(buffer, n);
-		} else if (n == 0) {
+		} else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
 			// EOF - child closed stdout
 			break;
-		} else {
-			// EAGAIN/EWOULDBLOCK - no data available
-			// Check if child is still running
-			int status;
-			pid_t result = waitpid(childPid, &status, WNOHANG);
-			if (result > 0) {
-				// Child exited
-				break;
-			}
-
-			// Sleep briefly to avoid busy waiting
-			usleep(10000); // 10ms
 		}
 	}
 
@@ -360,14 +375,15 @@ std::string Executor::handleParent(const PipeSet& pipes,
 	close(pipes.stdoutPipe[0]);
 
 	// Wait for child to finish (should be quick now)
-	int status;
-	waitpid(childPid, &status, 0);
+	if (!reaped) {
+		waitpid(childPid, &status, 0);
+	}
 
 	if (WIFEXITED(status)) {
 		int exitCode = WEXITSTATUS(status);
-		Logger::info << "CGI exited with code: " << exitCode << std::endl;
+		LOG_INFO << "CGI exited with code: " << exitCode << std::endl;
 	} else if (WIFSIGNALED(status)) {
-		Logger::error << "CGI killed by signal: " << WTERMSIG(status) << std::endl;
+		LOG_ERROR << "CGI killed by signal: " << WTERMSIG(status) << std::endl;
 	}
 
 	return output;
@@ -0,0 +1,418 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Cache.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:31:20 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:31:21 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Cache.cpp
+ * Implementation of the CGI response cache
+ */
+#include "includes/cgi/Cache.hpp"
+#include "includes/cgi/CGIExecutor.hpp"
+#include "includes/http/Request.hpp"
+#include "includes/config/Route.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/utils/Clock.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+namespace CGI {
+
+namespace {
+
+// Value of a "name=N" directive in a lowercased Cache-Control value
+bool directive(const std::string& control, const char* name, long& value) {
+	size_t length = std::strlen(name);
+	size_t pos = 0;
+	while ((pos = control.find(name, pos)) != std::string::npos) {
+		size_t end = pos + length;
+		bool start = (pos == 0 || control[pos - 1] == ' ' || control[pos - 1] == ',');
+		if (start && end < control.size() && control[end] == '=') {
+			const char* digits = control.c_str() + end + 1;
+			char* stop = NULL;
+			value = std::strtol(digits, &stop, 10);
+			return stop != digits && value >= 0;
+		}
+		pos = end;
+	}
+	return false;
+}
+
+bool hasToken(const std::string& control, const char* token) {
+	long ignored;
+	size_t length = std::strlen(token);
+	size_t pos = 0;
+	while ((pos = control.find(token, pos)) != std::string::npos) {
+		size_t end = pos + length;
+		bool start = (pos == 0 || control[pos - 1] == ' ' || control[pos - 1] == ',');
+		if (start && (end == control.size() || control[end] == ',' || control[end] == ' ' ||
+		              (control[end] == '=' && !directive(control, token, ignored)))) {
+			return true;
+		}
+		pos = end;
+	}
+	return false;
+}
+
+// IMF-fixdate (RFC 7231), the format of Expires
+bool parseHttpDate(const std::string& value, time_t& when) {
+	struct tm parts;
+	std::memset(&parts, 0, sizeof(parts));
+	if (!strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &parts)) {
+		return false;
+	}
+	when = timegm(&parts);
+	return true;
+}
+
+}
+
+Cache::Cache()
+	: _size(0)
+	, _capacity(16 * 1024 * 1024)
+	, _hits(0)
+	, _staleHits(0)
+	, _misses(0) {
+}
+
+// Refreshes still running at shutdown are stopped
+Cache::~Cache() {
+	for (size_t i = 0; i < _refreshes.size(); ++i) {
+		close(_refreshes[i].fd);
+		_exiting.push_back(_refreshes[i].pid);
+	}
+	for (size_t i = 0; i < _exiting.size(); ++i) {
+		kill(_exiting[i], SIGKILL);
+		waitpid(_exiting[i], NULL, 0);
+	}
+}
+
+HTTP::Response Cache::serve(const HTTP::Request& request, const Server* server,
+                            const Route* route, const std::string& scriptPath) {
+	Executor executor;
+
+	// Only GET without a body is answered from the cache
+	if (request.getMethod() != "GET" || !request.getBody().empty() || _capacity == 0) {
+		HTTP::Response response = executor.execute(request, server, route, scriptPath);
+		response.setHeader("X-Cache-Status", "BYPASS");
+		return response;
+	}
+
+	std::string key = makeKey(request, route);
+	double now = HTTP::RequestRecord::now();
+	bool refreshing = isRefreshing(key);
+	std::map<std::string, NodeList::iterator>::iterator it = _index.find(key);
+	if (it != _index.end()) {
+		const Entry& entry = it->second->entry;
+		if (now < entry.expires) {
+			++_hits;
+			_nodes.splice(_nodes.begin(), _nodes, it->second);
+			return cached(entry, now, "HIT");
+		}
+		// Expired: served as is while one refresh runs (still served past
+		// stale-while-revalidate if that refresh hasn't finished yet)
+		if (now < entry.staleUntil || refreshing) {
+			++_staleHits;
+			_nodes.splice(_nodes.begin(), _nodes, it->second);
+			if (!refreshing) {
+				refresh(key, request, server, route, scriptPath);
+			}
+			return cached(entry, now, "STALE");
+		}
+	}
+
+	// The entry is gone but its refresh still runs: wait for that one
+	// rather than starting the script a second time
+	++_misses;
+	HTTP::Response response;
+	if (!refreshing || !await(key, response)) {
+		response = executor.execute(request, server, route, scriptPath);
+		store(key, response, route->getCgiCache());
+	}
+	response.setHeader("X-Cache-Status", "MISS");
+	return response;
+}
+
+// Location, method, URI and the cgi_cache_vary headers
+std::string Cache::makeKey(const HTTP::Request& request, const Route* route) {
+	std::ostringstream key;
+	key << route->getMetricsId() << ' ' << request.getMethod() << ' ' << request.getUri();
+	const std::vector<std::string>& vary = route->getCgiCache().vary;
+	for (size_t i = 0; i < vary.size(); ++i) {
+		key << '\n' << request.getHeader(vary[i]);
+	}
+	return key.str();
+}
+
+// How long the response may be served (false: not at all), and for how
+// long after that while it is refreshed
+bool Cache::lifetime(const HTTP::Response& response, const CgiCacheSettings& settings,
+                     double& ttl, double& stale) {
+	if (response.getStatusCode() != 200 || !response.getHeader("Set-Cookie").empty()) {
+		return false;
+	}
+
+	std::string control = response.getHeader("Cache-Control");
+	for (size_t i = 0; i < control.length(); ++i) {
+		control[i] = std::tolower(control[i]);
+	}
+	if (hasToken(control, "no-store") || hasToken(control, "no-cache") ||
+	    hasToken(control, "private")) {
+		return false;
+	}
+
+	ttl = settings.valid;
+	stale = settings.staleWhileRevalidate;
+	long seconds;
+	if (directive(control, "s-maxage", seconds) || directive(control, "max-age", seconds)) {
+		ttl = seconds;
+	} else {
+		std::string expires = response.getHeader("Expires");
+		time_t when;
+		if (!expires.empty()) {
+			ttl = parseHttpDate(expires, when) ? std::difftime(when, Clock::now()) : 0;
+		}
+	}
+	if (directive(control, "stale-while-revalidate", seconds)) {
+		stale = seconds;
+	}
+	return ttl > 0;
+}
+
+HTTP::Response Cache::cached(const Entry& entry, double now, const char* status) {
+	HTTP::Response response = entry.response;
+	std::ostringstream age;
+	age << (now > entry.storedAt ? static_cast<long>(now - entry.storedAt) : 0);
+	response.setHeader("Age", age.str());
+	response.setHeader("X-Cache-Status", status);
+	return response;
+}
+
+// Keep the script's response if it may be cached (replacing the old one)
+void Cache::store(const std::string& key, const HTTP::Response& response,
+                  const CgiCacheSettings& settings) {
+	remove(key);
+
+	double ttl;
+	double stale;
+	if (!lifetime(response, settings, ttl, stale)) {
+		return;
+	}
+
+	std::vector<std::pair<std::string, std::string> > fields;
+	response.getHeaders(fields);
+	size_t bytes = sizeof(Node) + 2 * key.size() + response.getBody().size();
+	for (size_t i = 0; i < fields.size(); ++i) {
+		bytes += fields[i].first.size() + fields[i].second.size() + 4;
+	}
+	if (bytes > _capacity) {
+		return; // Would never fit, don't flush the cache for it
+	}
+	evict(bytes);
+
+	double now = HTTP::RequestRecord::now();
+	_nodes.push_front(Node());
+	Node& node = _nodes.front();
+	node.key = key;
+	node.entry.response = response;
+	node.entry.response.setCgiTiming(0, 0); // Hits don't run the script
+	node.entry.storedAt = now;
+	node.entry.expires = now + ttl;
+	node.entry.staleUntil = now + ttl + stale;
+	node.entry.bytes = bytes;
+	_index[key] = _nodes.begin();
+	_size += bytes;
+
+	LOG_DEBUG << "Cached CGI response for " << key.substr(0, key.find('\n')) << " (" << ttl
+	          << "s), cache: " << _size << "/" << _capacity << " bytes" << std::endl;
+}
+
+void Cache::remove(const std::string& key) {
+	std::map<std::string, NodeList::iterator>::iterator it = _index.find(key);
+	if (it != _index.end()) {
+		_size -= it->second->entry.bytes;
+		_nodes.erase(it->second);
+		_index.erase(it);
+	}
+}
+
+// Drop least recently used responses until `needed` more bytes fit
+void Cache::evict(size_t needed) {
+	while (!_nodes.empty() && _size + needed > _capacity) {
+		Node& victim = _nodes.back();
+		_size -= victim.entry.bytes;
+		_index.erase(victim.key);
+		_nodes.pop_back();
+	}
+}
+
+void Cache::setCapacity(size_t bytes) {
+	_capacity = bytes;
+	evict(0);
+}
+
+// Background refreshes
+bool Cache::isRefreshing(const std::string& key) const {
+	for (size_t i = 0; i < _refreshes.size(); ++i) {
+		if (_refreshes[i].key == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Cache::refresh(const std::string& key, const HTTP::Request& request, const Server* server,
+                    const Route* route, const std::string& scriptPath) {
+	Refresh job;
+	job.key = key;
+	job.settings = route->getCgiCache();
+	job.started = HTTP::RequestRecord::now();
+	job.fd = -1;
+
+	Executor executor;
+	job.pid = executor.start(request, server, route, scriptPath, job.fd);
+	if (job.pid < 0) {
+		return; // The stale response is served until it ages out
+	}
+	_refreshes.push_back(job);
+	LOG_DEBUG << "Refreshing CGI response for " << request.getUri() << " (pid " << job.pid
+	          << ")" << std::endl;
+}
+
+void Cache::getPollFds(std::vector<struct pollfd>& fds) const {
+	for (size_t i = 0; i < _refreshes.size(); ++i) {
+		struct pollfd pfd;
+		pfd.fd = _refreshes[i].fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		fds.push_back(pfd);
+	}
+}
+
+void Cache::handle(int fd, short revents) {
+	size_t i = 0;
+	while (i < _refreshes.size() && _refreshes[i].fd != fd) {
+		++i;
+	}
+	if (i == _refreshes.size() || !(revents & (POLLIN | POLLHUP | POLLERR))) {
+		return;
+	}
+
+	char buffer[4096];
+	while (true) {
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n > 0) {
+			_refreshes[i].output.append(buffer, n);
+		} else if (n == 0) {
+			finish(i, true); // EOF - the script is done
+			return;
+		} else if (errno == EAGAIN || errno == EINTR) {
+			return;
+		} else {
+			finish(i, false);
+			return;
+		}
+	}
+}
+
+// Block until the running refresh for key is done, as a miss would run
+// the script (false if it failed or timed out)
+bool Cache::await(const std::string& key, HTTP::Response& response) {
+	size_t i = 0;
+	while (i < _refreshes.size() && _refreshes[i].key != key) {
+		++i;
+	}
+	if (i == _refreshes.size()) {
+		return false;
+	}
+
+	double deadline = _refreshes[i].started + REFRESH_TIMEOUT;
+	char buffer[4096];
+	while (true) {
+		int wait = static_cast<int>((deadline - HTTP::RequestRecord::now()) * 1000);
+		if (wait <= 0) {
+			LOG_WARNING << "CGI cache refresh timeout - killing process" << std::endl;
+			return finish(i, false);
+		}
+		struct pollfd pfd;
+		pfd.fd = _refreshes[i].fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, wait) < 0 && errno != EINTR) {
+			return finish(i, false);
+		}
+
+		ssize_t n = read(pfd.fd, buffer, sizeof(buffer));
+		if (n > 0) {
+			_refreshes[i].output.append(buffer, n);
+		} else if (n == 0) {
+			return finish(i, true, &response);
+		} else if (errno != EAGAIN && errno != EINTR) {
+			return finish(i, false);
+		}
+	}
+}
+
+// Output complete (or given up on): store it, reap the child when it exits
+bool Cache::finish(size_t index, bool complete, HTTP::Response* response) {
+	Refresh job = _refreshes[index];
+	_refreshes[index] = _refreshes.back();
+	_refreshes.pop_back();
+
+	close(job.fd);
+	if (!complete) {
+		kill(job.pid, SIGKILL);
+	}
+	if (waitpid(job.pid, NULL, WNOHANG) == 0) {
+		_exiting.push_back(job.pid);
+	}
+
+	if (!complete) {
+		return false;
+	}
+	Executor executor;
+	HTTP::Response output = executor.parseCGIOutput(job.output);
+	store(job.key, output, job.settings);
+	if (response) {
+		*response = output;
+	}
+	return true;
+}
+
+// Stop refreshes past the timeout, reap the children that exited
+void Cache::tick() {
+	double now = HTTP::RequestRecord::now();
+	for (size_t i = _refreshes.size(); i-- > 0;) {
+		if (now - _refreshes[i].started > REFRESH_TIMEOUT) {
+			LOG_WARNING << "CGI cache refresh timeout - killing process" << std::endl;
+			finish(i, false);
+		}
+	}
+	for (size_t i = _exiting.size(); i-- > 0;) {
+		if (waitpid(_exiting[i], NULL, WNOHANG) != 0) {
+			_exiting[i] = _exiting.back();
+			_exiting.pop_back();
+		}
+	}
+}
+
+size_t Cache::getSize() const { return _size; }
+size_t Cache::getHits() const { return _hits; }
+size_t Cache::getStaleHits() const { return _staleHits; }
+size_t Cache::getMisses() const { return _misses; }
+
+} // namespace CGI
@@ -0,0 +1,89 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Environment.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:02:43 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:02:44 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Environment.cpp
+ * Implementation of the prepared CGI environment blocks
+ */
+#include "includes/cgi/Environment.hpp"
+#include "includes/config/Config.hpp"
+#include "includes/config/Server.hpp"
+#include "includes/config/Route.hpp"
+#include <sstream>
+
+namespace CGI {
+
+Environment::Environment() {
+}
+
+void Environment::open(const Config& config) {
+	_routes.clear();
+	const std::vector<Server>& servers = config.getServers();
+	for (size_t i = 0; i < servers.size(); ++i) {
+		const std::vector<Route>& routes = servers[i].getRoutes();
+		for (size_t j = 0; j < routes.size(); ++j) {
+			int id = routes[j].getMetricsId();
+			if (id < 0) {
+				continue;
+			}
+			if (static_cast<size_t>(id) >= _routes.size()) {
+				_routes.resize(id + 1);
+			}
+			build(&servers[i], _routes[id]);
+		}
+	}
+}
+
+const std::string& Environment::get(const Server* server, const Route* route) {
+	int id = route ? route->getMetricsId() : -1;
+	if (id >= 0 && static_cast<size_t>(id) < _routes.size() && !_routes[id].empty()) {
+		return _routes[id];
+	}
+	_scratch.clear();
+	build(server, _scratch);
+	return _scratch;
+}
+
+// Variables that only depend on the server (RFC 3875)
+void Environment::build(const Server* server, std::string& block) {
+	block.clear();
+	add(block, "SERVER_SOFTWARE", "webserv/1.0");
+	add(block, "GATEWAY_INTERFACE", "CGI/1.1");
+
+	const std::vector<int>& ports = server->getPorts();
+	std::ostringstream port;
+	port << (ports.empty() ? 8080 : ports[0]); // First port
+	add(block, "SERVER_PORT", port.str());
+
+	const std::vector<std::string>& serverNames = server->getServerNames();
+	add(block, "SERVER_NAME", serverNames.empty() ? server->getHost() : serverNames[0]);
+}
+
+void Environment::add(std::string& block, const char* name, const std::string& value) {
+	block += name;
+	block += '=';
+	block += value;
+	block += '\0';
+}
+
+// The block must not change while envp is in use
+void Environment::index(std::string& block, std::vector<char*>& envp) {
+	envp.clear();
+	size_t start = 0;
+	while (start < block.size()) {
+		envp.push_back(&block[start]);
+		start = block.find('\0', start) + 1;
+	}
+	envp.push_back(NULL);
+}
+
+} // namespace CGI
@@ -17,9 +17,16 @@
 #include "includes/config/Config.hpp"
 #include "includes/utils/Logger.hpp"
 #include <iostream>
+#include <algorithm>
 
 // Constructors
-Config::Config() {}
+Config::Config()
+	: _gzipCacheSize(16 * 1024 * 1024)
+	, _autoindexCacheSize(32 * 1024 * 1024)
+	, _cgiCacheSize(16 * 1024 * 1024)
+	, _captureSample(1)
+	, _captureMaxSize(0) {
+}
 
 Config::~Config() {}
 
@@ -30,6 +37,20 @@ Config::Config(const Config& other) {
 Config& Config::operator=(const Config& other) {
 	if (this != &other) {
 		_servers = other._servers;
+		_gzipCacheSize = other._gzipCacheSize;
+		_autoindexCacheSize = other._autoindexCacheSize;
+		_cgiCacheSize = other._cgiCacheSize;
+		_errorLogPath = other._errorLogPath;
+		_errorLogLevel = other._errorLogLevel;
+		_accessLog = other._accessLog;
+		_accessLogs = other._accessLogs;
+		_capturePath = other._capturePath;
+		_captureSample = other._captureSample;
+		_captureMaxSize = other._captureMaxSize;
+		_mimeTypes = other._mimeTypes;
+		_defaultType = other._defaultType;
+		_limitZones = other._limitZones;
+		_upstreams = other._upstreams;
 	}
 	return *this;
 }
@@ -43,6 +64,111 @@ const std::vector<Server>& Config::getServers() const {
 	return _servers;
 }
 
+// Global settings
+size_t Config::getGzipCacheSize() const {
+	return _gzipCacheSize;
+}
+
+void Config::setGzipCacheSize(size_t size) {
+	_gzipCacheSize = size;
+}
+
+size_t Config::getAutoindexCacheSize() const {
+	return _autoindexCacheSize;
+}
+
+void Config::setAutoindexCacheSize(size_t size) {
+	_autoindexCacheSize = size;
+}
+
+size_t Config::getCgiCacheSize() const {
+	return _cgiCacheSize;
+}
+
+void Config::setCgiCacheSize(size_t size) {
+	_cgiCacheSize = size;
+}
+
+const std::string& Config::getErrorLogPath() const {
+	return _errorLogPath;
+}
+
+const std::string& Config::getErrorLogLevel() const {
+	return _errorLogLevel;
+}
+
+void Config::setErrorLog(const std::string& path, const std::string& level) {
+	_errorLogPath = path;
+	_errorLogLevel = level;
+}
+
+void Config::addAccessLog(const AccessLogSettings& settings) {
+	_accessLog.push_back(settings);
+}
+
+bool Config::hasAccessLog() const {
+	return !_accessLog.empty();
+}
+
+const std::vector<AccessLogSettings>& Config::getAccessLogs() const {
+	return _accessLogs;
+}
+
+const std::string& Config::getCapturePath() const {
+	return _capturePath;
+}
+
+unsigned int Config::getCaptureSample() const {
+	return _captureSample;
+}
+
+size_t Config::getCaptureMaxSize() const {
+	return _captureMaxSize;
+}
+
+void Config::setCapture(const std::string& path, unsigned int sample, size_t maxSize) {
+	_capturePath = path;
+	_captureSample = sample;
+	_captureMaxSize = maxSize;
+}
+
+// Tipos MIME
+void Config::addMimeType(const std::string& type, const std::string& extension) {
+	_mimeTypes.add(type, extension);
+}
+
+const MimeTypes& Config::getMimeTypes() const {
+	return _mimeTypes;
+}
+
+const std::string& Config::getDefaultType() const {
+	return _defaultType;
+}
+
+void Config::setDefaultType(const std::string& type) {
+	_defaultType = type;
+}
+
+// Limites por cliente: o índice da zona é guardado pelos limit_req / limit_conn
+int Config::addLimitZone(const LimitZoneSettings& zone) {
+	_limitZones.push_back(zone);
+	return static_cast<int>(_limitZones.size()) - 1;
+}
+
+const std::vector<LimitZoneSettings>& Config::getLimitZones() const {
+	return _limitZones;
+}
+
+// Upstreams
+int Config::addUpstream(const UpstreamSettings& upstream) {
+	_upstreams.push_back(upstream);
+	return static_cast<int>(_upstreams.size()) - 1;
+}
+
+const std::vector<UpstreamSettings>& Config::getUpstreams() const {
+	return _upstreams;
+}
+
 // Server lookup
 const Server* Config::getServer(const std::string& host, int port, const std::string& serverName) const {
 	// 1. Procurar server com host:port e serverName matching
@@ -115,6 +241,51 @@ bool Config::isValid() const {
 	return true;
 }
 
+// Compilação
+void Config::compile() {
+	// Access logs: servers com o mesmo ficheiro partilham o mesmo log
+	// (e o mesmo buffer); o primeiro a declarar o ficheiro define o formato
+	_accessLogs.clear();
+	for (size_t i = 0; i < _servers.size(); ++i) {
+		Server& server = _servers[i];
+		const std::vector<AccessLogSettings>* logs = NULL;
+		if (server.getAccessLogMode() == Server::ACCESS_LOG_SET)
+			logs = &server.getAccessLogs();
+		else if (server.getAccessLogMode() == Server::ACCESS_LOG_INHERIT)
+			logs = &_accessLog;
+
+		std::vector<int> ids;
+		for (size_t k = 0; logs && k < logs->size(); ++k) {
+			const AccessLogSettings& settings = (*logs)[k];
+			int id = -1;
+			for (size_t j = 0; j < _accessLogs.size() && id < 0; ++j) {
+				if (_accessLogs[j].path == settings.path)
+					id = static_cast<int>(j);
+			}
+			if (id < 0) {
+				id = static_cast<int>(_accessLogs.size());
+				_accessLogs.push_back(settings);
+			}
+			// O mesmo ficheiro duas vezes no mesmo contexto: uma linha por pedido
+			if (std::find(ids.begin(), ids.end(), id) == ids.end())
+				ids.push_back(id);
+		}
+		server.setAccessLogIds(ids);
+	}
+
+	// Tabela de tipos MIME (um bloco types substitui os tipos por omissão)
+	if (_mimeTypes.empty())
+		_mimeTypes.addDefaults();
+	_mimeTypes.compile();
+
+	// Ids das routes contínuos entre servers: um histograma de latência por location
+	int nextRouteId = 0;
+	for (size_t i = 0; i < _servers.size(); ++i) {
+		nextRouteId = _servers[i].assignMetricsIds(nextRouteId);
+		_servers[i].compile();
+	}
+}
+
 // Debug
 void Config::print() const {
 	std::cout << "=== Configuration ===" << std::endl;
@@ -20,7 +20,29 @@
 #include <sstream>
 #include <cstdlib>
 
-ConfigParser::ConfigParser() : _error("") {}
+ConfigParser::ConfigParser() : _error("") {
+	// Formatos pré-definidos (log_format pode acrescentar outros)
+	AccessLogSettings combined;
+	combined.formatName = "combined";
+	combined.format = "$remote_addr - - [$time_local] \"$request\" $status $body_bytes_sent "
+	                  "\"$http_referer\" \"$http_user_agent\"";
+	_logFormats[combined.formatName] = combined;
+
+	AccessLogSettings timed = combined;
+	timed.formatName = "timed";
+	timed.format += " $request_time $upstream_cgi_time";
+	_logFormats[timed.formatName] = timed;
+
+	AccessLogSettings json;
+	json.formatName = "json";
+	json.escapeJson = true;
+	json.format = "{\"time\":\"$time_iso8601\",\"remote_addr\":\"$remote_addr\","
+	              "\"request\":\"$request\",\"status\":$status,"
+	              "\"body_bytes_sent\":$body_bytes_sent,\"request_time\":$request_time,"
+	              "\"upstream_cgi_time\":\"$upstream_cgi_time\","
+	              "\"http_referer\":\"$http_referer\",\"http_user_agent\":\"$http_user_agent\"}";
+	_logFormats[json.formatName] = json;
+}
 
 ConfigParser::~ConfigParser() {}
 
@@ -39,6 +61,12 @@ bool ConfigParser::parse(const std::string& filename, Config& config) {
 		return false;
 	}
 
+	// include: relativo à pasta do ficheiro de configuração
+	size_t slash = filename.rfind('/');
+	std::string baseDir = (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
+	if (!expandIncludes(tokens, baseDir, 0))
+		return false;
+
 	// Parsear tokens
 	size_t index = 0;
 	while (index < tokens.size()) {
@@ -51,17 +79,25 @@ bool ConfigParser::parse(const std::string& filename, Config& config) {
 			}
 			config.addServer(server);
 		} else {
-			setError("Unexpected token: " + token + " (expected 'server')");
-			return false;
+			if (!parseGlobalDirective(token, tokens, index, config)) {
+				return false;
+			}
 		}
 	}
 
+	// Upstreams (blocos upstream e os implícitos dos proxy_pass)
+	for (size_t i = 0; i < _upstreams.size(); ++i)
+		config.addUpstream(_upstreams[i]);
+
 	// Validar configuração
 	if (!config.isValid()) {
 		setError("Invalid configuration");
 		return false;
 	}
 
+	// Pré-calcular o que os handlers precisam em runtime
+	config.compile();
+
 	return true;
 }
 
@@ -100,6 +136,16 @@ std::vector<std::string> ConfigParser::tokenize(const std::string& content) {
 		if (inComment)
 			continue;
 
+		// Strings entre aspas (log_format): um só token, sem as aspas
+		if ((c == '\'' || c == '"') && token.empty()) {
+			size_t end = content.find(c, i + 1);
+			if (end == std::string::npos)
+				end = content.length();
+			tokens.push_back(content.substr(i + 1, end - i - 1));
+			i = end;
+			continue;
+		}
+
 		// Handle whitespace
 		if (c == ' ' || c == '\t' || c == '\r') {
 			if (!token.empty()) {
@@ -131,6 +177,43 @@ std::vector<std::string> ConfigParser::tokenize(const std::string& content) {
 	return tokens;
 }
 
+// Expand includes (os ficheiros incluídos podem incluir outros)
+bool ConfigParser::expandIncludes(std::vector<std::string>& tokens, const std::string& baseDir, int depth) {
+	size_t i = 0;
+	while (i < tokens.size()) {
+		if (tokens[i] != "include") {
+			++i;
+			continue;
+		}
+		if (i + 2 >= tokens.size() || tokens[i + 2] != ";") {
+			setError("Expected 'include <file>;'");
+			return false;
+		}
+		if (depth >= 8) {
+			setError("Too many nested includes: " + tokens[i + 1]);
+			return false;
+		}
+
+		std::string path = tokens[i + 1];
+		if (path[0] != '/')
+			path = baseDir + path;
+		std::string content = readFile(path);
+		if (content.empty()) {
+			setError("Failed to read included file: " + path);
+			return false;
+		}
+		std::vector<std::string> included = tokenize(content);
+		size_t slash = path.rfind('/');
+		if (!expandIncludes(included, (slash == std::string::npos) ? "" : path.substr(0, slash + 1), depth + 1))
+			return false;
+
+		tokens.erase(tokens.begin() + i, tokens.begin() + i + 3);
+		tokens.insert(tokens.begin() + i, included.begin(), included.end());
+		i += included.size();
+	}
+	return true;
+}
+
 // Parse server block
 bool ConfigParser::parseServer(std::vector<std::string>& tokens, size_t& index, Server& server) {
 	++index; // Skip "server"
@@ -187,6 +270,118 @@ bool ConfigParser::parseLocation(std::vector<std::string>& tokens, size_t& index
 	return true;
 }
 
+// Parse global directive (outside any server block)
+bool ConfigParser::parseGlobalDirective(const std::string& directive,
+                                       std::vector<std::string>& tokens,
+                                       size_t& index,
+                                       Config& config) {
+	++index; // Skip directive
+
+	if (directive == "gzip_cache_size") {
+		if (index >= tokens.size()) {
+			setError("Expected size after 'gzip_cache_size'");
+			return false;
+		}
+		config.setGzipCacheSize(toSize(tokens[index++]));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "autoindex_cache_size") {
+		if (index >= tokens.size()) {
+			setError("Expected size after 'autoindex_cache_size'");
+			return false;
+		}
+		config.setAutoindexCacheSize(toSize(tokens[index++]));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "cgi_cache_size") {
+		if (index >= tokens.size()) {
+			setError("Expected size after 'cgi_cache_size'");
+			return false;
+		}
+		config.setCgiCacheSize(toSize(tokens[index++]));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "error_log") {
+		// error_log <ficheiro|stderr> [nível];
+		if (index >= tokens.size() || tokens[index] == ";") {
+			setError("Expected path after 'error_log'");
+			return false;
+		}
+		std::string path = tokens[index++];
+		std::string level;
+		if (index < tokens.size() && tokens[index] != ";") {
+			level = tokens[index++];
+			Logger::Level parsed;
+			if (!Logger::parseLevel(level, parsed)) {
+				setError("Invalid error_log level: " + level);
+				return false;
+			}
+		}
+		config.setErrorLog(path, level);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "log_format") {
+		return parseLogFormat(tokens, index);
+
+	} else if (directive == "access_log") {
+		AccessLogSettings settings;
+		bool off = false;
+		if (!parseAccessLog(tokens, index, settings, off))
+			return false;
+		if (!off)
+			config.addAccessLog(settings);
+		return true;
+
+	} else if (directive == "types") {
+		return parseTypes(tokens, index, config);
+
+	} else if (directive == "default_type") {
+		if (index >= tokens.size() || tokens[index] == ";") {
+			setError("Expected type after 'default_type'");
+			return false;
+		}
+		config.setDefaultType(tokens[index++]);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "limit_req_zone" || directive == "limit_conn_zone") {
+		return parseLimitZone(directive, tokens, index, config);
+
+	} else if (directive == "upstream") {
+		return parseUpstream(tokens, index);
+
+	} else if (directive == "capture") {
+		// capture <ficheiro> [sample=N] [max_size=64m];
+		if (index >= tokens.size() || tokens[index] == ";") {
+			setError("Expected path after 'capture'");
+			return false;
+		}
+		std::string path = tokens[index++];
+		unsigned int sample = 1;
+		size_t maxSize = 0;
+		while (index < tokens.size() && tokens[index] != ";") {
+			const std::string& option = tokens[index++];
+			size_t equals = option.find('=');
+			std::string name = option.substr(0, equals);
+			std::string value = (equals == std::string::npos) ? "" : option.substr(equals + 1);
+
+			if (name == "sample" && isNumber(value) && toInt(value) >= 1) {
+				sample = static_cast<unsigned int>(toInt(value));
+			} else if (name == "max_size" && !value.empty()) {
+				maxSize = toSize(value);
+			} else {
+				setError("Invalid capture parameter: " + option);
+				return false;
+			}
+		}
+		config.setCapture(path, sample, maxSize);
+		return expectToken(tokens, index, ";");
+
+	} else {
+		setError("Unexpected token: " + directive + " (expected 'server')");
+		return false;
+	}
+}
+
 // Parse server directive
 bool ConfigParser::parseServerDirective(const std::string& directive,
                                        std::vector<std::string>& tokens,
@@ -202,6 +397,7 @@ bool ConfigParser::parseServerDirective(const std::string& directive,
 
 		std::string listenValue = tokens[index++];
 		size_t colonPos = listenValue.find(':');
+		int port;
 
 		if (colonPos != std::string::npos) {
 			// Format: host:port
@@ -210,20 +406,25 @@ bool ConfigParser::parseServerDirective(const std::string& directive,
 
 			server.setHost(host);
 
-			int port = toInt(portStr);
+			port = toInt(portStr);
 			if (port <= 0 || port > 65535) {
 				setError("Invalid port number in listen directive");
 				return false;
 			}
-			server.addPort(port);
 		} else {
 			// Format: port only
-			int port = toInt(listenValue);
+			port = toInt(listenValue);
 			if (port <= 0 || port > 65535) {
 				setError("Invalid port number");
 				return false;
 			}
-			server.addPort(port);
+		}
+		server.addPort(port);
+
+		// Parâmetro opcional: "listen 443 ssl;"
+		if (index < tokens.size() && tokens[index] == "ssl") {
+			server.addSslPort(port);
+			++index;
 		}
 
 		return expectToken(tokens, index, ";");
@@ -251,6 +452,47 @@ bool ConfigParser::parseServerDirective(const std::string& directive,
 		server.setMaxBodySize(size);
 		return expectToken(tokens, index, ";");
 
+	} else if (directive == "ssl_certificate" || directive == "ssl_certificate_key") {
+		if (index >= tokens.size()) {
+			setError("Expected path after '" + directive + "'");
+			return false;
+		}
+		if (directive == "ssl_certificate") {
+			server.setSslCertificate(tokens[index++]);
+		} else {
+			server.setSslCertificateKey(tokens[index++]);
+		}
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "ssl_session_cache") {
+		if (index >= tokens.size()) {
+			setError("Expected entry count or 'off' after 'ssl_session_cache'");
+			return false;
+		}
+		std::string value = tokens[index++];
+		if (value != "off" && !isNumber(value)) {
+			setError("Invalid ssl_session_cache value: " + value);
+			return false;
+		}
+		server.setSslSessionCache(value == "off" ? 0 : toSize(value));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "ssl_session_timeout") {
+		if (index >= tokens.size() || !isNumber(tokens[index])) {
+			setError("Expected seconds after 'ssl_session_timeout'");
+			return false;
+		}
+		server.setSslSessionTimeout(toInt(tokens[index++]));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "ssl_session_tickets") {
+		if (index >= tokens.size()) {
+			setError("Expected on/off after 'ssl_session_tickets'");
+			return false;
+		}
+		server.setSslSessionTickets(tokens[index++] == "on");
+		return expectToken(tokens, index, ";");
+
 	} else if (directive == "error_page") {
 		if (index + 1 >= tokens.size()) {
 			setError("Expected code and path after 'error_page'");
@@ -261,6 +503,64 @@ bool ConfigParser::parseServerDirective(const std::string& directive,
 		server.setErrorPage(code, path);
 		return expectToken(tokens, index, ";");
 
+	} else if (directive == "server_timing") {
+		if (index >= tokens.size()) {
+			setError("Expected on/off after 'server_timing'");
+			return false;
+		}
+		server.setServerTiming(tokens[index++] == "on");
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "slow_request_threshold") {
+		// slow_request_threshold <tempo>;  ("500ms", "2s", "off")
+		if (index >= tokens.size() || tokens[index] == ";") {
+			setError("Expected time after 'slow_request_threshold'");
+			return false;
+		}
+		std::string value = tokens[index++];
+		double seconds = 0;
+		if (value != "off" && (!toSeconds(value, seconds) || seconds <= 0)) {
+			setError("Invalid slow_request_threshold: " + value);
+			return false;
+		}
+		server.setSlowRequestThreshold(seconds);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "limit_req") {
+		LimitReqSettings limit;
+		if (!parseLimitReq(tokens, index, limit))
+			return false;
+		server.addLimitReq(limit);
+		return true;
+
+	} else if (directive == "limit_conn") {
+		LimitConnSettings limit;
+		if (!parseLimitConn(tokens, index, limit))
+			return false;
+		server.addLimitConn(limit);
+		return true;
+
+	} else if (directive == "limit_req_status" || directive == "limit_conn_status") {
+		int status;
+		if (!parseLimitStatus(directive, tokens, index, status))
+			return false;
+		if (directive == "limit_req_status")
+			server.setLimitReqStatus(status);
+		else
+			server.setLimitConnStatus(status);
+		return true;
+
+	} else if (directive == "access_log") {
+		AccessLogSettings settings;
+		bool off = false;
+		if (!parseAccessLog(tokens, index, settings, off))
+			return false;
+		if (off)
+			server.setAccessLogOff();
+		else
+			server.addAccessLog(settings);
+		return true;
+
 	} else {
 		setError("Unknown server directive: " + directive);
 		return false;
@@ -305,6 +605,15 @@ bool ConfigParser::parseLocationDirective(const std::string& directive,
 		route.setDirectoryListing(value == "on");
 		return expectToken(tokens, index, ";");
 
+	} else if (directive == "autoindex_format") {
+		// autoindex_format html|json;
+		if (index >= tokens.size() || (tokens[index] != "html" && tokens[index] != "json")) {
+			setError("Expected html/json after 'autoindex_format'");
+			return false;
+		}
+		route.setDirectoryListingJson(tokens[index++] == "json");
+		return expectToken(tokens, index, ";");
+
 	} else if (directive == "index") {
 		while (index < tokens.size() && tokens[index] != ";") {
 			route.addIndexFile(tokens[index++]);
@@ -328,6 +637,37 @@ bool ConfigParser::parseLocationDirective(const std::string& directive,
 		route.setCgiExtension(tokens[index++]);
 		return expectToken(tokens, index, ";");
 
+	} else if (directive == "cgi_cache") {
+		if (index >= tokens.size() || (tokens[index] != "on" && tokens[index] != "off")) {
+			setError("Expected on/off after 'cgi_cache'");
+			return false;
+		}
+		route.setCgiCache(tokens[index++] == "on");
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "cgi_cache_valid" || directive == "cgi_cache_stale_while_revalidate") {
+		double seconds;
+		if (index >= tokens.size() || !toSeconds(tokens[index], seconds) || seconds <= 0) {
+			setError("Expected time (e.g. 1s, 30s) after '" + directive + "'");
+			return false;
+		}
+		++index;
+		if (directive == "cgi_cache_valid")
+			route.setCgiCacheValid(seconds);
+		else
+			route.setCgiCacheStale(seconds);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "cgi_cache_vary") {
+		if (index >= tokens.size() || tokens[index] == ";") {
+			setError("Expected header names after 'cgi_cache_vary'");
+			return false;
+		}
+		while (index < tokens.size() && tokens[index] != ";") {
+			route.addCgiCacheVary(tokens[index++]);
+		}
+		return expectToken(tokens, index, ";");
+
 	} else if (directive == "upload_enable") {
 		if (index >= tokens.size()) {
 			setError("Expected on/off after 'upload_enable'");
@@ -337,6 +677,109 @@ bool ConfigParser::parseLocationDirective(const std::string& directive,
 		route.setUploadEnabled(value == "on");
 		return expectToken(tokens, index, ";");
 
+	} else if (directive == "gzip" || directive == "gzip_static") {
+		if (index >= tokens.size()) {
+			setError("Expected on/off after '" + directive + "'");
+			return false;
+		}
+		bool enabled = (tokens[index++] == "on");
+		if (directive == "gzip") {
+			route.setGzip(enabled);
+		} else {
+			route.setGzipStatic(enabled);
+		}
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "gzip_min_length") {
+		if (index >= tokens.size()) {
+			setError("Expected size after 'gzip_min_length'");
+			return false;
+		}
+		route.setGzipMinLength(toSize(tokens[index++]));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "gzip_max_length") {
+		if (index >= tokens.size()) {
+			setError("Expected size after 'gzip_max_length'");
+			return false;
+		}
+		route.setGzipMaxLength(toSize(tokens[index++]));
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "gzip_comp_level") {
+		if (index >= tokens.size() || !isNumber(tokens[index])) {
+			setError("Expected level (1-9) after 'gzip_comp_level'");
+			return false;
+		}
+		int level = toInt(tokens[index++]);
+		if (level < 1 || level > 9) {
+			setError("Invalid gzip_comp_level (expected 1-9)");
+			return false;
+		}
+		route.setGzipCompLevel(level);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "default_type") {
+		if (index >= tokens.size() || tokens[index] == ";") {
+			setError("Expected type after 'default_type'");
+			return false;
+		}
+		route.setDefaultType(tokens[index++]);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "gzip_types") {
+		while (index < tokens.size() && tokens[index] != ";") {
+			route.addGzipType(tokens[index++]);
+		}
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "stub_status" || directive == "metrics") {
+		// Sem argumentos (ou "on"): a location responde com as métricas
+		if (index < tokens.size() && tokens[index] == "on")
+			++index;
+		route.setStubStatus(true);
+		return expectToken(tokens, index, ";");
+
+	} else if (directive == "limit_req") {
+		LimitReqSettings limit;
+		if (!parseLimitReq(tokens, index, limit))
+			return false;
+		route.addLimitReq(limit);
+		return true;
+
+	} else if (directive == "limit_conn") {
+		LimitConnSettings limit;
+		if (!parseLimitConn(tokens, index, limit))
+			return false;
+		route.addLimitConn(limit);
+		return true;
+
+	} else if (directive == "limit_req_status" || directive == "limit_conn_status") {
+		int status;
+		if (!parseLimitStatus(directive, tokens, index, status))
+			return false;
+		if (directive == "limit_req_status")
+			route.setLimitReqStatus(status);
+		else
+			route.setLimitConnStatus(status);
+		return true;
+
+	} else if (directive == "proxy_pass") {
+		return parseProxyPass(tokens, index, route);
+
+	} else if (directive == "proxy_connect_timeout" || directive == "proxy_read_timeout") {
+		double seconds;
+		if (index >= tokens.size() || !toSeconds(tokens[index], seconds) || seconds <= 0) {
+			setError("Expected time (e.g. 60s, 500ms) after '" + directive + "'");
+			return false;
+		}
+		++index;
+		if (directive == "proxy_connect_timeout")
+			route.setProxyConnectTimeout(seconds);
+		else
+			route.setProxyReadTimeout(seconds);
+		return expectToken(tokens, index, ";");
+
 	} else if (directive == "upload_store" || directive == "upload_path") {
 		if (index >= tokens.size()) {
 			setError("Expected path after '" + directive + "'");
@@ -351,6 +794,401 @@ bool ConfigParser::parseLocationDirective(const std::string& directive,
 	}
 }
 
+// types { text/html html htm; ... } (o formato do mime.types do nginx)
+bool ConfigParser::parseTypes(std::vector<std::string>& tokens, size_t& index, Config& config) {
+	if (!expectToken(tokens, index, "{"))
+		return false;
+
+	while (index < tokens.size() && tokens[index] != "}") {
+		std::string type = tokens[index++];
+		size_t count = 0;
+		while (index < tokens.size() && tokens[index] != ";" && tokens[index] != "}") {
+			config.addMimeType(type, tokens[index++]);
+			++count;
+		}
+		if (count == 0) {
+			setError("Expected extensions after type '" + type + "'");
+			return false;
+		}
+		if (!expectToken(tokens, index, ";"))
+			return false;
+	}
+
+	return expectToken(tokens, index, "}");
+}
+
+// limit_req_zone $binary_remote_addr zone=<nome>:<tamanho> rate=<N>r/s|r/m;
+// limit_conn_zone $binary_remote_addr zone=<nome>:<tamanho>;
+bool ConfigParser::parseLimitZone(const std::string& directive, std::vector<std::string>& tokens,
+                                  size_t& index, Config& config) {
+	LimitZoneSettings zone;
+	zone.requests = (directive == "limit_req_zone");
+
+	// Só o endereço do cliente serve de chave
+	if (index >= tokens.size() ||
+	    (tokens[index] != "$binary_remote_addr" && tokens[index] != "$remote_addr")) {
+		setError("Expected $binary_remote_addr after '" + directive + "'");
+		return false;
+	}
+	++index;
+
+	while (index < tokens.size() && tokens[index] != ";") {
+		const std::string& option = tokens[index++];
+		size_t equals = option.find('=');
+		std::string name = option.substr(0, equals);
+		std::string value = (equals == std::string::npos) ? "" : option.substr(equals + 1);
+
+		if (name == "zone") {
+			size_t colon = value.find(':');
+			if (colon == 0 || colon == std::string::npos || colon + 1 == value.length()) {
+				setError("Invalid " + directive + " zone (expected zone=<name>:<size>): " + value);
+				return false;
+			}
+			zone.name = value.substr(0, colon);
+			zone.size = toSize(value.substr(colon + 1));
+		} else if (name == "rate" && zone.requests) {
+			// Guardada em pedidos por 1000 segundos (permite 1r/m sem arredondar)
+			size_t unit = value.find("r/");
+			std::string number = value.substr(0, unit);
+			std::string per = (unit == std::string::npos) ? "" : value.substr(unit + 2);
+			if (!isNumber(number) || toInt(number) <= 0 || (per != "s" && per != "m")) {
+				setError("Invalid limit_req_zone rate (expected <N>r/s or <N>r/m): " + value);
+				return false;
+			}
+			zone.rate = static_cast<unsigned long>(toInt(number)) * 1000;
+			if (per == "m")
+				zone.rate /= 60;
+		} else {
+			setError("Invalid " + directive + " parameter: " + option);
+			return false;
+		}
+	}
+
+	if (zone.name.empty() || zone.size == 0) {
+		setError("Expected zone=<name>:<size> in '" + directive + "'");
+		return false;
+	}
+	if (zone.requests && zone.rate == 0) {
+		setError("Expected rate=<N>r/s in 'limit_req_zone'");
+		return false;
+	}
+	if (_limitZones.count(zone.name)) {
+		setError("Duplicate limit zone: " + zone.name);
+		return false;
+	}
+	_limitZones[zone.name] = std::make_pair(config.addLimitZone(zone), zone.requests);
+	return expectToken(tokens, index, ";");
+}
+
+// limit_req zone=<nome> [burst=N] [nodelay | delay=N];
+bool ConfigParser::parseLimitReq(std::vector<std::string>& tokens, size_t& index, LimitReqSettings& limit) {
+	bool nodelay = false;
+	while (index < tokens.size() && tokens[index] != ";") {
+		const std::string& option = tokens[index++];
+		size_t equals = option.find('=');
+		std::string name = option.substr(0, equals);
+		std::string value = (equals == std::string::npos) ? "" : option.substr(equals + 1);
+
+		if (name == "zone") {
+			std::map<std::string, std::pair<int, bool> >::const_iterator it = _limitZones.find(value);
+			if (it == _limitZones.end() || !it->second.second) {
+				setError("Unknown limit_req_zone: " + value);
+				return false;
+			}
+			limit.zone = it->second.first;
+		} else if ((name == "burst" || name == "delay") && isNumber(value)) {
+			if (name == "burst")
+				limit.burst = static_cast<unsigned int>(toInt(value));
+			else
+				limit.delay = static_cast<unsigned int>(toInt(value));
+		} else if (option == "nodelay") {
+			nodelay = true;
+		} else {
+			setError("Invalid limit_req parameter: " + option);
+			return false;
+		}
+	}
+
+	if (limit.zone < 0) {
+		setError("Expected zone=<name> in 'limit_req'");
+		return false;
+	}
+	// nodelay: todo o burst é servido de imediato
+	if (nodelay || limit.delay > limit.burst)
+		limit.delay = limit.burst;
+	return expectToken(tokens, index, ";");
+}
+
+// limit_conn <zona> <N>;
+bool ConfigParser::parseLimitConn(std::vector<std::string>& tokens, size_t& index, LimitConnSettings& limit) {
+	if (index + 1 >= tokens.size()) {
+		setError("Expected zone and number after 'limit_conn'");
+		return false;
+	}
+	std::map<std::string, std::pair<int, bool> >::const_iterator it = _limitZones.find(tokens[index]);
+	if (it == _limitZones.end() || it->second.second) {
+		setError("Unknown limit_conn_zone: " + tokens[index]);
+		return false;
+	}
+	limit.zone = it->second.first;
+	++index;
+
+	if (!isNumber(tokens[index]) || toInt(tokens[index]) <= 0) {
+		setError("Invalid limit_conn number: " + tokens[index]);
+		return false;
+	}
+	limit.max = static_cast<unsigned int>(toInt(tokens[index++]));
+	return expectToken(tokens, index, ";");
+}
+
+// limit_req_status / limit_conn_status <400-599>;
+bool ConfigParser::parseLimitStatus(const std::string& directive, std::vector<std::string>& tokens,
+                                    size_t& index, int& status) {
+	if (index >= tokens.size() || !isNumber(tokens[index]) ||
+	    toInt(tokens[index]) < 400 || toInt(tokens[index]) > 599) {
+		setError("Expected status (400-599) after '" + directive + "'");
+		return false;
+	}
+	status = toInt(tokens[index++]);
+	return expectToken(tokens, index, ";");
+}
+
+// upstream <nome> { server ...; [least_conn; | hash <chave>;] [keepalive N;] [keepalive_timeout T;] }
+// Tem de ser declarado antes dos proxy_pass que o usam
+bool ConfigParser::parseUpstream(std::vector<std::string>& tokens, size_t& index) {
+	if (index >= tokens.size() || tokens[index] == "{") {
+		setError("Expected name after 'upstream'");
+		return false;
+	}
+	UpstreamSettings upstream;
+	upstream.name = tokens[index++];
+	if (_upstreamNames.count(upstream.name)) {
+		setError("Duplicate upstream: " + upstream.name);
+		return false;
+	}
+	if (!expectToken(tokens, index, "{"))
+		return false;
+
+	while (index < tokens.size() && tokens[index] != "}") {
+		const std::string directive = tokens[index++];
+
+		if (directive == "server") {
+			UpstreamPeerSettings peer;
+			if (!parseUpstreamServer(tokens, index, peer))
+				return false;
+			upstream.peers.push_back(peer);
+			continue;
+		} else if (directive == "least_conn") {
+			upstream.balance = UpstreamSettings::BALANCE_LEAST_CONN;
+		} else if (directive == "hash") {
+			// Só estas duas chaves (o endereço do cliente ou o URI do pedido)
+			if (index >= tokens.size() ||
+			    (tokens[index] != "$remote_addr" && tokens[index] != "$request_uri")) {
+				setError("Expected $remote_addr or $request_uri after 'hash'");
+				return false;
+			}
+			upstream.balance = UpstreamSettings::BALANCE_HASH;
+			upstream.hashUri = (tokens[index++] == "$request_uri");
+		} else if (directive == "keepalive") {
+			if (index >= tokens.size() || !isNumber(tokens[index])) {
+				setError("Expected number after 'keepalive'");
+				return false;
+			}
+			upstream.keepalive = static_cast<unsigned int>(toInt(tokens[index++]));
+		} else if (directive == "keepalive_timeout") {
+			if (index >= tokens.size() || !toSeconds(tokens[index], upstream.keepaliveTimeout) ||
+			    upstream.keepaliveTimeout <= 0) {
+				setError("Expected time after 'keepalive_timeout'");
+				return false;
+			}
+			++index;
+		} else {
+			setError("Unknown upstream directive: " + directive);
+			return false;
+		}
+		if (!expectToken(tokens, index, ";"))
+			return false;
+	}
+
+	if (upstream.peers.empty()) {
+		setError("No servers in upstream " + upstream.name);
+		return false;
+	}
+	_upstreamNames[upstream.name] = static_cast<int>(_upstreams.size());
+	_upstreams.push_back(upstream);
+	return expectToken(tokens, index, "}");
+}
+
+// server <host>[:<porta>] [weight=N] [max_fails=N] [fail_timeout=T];
+bool ConfigParser::parseUpstreamServer(std::vector<std::string>& tokens, size_t& index,
+                                       UpstreamPeerSettings& peer) {
+	if (index >= tokens.size() || tokens[index] == ";") {
+		setError("Expected address after 'server'");
+		return false;
+	}
+	if (!parseHostPort(tokens[index++], peer.host, peer.port))
+		return false;
+
+	while (index < tokens.size() && tokens[index] != ";") {
+		const std::string& option = tokens[index++];
+		size_t equals = option.find('=');
+		std::string name = option.substr(0, equals);
+		std::string value = (equals == std::string::npos) ? "" : option.substr(equals + 1);
+
+		bool valid;
+		if (name == "weight") {
+			valid = isNumber(value) && toInt(value) >= 1;
+			peer.weight = static_cast<unsigned int>(toInt(value));
+		} else if (name == "max_fails") {
+			valid = isNumber(value);
+			peer.maxFails = static_cast<unsigned int>(toInt(value));
+		} else {
+			valid = (name == "fail_timeout" && toSeconds(value, peer.failTimeout) && peer.failTimeout > 0);
+		}
+		if (!valid) {
+			setError("Invalid upstream server parameter: " + option);
+			return false;
+		}
+	}
+	return expectToken(tokens, index, ";");
+}
+
+// proxy_pass http://<upstream | host[:porta]>[/uri];
+// Com /uri, o prefixo da location é substituído por ele (como no nginx)
+bool ConfigParser::parseProxyPass(std::vector<std::string>& tokens, size_t& index, Route& route) {
+	if (index >= tokens.size() || tokens[index].compare(0, 7, "http://") != 0) {
+		setError("Expected http://<address> after 'proxy_pass'");
+		return false;
+	}
+	std::string target = tokens[index++].substr(7);
+	size_t slash = target.find('/');
+	std::string authority = target.substr(0, slash);
+	std::string uri = (slash == std::string::npos) ? "" : target.substr(slash);
+
+	// Um upstream com este nome, ou um upstream implícito só com este servidor
+	std::map<std::string, int>::const_iterator it = _upstreamNames.find(authority);
+	int upstream;
+	if (it != _upstreamNames.end()) {
+		upstream = it->second;
+	} else {
+		UpstreamPeerSettings peer;
+		if (!parseHostPort(authority, peer.host, peer.port))
+			return false;
+		UpstreamSettings implicit;
+		implicit.name = authority;
+		implicit.peers.push_back(peer);
+		upstream = static_cast<int>(_upstreams.size());
+		_upstreamNames[authority] = upstream;
+		_upstreams.push_back(implicit);
+	}
+
+	route.setProxyPass(upstream, uri, slash != std::string::npos);
+	return expectToken(tokens, index, ";");
+}
+
+// <host>[:<porta>] (porta 80 por omissão)
+bool ConfigParser::parseHostPort(const std::string& address, std::string& host, int& port) {
+	size_t colon = address.rfind(':');
+	host = address.substr(0, colon);
+	port = 80;
+	if (colon != std::string::npos) {
+		std::string number = address.substr(colon + 1);
+		if (!isNumber(number) || toInt(number) < 1 || toInt(number) > 65535) {
+			setError("Invalid port in upstream address: " + address);
+			return false;
+		}
+		port = toInt(number);
+	}
+	if (host.empty()) {
+		setError("Invalid upstream address: " + address);
+		return false;
+	}
+	return true;
+}
+
+// log_format <nome> [escape=json|default] '<texto>' ['<texto>' ...];
+bool ConfigParser::parseLogFormat(std::vector<std::string>& tokens, size_t& index) {
+	if (index >= tokens.size() || tokens[index] == ";") {
+		setError("Expected name after 'log_format'");
+		return false;
+	}
+	AccessLogSettings format;
+	format.formatName = tokens[index++];
+
+	if (index < tokens.size() && tokens[index].compare(0, 7, "escape=") == 0) {
+		std::string escape = tokens[index++].substr(7);
+		if (escape != "json" && escape != "default") {
+			setError("Invalid log_format escape: " + escape);
+			return false;
+		}
+		format.escapeJson = (escape == "json");
+	}
+
+	// Várias strings são concatenadas (formatos longos em várias linhas)
+	while (index < tokens.size() && tokens[index] != ";")
+		format.format += tokens[index++];
+	if (format.format.empty()) {
+		setError("Expected format string after 'log_format " + format.formatName + "'");
+		return false;
+	}
+
+	_logFormats[format.formatName] = format;
+	return expectToken(tokens, index, ";");
+}
+
+// access_log <ficheiro> [formato] [buffer=64k] [flush=1s] [sample=N];  ou  access_log off;
+bool ConfigParser::parseAccessLog(std::vector<std::string>& tokens, size_t& index,
+                                  AccessLogSettings& settings, bool& off) {
+	if (index >= tokens.size() || tokens[index] == ";") {
+		setError("Expected path or 'off' after 'access_log'");
+		return false;
+	}
+	std::string path = tokens[index++];
+	if (path == "off") {
+		off = true;
+		return expectToken(tokens, index, ";");
+	}
+
+	std::string formatName = "combined";
+	if (index < tokens.size() && tokens[index] != ";" && tokens[index].find('=') == std::string::npos)
+		formatName = tokens[index++];
+
+	// O formato tem de estar definido antes (como no nginx)
+	std::map<std::string, AccessLogSettings>::const_iterator format = _logFormats.find(formatName);
+	if (format == _logFormats.end()) {
+		setError("Unknown log_format in access_log: " + formatName);
+		return false;
+	}
+	settings = format->second;
+	settings.path = path;
+
+	while (index < tokens.size() && tokens[index] != ";") {
+		const std::string& option = tokens[index++];
+		size_t equals = option.find('=');
+		std::string name = option.substr(0, equals);
+		std::string value = (equals == std::string::npos) ? "" : option.substr(equals + 1);
+
+		if (name == "buffer" && !value.empty()) {
+			settings.bufferSize = toSize(value);
+		} else if (name == "flush" && !value.empty()) {
+			// Em segundos: "1s" ou "1"
+			if (value[value.length() - 1] == 's')
+				value.erase(value.length() - 1);
+			if (!isNumber(value) || toInt(value) < 1) {
+				setError("Invalid access_log flush interval: " + option);
+				return false;
+			}
+			settings.flushInterval = toInt(value);
+		} else if (name == "sample" && isNumber(value) && toInt(value) >= 1) {
+			settings.sample = static_cast<unsigned int>(toInt(value));
+		} else {
+			setError("Invalid access_log parameter: " + option);
+			return false;
+		}
+	}
+	return expectToken(tokens, index, ";");
+}
+
 // Utility functions
 bool ConfigParser::expectToken(std::vector<std::string>& tokens, size_t& index, const std::string& expected) {
 	if (index >= tokens.size()) {
@@ -401,6 +1239,25 @@ size_t ConfigParser::toSize(const std::string& str) {
 	return static_cast<size_t>(atoi(numStr.c_str())) * multiplier;
 }
 
+// Tempo com sufixo ms ou s (sem sufixo = segundos, aceita decimais)
+bool ConfigParser::toSeconds(const std::string& str, double& seconds) {
+	std::string number = str;
+	double scale = 1;
+	if (number.length() > 2 && number.compare(number.length() - 2, 2, "ms") == 0) {
+		number.erase(number.length() - 2);
+		scale = 0.001;
+	} else if (number.length() > 1 && number[number.length() - 1] == 's') {
+		number.erase(number.length() - 1);
+	}
+
+	char* end = NULL;
+	double value = strtod(number.c_str(), &end);
+	if (number.empty() || *end != '\0' || value < 0)
+		return false;
+	seconds = value * scale;
+	return true;
+}
+
 std::string ConfigParser::readFile(const std::string& filename) {
 	std::ifstream file(filename.c_str());
 	if (!file.is_open()) {
@@ -416,5 +1273,5 @@ std::string ConfigParser::readFile(const std::string& filename) {
 
 void ConfigParser::setError(const std::string& error) {
 	_error = error;
-	Logger::error << error << std::endl;
+	LOG_ERROR << error << std::endl;
 }
@@ -0,0 +1,149 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MimeTypes.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:40:05 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 19:40:06 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * MimeTypes.cpp
+ * Implementação da tabela de tipos MIME
+ */
+#include "includes/config/MimeTypes.hpp"
+#include <map>
+
+namespace {
+	// Tipos por omissão (config/mime.types tem a lista completa)
+	const char* const DEFAULT_TYPES[][2] = {
+		{ "html", "text/html" },
+		{ "htm", "text/html" },
+		{ "css", "text/css" },
+		{ "js", "application/javascript" },
+		{ "mjs", "application/javascript" },
+		{ "json", "application/json" },
+		{ "map", "application/json" },
+		{ "xml", "application/xml" },
+		{ "txt", "text/plain" },
+		{ "csv", "text/csv" },
+		{ "md", "text/markdown" },
+		{ "png", "image/png" },
+		{ "jpg", "image/jpeg" },
+		{ "jpeg", "image/jpeg" },
+		{ "gif", "image/gif" },
+		{ "svg", "image/svg+xml" },
+		{ "svgz", "image/svg+xml" },
+		{ "ico", "image/x-icon" },
+		{ "webp", "image/webp" },
+		{ "avif", "image/avif" },
+		{ "bmp", "image/bmp" },
+		{ "woff", "font/woff" },
+		{ "woff2", "font/woff2" },
+		{ "ttf", "font/ttf" },
+		{ "otf", "font/otf" },
+		{ "wasm", "application/wasm" },
+		{ "pdf", "application/pdf" },
+		{ "zip", "application/zip" },
+		{ "tar", "application/x-tar" },
+		{ "gz", "application/gzip" },
+		{ "mp3", "audio/mpeg" },
+		{ "ogg", "audio/ogg" },
+		{ "wav", "audio/wav" },
+		{ "mp4", "video/mp4" },
+		{ "webm", "video/webm" }
+	};
+
+	inline char lower(char c) {
+		return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+	}
+}
+
+MimeTypes::MimeTypes() : _mask(0), _count(0) {}
+
+void MimeTypes::add(const std::string& type, const std::string& extension) {
+	std::string key;
+	for (size_t i = 0; i < extension.length(); ++i)
+		key += lower(extension[i]);
+	_entries.push_back(std::make_pair(key, type));
+}
+
+bool MimeTypes::empty() const {
+	return _entries.empty();
+}
+
+void MimeTypes::addDefaults() {
+	for (size_t i = 0; i < sizeof(DEFAULT_TYPES) / sizeof(DEFAULT_TYPES[0]); ++i)
+		add(DEFAULT_TYPES[i][1], DEFAULT_TYPES[i][0]);
+}
+
+// FNV-1a sobre a extensão em minúsculas
+unsigned int MimeTypes::hash(const char* extension, size_t length) {
+	unsigned int value = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		value ^= static_cast<unsigned char>(lower(extension[i]));
+		value *= 16777619u;
+	}
+	return value;
+}
+
+void MimeTypes::compile() {
+	// A última definição de cada extensão ganha; tipos iguais partilham a string
+	std::map<std::string, std::string> latest;
+	for (size_t i = 0; i < _entries.size(); ++i)
+		latest[_entries[i].first] = _entries[i].second;
+
+	size_t capacity = 8;
+	while (capacity < latest.size() * 2)
+		capacity <<= 1;
+
+	Slot empty;
+	empty.hash = 0;
+	empty.type = -1;
+	_slots.assign(capacity, empty);
+	_mask = capacity - 1;
+	_types.clear();
+	_count = latest.size();
+
+	std::map<std::string, int> typeIds;
+	for (std::map<std::string, std::string>::const_iterator it = latest.begin(); it != latest.end(); ++it) {
+		std::map<std::string, int>::iterator id = typeIds.find(it->second);
+		if (id == typeIds.end()) {
+			id = typeIds.insert(std::make_pair(it->second, static_cast<int>(_types.size()))).first;
+			_types.push_back(it->second);
+		}
+
+		unsigned int value = hash(it->first.data(), it->first.length());
+		size_t index = value & _mask;
+		while (_slots[index].type >= 0)
+			index = (index + 1) & _mask;
+		_slots[index].hash = value;
+		_slots[index].type = id->second;
+		_slots[index].extension = it->first;
+	}
+}
+
+const std::string* MimeTypes::find(const char* extension, size_t length) const {
+	if (_slots.empty() || length == 0)
+		return NULL;
+
+	unsigned int value = hash(extension, length);
+	for (size_t index = value & _mask; _slots[index].type >= 0; index = (index + 1) & _mask) {
+		const Slot& slot = _slots[index];
+		if (slot.hash != value || slot.extension.length() != length)
+			continue;
+		size_t i = 0;
+		while (i < length && lower(extension[i]) == slot.extension[i])
+			++i;
+		if (i == length)
+			return &_types[slot.type];
+	}
+	return NULL;
+}
+
+size_t MimeTypes::size() const {
+	return _count;
+}
@@ -18,6 +18,8 @@
 #include "includes/utils/Logger.hpp"
 #include <iostream>
 #include <algorithm>
+#include <unistd.h>
+#include <climits>
 
 // Constructors
 Route::Route()
@@ -25,13 +27,24 @@ Route::Route()
 	, _redirect("")
 	, _root("")
 	, _directoryListing(false)
+	, _directoryListingJson(false)
 	, _cgiEnabled(false)
 	, _cgiPath("")
 	, _cgiExtension("")
 	, _uploadEnabled(false)
-	, _uploadPath("") {
+	, _uploadPath("")
+	, _gzip(false)
+	, _gzipStatic(false)
+	, _gzipMinLength(1024)
+	, _gzipMaxLength(1024 * 1024)
+	, _gzipCompLevel(6)
+	, _stubStatus(false)
+	, _metricsId(-1)
+	, _compiled(false)
+	, _methodMask(METHOD_NONE) {
 	// Por default, permitir GET
 	_allowedMethods.push_back("GET");
+	setDefaultGzipTypes();
 }
 
 Route::Route(const std::string& path)
@@ -39,13 +52,24 @@ Route::Route(const std::string& path)
 	, _redirect("")
 	, _root("")
 	, _directoryListing(false)
+	, _directoryListingJson(false)
 	, _cgiEnabled(false)
 	, _cgiPath("")
 	, _cgiExtension("")
 	, _uploadEnabled(false)
-	, _uploadPath("") {
+	, _uploadPath("")
+	, _gzip(false)
+	, _gzipStatic(false)
+	, _gzipMinLength(1024)
+	, _gzipMaxLength(1024 * 1024)
+	, _gzipCompLevel(6)
+	, _stubStatus(false)
+	, _metricsId(-1)
+	, _compiled(false)
+	, _methodMask(METHOD_NONE) {
 	// Por default, permitir GET
 	_allowedMethods.push_back("GET");
+	setDefaultGzipTypes();
 }
 
 Route::~Route() {}
@@ -61,12 +85,30 @@ Route& Route::operator=(const Route& other) {
 		_redirect = other._redirect;
 		_root = other._root;
 		_directoryListing = other._directoryListing;
+		_directoryListingJson = other._directoryListingJson;
 		_indexFiles = other._indexFiles;
 		_cgiEnabled = other._cgiEnabled;
 		_cgiPath = other._cgiPath;
 		_cgiExtension = other._cgiExtension;
 		_uploadEnabled = other._uploadEnabled;
 		_uploadPath = other._uploadPath;
+		_gzip = other._gzip;
+		_gzipStatic = other._gzipStatic;
+		_gzipMinLength = other._gzipMinLength;
+		_gzipMaxLength = other._gzipMaxLength;
+		_gzipCompLevel = other._gzipCompLevel;
+		_gzipTypes = other._gzipTypes;
+		_gzipTypesConfigured = other._gzipTypesConfigured;
+		_stubStatus = other._stubStatus;
+		_metricsId = other._metricsId;
+		_defaultType = other._defaultType;
+		_limits = other._limits;
+		_proxy = other._proxy;
+		_cgiCache = other._cgiCache;
+		_compiled = other._compiled;
+		_methodMask = other._methodMask;
+		_resolvedRoot = other._resolvedRoot;
+		_cgiExtensionKey = other._cgiExtensionKey;
 	}
 	return *this;
 }
@@ -77,12 +119,36 @@ const std::vector<std::string>& Route::getAllowedMethods() const { return _allow
 const std::string& Route::getRedirect() const { return _redirect; }
 const std::string& Route::getRoot() const { return _root; }
 bool Route::isDirectoryListingEnabled() const { return _directoryListing; }
+bool Route::isDirectoryListingJson() const { return _directoryListingJson; }
 const std::vector<std::string>& Route::getIndexFiles() const { return _indexFiles; }
 bool Route::isCgiEnabled() const { return _cgiEnabled; }
 const std::string& Route::getCgiPath() const { return _cgiPath; }
 const std::string& Route::getCgiExtension() const { return _cgiExtension; }
 bool Route::isUploadEnabled() const { return _uploadEnabled; }
 const std::string& Route::getUploadPath() const { return _uploadPath; }
+bool Route::isGzipEnabled() const { return _gzip; }
+bool Route::isGzipStaticEnabled() const { return _gzipStatic; }
+size_t Route::getGzipMinLength() const { return _gzipMinLength; }
+size_t Route::getGzipMaxLength() const { return _gzipMaxLength; }
+int Route::getGzipCompLevel() const { return _gzipCompLevel; }
+const std::vector<std::string>& Route::getGzipTypes() const { return _gzipTypes; }
+bool Route::isStubStatus() const { return _stubStatus; }
+int Route::getMetricsId() const { return _metricsId; }
+const std::string& Route::getDefaultType() const { return _defaultType; }
+const LimitSettings& Route::getLimits() const { return _limits; }
+bool Route::isProxy() const { return _proxy.upstream >= 0; }
+const ProxySettings& Route::getProxy() const { return _proxy; }
+const CgiCacheSettings& Route::getCgiCache() const { return _cgiCache; }
+
+// Verificar se um Content-Type é comprimível (ignora parâmetros como charset)
+bool Route::isGzipType(const std::string& contentType) const {
+	std::string type = contentType.substr(0, contentType.find(';'));
+	for (size_t i = 0; i < _gzipTypes.size(); ++i) {
+		if (_gzipTypes[i] == type || _gzipTypes[i] == "*")
+			return true;
+	}
+	return false;
+}
 
 // Setters
 void Route::setPath(const std::string& path) {
@@ -110,6 +176,10 @@ void Route::setDirectoryListing(bool enabled) {
 	_directoryListing = enabled;
 }
 
+void Route::setDirectoryListingJson(bool json) {
+	_directoryListingJson = json;
+}
+
 void Route::addIndexFile(const std::string& indexFile) {
 	_indexFiles.push_back(indexFile);
 }
@@ -134,6 +204,196 @@ void Route::setUploadPath(const std::string& uploadPath) {
 	_uploadPath = uploadPath;
 }
 
+void Route::setGzip(bool enabled) {
+	_gzip = enabled;
+}
+
+void Route::setGzipStatic(bool enabled) {
+	_gzipStatic = enabled;
+}
+
+void Route::setGzipMinLength(size_t length) {
+	_gzipMinLength = length;
+}
+
+void Route::setGzipMaxLength(size_t length) {
+	_gzipMaxLength = length;
+}
+
+void Route::setGzipCompLevel(int level) {
+	_gzipCompLevel = level;
+}
+
+void Route::addGzipType(const std::string& contentType) {
+	// A primeira directiva gzip_types substitui a lista default
+	if (!_gzipTypesConfigured) {
+		_gzipTypes.clear();
+		_gzipTypesConfigured = true;
+	}
+	for (size_t i = 0; i < _gzipTypes.size(); ++i) {
+		if (_gzipTypes[i] == contentType)
+			return;
+	}
+	_gzipTypes.push_back(contentType);
+}
+
+void Route::setStubStatus(bool enabled) {
+	_stubStatus = enabled;
+}
+
+void Route::setMetricsId(int id) {
+	_metricsId = id;
+}
+
+void Route::setDefaultType(const std::string& type) {
+	_defaultType = type;
+}
+
+void Route::addLimitReq(const LimitReqSettings& limit) {
+	_limits.requests.push_back(limit);
+}
+
+void Route::addLimitConn(const LimitConnSettings& limit) {
+	_limits.connections.push_back(limit);
+}
+
+void Route::setLimitReqStatus(int status) {
+	_limits.requestStatus = status;
+}
+
+void Route::setLimitConnStatus(int status) {
+	_limits.connectionStatus = status;
+}
+
+void Route::inheritLimits(const LimitSettings& server) {
+	_limits.inherit(server);
+}
+
+void Route::setProxyPass(int upstream, const std::string& uri, bool hasUri) {
+	_proxy.upstream = upstream;
+	_proxy.uri = uri;
+	_proxy.hasUri = hasUri;
+}
+
+void Route::setProxyConnectTimeout(double seconds) {
+	_proxy.connectTimeout = seconds;
+}
+
+void Route::setProxyReadTimeout(double seconds) {
+	_proxy.readTimeout = seconds;
+}
+
+void Route::setCgiCache(bool enabled) {
+	_cgiCache.enabled = enabled;
+}
+
+void Route::setCgiCacheValid(double seconds) {
+	_cgiCache.valid = seconds;
+}
+
+void Route::setCgiCacheStale(double seconds) {
+	_cgiCache.staleWhileRevalidate = seconds;
+}
+
+void Route::addCgiCacheVary(const std::string& header) {
+	_cgiCache.vary.push_back(header);
+}
+
+// Tipos comprimíveis por default (texto e formatos estruturados)
+void Route::setDefaultGzipTypes() {
+	_gzipTypes.clear();
+	_gzipTypes.push_back("text/html");
+	_gzipTypes.push_back("text/css");
+	_gzipTypes.push_back("text/plain");
+	_gzipTypes.push_back("text/csv");
+	_gzipTypes.push_back("application/javascript");
+	_gzipTypes.push_back("application/json");
+	_gzipTypes.push_back("application/xml");
+	_gzipTypes.push_back("image/svg+xml");
+	_gzipTypesConfigured = false;
+}
+
+// Compilação
+Route::Method Route::methodFromString(const std::string& method) {
+	if (method == "GET")
+		return METHOD_GET;
+	if (method == "POST")
+		return METHOD_POST;
+	if (method == "DELETE")
+		return METHOD_DELETE;
+	return METHOD_NONE;
+}
+
+void Route::compile() {
+	_methodMask = METHOD_NONE;
+	for (size_t i = 0; i < _allowedMethods.size(); ++i) {
+		_methodMask |= methodFromString(_allowedMethods[i]);
+	}
+
+	// ".py" e "py" são a mesma extensão
+	_cgiExtensionKey = _cgiExtension;
+	if (!_cgiExtensionKey.empty() && _cgiExtensionKey[0] == '.')
+		_cgiExtensionKey.erase(0, 1);
+
+	// Root relativa ao diretório de trabalho do servidor ("./www" -> "/cwd/www")
+	// Root vazia mantém-se vazia (o path do request é usado tal como está)
+	_resolvedRoot = _root;
+	if (!_resolvedRoot.empty() && _resolvedRoot[0] != '/') {
+		char cwd[PATH_MAX];
+		if (getcwd(cwd, sizeof(cwd))) {
+			std::string relative = _resolvedRoot;
+			while (relative.compare(0, 2, "./") == 0)
+				relative.erase(0, 2);
+			if (relative == ".")
+				relative.clear();
+			_resolvedRoot = cwd;
+			if (!relative.empty()) {
+				if (_resolvedRoot[_resolvedRoot.length() - 1] != '/')
+					_resolvedRoot += "/";
+				_resolvedRoot += relative;
+			}
+		}
+	}
+	while (_resolvedRoot.length() > 1 && _resolvedRoot[_resolvedRoot.length() - 1] == '/')
+		_resolvedRoot.erase(_resolvedRoot.length() - 1);
+
+	_compiled = true;
+}
+
+bool Route::isCompiled() const { return _compiled; }
+
+bool Route::isMethodAllowed(Method method) const {
+	return (_methodMask & method) != 0;
+}
+
+const std::string& Route::getResolvedRoot() const { return _resolvedRoot; }
+
+// O ficheiro tem a extensão CGI desta route? (sem alocar)
+bool Route::matchesCgiExtension(const std::string& filePath) const {
+	size_t dot = filePath.find_last_of('.');
+	if (dot == std::string::npos || dot == filePath.length() - 1)
+		return _cgiExtensionKey.empty();
+	return filePath.compare(dot + 1, std::string::npos, _cgiExtensionKey) == 0;
+}
+
+// Path do request -> path no filesystem (remove o prefixo da route)
+std::string Route::resolvePath(const std::string& requestPath) const {
+	const std::string& root = _compiled ? _resolvedRoot : _root;
+
+	size_t skip = 0;
+	if (requestPath.compare(0, _path.length(), _path) == 0)
+		skip = _path.length();
+
+	std::string fullPath;
+	fullPath.reserve(root.length() + 1 + requestPath.length() - skip);
+	fullPath = root;
+	if (!fullPath.empty() && fullPath[fullPath.length() - 1] != '/' &&
+	    (skip == requestPath.length() || requestPath[skip] != '/'))
+		fullPath += "/";
+	fullPath.append(requestPath, skip, std::string::npos);
+	return fullPath;
+}
+
 // Validation
 bool Route::isMethodAllowed(const std::string& method) const {
 	for (size_t i = 0; i < _allowedMethods.size(); ++i) {
@@ -177,7 +437,8 @@ void Route::print() const {
 	if (!_root.empty())
 		std::cout << "    Root: " << _root << std::endl;
 
-	std::cout << "    Directory listing: " << (_directoryListing ? "on" : "off") << std::endl;
+	std::cout << "    Directory listing: " << (_directoryListing ? "on" : "off")
+	          << (_directoryListingJson ? " (json)" : "") << std::endl;
 
 	if (!_indexFiles.empty()) {
 		std::cout << "    Index files: ";
@@ -199,4 +460,12 @@ void Route::print() const {
 		std::cout << "    Upload enabled: yes" << std::endl;
 		std::cout << "    Upload path: " << _uploadPath << std::endl;
 	}
+
+	if (_gzip || _gzipStatic) {
+		std::cout << "    Gzip: " << (_gzip ? "on" : "off")
+		          << ", gzip_static: " << (_gzipStatic ? "on" : "off")
+		          << ", min length: " << _gzipMinLength
+		          << ", max length: " << _gzipMaxLength
+		          << ", level: " << _gzipCompLevel << std::endl;
+	}
 }
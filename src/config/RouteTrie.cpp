@@ -0,0 +1,160 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RouteTrie.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:25:50 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:25:51 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * RouteTrie.cpp
+ * Implementação da trie de routes
+ */
+#include "includes/config/RouteTrie.hpp"
+#include "includes/config/Route.hpp"
+
+// Constructors
+RouteTrie::RouteTrie()
+	: _nodeRoutes(1, -1)
+	, _edges(16)
+	, _edgeCount(0)
+	, _rootRoute(-1) {
+	for (size_t i = 0; i < _edges.size(); ++i)
+		_edges[i].child = -1;
+}
+
+// Compilação
+void RouteTrie::build(const std::vector<Route>& routes) {
+	*this = RouteTrie();
+
+	for (size_t i = 0; i < routes.size(); ++i) {
+		const std::string& path = routes[i].getPath();
+
+		// "/" serve qualquer path sem match melhor; "" nunca faz match
+		if (path == "/") {
+			if (_rootRoute < 0)
+				_rootRoute = static_cast<int>(i);
+			continue;
+		}
+		if (path.empty())
+			continue;
+
+		int node = 0;
+		size_t start = 0;
+		while (true) {
+			size_t end = path.find('/', start);
+			if (end == std::string::npos)
+				end = path.length();
+			node = addChild(node, path.substr(start, end - start));
+			if (end == path.length())
+				break;
+			start = end + 1;
+		}
+
+		// Paths repetidos: ganha a primeira route declarada
+		if (_nodeRoutes[node] < 0)
+			_nodeRoutes[node] = static_cast<int>(i);
+	}
+}
+
+// Match
+int RouteTrie::match(const std::string& path) const {
+	int best = -1;
+	int node = 0;
+	size_t start = 0;
+
+	while (true) {
+		size_t end = path.find('/', start);
+		if (end == std::string::npos)
+			end = path.length();
+
+		node = findChild(node, path.data() + start, end - start);
+		if (node < 0)
+			break;
+		if (_nodeRoutes[node] >= 0)
+			best = _nodeRoutes[node];
+		if (end == path.length())
+			break;
+		start = end + 1;
+	}
+
+	return best >= 0 ? best : _rootRoute;
+}
+
+// Arestas
+int RouteTrie::findChild(int node, const char* segment, size_t length) const {
+	size_t value = hash(node, segment, length);
+	size_t mask = _edges.size() - 1;
+
+	for (size_t i = value & mask; _edges[i].child >= 0; i = (i + 1) & mask) {
+		const Edge& edge = _edges[i];
+		if (edge.hash == value && edge.parent == node &&
+		    edge.segment.compare(0, std::string::npos, segment, length) == 0)
+			return edge.child;
+	}
+	return -1;
+}
+
+int RouteTrie::addChild(int node, const std::string& segment) {
+	int child = findChild(node, segment.data(), segment.length());
+	if (child >= 0)
+		return child;
+
+	if ((_edgeCount + 1) * 2 > _edges.size())
+		grow();
+
+	child = static_cast<int>(_nodeRoutes.size());
+	_nodeRoutes.push_back(-1);
+
+	size_t value = hash(node, segment.data(), segment.length());
+	size_t mask = _edges.size() - 1;
+	size_t i = value & mask;
+	while (_edges[i].child >= 0)
+		i = (i + 1) & mask;
+
+	_edges[i].hash = value;
+	_edges[i].parent = node;
+	_edges[i].child = child;
+	_edges[i].segment = segment;
+	++_edgeCount;
+	return child;
+}
+
+void RouteTrie::grow() {
+	std::vector<Edge> old;
+	old.swap(_edges);
+	_edges.resize(old.size() * 2);
+	for (size_t i = 0; i < _edges.size(); ++i)
+		_edges[i].child = -1;
+
+	size_t mask = _edges.size() - 1;
+	for (size_t j = 0; j < old.size(); ++j) {
+		if (old[j].child < 0)
+			continue;
+		size_t i = old[j].hash & mask;
+		while (_edges[i].child >= 0)
+			i = (i + 1) & mask;
+		_edges[i].hash = old[j].hash;
+		_edges[i].parent = old[j].parent;
+		_edges[i].child = old[j].child;
+		_edges[i].segment.swap(old[j].segment);
+	}
+}
+
+// FNV-1a sobre o nó pai e o segmento
+size_t RouteTrie::hash(int node, const char* segment, size_t length) {
+	size_t value = static_cast<size_t>(2166136261u);
+	for (size_t i = 0; i < sizeof(node); ++i) {
+		value ^= static_cast<unsigned char>(node >> (i * 8));
+		value *= static_cast<size_t>(16777619u);
+	}
+	for (size_t i = 0; i < length; ++i) {
+		value ^= static_cast<unsigned char>(segment[i]);
+		value *= static_cast<size_t>(16777619u);
+	}
+	return value;
+}
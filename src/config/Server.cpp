@@ -23,7 +23,14 @@
 Server::Server()
 	: _host("0.0.0.0")
 	, _maxBodySize(1048576) // 1MB default
-	, _isDefaultServer(false) {
+	, _routesCompiled(false)
+	, _isDefaultServer(false)
+	, _sslSessionCache(20480)
+	, _sslSessionTimeout(300)
+	, _sslSessionTickets(true)
+	, _accessLogMode(ACCESS_LOG_INHERIT)
+	, _serverTiming(false)
+	, _slowRequestThreshold(0) {
 }
 
 Server::~Server() {}
@@ -39,8 +46,23 @@ Server& Server::operator=(const Server& other) {
 		_serverNames = other._serverNames;
 		_maxBodySize = other._maxBodySize;
 		_errorPages = other._errorPages;
+		_errorPageFiles = other._errorPageFiles;
 		_routes = other._routes;
+		_routeTrie = other._routeTrie;
+		_routesCompiled = other._routesCompiled;
 		_isDefaultServer = other._isDefaultServer;
+		_sslPorts = other._sslPorts;
+		_sslCertificate = other._sslCertificate;
+		_sslCertificateKey = other._sslCertificateKey;
+		_sslSessionCache = other._sslSessionCache;
+		_sslSessionTimeout = other._sslSessionTimeout;
+		_sslSessionTickets = other._sslSessionTickets;
+		_accessLogMode = other._accessLogMode;
+		_accessLogs = other._accessLogs;
+		_accessLogIds = other._accessLogIds;
+		_serverTiming = other._serverTiming;
+		_slowRequestThreshold = other._slowRequestThreshold;
+		_limits = other._limits;
 	}
 	return *this;
 }
@@ -54,6 +76,28 @@ const std::map<int, std::string>& Server::getErrorPages() const { return _errorP
 const std::vector<Route>& Server::getRoutes() const { return _routes; }
 bool Server::isDefaultServer() const { return _isDefaultServer; }
 
+// TLS
+bool Server::isSslPort(int port) const {
+	return std::find(_sslPorts.begin(), _sslPorts.end(), port) != _sslPorts.end();
+}
+
+bool Server::hasSsl() const { return !_sslPorts.empty(); }
+const std::string& Server::getSslCertificate() const { return _sslCertificate; }
+const std::string& Server::getSslCertificateKey() const { return _sslCertificateKey; }
+size_t Server::getSslSessionCache() const { return _sslSessionCache; }
+long Server::getSslSessionTimeout() const { return _sslSessionTimeout; }
+bool Server::getSslSessionTickets() const { return _sslSessionTickets; }
+
+// Access log
+Server::AccessLogMode Server::getAccessLogMode() const { return _accessLogMode; }
+const std::vector<AccessLogSettings>& Server::getAccessLogs() const { return _accessLogs; }
+const std::vector<int>& Server::getAccessLogIds() const { return _accessLogIds; }
+
+// Tempos por fase
+bool Server::hasServerTiming() const { return _serverTiming; }
+double Server::getSlowRequestThreshold() const { return _slowRequestThreshold; }
+const LimitSettings& Server::getLimits() const { return _limits; }
+
 // Setters
 void Server::addPort(int port) {
 	// Verificar se já existe
@@ -82,14 +126,121 @@ void Server::setErrorPage(int code, const std::string& path) {
 
 void Server::addRoute(const Route& route) {
 	_routes.push_back(route);
+	_routesCompiled = false; // A trie tem de ser recompilada
 }
 
 void Server::setDefaultServer(bool isDefault) {
 	_isDefaultServer = isDefault;
 }
 
+void Server::addSslPort(int port) {
+	if (!isSslPort(port))
+		_sslPorts.push_back(port);
+}
+
+void Server::setSslCertificate(const std::string& path) {
+	_sslCertificate = path;
+}
+
+void Server::setSslCertificateKey(const std::string& path) {
+	_sslCertificateKey = path;
+}
+
+void Server::setSslSessionCache(size_t entries) {
+	_sslSessionCache = entries;
+}
+
+void Server::setSslSessionTimeout(long seconds) {
+	_sslSessionTimeout = seconds;
+}
+
+void Server::setSslSessionTickets(bool enabled) {
+	_sslSessionTickets = enabled;
+}
+
+// "off" anula os outros access_log do server, antes ou depois dele (nginx)
+void Server::addAccessLog(const AccessLogSettings& settings) {
+	if (_accessLogMode == ACCESS_LOG_OFF)
+		return;
+	_accessLogMode = ACCESS_LOG_SET;
+	_accessLogs.push_back(settings);
+}
+
+void Server::setAccessLogOff() {
+	_accessLogMode = ACCESS_LOG_OFF;
+	_accessLogs.clear();
+}
+
+void Server::setAccessLogIds(const std::vector<int>& ids) {
+	_accessLogIds = ids;
+}
+
+void Server::setServerTiming(bool enabled) {
+	_serverTiming = enabled;
+}
+
+void Server::setSlowRequestThreshold(double seconds) {
+	_slowRequestThreshold = seconds;
+}
+
+void Server::addLimitReq(const LimitReqSettings& limit) {
+	_limits.requests.push_back(limit);
+}
+
+void Server::addLimitConn(const LimitConnSettings& limit) {
+	_limits.connections.push_back(limit);
+}
+
+void Server::setLimitReqStatus(int status) {
+	_limits.requestStatus = status;
+}
+
+void Server::setLimitConnStatus(int status) {
+	_limits.connectionStatus = status;
+}
+
 // Route matching
 const Route* Server::matchRoute(const std::string& path) const {
+	if (!_routesCompiled)
+		return matchRouteLinear(path);
+
+	int index = _routeTrie.match(path);
+	return index >= 0 ? &_routes[index] : NULL;
+}
+
+// Compilação
+void Server::compile() {
+	// Limites: status por omissão no server, locations sem limites herdam os do server
+	if (!_limits.requestStatus)
+		_limits.requestStatus = 429;
+	if (!_limits.connectionStatus)
+		_limits.connectionStatus = 503;
+	for (size_t i = 0; i < _routes.size(); ++i) {
+		_routes[i].inheritLimits(_limits);
+		_routes[i].compile();
+	}
+	_routeTrie.build(_routes);
+	_routesCompiled = true;
+
+	// As error pages são servidas a partir da root da route "/"
+	_errorPageFiles.clear();
+	const Route* root = matchRoute("/");
+	if (!root)
+		return;
+	for (std::map<int, std::string>::const_iterator it = _errorPages.begin();
+	     it != _errorPages.end(); ++it) {
+		_errorPageFiles[it->first] = root->resolvePath(it->second);
+	}
+}
+
+int Server::assignMetricsIds(int first) {
+	for (size_t i = 0; i < _routes.size(); ++i)
+		_routes[i].setMetricsId(first++);
+	return first;
+}
+
+// Match original: compara o path com todas as routes (referência para a trie)
+const Route* Server::matchRouteLinear(const std::string& path) const {
 	// Procurar a route que melhor corresponde ao path
 	// Algoritmo: procurar o longest prefix match
 	const Route* bestMatch = NULL;
@@ -138,12 +289,25 @@ std::string Server::getErrorPage(int code) const {
 	return ""; // Empty string significa usar default error page
 }
 
+const std::string* Server::getErrorPageFile(int code) const {
+	std::map<int, std::string>::const_iterator it = _errorPageFiles.find(code);
+	if (it != _errorPageFiles.end())
+		return &it->second;
+	return NULL;
+}
+
 // Validation
 bool Server::isValid() const {
 	// Um server precisa de pelo menos uma porta
 	if (_ports.empty())
 		return false;
 
+	// Portas TLS precisam de certificado e chave
+	if (!_sslPorts.empty() && (_sslCertificate.empty() || _sslCertificateKey.empty())) {
+		LOG_ERROR << "Server with an ssl listen needs ssl_certificate and ssl_certificate_key" << std::endl;
+		return false;
+	}
+
 	// Verificar se todas as routes são válidas
 	for (size_t i = 0; i < _routes.size(); ++i) {
 		if (!_routes[i].isValid())
@@ -179,6 +343,19 @@ void Server::print() const {
 	std::cout << "  Max body size: " << _maxBodySize << " bytes" << std::endl;
 	std::cout << "  Default server: " << (_isDefaultServer ? "yes" : "no") << std::endl;
 
+	if (!_sslPorts.empty()) {
+		std::cout << "  TLS ports: ";
+		for (size_t i = 0; i < _sslPorts.size(); ++i) {
+			std::cout << _sslPorts[i];
+			if (i < _sslPorts.size() - 1)
+				std::cout << ", ";
+		}
+		std::cout << std::endl;
+		std::cout << "  TLS certificate: " << _sslCertificate << std::endl;
+		std::cout << "  TLS session cache: " << _sslSessionCache << " entries, timeout "
+		          << _sslSessionTimeout << "s, tickets " << (_sslSessionTickets ? "on" : "off") << std::endl;
+	}
+
 	if (!_errorPages.empty()) {
 		std::cout << "  Error pages:" << std::endl;
 		for (std::map<int, std::string>::const_iterator it = _errorPages.begin();
@@ -0,0 +1,225 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   VirtualHostTable.cpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:02:37 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:02:38 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * VirtualHostTable.cpp
+ * Implementação do índice de virtual hosts
+ */
+#include "includes/config/VirtualHostTable.hpp"
+#include "includes/config/Server.hpp"
+#include "includes/utils/Logger.hpp"
+#include <cctype>
+
+// Constructors
+VirtualHostTable::VirtualHostTable()
+	: _default(NULL) {
+}
+
+VirtualHostTable::~VirtualHostTable() {}
+
+// Construção
+void VirtualHostTable::build(const std::vector<Server>& servers, const std::string& host, int port) {
+	for (size_t i = 0; i < servers.size(); ++i) {
+		const Server& server = servers[i];
+		if (server.getHost() != host)
+			continue;
+
+		const std::vector<int>& ports = server.getPorts();
+		bool portMatch = false;
+		for (size_t j = 0; j < ports.size() && !portMatch; ++j) {
+			portMatch = (ports[j] == port);
+		}
+		if (!portMatch)
+			continue;
+
+		if (!_default)
+			_default = &server;
+
+		const std::vector<std::string>& names = server.getServerNames();
+		for (size_t j = 0; j < names.size(); ++j) {
+			add(names[j], &server);
+		}
+	}
+
+	LOG_DEBUG << "Virtual hosts for " << host << ":" << port << ": " << size()
+	          << " names indexed" << std::endl;
+}
+
+void VirtualHostTable::add(const std::string& name, const Server* server) {
+	std::string key;
+	for (size_t i = 0; i < name.length(); ++i) {
+		key += static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+	}
+	if (key.empty())
+		return;
+
+	bool inserted;
+	if (key.compare(0, 2, "*.") == 0) {
+		// "*.example.com" -> sufixo ".example.com" (não inclui example.com)
+		inserted = _suffix.insert(key.substr(1), server);
+	} else if (key[0] == '.') {
+		// ".example.com" -> example.com e todos os subdomínios
+		inserted = _exact.insert(key.substr(1), server);
+		inserted = _suffix.insert(key, server) && inserted;
+	} else if (key.length() > 2 && key.compare(key.length() - 2, 2, ".*") == 0) {
+		// "www.example.*" -> prefixo "www.example."
+		inserted = _prefix.insert(key.substr(0, key.length() - 1), server);
+	} else {
+		inserted = _exact.insert(key, server);
+	}
+
+	if (!inserted) {
+		LOG_WARNING << "Conflicting server name \"" << name << "\", ignored" << std::endl;
+	}
+}
+
+void VirtualHostTable::setDefault(const Server* server) {
+	_default = server;
+}
+
+// Lookup
+const Server* VirtualHostTable::find(const std::string& hostHeader) const {
+	char name[256];
+	size_t length = normalize(hostHeader, name, sizeof(name));
+	if (length == 0)
+		return _default;
+
+	const Server* server = _exact.find(name, length);
+	if (server)
+		return server;
+
+	// Wildcard à esquerda: testar os sufixos a partir de cada ponto, do mais longo
+	for (size_t i = 0; i < length; ++i) {
+		if (name[i] == '.' && (server = _suffix.find(name + i, length - i)))
+			return server;
+	}
+
+	// Wildcard à direita: testar os prefixos até cada ponto, do mais longo
+	for (size_t i = length; i-- > 0;) {
+		if (name[i] == '.' && (server = _prefix.find(name, i + 1)))
+			return server;
+	}
+
+	return _default;
+}
+
+const Server* VirtualHostTable::getDefault() const {
+	return _default;
+}
+
+size_t VirtualHostTable::size() const {
+	return _exact.size() + _suffix.size() + _prefix.size();
+}
+
+// FNV-1a
+size_t VirtualHostTable::hash(const char* data, size_t length) {
+	size_t value = static_cast<size_t>(2166136261u);
+	for (size_t i = 0; i < length; ++i) {
+		value ^= static_cast<unsigned char>(data[i]);
+		value *= static_cast<size_t>(16777619u);
+	}
+	return value;
+}
+
+size_t VirtualHostTable::normalize(const std::string& hostHeader, char* out, size_t capacity) {
+	size_t start = 0;
+	size_t end = hostHeader.length();
+
+	while (start < end && (hostHeader[start] == ' ' || hostHeader[start] == '\t'))
+		++start;
+	while (end > start && (hostHeader[end - 1] == ' ' || hostHeader[end - 1] == '\t'))
+		--end;
+
+	// Remover a porta ("example.com:8080"); IPv6 literal: "[::1]:8080"
+	if (start < end && hostHeader[start] == '[') {
+		size_t bracket = hostHeader.find(']', start);
+		if (bracket != std::string::npos && bracket < end)
+			end = bracket + 1;
+	} else {
+		size_t colon = hostHeader.find(':', start);
+		if (colon != std::string::npos && colon < end)
+			end = colon;
+	}
+
+	// "example.com." é o mesmo nome que "example.com"
+	if (end > start && hostHeader[end - 1] == '.')
+		--end;
+
+	if (end - start >= capacity)
+		return 0; // Nome inválido (máximo de 255 caracteres)
+
+	for (size_t i = start; i < end; ++i) {
+		out[i - start] = static_cast<char>(std::tolower(static_cast<unsigned char>(hostHeader[i])));
+	}
+	return end - start;
+}
+
+// NameIndex
+VirtualHostTable::NameIndex::NameIndex()
+	: _slots(16)
+	, _count(0) {
+}
+
+bool VirtualHostTable::NameIndex::insert(const std::string& name, const Server* server) {
+	if (find(name.data(), name.length()))
+		return false;
+
+	if ((_count + 1) * 2 > _slots.size())
+		grow();
+
+	size_t value = hash(name.data(), name.length());
+	size_t mask = _slots.size() - 1;
+	size_t i = value & mask;
+	while (!_slots[i].name.empty())
+		i = (i + 1) & mask;
+
+	_slots[i].hash = value;
+	_slots[i].name = name;
+	_slots[i].server = server;
+	++_count;
+	return true;
+}
+
+const Server* VirtualHostTable::NameIndex::find(const char* name, size_t length) const {
+	if (_count == 0)
+		return NULL;
+
+	size_t value = hash(name, length);
+	size_t mask = _slots.size() - 1;
+	for (size_t i = value & mask; !_slots[i].name.empty(); i = (i + 1) & mask) {
+		if (_slots[i].hash == value && _slots[i].name.compare(0, std::string::npos, name, length) == 0)
+			return _slots[i].server;
+	}
+	return NULL;
+}
+
+size_t VirtualHostTable::NameIndex::size() const {
+	return _count;
+}
+
+void VirtualHostTable::NameIndex::grow() {
+	std::vector<Slot> old;
+	old.swap(_slots);
+	_slots.resize(old.size() * 2);
+
+	size_t mask = _slots.size() - 1;
+	for (size_t j = 0; j < old.size(); ++j) {
+		if (old[j].name.empty())
+			continue;
+		size_t i = old[j].hash & mask;
+		while (!_slots[i].name.empty())
+			i = (i + 1) & mask;
+		_slots[i].hash = old[j].hash;
+		_slots[i].name.swap(old[j].name);
+		_slots[i].server = old[j].server;
+	}
+}
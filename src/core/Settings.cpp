@@ -16,8 +16,10 @@
  */
 #include "includes/core/Settings.hpp"
 
-Settings::Settings() {
-    // Constructor - settings are hard-coded
+Settings::Settings() : _defaultType("application/octet-stream") {
+    // Tipos MIME por omissão até o config ser carregado
+    _mimeTypes.addDefaults();
+    _mimeTypes.compile();
 }
 
 bool Settings::isValid() const {
@@ -32,6 +34,7 @@ const std::string Settings::httpStatusCode(int code) const {
         case 200: return "OK";
         case 201: return "Created";
         case 204: return "No Content";
+        case 206: return "Partial Content";
         case 301: return "Moved Permanently";
         case 302: return "Found";
         case 304: return "Not Modified";
@@ -43,6 +46,8 @@ const std::string Settings::httpStatusCode(int code) const {
         case 408: return "Request Timeout";
         case 413: return "Payload Too Large";
         case 414: return "URI Too Long";
+        case 416: return "Range Not Satisfiable";
+        case 429: return "Too Many Requests";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 502: return "Bad Gateway";
@@ -54,40 +59,19 @@ const std::string Settings::httpStatusCode(int code) const {
 }
 
 const std::string& Settings::httpMimeType(const std::string& ext) const {
-    // Static mime type mapping
-    // In a real implementation, this would be loaded from config
-    static std::map<std::string, std::string> mimeTypes;
-    static bool initialized = false;
-
-    // Initialize the map on first use (C++98 compatible)
-    if (!initialized) {
-        mimeTypes["html"] = "text/html";
-        mimeTypes["htm"] = "text/html";
-        mimeTypes["css"] = "text/css";
-        mimeTypes["js"] = "application/javascript";
-        mimeTypes["json"] = "application/json";
-        mimeTypes["xml"] = "application/xml";
-        mimeTypes["txt"] = "text/plain";
-        mimeTypes["csv"] = "text/csv";
-        mimeTypes["png"] = "image/png";
-        mimeTypes["jpg"] = "image/jpeg";
-        mimeTypes["jpeg"] = "image/jpeg";
-        mimeTypes["gif"] = "image/gif";
-        mimeTypes["svg"] = "image/svg+xml";
-        mimeTypes["ico"] = "image/x-icon";
-        mimeTypes["pdf"] = "application/pdf";
-        mimeTypes["zip"] = "application/zip";
-        mimeTypes["tar"] = "application/x-tar";
-        mimeTypes["gz"] = "application/gzip";
-        initialized = true;
-    }
-
-    static std::string defaultType = "application/octet-stream";
+    return httpMimeType(ext.data(), ext.length(), _defaultType);
+}
 
-    std::map<std::string, std::string>::const_iterator it = mimeTypes.find(ext);
-    if (it != mimeTypes.end()) {
-        return it->second;
-    }
+const std::string& Settings::httpMimeType(const char* ext, size_t length,
+                                          const std::string& fallback) const {
+    const std::string* type = _mimeTypes.find(ext, length);
+    if (type)
+        return *type;
+    return fallback.empty() ? _defaultType : fallback;
+}
 
-    return defaultType;
+void Settings::setMimeTypes(const MimeTypes& types, const std::string& defaultType) {
+    _mimeTypes = types;
+    if (!defaultType.empty())
+        _defaultType = defaultType;
 }
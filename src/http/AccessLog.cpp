@@ -0,0 +1,509 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLog.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:40:18 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 15:40:19 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * AccessLog.cpp
+ * Implementation of the access log
+ */
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/Request.hpp"
+#include "includes/http/Response.hpp"
+#include "includes/config/Server.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+namespace HTTP {
+
+namespace {
+
+// Named intervals between phases: access log $time_<name>, slow request trace
+struct Stage {
+	const char* name;
+	RequestRecord::Phase from;
+	RequestRecord::Phase to;
+};
+
+const Stage STAGES[] = {
+	{ "wait", RequestRecord::PHASE_ACCEPT, RequestRecord::PHASE_FIRST_BYTE },
+	{ "headers", RequestRecord::PHASE_FIRST_BYTE, RequestRecord::PHASE_HEADERS },
+	{ "body", RequestRecord::PHASE_HEADERS, RequestRecord::PHASE_BODY },
+	{ "queue", RequestRecord::PHASE_BODY, RequestRecord::PHASE_HANDLER_START },
+	{ "handler", RequestRecord::PHASE_HANDLER_START, RequestRecord::PHASE_HANDLER_END },
+	{ "cgi", RequestRecord::PHASE_CGI_SPAWN, RequestRecord::PHASE_CGI_EXIT },
+	{ "ttfb", RequestRecord::PHASE_FIRST_BYTE, RequestRecord::PHASE_FIRST_SENT },
+	{ "send", RequestRecord::PHASE_FIRST_SENT, RequestRecord::PHASE_LAST_SENT }
+};
+const size_t STAGE_COUNT = sizeof(STAGES) / sizeof(STAGES[0]);
+
+}
+
+// RequestRecord
+RequestRecord::RequestRecord()
+	: status(0)
+	, bytesSent(0)
+	, headerBytes(0)
+	, routeId(-1)
+	, logged(false) {
+	for (int i = 0; i < PHASE_COUNT; ++i) {
+		phases[i] = 0;
+	}
+}
+
+void RequestRecord::setRequest(const Request& request) {
+	method = request.getMethod();
+	uri = request.getUri();
+	protocol = request.getVersion();
+	host = request.getHeader("host");
+	referer = request.getHeader("referer");
+	userAgent = request.getHeader("user-agent");
+}
+
+size_t RequestRecord::bodyBytesSent() const {
+	return bytesSent > headerBytes ? bytesSent - headerBytes : 0;
+}
+
+void RequestRecord::handled(const Response& response) {
+	mark(PHASE_HANDLER_END);
+	if (response.getCgiSpawned() != 0) {
+		phases[PHASE_CGI_SPAWN] = response.getCgiSpawned();
+		phases[PHASE_CGI_EXIT] = response.getCgiExited();
+	}
+}
+
+double RequestRecord::elapsed(Phase from, Phase to) const {
+	if (phases[from] == 0 || phases[to] == 0) {
+		return -1;
+	}
+	return phases[to] - phases[from];
+}
+
+double RequestRecord::requestTime() const {
+	if (phases[PHASE_FIRST_BYTE] == 0) {
+		return 0;
+	}
+	double end = phases[PHASE_LAST_SENT] != 0 ? phases[PHASE_LAST_SENT] : now();
+	return end - phases[PHASE_FIRST_BYTE];
+}
+
+// "read;dur=0.210, handler;dur=12.500, cgi;dur=12.100" (milliseconds)
+std::string RequestRecord::serverTiming() const {
+	std::ostringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(3);
+
+	double read = elapsed(PHASE_FIRST_BYTE, PHASE_BODY);
+	double handler = elapsed(PHASE_HANDLER_START, PHASE_HANDLER_END);
+	double cgi = elapsed(PHASE_CGI_SPAWN, PHASE_CGI_EXIT);
+	if (read >= 0) {
+		out << "read;dur=" << read * 1000;
+	}
+	if (handler >= 0) {
+		out << (out.tellp() > 0 ? ", " : "") << "handler;dur=" << handler * 1000;
+	}
+	if (cgi >= 0) {
+		out << (out.tellp() > 0 ? ", " : "") << "cgi;dur=" << cgi * 1000;
+	}
+	return out.str();
+}
+
+// "wait=0.120ms headers=0.015ms ... total=13.002ms" ("-" for phases not reached)
+std::string RequestRecord::breakdown() const {
+	std::ostringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(3);
+
+	for (size_t i = 0; i < STAGE_COUNT; ++i) {
+		double seconds = elapsed(STAGES[i].from, STAGES[i].to);
+		out << STAGES[i].name << "=";
+		if (seconds < 0) {
+			out << "-";
+		} else {
+			out << seconds * 1000 << "ms";
+		}
+		out << " ";
+	}
+	out << "total=" << requestTime() * 1000 << "ms";
+	return out.str();
+}
+
+double RequestRecord::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// AccessLog
+AccessLog::AccessLog()
+	: _fd(-1)
+	, _lastFlush(Clock::now())
+	, _successCount(0) {
+}
+
+AccessLog::~AccessLog() {
+	flush();
+	if (_fd >= 0) {
+		::close(_fd);
+	}
+}
+
+bool AccessLog::open(const AccessLogSettings& settings, std::string& error) {
+	_settings = settings;
+	if (_settings.sample == 0) {
+		_settings.sample = 1;
+	}
+	if (!compile(_settings.format, error)) {
+		return false;
+	}
+
+	_fd = ::open(_settings.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		error = "cannot open " + _settings.path + ": " + std::strerror(errno);
+		return false;
+	}
+	_buffer.reserve(_settings.bufferSize + 1024);
+	return true;
+}
+
+// Split the format into literal text and $variables (or ${variable})
+bool AccessLog::compile(const std::string& format, std::string& error) {
+	static const struct {
+		const char* name;
+		Variable variable;
+	} variables[] = {
+		{ "remote_addr", REMOTE_ADDR },
+		{ "request", REQUEST },
+		{ "request_method", REQUEST_METHOD },
+		{ "request_uri", REQUEST_URI },
+		{ "server_protocol", SERVER_PROTOCOL },
+		{ "host", HOST },
+		{ "status", STATUS },
+		{ "body_bytes_sent", BODY_BYTES_SENT },
+		{ "bytes_sent", BYTES_SENT },
+		{ "request_time", REQUEST_TIME },
+		{ "time_local", TIME_LOCAL },
+		{ "time_iso8601", TIME_ISO8601 },
+		{ "msec", MSEC },
+		{ "http_referer", HTTP_REFERER },
+		{ "http_user_agent", HTTP_USER_AGENT }
+	};
+
+	_parts.clear();
+	Part literal;
+	literal.variable = LITERAL;
+
+	size_t pos = 0;
+	while (pos < format.length()) {
+		if (format[pos] != '$') {
+			literal.literal += format[pos++];
+			continue;
+		}
+
+		bool braced = (pos + 1 < format.length() && format[pos + 1] == '{');
+		size_t start = pos + (braced ? 2 : 1);
+		size_t end = start;
+		while (end < format.length() && (std::isalnum(static_cast<unsigned char>(format[end])) ||
+		                                  format[end] == '_')) {
+			++end;
+		}
+		std::string name = format.substr(start, end - start);
+		if (braced) {
+			if (end >= format.length() || format[end] != '}') {
+				error = "unterminated ${ in log format";
+				return false;
+			}
+			++end;
+		}
+
+		Part part;
+		size_t i = 0;
+		while (i < sizeof(variables) / sizeof(variables[0]) && name != variables[i].name) {
+			++i;
+		}
+		if (i < sizeof(variables) / sizeof(variables[0])) {
+			part.variable = variables[i].variable;
+		} else {
+			// Phase intervals: $time_<stage>, $upstream_cgi_time = $time_cgi
+			std::string stage = (name == "upstream_cgi_time") ? "cgi" :
+			                    (name.compare(0, 5, "time_") == 0) ? name.substr(5) : "";
+			size_t s = 0;
+			while (s < STAGE_COUNT && stage != STAGES[s].name) {
+				++s;
+			}
+			if (s == STAGE_COUNT) {
+				error = "unknown log format variable $" + name;
+				return false;
+			}
+			part.variable = PHASE_TIME;
+			part.from = STAGES[s].from;
+			part.to = STAGES[s].to;
+		}
+
+		if (!literal.literal.empty()) {
+			_parts.push_back(literal);
+			literal.literal.clear();
+		}
+		_parts.push_back(part);
+		pos = end;
+	}
+	if (!literal.literal.empty()) {
+		_parts.push_back(literal);
+	}
+	return true;
+}
+
+void AccessLog::write(const RequestRecord& record) {
+	// sample=N: errors are always logged, successes one in N
+	if (record.status < 400 && _settings.sample > 1 && (_successCount++ % _settings.sample) != 0) {
+		return;
+	}
+
+	char number[64];
+
+	for (size_t i = 0; i < _parts.size(); ++i) {
+		const Part& part = _parts[i];
+		switch (part.variable) {
+			case LITERAL:
+				_buffer += part.literal;
+				break;
+			case REMOTE_ADDR:
+				appendValue(record.remoteAddr);
+				break;
+			case REQUEST:
+				if (record.method.empty()) {
+					appendValue("");
+				} else {
+					appendValue(record.method + " " + record.uri + " " + record.protocol);
+				}
+				break;
+			case REQUEST_METHOD:
+				appendValue(record.method);
+				break;
+			case REQUEST_URI:
+				appendValue(record.uri);
+				break;
+			case SERVER_PROTOCOL:
+				appendValue(record.protocol);
+				break;
+			case HOST:
+				appendValue(record.host);
+				break;
+			case STATUS:
+				snprintf(number, sizeof(number), "%03d", record.status);
+				_buffer += number;
+				break;
+			case BODY_BYTES_SENT:
+				snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(record.bodyBytesSent()));
+				_buffer += number;
+				break;
+			case BYTES_SENT:
+				snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(record.bytesSent));
+				_buffer += number;
+				break;
+			case REQUEST_TIME:
+				snprintf(number, sizeof(number), "%.3f", record.requestTime());
+				_buffer += number;
+				break;
+			case PHASE_TIME: {
+				double seconds = record.elapsed(part.from, part.to);
+				if (seconds < 0) {
+					_buffer += "-";
+				} else {
+					snprintf(number, sizeof(number), "%.3f", seconds);
+					_buffer += number;
+				}
+				break;
+			}
+			case TIME_LOCAL:
+				_buffer += Clock::timeLocal();
+				break;
+			case TIME_ISO8601:
+				_buffer += Clock::timeIso8601();
+				break;
+			case MSEC: {
+				unsigned long long msec = Clock::nowMilliseconds();
+				snprintf(number, sizeof(number), "%llu.%03llu", msec / 1000, msec % 1000);
+				_buffer += number;
+				break;
+			}
+			case HTTP_REFERER:
+				appendValue(record.referer);
+				break;
+			case HTTP_USER_AGENT:
+				appendValue(record.userAgent);
+				break;
+		}
+	}
+	_buffer += '\n';
+
+	if (_buffer.size() >= _settings.bufferSize) {
+		flush();
+	}
+}
+
+// Request-controlled text: escaped so a line can't be forged or broken
+void AccessLog::appendValue(const std::string& value) {
+	static const char hex[] = "0123456789ABCDEF";
+
+	if (value.empty()) {
+		if (!_settings.escapeJson) {
+			_buffer += '-';
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < value.length(); ++i) {
+		unsigned char c = static_cast<unsigned char>(value[i]);
+		if (_settings.escapeJson) {
+			if (c == '"' || c == '\\') {
+				_buffer += '\\';
+				_buffer += static_cast<char>(c);
+			} else if (c < 0x20) {
+				_buffer += "\\u00";
+				_buffer += hex[c >> 4];
+				_buffer += hex[c & 0xF];
+			} else {
+				_buffer += static_cast<char>(c);
+			}
+		} else if (c == '"' || c == '\\' || c < 0x20 || c >= 0x7F) {
+			_buffer += "\\x";
+			_buffer += hex[c >> 4];
+			_buffer += hex[c & 0xF];
+		} else {
+			_buffer += static_cast<char>(c);
+		}
+	}
+}
+
+void AccessLog::flush() {
+	_lastFlush = Clock::now();
+	if (_buffer.empty() || _fd < 0) {
+		return;
+	}
+
+	size_t offset = 0;
+	while (offset < _buffer.size()) {
+		ssize_t written = ::write(_fd, _buffer.data() + offset, _buffer.size() - offset);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			LOG_ERROR << "Failed to write access log " << _settings.path << ": "
+			          << Logger::errstr() << std::endl;
+			break;
+		}
+		offset += written;
+	}
+	_buffer.clear();
+}
+
+void AccessLog::tick(time_t now) {
+	if (!_buffer.empty() && now - _lastFlush >= _settings.flushInterval) {
+		flush();
+	}
+}
+
+bool AccessLog::reopen() {
+	flush();
+
+	int fd = ::open(_settings.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		LOG_ERROR << "Failed to reopen access log " << _settings.path << ": "
+		          << Logger::errstr() << std::endl;
+		return false;
+	}
+	dup2(fd, _fd);
+	::close(fd);
+	return true;
+}
+
+// AccessLogs
+volatile sig_atomic_t AccessLogs::_reopenRequested = 0;
+
+AccessLogs::AccessLogs() {}
+
+AccessLogs::~AccessLogs() {
+	for (size_t i = 0; i < _logs.size(); ++i) {
+		delete _logs[i];
+	}
+}
+
+bool AccessLogs::open(const std::vector<AccessLogSettings>& logs) {
+	for (size_t i = 0; i < logs.size(); ++i) {
+		AccessLog* log = new AccessLog();
+		std::string error;
+		if (!log->open(logs[i], error)) {
+			LOG_ERROR << "access_log " << logs[i].path << " (format " << logs[i].formatName
+			          << "): " << error << std::endl;
+			delete log;
+			return false;
+		}
+		_logs.push_back(log);
+		LOG_DEBUG << "Access log " << logs[i].path << " (format " << logs[i].formatName << ")" << std::endl;
+	}
+	return true;
+}
+
+void AccessLogs::write(const Server* server, const RequestRecord& record) {
+	if (!server) {
+		return;
+	}
+
+	double threshold = server->getSlowRequestThreshold();
+	if (threshold > 0 && record.requestTime() >= threshold) {
+		LOG_WARNING << "Slow request from " << record.remoteAddr << ": " << record.method << " "
+		            << record.uri << " " << record.status << " (" << record.breakdown() << ")"
+		            << std::endl;
+	}
+
+	const std::vector<int>& ids = server->getAccessLogIds();
+	for (size_t i = 0; i < ids.size(); ++i) {
+		if (static_cast<size_t>(ids[i]) < _logs.size()) {
+			_logs[ids[i]]->write(record);
+		}
+	}
+}
+
+void AccessLogs::tick() {
+	if (_reopenRequested) {
+		_reopenRequested = 0;
+		for (size_t i = 0; i < _logs.size(); ++i) {
+			_logs[i]->reopen();
+		}
+		if (!Logger::reopenLogFile()) {
+			LOG_ERROR << "Failed to reopen error_log: " << Logger::errstr() << std::endl;
+		}
+		LOG_INFO << "Log files reopened" << std::endl;
+	}
+
+	time_t now = Clock::now();
+	for (size_t i = 0; i < _logs.size(); ++i) {
+		_logs[i]->tick(now);
+	}
+}
+
+void AccessLogs::flush() {
+	for (size_t i = 0; i < _logs.size(); ++i) {
+		_logs[i]->flush();
+	}
+}
+
+void AccessLogs::requestReopen(int /* signal */) {
+	_reopenRequested = 1;
+}
+
+} // namespace HTTP
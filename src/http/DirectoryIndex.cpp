@@ -0,0 +1,372 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   DirectoryIndex.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:02:11 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:02:12 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * DirectoryIndex.cpp
+ * Implementation of the directory listing cache and its HTML/JSON pages
+ */
+
+#include "includes/http/DirectoryIndex.hpp"
+#include "includes/http/Response.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace HTTP {
+
+namespace {
+
+// Body segments are flushed at this size, so a page never sits in one buffer
+const size_t CHUNK_SIZE = 64 * 1024;
+
+void appendNumber(std::string& out, size_t value) {
+	char digits[24];
+	int length = snprintf(digits, sizeof(digits), "%lu", static_cast<unsigned long>(value));
+	out.append(digits, length);
+}
+
+void appendHtml(std::string& out, const char* text, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		switch (text[i]) {
+			case '&': out += "&amp;"; break;
+			case '<': out += "&lt;"; break;
+			case '>': out += "&gt;"; break;
+			case '"': out += "&quot;"; break;
+			case '\'': out += "&#39;"; break;
+			default: out += text[i];
+		}
+	}
+}
+
+// Link target: everything but unreserved characters is percent-encoded
+void appendHref(std::string& out, const char* text, size_t length) {
+	static const char hex[] = "0123456789ABCDEF";
+	for (size_t i = 0; i < length; ++i) {
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+		    || c == '-' || c == '.' || c == '_' || c == '~') {
+			out += static_cast<char>(c);
+		} else {
+			out += '%';
+			out += hex[c >> 4];
+			out += hex[c & 0x0F];
+		}
+	}
+}
+
+void appendJson(std::string& out, const char* text, size_t length) {
+	static const char hex[] = "0123456789abcdef";
+	for (size_t i = 0; i < length; ++i) {
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += static_cast<char>(c);
+		} else if (c < 0x20) {
+			out += "\\u00";
+			out += hex[c >> 4];
+			out += hex[c & 0x0F];
+		} else {
+			out += static_cast<char>(c);
+		}
+	}
+}
+
+// Query string of another page of the same listing (HTML-escaped '&')
+void appendPageLink(std::string& out, const DirectoryIndex::Page& page, size_t offset) {
+	out += "<a href=\"?sort=";
+	out += (page.sort == DirectoryIndex::SORT_TYPE ? "type" : "name");
+	out += "&amp;order=";
+	out += (page.descending ? "desc" : "asc");
+	out += "&amp;offset=";
+	appendNumber(out, offset);
+	out += "&amp;limit=";
+	appendNumber(out, page.limit);
+	out += "\">";
+}
+
+void flush(std::string& chunk, Response& response) {
+	response.appendSegment(chunk);
+	chunk.clear();
+}
+
+} // namespace
+
+const size_t DirectoryIndex::DEFAULT_LIMIT;
+const size_t DirectoryIndex::MAX_LIMIT;
+
+// Ordered by name, bytewise (like ls with LC_ALL=C)
+bool DirectoryIndex::NameLess::operator()(const Entry& a, const Entry& b) const {
+	int cmp = memcmp(names + a.offset, names + b.offset, std::min(a.length, b.length));
+	return cmp < 0 || (cmp == 0 && a.length < b.length);
+}
+
+DirectoryIndex::Page::Page()
+	: sort(SORT_NAME)
+	, descending(false)
+	, offset(0)
+	, limit(DEFAULT_LIMIT) {
+}
+
+DirectoryIndex::DirectoryIndex()
+	: _size(0)
+	, _capacity(32 * 1024 * 1024)
+	, _hits(0)
+	, _misses(0) {
+}
+
+// Still the same directory, unchanged since it was read? A listing read in
+// the same second as the last change may have missed a later change with
+// the same timestamp (coarse filesystem clocks), so it is read again
+bool DirectoryIndex::isCurrent(const Listing& listing, const struct stat& fileStat) {
+#ifdef __APPLE__
+	long nsec = fileStat.st_mtimespec.tv_nsec;
+#else
+	long nsec = fileStat.st_mtim.tv_nsec;
+#endif
+	return listing.ino == fileStat.st_ino && listing.dev == fileStat.st_dev
+	    && listing.mtime == fileStat.st_mtime && listing.mtimeNsec == nsec
+	    && listing.readAt > listing.mtime;
+}
+
+// Read and sort a directory; entry types come from d_type, and only
+// entries without one (or symlinks, which are listed as their target)
+// need a stat()
+bool DirectoryIndex::read(const std::string& dirPath, const struct stat& fileStat, Listing& listing) {
+	DIR* dir = opendir(dirPath.c_str());
+	if (!dir) {
+		LOG_DEBUG << "opendir(" << dirPath << ") failed: " << Logger::errstr() << std::endl;
+		return false;
+	}
+
+	listing.names.clear();
+	listing.entries.clear();
+	listing.byType.clear();
+
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const char* name = entry->d_name;
+		if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+			continue;
+		}
+
+		Entry item;
+		item.offset = listing.names.length();
+		item.length = strlen(name);
+		item.directory = (entry->d_type == DT_DIR);
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+			struct stat entryStat;
+			item.directory = fstatat(dirfd(dir), name, &entryStat, 0) == 0 && S_ISDIR(entryStat.st_mode);
+		}
+		listing.names.append(name, item.length);
+		listing.entries.push_back(item);
+	}
+	closedir(dir);
+
+	NameLess less;
+	less.names = listing.names.data();
+	std::sort(listing.entries.begin(), listing.entries.end(), less);
+
+	listing.byType.reserve(listing.entries.size());
+	for (size_t i = 0; i < listing.entries.size(); ++i) {
+		if (listing.entries[i].directory) {
+			listing.byType.push_back(i);
+		}
+	}
+	listing.directories = listing.byType.size();
+	for (size_t i = 0; i < listing.entries.size(); ++i) {
+		if (!listing.entries[i].directory) {
+			listing.byType.push_back(i);
+		}
+	}
+
+	listing.dev = fileStat.st_dev;
+	listing.ino = fileStat.st_ino;
+	listing.mtime = fileStat.st_mtime;
+#ifdef __APPLE__
+	listing.mtimeNsec = fileStat.st_mtimespec.tv_nsec;
+#else
+	listing.mtimeNsec = fileStat.st_mtim.tv_nsec;
+#endif
+	listing.readAt = Clock::now();
+	listing.bytes = sizeof(Node) + dirPath.length() + listing.names.capacity()
+	              + listing.entries.capacity() * sizeof(Entry)
+	              + listing.byType.capacity() * sizeof(unsigned int);
+	return true;
+}
+
+// Cached listing of a directory, read again if it changed
+const DirectoryIndex::Listing* DirectoryIndex::find(const std::string& dirPath, const struct stat& fileStat) {
+	std::map<std::string, NodeList::iterator>::iterator it = _index.find(dirPath);
+	if (it != _index.end()) {
+		if (isCurrent(it->second->listing, fileStat)) {
+			++_hits;
+			_nodes.splice(_nodes.begin(), _nodes, it->second);
+			return &it->second->listing;
+		}
+		_size -= it->second->listing.bytes;
+		_nodes.erase(it->second);
+		_index.erase(it);
+	}
+
+	++_misses;
+	_nodes.push_front(Node());
+	Node& node = _nodes.front();
+	if (!read(dirPath, fileStat, node.listing)) {
+		_nodes.pop_front();
+		return NULL;
+	}
+	if (node.listing.bytes > _capacity) {
+		// Would never fit, don't flush the cache for it (kept for this request)
+		_uncached.splice(_uncached.begin(), _nodes, _nodes.begin());
+		return &node.listing;
+	}
+
+	evict(node.listing.bytes);
+
+	node.path = dirPath;
+	_index[dirPath] = _nodes.begin();
+	_size += node.listing.bytes;
+
+	LOG_DEBUG << "Cached listing of " << dirPath << " (" << node.listing.entries.size()
+	          << " entries), cache: " << _size << "/" << _capacity << " bytes" << std::endl;
+	return &node.listing;
+}
+
+// Entry shown at position i of the page's order (directories stay first
+// when sorted by type, only the names within each group are reversed)
+size_t DirectoryIndex::position(const Listing& listing, const Page& page, size_t i) {
+	size_t total = listing.entries.size();
+	if (page.sort == SORT_NAME) {
+		return page.descending ? total - 1 - i : i;
+	}
+	if (page.descending) {
+		i = (i < listing.directories) ? listing.directories - 1 - i : total - 1 - (i - listing.directories);
+	}
+	return listing.byType[i];
+}
+
+bool DirectoryIndex::render(const std::string& dirPath, const struct stat& fileStat,
+                            const std::string& requestPath, Format format, const Page& page,
+                            Response& response) {
+	const Listing* listing = find(dirPath, fileStat);
+	if (!listing) {
+		return false;
+	}
+
+	size_t total = listing->entries.size();
+	size_t first = std::min(page.offset, total);
+	size_t last = first + std::min(page.limit, total - first);
+
+	std::string chunk;
+	chunk.reserve(CHUNK_SIZE + 1024);
+
+	if (format == FORMAT_JSON) {
+		chunk += "{\"path\":\"";
+		appendJson(chunk, requestPath.data(), requestPath.length());
+		chunk += "\",\"total\":";
+		appendNumber(chunk, total);
+		chunk += ",\"offset\":";
+		appendNumber(chunk, first);
+		chunk += ",\"limit\":";
+		appendNumber(chunk, page.limit);
+		chunk += ",\"entries\":[";
+	} else {
+		chunk += "<!DOCTYPE html>\n<html>\n<head><title>Index of ";
+		appendHtml(chunk, requestPath.data(), requestPath.length());
+		chunk += "</title></head>\n<body>\n<h1>Index of ";
+		appendHtml(chunk, requestPath.data(), requestPath.length());
+		chunk += "</h1>\n<hr>\n<ul>\n";
+		if (requestPath != "/" && first == 0) {
+			chunk += "<li><a href=\"../\">../</a></li>\n";
+		}
+	}
+
+	for (size_t i = first; i < last; ++i) {
+		const Entry& entry = listing->entries[position(*listing, page, i)];
+		const char* name = listing->names.data() + entry.offset;
+
+		if (format == FORMAT_JSON) {
+			if (i != first) {
+				chunk += ',';
+			}
+			chunk += "\n{\"name\":\"";
+			appendJson(chunk, name, entry.length);
+			chunk += entry.directory ? "\",\"type\":\"directory\"}" : "\",\"type\":\"file\"}";
+		} else {
+			chunk += "<li><a href=\"";
+			appendHref(chunk, name, entry.length);
+			chunk += entry.directory ? "/\">" : "\">";
+			appendHtml(chunk, name, entry.length);
+			chunk += entry.directory ? "/</a></li>\n" : "</a></li>\n";
+		}
+
+		if (chunk.length() >= CHUNK_SIZE) {
+			flush(chunk, response);
+		}
+	}
+
+	if (format == FORMAT_JSON) {
+		chunk += "\n]}\n";
+	} else {
+		chunk += "</ul>\n<hr>\n";
+		if (first > 0 || last < total) {
+			chunk += "<p>";
+			appendNumber(chunk, total == 0 ? 0 : first + 1);
+			chunk += "-";
+			appendNumber(chunk, last);
+			chunk += " of ";
+			appendNumber(chunk, total);
+			if (first > 0) {
+				chunk += " ";
+				appendPageLink(chunk, page, first > page.limit ? first - page.limit : 0);
+				chunk += "previous</a>";
+			}
+			if (last < total) {
+				chunk += " ";
+				appendPageLink(chunk, page, last);
+				chunk += "next</a>";
+			}
+			chunk += "</p>\n";
+		}
+		chunk += "<p><em>webserv/1.0</em></p>\n</body>\n</html>\n";
+	}
+	flush(chunk, response);
+	_uncached.clear();
+
+	response.setContentType(format == FORMAT_JSON ? "application/json" : "text/html");
+	return true;
+}
+
+void DirectoryIndex::setCapacity(size_t bytes) {
+	_capacity = bytes;
+	evict(0);
+}
+
+// Drop least recently used listings until `needed` more bytes fit
+void DirectoryIndex::evict(size_t needed) {
+	while (!_nodes.empty() && _size + needed > _capacity) {
+		Node& victim = _nodes.back();
+		_size -= victim.listing.bytes;
+		_index.erase(victim.path);
+		_nodes.pop_back();
+	}
+}
+
+size_t DirectoryIndex::getSize() const { return _size; }
+size_t DirectoryIndex::getHits() const { return _hits; }
+size_t DirectoryIndex::getMisses() const { return _misses; }
+
+} // namespace HTTP
@@ -0,0 +1,141 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ErrorPages.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 20:05:18 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 20:05:19 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * ErrorPages.cpp
+ * Implementation of the prepared error responses
+ */
+#include "includes/http/ErrorPages.hpp"
+#include "includes/config/Config.hpp"
+#include "includes/utils/Logger.hpp"
+#include <fstream>
+#include <sstream>
+
+namespace HTTP {
+
+namespace {
+	// Error statuses with a prepared page, and the built-in page's message
+	struct ErrorStatus {
+		int code;
+		const char* message;
+	};
+
+	const ErrorStatus STATUSES[] = {
+		{ 400, "" },
+		{ 401, "" },
+		{ 403, "" },
+		{ 404, "The requested URL was not found on this server." },
+		{ 405, "The method is not allowed for this resource." },
+		{ 408, "" },
+		{ 413, "Request entity too large." },
+		{ 414, "" },
+		{ 416, "" },
+		{ 429, "" },
+		{ 500, "" },
+		{ 501, "The method is not implemented." },
+		{ 502, "" },
+		{ 503, "" },
+		{ 504, "" },
+		{ 505, "" }
+	};
+
+	const int STATUS_COUNT = sizeof(STATUSES) / sizeof(STATUSES[0]);
+
+	bool readPage(const std::string& path, std::string& content) {
+		std::ifstream file(path.c_str());
+		if (!file.is_open()) {
+			return false;
+		}
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		content = buffer.str();
+		return !content.empty();
+	}
+}
+
+ErrorPages::ErrorPages() {}
+
+ErrorPages::~ErrorPages() {}
+
+int ErrorPages::indexOf(int status) {
+	for (int i = 0; i < STATUS_COUNT; ++i) {
+		if (STATUSES[i].code == status) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void ErrorPages::open(const Config& config) {
+	_defaults.clear();
+	_servers.clear();
+
+	_defaults.resize(STATUS_COUNT);
+	for (int i = 0; i < STATUS_COUNT; ++i) {
+		_defaults[i] = Response::errorResponse(STATUSES[i].code, STATUSES[i].message);
+		_defaults[i].prepare();
+	}
+
+	// error_page files are read now; a missing file keeps the built-in page
+	const std::vector<Server>& servers = config.getServers();
+	size_t custom = 0;
+	for (size_t s = 0; s < servers.size(); ++s) {
+		const Server& server = servers[s];
+		if (server.getErrorPages().empty()) {
+			continue;
+		}
+
+		std::vector<Response>& pages = _servers[&server];
+		pages = _defaults;
+		for (int i = 0; i < STATUS_COUNT; ++i) {
+			const std::string* path = server.getErrorPageFile(STATUSES[i].code);
+			std::string content;
+			if (!path) {
+				continue;
+			}
+			if (!readPage(*path, content)) {
+				LOG_WARNING << "Cannot read error_page " << Logger::param(*path)
+				            << ", using the built-in " << STATUSES[i].code << " page" << std::endl;
+				continue;
+			}
+
+			Response page;
+			page.setStatus(STATUSES[i].code);
+			page.setContentType("text/html");
+			page.setBody(content);
+			page.setKeepAlive(false);
+			page.prepare();
+			pages[i] = page;
+			++custom;
+		}
+	}
+
+	LOG_DEBUG << "Prepared " << STATUS_COUNT << " built-in and " << custom
+	          << " custom error pages" << std::endl;
+}
+
+Response ErrorPages::get(const Server* server, int status) const {
+	int index = indexOf(status);
+	if (index < 0 || _defaults.empty()) {
+		return Response::errorResponse(status);
+	}
+
+	if (server) {
+		std::map<const Server*, std::vector<Response> >::const_iterator it = _servers.find(server);
+		if (it != _servers.end()) {
+			return Response::prepared(it->second[index]);
+		}
+	}
+	return Response::prepared(_defaults[index]);
+}
+
+} // namespace HTTP
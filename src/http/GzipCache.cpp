@@ -0,0 +1,141 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   GzipCache.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 12:20:04 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 12:20:05 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * GzipCache.cpp
+ * Implementation of gzip compression and the compressed-variant cache
+ */
+#include "includes/http/GzipCache.hpp"
+#include "includes/utils/Logger.hpp"
+#include <zlib.h>
+
+namespace HTTP {
+
+GzipCache::GzipCache()
+	: _size(0)
+	, _capacity(16 * 1024 * 1024)
+	, _hits(0)
+	, _misses(0) {
+}
+
+bool GzipCache::Key::operator<(const Key& other) const {
+	if (ino != other.ino) return ino < other.ino;
+	if (dev != other.dev) return dev < other.dev;
+	if (mtime != other.mtime) return mtime < other.mtime;
+	if (size != other.size) return size < other.size;
+	return level < other.level;
+}
+
+GzipCache::Key GzipCache::makeKey(const struct stat& fileStat, int level) {
+	Key key;
+	key.dev = fileStat.st_dev;
+	key.ino = fileStat.st_ino;
+	key.mtime = fileStat.st_mtime;
+	key.size = fileStat.st_size;
+	key.level = level;
+	return key;
+}
+
+// Look up a variant and mark it as most recently used
+bool GzipCache::find(const struct stat& fileStat, int level, SharedBuffer& compressed) {
+	std::map<Key, EntryList::iterator>::iterator it = _index.find(makeKey(fileStat, level));
+	if (it == _index.end()) {
+		++_misses;
+		return false;
+	}
+
+	++_hits;
+	_entries.splice(_entries.begin(), _entries, it->second);
+	compressed = it->second->data;
+	return true;
+}
+
+// Insert a variant, evicting least recently used entries first
+// (an evicted variant lives on until the responses sending it are done)
+void GzipCache::insert(const struct stat& fileStat, int level, const SharedBuffer& compressed) {
+	if (compressed.size() > _capacity) {
+		return; // Would never fit, don't flush the cache for it
+	}
+
+	Key key = makeKey(fileStat, level);
+	std::map<Key, EntryList::iterator>::iterator it = _index.find(key);
+	if (it != _index.end()) {
+		_size -= it->second->data.size();
+		_entries.erase(it->second);
+		_index.erase(it);
+	}
+
+	evict(compressed.size());
+
+	Entry entry;
+	entry.key = key;
+	entry.data = compressed;
+	_entries.push_front(entry);
+	_index[key] = _entries.begin();
+	_size += compressed.size();
+
+	LOG_DEBUG << "Cached gzip variant (" << compressed.size() << " bytes), cache: "
+	          << _size << "/" << _capacity << " bytes" << std::endl;
+}
+
+void GzipCache::setCapacity(size_t bytes) {
+	_capacity = bytes;
+	evict(0);
+}
+
+// Drop least recently used entries until `needed` more bytes fit
+void GzipCache::evict(size_t needed) {
+	while (!_entries.empty() && _size + needed > _capacity) {
+		Entry& victim = _entries.back();
+		_size -= victim.data.size();
+		_index.erase(victim.key);
+		_entries.pop_back();
+	}
+}
+
+size_t GzipCache::getCapacity() const { return _capacity; }
+size_t GzipCache::getSize() const { return _size; }
+size_t GzipCache::getHits() const { return _hits; }
+size_t GzipCache::getMisses() const { return _misses; }
+
+// Compress a buffer into gzip format (RFC 1952)
+bool GzipCache::compress(const std::string& input, std::string& output, int level) {
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+
+	// windowBits 15 + 16 selects the gzip wrapper instead of zlib
+	if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		LOG_ERROR << "deflateInit2 failed" << std::endl;
+		return false;
+	}
+
+	output.resize(deflateBound(&stream, input.length()));
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+	stream.avail_in = input.length();
+	stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+	stream.avail_out = output.length();
+
+	int result = deflate(&stream, Z_FINISH);
+	output.resize(stream.total_out);
+	deflateEnd(&stream);
+
+	if (result != Z_STREAM_END) {
+		LOG_ERROR << "deflate failed: " << result << std::endl;
+		output.clear();
+		return false;
+	}
+	return true;
+}
+
+} // namespace HTTP
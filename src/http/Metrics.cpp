@@ -0,0 +1,246 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:21:40 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:21:41 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Metrics.cpp
+ * Implementation of the metrics registry
+ */
+#include "includes/http/Metrics.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/GzipCache.hpp"
+#include "includes/http/DirectoryIndex.hpp"
+#include "includes/http/RateLimiter.hpp"
+#include "includes/http/Upstreams.hpp"
+#include "includes/cgi/Cache.hpp"
+#include "includes/config/Config.hpp"
+#include "includes/core/Instance.hpp"
+#include "includes/utils/AsyncLog.hpp"
+#include <sstream>
+#include <cstdio>
+
+namespace HTTP {
+
+Metrics::Histogram::Histogram()
+	: count(0)
+	, sum(0) {
+	for (int i = 0; i <= BUCKETS; ++i) {
+		buckets[i] = 0;
+	}
+}
+
+Metrics::Metrics()
+	: _accepted(0)
+	, _reading(0)
+	, _writing(0)
+	, _http2(0)
+	, _bytesIn(0)
+	, _bytesOut(0)
+	, _cgiSpawns(0)
+	, _cgiTimeouts(0)
+	, _tlsHandshakes(0)
+	, _tlsResumed(0)
+	, _tlsFailures(0) {
+	for (int i = 0; i < 6; ++i) {
+		_requests[i] = 0;
+	}
+}
+
+Metrics::~Metrics() {}
+
+void Metrics::open(const Config& config) {
+	const std::vector<Server>& servers = config.getServers();
+	for (size_t i = 0; i < servers.size(); ++i) {
+		const Server& server = servers[i];
+
+		// First server_name, or host:port for unnamed servers
+		std::ostringstream name;
+		if (!server.getServerNames().empty()) {
+			name << server.getServerNames()[0];
+		} else {
+			name << server.getHost();
+			if (!server.getPorts().empty()) {
+				name << ":" << server.getPorts()[0];
+			}
+		}
+
+		const std::vector<Route>& routes = server.getRoutes();
+		for (size_t j = 0; j < routes.size(); ++j) {
+			int id = routes[j].getMetricsId();
+			if (id < 0) {
+				continue;
+			}
+			if (static_cast<size_t>(id) >= _histograms.size()) {
+				_histograms.resize(id + 1);
+			}
+			_histograms[id].labels = "server=\"" + escapeLabel(name.str()) + "\",location=\"" +
+			                         escapeLabel(routes[j].getPath()) + "\"";
+		}
+	}
+}
+
+int Metrics::bucketFor(unsigned long microseconds) {
+	if (microseconds <= FIRST_BUCKET_US) {
+		return 0;
+	}
+	// Smallest i with microseconds <= FIRST_BUCKET_US << i
+	unsigned long scaled = (microseconds - 1) / FIRST_BUCKET_US;
+	int bucket = static_cast<int>(sizeof(unsigned long) * 8) - __builtin_clzl(scaled);
+	return bucket < BUCKETS ? bucket : BUCKETS;
+}
+
+void Metrics::recordRequest(const RequestRecord& record) {
+	int statusClass = record.status / 100;
+	++_requests[statusClass >= 1 && statusClass <= 5 ? statusClass : 0];
+
+	if (record.routeId < 0 || static_cast<size_t>(record.routeId) >= _histograms.size()) {
+		return;
+	}
+	double seconds = record.requestTime();
+	Histogram& histogram = _histograms[record.routeId];
+	++histogram.buckets[bucketFor(static_cast<unsigned long>(seconds * 1e6))];
+	++histogram.count;
+	histogram.sum += seconds;
+}
+
+void Metrics::setConnections(size_t reading, size_t writing, size_t http2) {
+	_reading = reading;
+	_writing = writing;
+	_http2 = http2;
+}
+
+std::string Metrics::render() const {
+	static const char* classes[6] = { "unknown", "1xx", "2xx", "3xx", "4xx", "5xx" };
+	std::ostringstream out;
+
+	out << "# HELP webserv_connections_accepted_total Accepted client connections.\n"
+	    << "# TYPE webserv_connections_accepted_total counter\n"
+	    << "webserv_connections_accepted_total " << _accepted << "\n"
+	    << "# HELP webserv_connections_active Open client connections.\n"
+	    << "# TYPE webserv_connections_active gauge\n"
+	    << "webserv_connections_active " << (_reading + _writing + _http2) << "\n"
+	    << "# HELP webserv_connections Open client connections by state.\n"
+	    << "# TYPE webserv_connections gauge\n"
+	    << "webserv_connections{state=\"reading\"} " << _reading << "\n"
+	    << "webserv_connections{state=\"writing\"} " << _writing << "\n"
+	    << "webserv_connections{state=\"http2\"} " << _http2 << "\n";
+
+	out << "# HELP webserv_requests_total Completed requests by status class.\n"
+	    << "# TYPE webserv_requests_total counter\n";
+	for (int i = 1; i <= 5; ++i) {
+		out << "webserv_requests_total{status=\"" << classes[i] << "\"} " << _requests[i] << "\n";
+	}
+	if (_requests[0]) {
+		out << "webserv_requests_total{status=\"" << classes[0] << "\"} " << _requests[0] << "\n";
+	}
+
+	out << "# HELP webserv_received_bytes_total Bytes read from clients.\n"
+	    << "# TYPE webserv_received_bytes_total counter\n"
+	    << "webserv_received_bytes_total " << _bytesIn << "\n"
+	    << "# HELP webserv_sent_bytes_total Bytes written to clients.\n"
+	    << "# TYPE webserv_sent_bytes_total counter\n"
+	    << "webserv_sent_bytes_total " << _bytesOut << "\n"
+	    << "# HELP webserv_cgi_spawns_total CGI processes started.\n"
+	    << "# TYPE webserv_cgi_spawns_total counter\n"
+	    << "webserv_cgi_spawns_total " << _cgiSpawns << "\n"
+	    << "# HELP webserv_cgi_timeouts_total CGI processes killed after the timeout.\n"
+	    << "# TYPE webserv_cgi_timeouts_total counter\n"
+	    << "webserv_cgi_timeouts_total " << _cgiTimeouts << "\n"
+	    << "# HELP webserv_tls_handshakes_total Completed TLS handshakes.\n"
+	    << "# TYPE webserv_tls_handshakes_total counter\n"
+	    << "webserv_tls_handshakes_total{resumed=\"false\"} " << (_tlsHandshakes - _tlsResumed) << "\n"
+	    << "webserv_tls_handshakes_total{resumed=\"true\"} " << _tlsResumed << "\n"
+	    << "# HELP webserv_tls_handshake_failures_total Failed TLS handshakes.\n"
+	    << "# TYPE webserv_tls_handshake_failures_total counter\n"
+	    << "webserv_tls_handshake_failures_total " << _tlsFailures << "\n";
+
+	const GzipCache* gzip = Instance::Get<GzipCache>();
+	out << "# HELP webserv_gzip_cache_hits_total Compressed variants served from the cache.\n"
+	    << "# TYPE webserv_gzip_cache_hits_total counter\n"
+	    << "webserv_gzip_cache_hits_total " << gzip->getHits() << "\n"
+	    << "# HELP webserv_gzip_cache_misses_total Compressed variants built on demand.\n"
+	    << "# TYPE webserv_gzip_cache_misses_total counter\n"
+	    << "webserv_gzip_cache_misses_total " << gzip->getMisses() << "\n";
+
+	const DirectoryIndex* listings = Instance::Get<DirectoryIndex>();
+	out << "# HELP webserv_autoindex_cache_hits_total Directory listings served from the cache.\n"
+	    << "# TYPE webserv_autoindex_cache_hits_total counter\n"
+	    << "webserv_autoindex_cache_hits_total " << listings->getHits() << "\n"
+	    << "# HELP webserv_autoindex_cache_misses_total Directory listings read from disk.\n"
+	    << "# TYPE webserv_autoindex_cache_misses_total counter\n"
+	    << "webserv_autoindex_cache_misses_total " << listings->getMisses() << "\n";
+
+	const CGI::Cache* responses = Instance::Get<CGI::Cache>();
+	out << "# HELP webserv_cgi_cache_requests_total CGI requests on cgi_cache locations, by result.\n"
+	    << "# TYPE webserv_cgi_cache_requests_total counter\n"
+	    << "webserv_cgi_cache_requests_total{status=\"hit\"} " << responses->getHits() << "\n"
+	    << "webserv_cgi_cache_requests_total{status=\"stale\"} " << responses->getStaleHits() << "\n"
+	    << "webserv_cgi_cache_requests_total{status=\"miss\"} " << responses->getMisses() << "\n";
+
+	const RateLimiter* limiter = Instance::Get<RateLimiter>();
+	out << "# HELP webserv_limited_requests_total Requests delayed or rejected by limit_req / limit_conn.\n"
+	    << "# TYPE webserv_limited_requests_total counter\n"
+	    << "webserv_limited_requests_total{action=\"delayed\"} " << limiter->getDelayed() << "\n"
+	    << "webserv_limited_requests_total{action=\"rejected\"} " << limiter->getRejected() << "\n";
+
+	const Upstreams* upstreams = Instance::Get<Upstreams>();
+	out << "# HELP webserv_upstream_connections_total Upstream connections used by proxy_pass.\n"
+	    << "# TYPE webserv_upstream_connections_total counter\n"
+	    << "webserv_upstream_connections_total{type=\"new\"} " << upstreams->getConnects() << "\n"
+	    << "webserv_upstream_connections_total{type=\"reused\"} " << upstreams->getReused() << "\n"
+	    << "# HELP webserv_upstream_failures_total Upstream connects / exchanges that failed.\n"
+	    << "# TYPE webserv_upstream_failures_total counter\n"
+	    << "webserv_upstream_failures_total " << upstreams->getFailures() << "\n"
+	    << "# HELP webserv_log_dropped_records_total Log records dropped with the log buffer full.\n"
+	    << "# TYPE webserv_log_dropped_records_total counter\n"
+	    << "webserv_log_dropped_records_total " << Logger::droppedRecords() << "\n";
+
+	out << "# HELP webserv_request_duration_seconds Time from the first request byte to the response.\n"
+	    << "# TYPE webserv_request_duration_seconds histogram\n";
+	for (size_t i = 0; i < _histograms.size(); ++i) {
+		const Histogram& histogram = _histograms[i];
+		if (histogram.labels.empty()) {
+			continue;
+		}
+
+		unsigned long cumulative = 0;
+		for (int b = 0; b < BUCKETS; ++b) {
+			char bound[32];
+			snprintf(bound, sizeof(bound), "%g", (FIRST_BUCKET_US << b) / 1e6);
+			cumulative += histogram.buckets[b];
+			out << "webserv_request_duration_seconds_bucket{" << histogram.labels
+			    << ",le=\"" << bound << "\"} " << cumulative << "\n";
+		}
+		out << "webserv_request_duration_seconds_bucket{" << histogram.labels
+		    << ",le=\"+Inf\"} " << histogram.count << "\n"
+		    << "webserv_request_duration_seconds_sum{" << histogram.labels << "} " << histogram.sum << "\n"
+		    << "webserv_request_duration_seconds_count{" << histogram.labels << "} " << histogram.count << "\n";
+	}
+	return out.str();
+}
+
+// Label values: backslash, double quote and newline are escaped
+std::string Metrics::escapeLabel(const std::string& value) {
+	std::string escaped;
+	for (size_t i = 0; i < value.length(); ++i) {
+		if (value[i] == '\\' || value[i] == '"') {
+			escaped += '\\';
+			escaped += value[i];
+		} else if (value[i] == '\n') {
+			escaped += "\\n";
+		} else {
+			escaped += value[i];
+		}
+	}
+	return escaped;
+}
+
+} // namespace HTTP
@@ -0,0 +1,625 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Proxy.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:21:48 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 18:21:49 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Proxy.cpp
+ * Implementation of the proxy_pass exchange with an upstream
+ */
+
+#include "includes/http/Proxy.hpp"
+#include "includes/http/Request.hpp"
+#include "includes/http/Upstreams.hpp"
+#include "includes/config/Route.hpp"
+#include "includes/core/Instance.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <strings.h>
+#include <sstream>
+
+namespace HTTP {
+
+namespace {
+	// Hop-by-hop headers (RFC 7230 section 6.1) are never forwarded
+	bool isHopByHop(const std::string& name) {
+		static const char* NAMES[] = {
+			"connection", "keep-alive", "proxy-connection", "te", "trailer",
+			"transfer-encoding", "upgrade"
+		};
+		for (size_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); ++i) {
+			if (strcasecmp(name.c_str(), NAMES[i]) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Does a comma-separated header value list the token? (case-insensitive)
+	bool hasToken(const std::string& value, const char* token) {
+		size_t length = std::strlen(token);
+		size_t pos = 0;
+		while (pos < value.length()) {
+			while (pos < value.length() && (value[pos] == ' ' || value[pos] == '\t' || value[pos] == ',')) {
+				++pos;
+			}
+			size_t end = value.find(',', pos);
+			if (end == std::string::npos) {
+				end = value.length();
+			}
+			size_t last = end;
+			while (last > pos && (value[last - 1] == ' ' || value[last - 1] == '\t')) {
+				--last;
+			}
+			if (last - pos == length && strncasecmp(value.c_str() + pos, token, length) == 0) {
+				return true;
+			}
+			pos = end;
+		}
+		return false;
+	}
+}
+
+Proxy::Proxy(const Route& route, const Request& request, const std::string& clientAddress, bool secure)
+	: _upstream(route.getProxy().upstream)
+	, _connectTimeout(route.getProxy().connectTimeout)
+	, _readTimeout(route.getProxy().readTimeout)
+	, _clientAddress(clientAddress)
+	, _uri(request.getUri())
+	, _idempotent(request.getMethod() != "POST" && request.getMethod() != "PATCH")
+	, _headRequest(request.getMethod() == "HEAD")
+	, _tried(Instance::Get<Upstreams>()->getPeerCount(_upstream), false)
+	, _peer(-1)
+	, _fd(-1)
+	, _reused(false)
+	, _state(STATE_IDLE)
+	, _deadline(0)
+	, _sent(0)
+	, _received(0)
+	, _headDone(false)
+	, _status(0)
+	, _keepAlive(false)
+	, _bodyMode(BODY_NONE)
+	, _remaining(0)
+	, _chunkState(CHUNK_SIZE)
+	, _bodyOffset(0)
+	, _errorStatus(0) {
+	buildRequest(route, request, secure);
+}
+
+Proxy::~Proxy() {
+	if (_fd >= 0) {
+		Instance::Get<Upstreams>()->release(_upstream, _peer, _fd, false);
+	}
+}
+
+// Request line with the location prefix mapped onto the proxy_pass URI,
+// the end-to-end headers, the X-Forwarded-* headers and the body
+void Proxy::buildRequest(const Route& route, const Request& request, bool secure) {
+	const ProxySettings& proxy = route.getProxy();
+	std::string uri = request.getUri();
+	if (proxy.hasUri && uri.compare(0, route.getPath().length(), route.getPath()) == 0) {
+		std::string rest = uri.substr(route.getPath().length());
+		if (!rest.empty() && rest[0] == '/' && !proxy.uri.empty() &&
+		    proxy.uri[proxy.uri.length() - 1] == '/') {
+			rest.erase(0, 1);
+		}
+		uri = proxy.uri + rest;
+		if (uri.empty() || uri[0] != '/') {
+			uri.insert(0, "/");
+		}
+	}
+
+	_request.reserve(512 + request.getBody().length());
+	_request = request.getMethod() + " " + uri + " HTTP/1.1\r\n";
+
+	const std::map<std::string, std::string>& headers = request.getHeaders();
+	std::string forwardedFor;
+	for (std::map<std::string, std::string>::const_iterator it = headers.begin();
+	     it != headers.end(); ++it) {
+		const std::string& name = it->first;
+		if (name == "x-forwarded-for") {
+			forwardedFor = it->second + ", ";
+			continue;
+		}
+		if (isHopByHop(name) || name == "host" || name == "content-length" || name == "expect" ||
+		    name == "x-real-ip" || name == "x-forwarded-proto" || (!name.empty() && name[0] == ':')) {
+			continue;
+		}
+		_request += name + ": " + it->second + "\r\n";
+	}
+
+	// The client's Host, so name-based applications see the name they were asked for
+	std::string host = request.getHeader("host");
+	_request += "Host: " + (host.empty() ? Instance::Get<Upstreams>()->getName(_upstream) : host) + "\r\n";
+	_request += "X-Real-IP: " + _clientAddress + "\r\n";
+	_request += "X-Forwarded-For: " + forwardedFor + _clientAddress + "\r\n";
+	_request += std::string("X-Forwarded-Proto: ") + (secure ? "https" : "http") + "\r\n";
+
+	const std::string& method = request.getMethod();
+	if (!request.getBody().empty() || method == "POST" || method == "PUT" || method == "PATCH") {
+		std::ostringstream length;
+		length << request.getBody().length();
+		_request += "Content-Length: " + length.str() + "\r\n";
+	}
+
+	// HTTP/1.1 connections persist by default: only say so when the pool is off
+	if (!Instance::Get<Upstreams>()->keepsAlive(_upstream)) {
+		_request += "Connection: close\r\n";
+	}
+	_request += "\r\n";
+	_request += request.getBody();
+}
+
+bool Proxy::start() {
+	return connectNext();
+}
+
+// Next peer the balancer picks among those not tried yet
+bool Proxy::connectNext() {
+	Upstreams* upstreams = Instance::Get<Upstreams>();
+	while (true) {
+		int peer = upstreams->select(_upstream, _clientAddress, _uri, _tried);
+		if (peer < 0) {
+			LOG_ERROR << "No upstream server left for " << _uri << " (upstream "
+			          << upstreams->getName(_upstream) << ")" << std::endl;
+			if (_errorStatus == 0) {
+				_errorStatus = 502;
+			}
+			_state = STATE_FAILED;
+			return false;
+		}
+
+		_tried[peer] = true;
+		_peer = peer;
+		_fd = upstreams->connect(_upstream, peer, _reused);
+		if (_fd < 0) {
+			upstreams->failed(_upstream, peer);
+			continue;
+		}
+
+		LOG_DEBUG << "Proxying " << _uri << " to " << upstreams->getPeerName(_upstream, peer)
+		          << " (upstream fd: " << _fd << (_reused ? ", kept alive" : "") << ")" << std::endl;
+		_sent = 0;
+		_received = 0;
+		_head.clear();
+		_state = _reused ? STATE_SENDING : STATE_CONNECTING;
+		_deadline = Clock::monotonic() + (_reused ? _readTimeout : _connectTimeout);
+		return true;
+	}
+}
+
+int Proxy::getFd() const {
+	return _fd;
+}
+
+short Proxy::getPollEvents() const {
+	if (_fd < 0) {
+		return 0;
+	}
+	switch (_state) {
+		case STATE_CONNECTING:
+		case STATE_SENDING:
+			return POLLOUT;
+		case STATE_READING_HEAD:
+			return POLLIN;
+		case STATE_READING_BODY:
+			return isPaused() ? 0 : POLLIN;
+		default:
+			return 0;
+	}
+}
+
+// Reading waits while the client hasn't taken the buffered body
+bool Proxy::isPaused() const {
+	return _state == STATE_READING_BODY && size() >= MAX_BUFFERED;
+}
+
+double Proxy::getDeadline() const {
+	if (_fd < 0 || isPaused()) {
+		return 0;
+	}
+	return _deadline;
+}
+
+void Proxy::handleEvent(short revents) {
+	if (_fd < 0) {
+		return;
+	}
+
+	if (_state == STATE_CONNECTING) {
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+			error = errno;
+		}
+		if (error != 0 || !(revents & POLLOUT)) {
+			LOG_WARNING << "connect() to upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+			            << " failed: " << std::strerror(error ? error : ECONNREFUSED) << std::endl;
+			fail(502, true);
+			return;
+		}
+		_state = STATE_SENDING;
+		_deadline = Clock::monotonic() + _readTimeout;
+	}
+
+	if (_state == STATE_SENDING) {
+		sendRequest();
+	} else if (_state == STATE_READING_HEAD || _state == STATE_READING_BODY) {
+		receive();
+	}
+}
+
+void Proxy::sendRequest() {
+	ssize_t sent = send(_fd, _request.data() + _sent, _request.size() - _sent, 0);
+	if (sent < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return;
+		}
+		if (!_reused) {
+			LOG_WARNING << "Sending to upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+			            << " failed: " << Logger::errstr() << std::endl;
+		}
+		fail(502, !_reused);
+		return;
+	}
+	_sent += sent;
+	_deadline = Clock::monotonic() + _readTimeout;
+	if (_sent == _request.size()) {
+		_state = STATE_READING_HEAD;
+	}
+}
+
+void Proxy::receive() {
+	char buffer[READ_SIZE];
+	ssize_t received = recv(_fd, buffer, sizeof(buffer), 0);
+	if (received < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return;
+		}
+		closedEarly();
+		return;
+	}
+	if (received == 0) {
+		closedEarly();
+		return;
+	}
+
+	_received += received;
+	_deadline = Clock::monotonic() + _readTimeout;
+	if (_state == STATE_READING_HEAD) {
+		_head.append(buffer, received);
+		parseHead();
+	} else {
+		feed(buffer, received);
+	}
+}
+
+// Upstream closed (or reset) the connection
+void Proxy::closedEarly() {
+	if (_state == STATE_READING_BODY && _bodyMode == BODY_UNTIL_CLOSE) {
+		finish(false);
+		return;
+	}
+
+	// A kept-alive connection the peer closed while it sat in the pool is
+	// not the peer's fault: the request goes out again on a new connection
+	bool stale = _reused && _received == 0;
+	if (!stale) {
+		LOG_WARNING << "Upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+		            << " closed the connection prematurely (" << _uri << ")" << std::endl;
+	}
+	fail(502, !stale);
+}
+
+void Proxy::checkTimeout(double now) {
+	double deadline = getDeadline();
+	if (deadline == 0 || now < deadline) {
+		return;
+	}
+	LOG_WARNING << "Upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+	            << " timed out (" << (_state == STATE_CONNECTING ? "connect" : "read")
+	            << ", " << _uri << ")" << std::endl;
+	fail(504, true);
+}
+
+// Status line and headers; interim 1xx responses are skipped
+// Returns false once the exchange failed
+bool Proxy::parseHead() {
+	size_t end;
+	while ((end = _head.find("\r\n\r\n")) != std::string::npos) {
+		size_t lineEnd = _head.find("\r\n");
+		std::string statusLine = _head.substr(0, lineEnd);
+		if (statusLine.length() < 12 || statusLine.compare(0, 7, "HTTP/1.") != 0 ||
+		    statusLine[8] != ' ' || !std::isdigit(statusLine[9]) || !std::isdigit(statusLine[10]) ||
+		    !std::isdigit(statusLine[11])) {
+			LOG_WARNING << "Upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+			            << " sent an invalid status line" << std::endl;
+			fail(502, true);
+			return false;
+		}
+		_status = std::atoi(statusLine.c_str() + 9);
+		if (_status >= 100 && _status < 200 && _status != 101) {
+			_head.erase(0, end + 4);
+			continue;
+		}
+		if (_status < 200) {
+			LOG_WARNING << "Upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+			            << " answered with status " << _status << std::endl;
+			fail(502, true);
+			return false;
+		}
+		_reason = (statusLine.length() > 13) ? statusLine.substr(13) : "";
+
+		bool close = (statusLine[7] == '0');   // HTTP/1.0 closes unless told otherwise
+		bool chunked = false;
+		bool hasLength = false;
+		size_t length = 0;
+		size_t pos = lineEnd + 2;
+		while (pos < end) {
+			size_t next = _head.find("\r\n", pos);
+			size_t colon = _head.find(':', pos);
+			if (colon != std::string::npos && colon < next) {
+				std::string name = _head.substr(pos, colon - pos);
+				size_t valueStart = colon + 1;
+				while (valueStart < next && (_head[valueStart] == ' ' || _head[valueStart] == '\t')) {
+					++valueStart;
+				}
+				size_t valueEnd = next;
+				while (valueEnd > valueStart && (_head[valueEnd - 1] == ' ' || _head[valueEnd - 1] == '\t')) {
+					--valueEnd;
+				}
+				std::string value = _head.substr(valueStart, valueEnd - valueStart);
+
+				if (strcasecmp(name.c_str(), "connection") == 0) {
+					close = hasToken(value, "close") || (close && !hasToken(value, "keep-alive"));
+				} else if (strcasecmp(name.c_str(), "transfer-encoding") == 0) {
+					chunked = hasToken(value, "chunked");
+				} else if (!isHopByHop(name)) {
+					if (strcasecmp(name.c_str(), "content-length") == 0) {
+						hasLength = true;
+						length = static_cast<size_t>(std::strtoul(value.c_str(), NULL, 10));
+					}
+					_headers.push_back(std::make_pair(name, value));
+				}
+			}
+			pos = next + 2;
+		}
+
+		if (_headRequest || _status == 204 || _status == 304) {
+			_bodyMode = BODY_NONE;
+		} else if (chunked) {
+			// The body is passed on de-chunked: its length is still unknown
+			_bodyMode = BODY_CHUNKED;
+			for (size_t i = 0; i < _headers.size(); ++i) {
+				if (strcasecmp(_headers[i].first.c_str(), "content-length") == 0) {
+					_headers.erase(_headers.begin() + i);
+					break;
+				}
+			}
+		} else if (hasLength) {
+			_bodyMode = BODY_LENGTH;
+			_remaining = length;
+		} else {
+			_bodyMode = BODY_UNTIL_CLOSE;
+			close = true;
+		}
+		_keepAlive = !close;
+
+		_headDone = true;
+		_state = STATE_READING_BODY;
+		Instance::Get<Upstreams>()->succeeded(_upstream, _peer);
+		LOG_DEBUG << "Upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+		          << " answered " << _status << " (" << _uri << ")" << std::endl;
+
+		std::string rest = _head.substr(end + 4);
+		std::string().swap(_head);
+		if (_bodyMode == BODY_NONE || (_bodyMode == BODY_LENGTH && _remaining == 0)) {
+			finish(rest.empty());
+		} else if (!rest.empty()) {
+			feed(rest.data(), rest.length());
+		}
+		return _state != STATE_FAILED;
+	}
+
+	if (_head.size() > MAX_HEAD) {
+		LOG_WARNING << "Upstream " << Instance::Get<Upstreams>()->getPeerName(_upstream, _peer)
+		            << " sent a response head over " << MAX_HEAD << " bytes" << std::endl;
+		fail(502, true);
+		return false;
+	}
+	return true;
+}
+
+// Body bytes: pass them on, following the framing to find the end
+void Proxy::feed(const char* data, size_t length) {
+	size_t i = 0;
+	while (i < length && _state == STATE_READING_BODY) {
+		if (_bodyMode == BODY_UNTIL_CLOSE) {
+			append(data + i, length - i);
+			return;
+		}
+		if (_bodyMode == BODY_LENGTH || _chunkState == CHUNK_DATA) {
+			size_t take = length - i < _remaining ? length - i : _remaining;
+			append(data + i, take);
+			i += take;
+			_remaining -= take;
+			if (_remaining > 0) {
+				continue;
+			}
+			if (_bodyMode == BODY_LENGTH) {
+				finish(i == length);
+			} else {
+				_chunkState = CHUNK_DATA_END;
+			}
+			continue;
+		}
+
+		// Chunk size line, CRLF after the data, or trailer lines
+		char c = data[i++];
+		if (c != '\n') {
+			_line += c;
+			if (_line.length() > 4096) {
+				LOG_WARNING << "Upstream sent an invalid chunked body (" << _uri << ")" << std::endl;
+				fail(502, true);
+				return;
+			}
+			continue;
+		}
+		if (!_line.empty() && _line[_line.length() - 1] == '\r') {
+			_line.erase(_line.length() - 1);
+		}
+
+		if (_chunkState == CHUNK_SIZE) {
+			char* end = NULL;
+			unsigned long size = std::strtoul(_line.c_str(), &end, 16);
+			if (end == _line.c_str() || (*end != '\0' && *end != ';' && *end != ' ' && *end != '\t')) {
+				LOG_WARNING << "Upstream sent an invalid chunk size (" << _uri << ")" << std::endl;
+				fail(502, true);
+				return;
+			}
+			_remaining = size;
+			_chunkState = (size == 0) ? CHUNK_TRAILER : CHUNK_DATA;
+		} else if (_chunkState == CHUNK_DATA_END) {
+			if (!_line.empty()) {
+				LOG_WARNING << "Upstream sent an invalid chunked body (" << _uri << ")" << std::endl;
+				fail(502, true);
+				return;
+			}
+			_chunkState = CHUNK_SIZE;
+		} else if (_line.empty()) {
+			finish(i == length);   // Last trailer line (trailers are dropped)
+		}
+		_line.clear();
+	}
+}
+
+void Proxy::append(const char* data, size_t length) {
+	if (_bodyOffset == _body.size()) {
+		_body.clear();
+		_bodyOffset = 0;
+	}
+	_body.append(data, length);
+}
+
+// Whole response received: the connection goes back to the pool if the
+// upstream allows it and nothing followed the response
+void Proxy::finish(bool reusable) {
+	Instance::Get<Upstreams>()->release(_upstream, _peer, _fd, reusable && _keepAlive);
+	_fd = -1;
+	_state = STATE_DONE;
+}
+
+// Give up on the current connection; before the response head, try the
+// next peer if sending the request again is safe
+void Proxy::fail(int status, bool peerFault) {
+	Upstreams* upstreams = Instance::Get<Upstreams>();
+	if (_fd >= 0) {
+		upstreams->release(_upstream, _peer, _fd, false);
+		_fd = -1;
+	}
+	if (peerFault) {
+		upstreams->failed(_upstream, _peer);
+	}
+	_errorStatus = status;
+
+	if (!_headDone) {
+		bool stale = _reused && _received == 0;
+		if (stale) {
+			_tried[_peer] = false;   // Same peer again, on another connection
+		}
+		if (stale || _sent == 0 || _idempotent) {
+			connectNext();
+			return;
+		}
+	}
+	_state = STATE_FAILED;
+}
+
+// Response head
+bool Proxy::hasHead() const {
+	return _headDone;
+}
+
+int Proxy::getStatus() const {
+	return _status;
+}
+
+const Proxy::HeaderList& Proxy::getHeaders() const {
+	return _headers;
+}
+
+void Proxy::buildHead(std::string& out, bool chunked) const {
+	std::ostringstream status;
+	status << _status;
+	out = "HTTP/1.1 " + status.str() + " " + _reason + "\r\n";
+
+	bool hasDate = false;
+	for (size_t i = 0; i < _headers.size(); ++i) {
+		if (strcasecmp(_headers[i].first.c_str(), "date") == 0) {
+			hasDate = true;
+		}
+		out += _headers[i].first + ": " + _headers[i].second + "\r\n";
+	}
+	if (!hasDate) {
+		out += std::string("Date: ") + Clock::httpDate() + "\r\n";
+	}
+	if (chunked) {
+		out += "Transfer-Encoding: chunked\r\n";
+	}
+	out += "Connection: close\r\n\r\n";
+}
+
+bool Proxy::hasKnownLength() const {
+	return _bodyMode == BODY_NONE || _bodyMode == BODY_LENGTH;
+}
+
+// Body
+const char* Proxy::data() const {
+	return _body.data() + _bodyOffset;
+}
+
+size_t Proxy::size() const {
+	return _body.size() - _bodyOffset;
+}
+
+void Proxy::consume(size_t bytes) {
+	bool paused = isPaused();
+	_bodyOffset += bytes;
+	if (_bodyOffset >= _body.size()) {
+		_body.clear();
+		_bodyOffset = 0;
+	}
+	// Reading resumes: the read timeout starts over
+	if (paused && !isPaused()) {
+		_deadline = Clock::monotonic() + _readTimeout;
+	}
+}
+
+bool Proxy::isComplete() const {
+	return _state == STATE_DONE;
+}
+
+bool Proxy::hasFailed() const {
+	return _state == STATE_FAILED;
+}
+
+int Proxy::getErrorStatus() const {
+	return _headDone ? 0 : _errorStatus;
+}
+
+} // namespace HTTP
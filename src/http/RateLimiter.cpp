@@ -0,0 +1,298 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RateLimiter.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:48:31 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 16:48:32 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * RateLimiter.cpp
+ * Implementation of the limit_req / limit_conn zones
+ */
+
+#include "includes/http/RateLimiter.hpp"
+#include "includes/config/Config.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include <unistd.h>
+#include <sstream>
+
+namespace HTTP {
+
+namespace {
+	// Dotted quad of an address in network byte order (log messages only)
+	std::string addressString(in_addr_t address) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&address);
+		std::ostringstream out;
+		out << static_cast<int>(bytes[0]) << "." << static_cast<int>(bytes[1]) << "."
+		    << static_cast<int>(bytes[2]) << "." << static_cast<int>(bytes[3]);
+		return out.str();
+	}
+
+	// Seed for the bucket hash: addresses an attacker picks to collide in
+	// one process don't collide in the next
+	unsigned int randomSeed() {
+		double now = Clock::monotonic();
+		unsigned int seed = static_cast<unsigned int>((now - static_cast<long>(now)) * 1e9);
+		return seed ^ (static_cast<unsigned int>(getpid()) << 16) ^ static_cast<unsigned int>(Clock::now());
+	}
+}
+
+// Zone
+
+RateLimiter::Zone::Zone(const LimitZoneSettings& settings, unsigned int seed)
+	: _name(settings.name)
+	, _rate(settings.rate)
+	, _seed(seed)
+	, _head(NONE)
+	, _tail(NONE)
+	, _free(NONE) {
+	size_t count = settings.size / (sizeof(Node) + sizeof(unsigned int));
+	if (count == 0) {
+		count = 1;
+	}
+	unsigned int buckets = 1;
+	while (buckets < count) {
+		buckets <<= 1;
+	}
+	_mask = buckets - 1;
+	_buckets.assign(buckets, NONE);
+
+	// Every node starts on the free list
+	_nodes.resize(count);
+	for (size_t i = count; i-- > 0;) {
+		_nodes[i].next = _free;
+		_free = static_cast<unsigned int>(i);
+	}
+}
+
+// Murmur3 finalizer over the seeded address
+unsigned int RateLimiter::Zone::bucketOf(in_addr_t address) const {
+	unsigned int hash = static_cast<unsigned int>(address) ^ _seed;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash & _mask;
+}
+
+unsigned int RateLimiter::Zone::lookup(in_addr_t address) {
+	unsigned int bucket = bucketOf(address);
+	for (unsigned int i = _buckets[bucket]; i != NONE; i = _nodes[i].hashNext) {
+		if (_nodes[i].address == address) {
+			return i;
+		}
+	}
+
+	// New client: a free node, or the least recently used idle one
+	unsigned int index = _free;
+	if (index != NONE) {
+		_free = _nodes[index].next;
+	} else if (_tail != NONE) {
+		index = _tail;
+		unlink(index);
+		unhash(index);
+	} else {
+		return NONE;
+	}
+
+	Node& node = _nodes[index];
+	node.address = address;
+	node.connections = 0;
+	node.excess = 0;
+	node.last = -1;
+	node.hashNext = _buckets[bucket];
+	_buckets[bucket] = index;
+	pushFront(index);
+	return index;
+}
+
+void RateLimiter::Zone::touch(unsigned int index) {
+	if (_nodes[index].connections == 0 && _head != index) {
+		unlink(index);
+		pushFront(index);
+	}
+}
+
+void RateLimiter::Zone::hold(unsigned int index) {
+	if (_nodes[index].connections++ == 0) {
+		unlink(index);
+	}
+}
+
+void RateLimiter::Zone::unhold(unsigned int index) {
+	if (_nodes[index].connections > 0 && --_nodes[index].connections == 0) {
+		pushFront(index);
+	}
+}
+
+RateLimiter::Node& RateLimiter::Zone::at(unsigned int index) {
+	return _nodes[index];
+}
+
+unsigned long RateLimiter::Zone::rate() const {
+	return _rate;
+}
+
+const std::string& RateLimiter::Zone::name() const {
+	return _name;
+}
+
+void RateLimiter::Zone::unlink(unsigned int index) {
+	Node& node = _nodes[index];
+	if (node.prev != NONE) {
+		_nodes[node.prev].next = node.next;
+	} else {
+		_head = node.next;
+	}
+	if (node.next != NONE) {
+		_nodes[node.next].prev = node.prev;
+	} else {
+		_tail = node.prev;
+	}
+}
+
+void RateLimiter::Zone::pushFront(unsigned int index) {
+	Node& node = _nodes[index];
+	node.prev = NONE;
+	node.next = _head;
+	if (_head != NONE) {
+		_nodes[_head].prev = index;
+	} else {
+		_tail = index;
+	}
+	_head = index;
+}
+
+void RateLimiter::Zone::unhash(unsigned int index) {
+	unsigned int* link = &_buckets[bucketOf(_nodes[index].address)];
+	while (*link != NONE && *link != index) {
+		link = &_nodes[*link].hashNext;
+	}
+	if (*link == index) {
+		*link = _nodes[index].hashNext;
+	}
+}
+
+// RateLimiter
+
+RateLimiter::RateLimiter()
+	: _delayed(0)
+	, _rejected(0) {
+}
+
+RateLimiter::~RateLimiter() {}
+
+void RateLimiter::open(const Config& config) {
+	_zones.clear();
+	const std::vector<LimitZoneSettings>& zones = config.getLimitZones();
+	unsigned int seed = randomSeed();
+	for (size_t i = 0; i < zones.size(); ++i) {
+		_zones.push_back(Zone(zones[i], seed));
+		LOG_DEBUG << (zones[i].requests ? "limit_req_zone " : "limit_conn_zone ") << zones[i].name
+		          << ": " << zones[i].size / (sizeof(Node) + sizeof(unsigned int)) << " clients" << std::endl;
+	}
+}
+
+bool RateLimiter::enabled() const {
+	return !_zones.empty();
+}
+
+// Leaky bucket (as nginx's limit_req): excess drains at the zone's rate and
+// each request adds one; over burst the request is rejected (and not
+// counted), over delay it waits until the excess above delay has drained
+int RateLimiter::limitRequest(const LimitSettings& limits, in_addr_t address, double& delay) {
+	delay = 0;
+	if (limits.requests.empty()) {
+		return 0;
+	}
+
+	long long now = static_cast<long long>(Clock::monotonic() * 1000);
+	for (size_t r = 0; r < limits.requests.size(); ++r) {
+		const LimitReqSettings& limit = limits.requests[r];
+		Zone& zone = _zones[limit.zone];
+		unsigned int index = zone.lookup(address);
+		if (index == NONE) {
+			continue;
+		}
+		zone.touch(index);
+
+		Node& node = zone.at(index);
+		long long excess = 0;
+		if (node.last >= 0) {
+			long long elapsed = now > node.last ? now - node.last : 0;
+			excess = node.excess - static_cast<long long>(zone.rate()) * elapsed / 1000 + 1000;
+			if (excess < 0) {
+				excess = 0;
+			}
+		}
+
+		if (excess > static_cast<long long>(limit.burst) * 1000) {
+			++_rejected;
+			LOG_INFO << "Limiting requests, excess: " << excess / 1000.0 << " by zone \"" << zone.name()
+			         << "\", client: " << addressString(address) << std::endl;
+			return limits.requestStatus;
+		}
+
+		node.excess = static_cast<long>(excess);
+		node.last = now;
+
+		long long over = excess - static_cast<long long>(limit.delay) * 1000;
+		if (over > 0) {
+			double wait = static_cast<double>(over) / zone.rate();
+			if (wait > delay) {
+				delay = wait;
+			}
+		}
+	}
+
+	if (delay > 0) {
+		++_delayed;
+		LOG_DEBUG << "Delaying request from " << addressString(address) << " by "
+		          << delay << "s" << std::endl;
+	}
+	return 0;
+}
+
+int RateLimiter::acquire(const LimitSettings& limits, in_addr_t address, Slots& slots) {
+	for (size_t c = 0; c < limits.connections.size(); ++c) {
+		const LimitConnSettings& limit = limits.connections[c];
+		Zone& zone = _zones[limit.zone];
+		unsigned int index = zone.lookup(address);
+		if (index == NONE || zone.at(index).connections >= limit.max) {
+			release(slots);
+			++_rejected;
+			LOG_INFO << "Limiting connections by zone \"" << zone.name() << "\""
+			         << (index == NONE ? " (zone full)" : "") << ", client: "
+			         << addressString(address) << std::endl;
+			return limits.connectionStatus;
+		}
+		zone.hold(index);
+
+		Slot slot;
+		slot.zone = limit.zone;
+		slot.node = index;
+		slots.push_back(slot);
+	}
+	return 0;
+}
+
+void RateLimiter::release(Slots& slots) {
+	for (size_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].zone < _zones.size()) {
+			_zones[slots[i].zone].unhold(slots[i].node);
+		}
+	}
+	slots.clear();
+}
+
+size_t RateLimiter::getDelayed() const { return _delayed; }
+size_t RateLimiter::getRejected() const { return _rejected; }
+
+} // namespace HTTP
@@ -62,13 +62,13 @@ bool Request::parse(const std::string& rawRequest) {
 
 	// Parse request line (first line)
 	if (!parseRequestLine(lines[0])) {
-		Logger::error << "Failed to parse request line: " << lines[0] << std::endl;
+		LOG_ERROR << "Failed to parse request line: " << lines[0] << std::endl;
 		return false;
 	}
 
 	// Check URI length limit
 	if (_uri.length() > MAX_URI_LENGTH) {
-		Logger::error << "URI too long: " << _uri.length() << " bytes (max: " << MAX_URI_LENGTH << ")" << std::endl;
+		LOG_ERROR << "URI too long: " << _uri.length() << " bytes (max: " << MAX_URI_LENGTH << ")" << std::endl;
 		return false;
 	}
 
@@ -84,18 +84,18 @@ bool Request::parse(const std::string& rawRequest) {
 
 		// Check header count limit
 		if (headerCount >= MAX_HEADERS_COUNT) {
-			Logger::error << "Too many headers: " << headerCount << " (max: " << MAX_HEADERS_COUNT << ")" << std::endl;
+			LOG_ERROR << "Too many headers: " << headerCount << " (max: " << MAX_HEADERS_COUNT << ")" << std::endl;
 			return false;
 		}
 
 		// Check header size limit
 		if (lines[i].length() > MAX_HEADER_SIZE) {
-			Logger::error << "Header too long: " << lines[i].length() << " bytes (max: " << MAX_HEADER_SIZE << ")" << std::endl;
+			LOG_ERROR << "Header too long: " << lines[i].length() << " bytes (max: " << MAX_HEADER_SIZE << ")" << std::endl;
 			return false;
 		}
 
 		if (!parseHeader(lines[i])) {
-			Logger::warning << "Failed to parse header: " << lines[i] << std::endl;
+			LOG_WARNING << "Failed to parse header: " << lines[i] << std::endl;
 		}
 		++headerCount;
 	}
@@ -136,6 +136,47 @@ bool Request::parse(const std::string& rawRequest) {
 	return true;
 }
 
+// Build from already-decoded parts; repeated fields are folded as in HTTP/1.1
+bool Request::assign(const std::string& method, const std::string& uri, const std::string& version,
+                     const std::vector<std::pair<std::string, std::string> >& headers,
+                     const std::string& body) {
+	clear();
+	if (method.empty() || uri.empty() || uri.length() > MAX_URI_LENGTH ||
+	    headers.size() > MAX_HEADERS_COUNT) {
+		return false;
+	}
+
+	_method = method;
+	_uri = uri;
+	_version = version;
+	parseUri(_uri);
+
+	for (size_t i = 0; i < headers.size(); ++i) {
+		std::string name = toLowerCase(headers[i].first);
+		std::map<std::string, std::string>::iterator it = _headers.find(name);
+		if (it == _headers.end()) {
+			_headers[name] = headers[i].second;
+		} else {
+			// Cookies are split into separate fields in HTTP/2 (RFC 7540 section 8.1.2.5)
+			it->second += (name == "cookie" ? "; " : ", ") + headers[i].second;
+		}
+	}
+
+	_body = body;
+	if (hasHeader("content-length")) {
+		_contentLength = static_cast<size_t>(atoi(getHeader("content-length").c_str()));
+	} else {
+		_contentLength = _body.length();
+		if (!_body.empty()) {
+			_headers["content-length"] = static_cast<std::ostringstream&>(
+				std::ostringstream() << _body.length()).str();
+		}
+	}
+	_hasContentLength = true;
+	_complete = true;
+	return true;
+}
+
 // Parse request line (e.g., "GET /path HTTP/1.1")
 bool Request::parseRequestLine(const std::string& line) {
 	std::istringstream iss(line);
@@ -222,7 +263,7 @@ std::string Request::decodeChunkedBody(const std::string& chunkedData) {
 }
 
 // URL decode (convert %XX to characters)
-std::string Request::urlDecode(const std::string& str) const {
+std::string Request::urlDecode(const std::string& str) {
 	std::string result;
 	result.reserve(str.length());
 
@@ -309,6 +350,14 @@ bool Request::isChunked() const {
 	return _isChunked;
 }
 
+void Request::setRemoteAddr(const std::string& addr) {
+	_remoteAddr = addr;
+}
+
+const std::string& Request::getRemoteAddr() const {
+	return _remoteAddr;
+}
+
 bool Request::keepAlive() const {
 	std::string connection = getHeader("connection");
 
@@ -321,6 +370,37 @@ bool Request::keepAlive() const {
 	return (toLowerCase(connection) == "keep-alive");
 }
 
+// Check if a content-coding is acceptable (e.g. "gzip;q=0.8, br")
+bool Request::acceptsEncoding(const std::string& coding) const {
+	std::string header = toLowerCase(getHeader("accept-encoding"));
+	if (header.empty()) {
+		return false;
+	}
+
+	bool wildcard = false;
+	std::istringstream stream(header);
+	std::string item;
+
+	while (std::getline(stream, item, ',')) {
+		std::string name = trim(item.substr(0, item.find(';')));
+		double quality = 1.0;
+
+		size_t qPos = item.find("q=");
+		if (qPos != std::string::npos) {
+			quality = strtod(item.c_str() + qPos + 2, NULL);
+		}
+
+		if (name == coding || (coding == "gzip" && name == "x-gzip")) {
+			return quality > 0;
+		}
+		if (name == "*") {
+			wildcard = quality > 0;
+		}
+	}
+
+	return wildcard;
+}
+
 // Parse query string into key-value pairs
 std::map<std::string, std::string> Request::getQueryParams() const {
 	std::map<std::string, std::string> params;
@@ -455,6 +535,7 @@ void Request::clear() {
 	_version.clear();
 	_headers.clear();
 	_body.clear();
+	_remoteAddr.clear();
 	_complete = false;
 	_contentLength = 0;
 	_hasContentLength = false;
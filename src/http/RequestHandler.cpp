@@ -15,97 +15,144 @@
  * Implementation of HTTP Request Handler
  */
 #include "includes/http/RequestHandler.hpp"
+#include "includes/http/GzipCache.hpp"
+#include "includes/http/DirectoryIndex.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/http/ErrorPages.hpp"
 #include "includes/cgi/CGIExecutor.hpp"
+#include "includes/cgi/Cache.hpp"
 #include "includes/core/Settings.hpp"
 #include "includes/core/Instance.hpp"
 #include "includes/utils/Logger.hpp"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <dirent.h>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <ctime>
 #include <vector>
+#include <cstdlib>
 
 namespace HTTP {
 
 // Constructor
 RequestHandler::RequestHandler(const Server* server)
-	: _server(server) {
+	: _server(server)
+	, _route(NULL) {
 }
 
 RequestHandler::~RequestHandler() {}
 
 // Handle request
 Response RequestHandler::handle(const Request& request) {
-	Logger::info << "Handling " << request.getMethod() << " " << request.getPath() << std::endl;
+	LOG_INFO << "Handling " << request.getMethod() << " " << request.getPath() << std::endl;
 
 	// First, check if method is recognized (GET, POST, DELETE)
-	std::string method = request.getMethod();
-	if (method != "GET" && method != "POST" && method != "DELETE") {
-		Logger::warning << "Unknown method: " << method << std::endl;
-		return notImplemented(method);
+	Route::Method method = Route::methodFromString(request.getMethod());
+	if (method == Route::METHOD_NONE) {
+		LOG_WARNING << "Unknown method: " << request.getMethod() << std::endl;
+		return notImplemented(request.getMethod());
 	}
 
 	// Find matching route
 	const Route* route = _server->matchRoute(request.getPath());
+	_route = route;
 	if (!route) {
-		Logger::warning << "No route found for path: " << request.getPath() << std::endl;
+		LOG_WARNING << "No route found for path: " << request.getPath() << std::endl;
 		return notFound(request.getPath());
 	}
 
 	// Check if method is allowed
-	if (!route->isMethodAllowed(request.getMethod())) {
-		Logger::warning << "Method " << request.getMethod() << " not allowed for path: "
-		                << request.getPath() << std::endl;
+	if (!route->isMethodAllowed(method)) {
+		LOG_WARNING << "Method " << request.getMethod() << " not allowed for path: "
+		            << request.getPath() << std::endl;
 		return methodNotAllowed(request.getMethod());
 	}
 
 	// Check for redirect
 	if (!route->getRedirect().empty()) {
-		Logger::info << "Redirecting to: " << route->getRedirect() << std::endl;
+		LOG_INFO << "Redirecting to: " << route->getRedirect() << std::endl;
 		return Response::redirect(route->getRedirect(), 301);
 	}
 
+	// Metrics location (stub_status)
+	if (route->isStubStatus()) {
+		Response response;
+		response.setContentType("text/plain; version=0.0.4; charset=utf-8");
+		response.setCacheControl("no-store");
+		response.setBody(Instance::Get<Metrics>()->render());
+		return response;
+	}
+
 	// Handle based on method
-	if (request.getMethod() == "GET") {
-		return handleGet(request, route);
-	} else if (request.getMethod() == "POST") {
-		return handlePost(request, route);
-	} else if (request.getMethod() == "DELETE") {
-		return handleDelete(request, route);
-	} else {
-		return notImplemented(request.getMethod());
+	switch (method) {
+		case Route::METHOD_GET:
+			return handleGet(request, route);
+		case Route::METHOD_POST:
+			return handlePost(request, route);
+		case Route::METHOD_DELETE:
+			return handleDelete(request, route);
+		default:
+			return notImplemented(request.getMethod());
 	}
 }
 
+// Evaluate a request before its body is received (Expect: 100-continue)
+// Applies the same route, method and size rules as handle() so that a
+// rejected upload fails before any body bytes are transferred
+bool RequestHandler::acceptsBody(const Request& request, Response& rejection) {
+	Route::Method method = Route::methodFromString(request.getMethod());
+	if (method == Route::METHOD_NONE) {
+		rejection = notImplemented(request.getMethod());
+		return false;
+	}
+
+	const Route* route = _server->matchRoute(request.getPath());
+	_route = route;
+	if (!route) {
+		rejection = notFound(request.getPath());
+		return false;
+	}
+
+	if (!route->isMethodAllowed(method)) {
+		rejection = methodNotAllowed(request.getMethod());
+		return false;
+	}
+
+	if (request.getContentLength() > _server->getMaxBodySize()) {
+		LOG_DEBUG << "413: " << request.getContentLength() << " bytes (max: "
+		          << _server->getMaxBodySize() << ")" << std::endl;
+		rejection = errorPage(413);
+		return false;
+	}
+
+	// Multipart uploads are only accepted where uploads (or CGI) are enabled
+	if (method == Route::METHOD_POST && request.isMultipart() && !route->isUploadEnabled() &&
+	    !isCgiScript(resolveFilePath(request.getPath(), route), route)) {
+		rejection = Response::errorResponse(403, "File upload is not allowed for this resource");
+		return false;
+	}
+
+	return true;
+}
+
+const Route* RequestHandler::getRoute() const {
+	return _route;
+}
+
 // Handle GET request
 Response RequestHandler::handleGet(const Request& request, const Route* route) {
 	std::string filePath = resolveFilePath(request.getPath(), route);
 
-	Logger::debug << "Resolved file path: " << filePath << std::endl;
+	LOG_DEBUG << "Resolved file path: " << filePath << std::endl;
 
 	// Check if CGI is enabled and file extension matches
-	if (route->isCgiEnabled()) {
-		std::string ext = getFileExtension(filePath);
-		std::string cgiExt = route->getCgiExtension();
-
-		// Normalize extensions (add dot if missing)
-		if (!ext.empty() && ext[0] != '.') {
-			ext = "." + ext;
-		}
-		if (!cgiExt.empty() && cgiExt[0] != '.') {
-			cgiExt = "." + cgiExt;
-		}
-
-		if (ext == cgiExt) {
-			// This is a CGI script
-			if (fileExists(filePath)) {
-				return handleCGI(request, route, filePath);
-			} else {
-				return notFound(request.getPath());
-			}
+	if (isCgiScript(filePath, route)) {
+		if (fileExists(filePath)) {
+			return handleCGI(request, route, filePath);
+		} else {
+			return notFound(request.getPath());
 		}
 	}
 
@@ -118,12 +165,12 @@ Response RequestHandler::handleGet(const Request& request, const Route* route) {
 	if (isDirectory(filePath)) {
 		// Try index files first
 		const std::vector<std::string>& indexFiles = route->getIndexFiles();
+		std::string directory = filePath;
+		if (directory[directory.length() - 1] != '/') {
+			directory += "/";
+		}
 		for (size_t i = 0; i < indexFiles.size(); ++i) {
-			std::string indexPath = filePath;
-			if (indexPath[indexPath.length() - 1] != '/') {
-				indexPath += "/";
-			}
-			indexPath += indexFiles[i];
+			std::string indexPath = directory + indexFiles[i];
 
 			if (fileExists(indexPath) && !isDirectory(indexPath)) {
 				filePath = indexPath;
@@ -134,121 +181,299 @@ Response RequestHandler::handleGet(const Request& request, const Route* route) {
 		// If still a directory, check if autoindex is enabled
 		if (isDirectory(filePath)) {
 			if (route->isDirectoryListingEnabled()) {
-				// Generate directory listing
-				Response response;
-				response.setStatus(200);
-				response.setContentType("text/html");
-				response.setBody(generateDirectoryListing(filePath, request.getPath()));
-				return response;
+				return directoryListing(request, route, filePath);
 			} else {
 				return forbidden("Directory listing is disabled");
 			}
 		}
 	}
 
-	// Read file
-	std::string content = readFile(filePath);
-	if (content.empty() && !fileExists(filePath)) {
+	if (!hasReadPermission(filePath)) {
+		return forbidden("Permission denied");
+	}
+
+	struct stat fileStat;
+	if (stat(filePath.c_str(), &fileStat) != 0) {
 		return internalServerError("Failed to read file");
 	}
 
+	// Set content type based on file extension (looked up in place, no copy)
+	size_t nameStart = filePath.rfind('/') + 1;
+	size_t dot = filePath.rfind('.');
+	size_t extensionStart = (dot == std::string::npos || dot < nameStart) ? filePath.length() : dot + 1;
+	Settings* settings = Instance::Get<Settings>();
+	const std::string& contentType = settings->httpMimeType(filePath.data() + extensionStart,
+	                                                        filePath.length() - extensionStart,
+	                                                        route->getDefaultType());
+
+	// Pick the representation: precompressed .gz sidecar, on-the-fly gzip or identity
+	std::string servePath = filePath;
+	SharedBuffer compressed;
+	bool onTheFly = false;
+	bool varies = false;
+
+	if (route->isGzipStaticEnabled()) {
+		std::string gzPath = filePath + ".gz";
+		struct stat gzStat;
+		if (stat(gzPath.c_str(), &gzStat) == 0 && S_ISREG(gzStat.st_mode)) {
+			varies = true;
+			if (request.acceptsEncoding("gzip") && hasReadPermission(gzPath)) {
+				servePath = gzPath;
+				fileStat = gzStat;
+			}
+		}
+	}
+	size_t fileSize = static_cast<size_t>(fileStat.st_size);
+	if (servePath == filePath && route->isGzipEnabled() && route->isGzipType(contentType) &&
+	    fileSize >= route->getGzipMinLength()) {
+		varies = true;
+		// Too large to deflate in the event loop or to keep cached: serve identity
+		if (request.acceptsEncoding("gzip") && fileSize <= route->getGzipMaxLength() &&
+		    fileSize <= Instance::Get<GzipCache>()->getCapacity()) {
+			onTheFly = gzipVariant(filePath, fileStat, route->getGzipCompLevel(), compressed);
+		}
+	}
+	bool encoded = onTheFly || servePath != filePath;
+
 	// Build response
 	Response response;
 	response.setStatus(200);
-
-	// Set content type based on file extension
-	std::string extension = getFileExtension(filePath);
-	Settings* settings = Instance::Get<Settings>();
-	response.setContentType(settings->httpMimeType(extension));
+	response.setContentType(contentType);
+	if (!onTheFly) {
+		response.setHeader("Accept-Ranges", "bytes");
+	}
+	if (varies) {
+		response.setHeader("Vary", "Accept-Encoding");
+	}
+	if (encoded) {
+		response.setHeader("Content-Encoding", "gzip");
+	}
 
 	// Add cache headers
-	struct stat fileStat;
-	if (stat(filePath.c_str(), &fileStat) == 0) {
-		// Set Last-Modified header
-		response.setLastModified(fileStat.st_mtime);
-
-		// Generate and set ETag (based on inode, mtime, and size)
-		response.setETag(generateETag(filePath));
-
-		// Check If-None-Match (ETag validation)
-		if (request.hasHeader("if-none-match")) {
-			std::string clientETag = request.getHeader("if-none-match");
-			std::string serverETag = "\"" + generateETag(filePath) + "\"";
-			if (clientETag == serverETag) {
-				// File hasn't changed, return 304 Not Modified
-				Response notModified;
-				notModified.setStatus(304);
-				notModified.setKeepAlive(false);
-				return notModified;
+	response.setLastModified(fileStat.st_mtime);
+
+	// Generate and set ETag (based on inode, mtime, and size)
+	// Each encoding of the file gets its own ETag
+	std::string etag = generateETag(servePath);
+	if (onTheFly) {
+		etag += "-gz";
+	}
+	response.setETag(etag);
+
+	// Check If-None-Match (ETag validation)
+	if (request.hasHeader("if-none-match")) {
+		std::string clientETag = request.getHeader("if-none-match");
+		std::string serverETag = "\"" + etag + "\"";
+		if (clientETag == serverETag) {
+			// File hasn't changed, return 304 Not Modified
+			Response notModified;
+			notModified.setStatus(304);
+			if (varies) {
+				notModified.setHeader("Vary", "Accept-Encoding");
 			}
+			notModified.setKeepAlive(false);
+			return notModified;
 		}
+	}
 
-		// Check If-Modified-Since
-		if (request.hasHeader("if-modified-since")) {
-			// For simplicity, we'll skip date parsing
-			// In production, you'd parse the date and compare with fileStat.st_mtime
+	// Check If-Modified-Since
+	if (request.hasHeader("if-modified-since")) {
+		// For simplicity, we'll skip date parsing
+		// In production, you'd parse the date and compare with fileStat.st_mtime
+	}
+
+	// Set Cache-Control header based on file type
+	// HTML files with dynamic content should not be cached
+	if (contentType == "text/html") {
+		// Disable cache for HTML files (they often contain dynamic JavaScript)
+		response.setCacheControl("no-cache, no-store, must-revalidate");
+		response.setHeader("Pragma", "no-cache");
+		response.setHeader("Expires", "0");
+	} else {
+		// Cache static resources (CSS, JS, images, etc.) for 1 hour
+		response.setCacheControl("public, max-age=3600");
+	}
+
+	response.setKeepAlive(false); // For now, always close connection
+
+	// Compressed on the fly: the cached variant is sent as is, ranges don't apply
+	if (onTheFly) {
+		response.appendSegment(compressed);
+		LOG_SUCCESS << "Served file: " << filePath << " (gzip, " << fileStat.st_size
+		            << " -> " << compressed.size() << " bytes)" << std::endl;
+		return response;
+	}
+
+	response.setFile(servePath);
+
+	// Range request: only honoured if If-Range (when present) still matches
+	if (request.hasHeader("range") && ifRangeMatches(request, etag, fileStat.st_mtime)) {
+		std::vector<ByteRange> ranges;
+		int result = parseRangeHeader(request.getHeader("range"), fileStat.st_size, ranges);
+		if (result < 0) {
+			LOG_INFO << "Unsatisfiable range for " << servePath << ": "
+			         << request.getHeader("range") << std::endl;
+			Response unsatisfiable = errorPage(416);
+			std::ostringstream contentRange;
+			contentRange << "bytes */" << fileStat.st_size;
+			unsatisfiable.setHeader("Content-Range", contentRange.str());
+			return unsatisfiable;
+		}
+		if (result > 0) {
+			return serveRanges(response, servePath, fileStat.st_size, contentType, ranges);
+		}
+	}
+
+	// Whole file, sent zero-copy by the connection
+	if (fileStat.st_size > 0) {
+		response.appendFileRange(0, static_cast<size_t>(fileStat.st_size));
+	}
+
+	LOG_SUCCESS << "Served file: " << servePath << " (" << fileStat.st_size << " bytes)" << std::endl;
+
+	return response;
+}
+
+// Parse a Range header against the file size
+// Returns 1 with ranges filled, 0 to ignore the header (serve the whole file)
+// or -1 if no range is satisfiable (416)
+int RequestHandler::parseRangeHeader(const std::string& header, off_t fileSize,
+                                     std::vector<ByteRange>& ranges) {
+	const std::string unit = "bytes=";
+	if (header.length() <= unit.length() || header.compare(0, unit.length(), unit) != 0) {
+		return 0; // Unknown range unit
+	}
+
+	std::istringstream stream(header.substr(unit.length()));
+	std::string spec;
+	size_t specCount = 0;
+
+	while (std::getline(stream, spec, ',')) {
+		// Trim whitespace
+		size_t start = spec.find_first_not_of(" \t");
+		size_t end = spec.find_last_not_of(" \t");
+		if (start == std::string::npos) {
+			continue;
+		}
+		spec = spec.substr(start, end - start + 1);
+
+		if (++specCount > MAX_RANGES) {
+			return 0; // Too many ranges, serve the whole file instead
+		}
+
+		size_t dash = spec.find('-');
+		if (dash == std::string::npos) {
+			return 0;
+		}
+		std::string firstStr = spec.substr(0, dash);
+		std::string lastStr = spec.substr(dash + 1);
+		if (firstStr.find_first_not_of("0123456789") != std::string::npos ||
+		    lastStr.find_first_not_of("0123456789") != std::string::npos ||
+		    (firstStr.empty() && lastStr.empty())) {
+			return 0; // Syntactically invalid: ignore the whole header
 		}
 
-		// Set Cache-Control header based on file type
-		// HTML files with dynamic content should not be cached
-		if (extension == "html" || extension == "htm") {
-			// Disable cache for HTML files (they often contain dynamic JavaScript)
-			response.setCacheControl("no-cache, no-store, must-revalidate");
-			response.setHeader("Pragma", "no-cache");
-			response.setHeader("Expires", "0");
+		ByteRange range;
+		if (firstStr.empty()) {
+			// Suffix range: last N bytes
+			off_t suffix = static_cast<off_t>(strtoll(lastStr.c_str(), NULL, 10));
+			if (suffix == 0 || fileSize == 0) {
+				continue; // Unsatisfiable
+			}
+			range.first = (suffix >= fileSize) ? 0 : fileSize - suffix;
+			range.last = fileSize - 1;
 		} else {
-			// Cache static resources (CSS, JS, images, etc.) for 1 hour
-			response.setCacheControl("public, max-age=3600");
+			range.first = static_cast<off_t>(strtoll(firstStr.c_str(), NULL, 10));
+			range.last = lastStr.empty() ? fileSize - 1
+			                             : static_cast<off_t>(strtoll(lastStr.c_str(), NULL, 10));
+			if (!lastStr.empty() && range.last < range.first) {
+				return 0;
+			}
+			if (range.first >= fileSize) {
+				continue; // Unsatisfiable
+			}
+			if (range.last >= fileSize) {
+				range.last = fileSize - 1;
+			}
 		}
+		ranges.push_back(range);
 	}
 
-	response.setBody(content);
-	response.setKeepAlive(false); // For now, always close connection
+	if (specCount == 0) {
+		return 0;
+	}
+	return ranges.empty() ? -1 : 1;
+}
+
+// If-Range: the range applies only if the validator still matches
+// (strong ETag comparison, or exact Last-Modified date)
+bool RequestHandler::ifRangeMatches(const Request& request, const std::string& etag, time_t mtime) {
+	if (!request.hasHeader("if-range")) {
+		return true;
+	}
+
+	std::string validator = request.getHeader("if-range");
+	if (!validator.empty() && validator[0] == '"') {
+		return validator == "\"" + etag + "\"";
+	}
+	if (validator.compare(0, 2, "W/") == 0) {
+		return false; // Weak validators never match for ranges
+	}
+	return validator == Response::formatHttpDate(mtime);
+}
+
+// Build a 206 response: one range as-is, several as multipart/byteranges
+Response RequestHandler::serveRanges(Response& response, const std::string& filePath, off_t fileSize,
+                                     const std::string& contentType, const std::vector<ByteRange>& ranges) {
+	response.setStatus(206);
 
-	Logger::success << "Served file: " << filePath << " (" << content.length() << " bytes)" << std::endl;
+	if (ranges.size() == 1) {
+		std::ostringstream contentRange;
+		contentRange << "bytes " << ranges[0].first << "-" << ranges[0].last << "/" << fileSize;
+		response.setHeader("Content-Range", contentRange.str());
+		response.appendFileRange(ranges[0].first, static_cast<size_t>(ranges[0].last - ranges[0].first + 1));
+	} else {
+		std::ostringstream boundaryStream;
+		boundaryStream << "webserv_" << std::hex << time(NULL) << fileSize;
+		std::string boundary = boundaryStream.str();
+
+		response.setContentType("multipart/byteranges; boundary=" + boundary);
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			std::ostringstream partHead;
+			partHead << "\r\n--" << boundary << "\r\n"
+			         << "Content-Type: " << contentType << "\r\n"
+			         << "Content-Range: bytes " << ranges[i].first << "-" << ranges[i].last
+			         << "/" << fileSize << "\r\n\r\n";
+			response.appendSegment(partHead.str());
+			response.appendFileRange(ranges[i].first, static_cast<size_t>(ranges[i].last - ranges[i].first + 1));
+		}
+		response.appendSegment("\r\n--" + boundary + "--\r\n");
+	}
+
+	LOG_SUCCESS << "Served " << ranges.size() << " range(s) of " << filePath << std::endl;
 
 	return response;
 }
 
 // Handle POST request
 Response RequestHandler::handlePost(const Request& request, const Route* route) {
-	Logger::info << "POST request - Content-Type: " << request.getContentType() << std::endl;
+	LOG_INFO << "POST request - Content-Type: " << request.getContentType() << std::endl;
 
 	// Check if this is a CGI request (before other handlers)
-	if (route->isCgiEnabled()) {
-		// Check if file extension matches CGI extension
-		std::string path = resolveFilePath(request.getPath(), route);
-		std::string ext = getFileExtension(path);
-		std::string cgiExt = route->getCgiExtension();
-
-		// Normalize extensions (add dot if missing)
-		if (!ext.empty() && ext[0] != '.') {
-			ext = "." + ext;
-		}
-		if (!cgiExt.empty() && cgiExt[0] != '.') {
-			cgiExt = "." + cgiExt;
-		}
-
-		if (ext == cgiExt) {
-			// This is a CGI script
-			if (fileExists(path)) {
-				return handleCGI(request, route, path);
-			} else {
-				return notFound(request.getPath());
-			}
+	std::string path = resolveFilePath(request.getPath(), route);
+	if (isCgiScript(path, route)) {
+		if (fileExists(path)) {
+			return handleCGI(request, route, path);
+		} else {
+			return notFound(request.getPath());
 		}
 	}
 
 	// Check if this is a POST to a static file (should return 405)
 	// Do this check BEFORE handling form data or other generic handlers
-	std::string resolvedPath = resolveFilePath(request.getPath(), route);
-	if (fileExists(resolvedPath) && !isDirectory(resolvedPath)) {
+	if (fileExists(path) && !isDirectory(path)) {
 		// This is an existing file - check if it's a static file
-		std::string ext = getFileExtension(resolvedPath);
-		// Common static file extensions
-		if (ext == "html" || ext == "htm" || ext == "css" || ext == "js" ||
-		    ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "gif" ||
-		    ext == "txt" || ext == "pdf" || ext == "ico") {
+		if (isStaticExtension(getFileExtension(path))) {
 			// This is a static file with no POST handler (not CGI, not upload)
 			return methodNotAllowed(request.getMethod());
 		}
@@ -299,7 +524,7 @@ Response RequestHandler::handlePost(const Request& request, const Route* route)
 Response RequestHandler::handleFormData(const Request& request, const Route* /* route */) {
 	std::map<std::string, std::string> formData = request.getFormData();
 
-	Logger::info << "Form data received with " << formData.size() << " fields" << std::endl;
+	LOG_INFO << "Form data received with " << formData.size() << " fields" << std::endl;
 
 	Response response;
 	response.setStatus(200);
@@ -317,7 +542,7 @@ Response RequestHandler::handleFormData(const Request& request, const Route* /*
 	for (std::map<std::string, std::string>::const_iterator it = formData.begin();
 	     it != formData.end(); ++it) {
 		body << "<tr><td>" << it->first << "</td><td>" << it->second << "</td></tr>\n";
-		Logger::debug << "  " << it->first << " = " << it->second << std::endl;
+		LOG_DEBUG << "  " << it->first << " = " << it->second << std::endl;
 	}
 
 	body << "</table>\n"
@@ -337,7 +562,7 @@ Response RequestHandler::handleFileUpload(const Request& request, const Route* r
 		return Response::errorResponse(400, "Missing boundary in multipart/form-data");
 	}
 
-	Logger::info << "File upload - boundary: " << boundary << std::endl;
+	LOG_INFO << "File upload - boundary: " << boundary << std::endl;
 
 	// Parse multipart data
 	std::vector<UploadedFile> files = parseMultipartData(request.getBody(), boundary);
@@ -358,7 +583,7 @@ Response RequestHandler::handleFileUpload(const Request& request, const Route* r
 		std::string savedPath = saveUploadedFile(files[i].content, files[i].filename, uploadDir);
 		if (!savedPath.empty()) {
 			savedPaths.push_back(savedPath);
-			Logger::success << "Saved uploaded file: " << savedPath << std::endl;
+			LOG_SUCCESS << "Saved uploaded file: " << savedPath << std::endl;
 		}
 	}
 
@@ -446,7 +671,7 @@ Response RequestHandler::handleFileUpload(const Request& request, const Route* r
 Response RequestHandler::handleDelete(const Request& request, const Route* route) {
 	std::string filePath = resolveFilePath(request.getPath(), route);
 
-	Logger::debug << "Attempting to delete: " << filePath << std::endl;
+	LOG_DEBUG << "Attempting to delete: " << filePath << std::endl;
 
 	// Check if file exists
 	if (!fileExists(filePath)) {
@@ -465,7 +690,7 @@ Response RequestHandler::handleDelete(const Request& request, const Route* route
 
 	// Try to delete file
 	if (unlink(filePath.c_str()) == 0) {
-		Logger::success << "Deleted file: " << filePath << std::endl;
+		LOG_SUCCESS << "Deleted file: " << filePath << std::endl;
 
 		// Return 204 No Content (preferred for DELETE)
 		Response response;
@@ -473,39 +698,31 @@ Response RequestHandler::handleDelete(const Request& request, const Route* route
 		response.setKeepAlive(false);
 		return response;
 	} else {
-		Logger::error << "Failed to delete file: " << filePath << std::endl;
+		LOG_ERROR << "Failed to delete file: " << filePath << std::endl;
 		return Response::errorResponse(500, "Failed to delete file");
 	}
 }
 
-// Resolve file path
+// Resolve file path (root and prefix come precomputed from the route)
 std::string RequestHandler::resolveFilePath(const std::string& requestPath, const Route* route) {
-	std::string root = route->getRoot();
-	std::string routePath = route->getPath();
-
-	Logger::debug << "resolveFilePath: requestPath='" << requestPath
-	              << "', root='" << root
-	              << "', routePath='" << routePath << "'" << std::endl;
+	std::string fullPath = route->resolvePath(requestPath);
 
-	// Remove route prefix from request path
-	std::string relativePath = requestPath;
-	if (relativePath.compare(0, routePath.length(), routePath) == 0) {
-		relativePath = relativePath.substr(routePath.length());
-	}
+	LOG_DEBUG << "resolveFilePath: '" << requestPath << "' -> '" << fullPath << "'" << std::endl;
 
-	Logger::debug << "relativePath after prefix removal: '" << relativePath << "'" << std::endl;
+	return fullPath;
+}
 
-	// Build full path
-	std::string fullPath = root;
-	if (!fullPath.empty() && fullPath[fullPath.length() - 1] != '/' &&
-	    (relativePath.empty() || relativePath[0] != '/')) {
-		fullPath += "/";
+// Extensions that only ever name static content (POST to them is a 405)
+bool RequestHandler::isStaticExtension(const std::string& extension) {
+	static const char* const extensions[] = {
+		"html", "htm", "css", "js", "jpg", "jpeg", "png", "gif", "txt", "pdf", "ico"
+	};
+	for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i) {
+		if (extension == extensions[i]) {
+			return true;
+		}
 	}
-	fullPath += relativePath;
-
-	Logger::debug << "Final fullPath: '" << fullPath << "'" << std::endl;
-
-	return fullPath;
+	return false;
 }
 
 // Get file extension
@@ -532,71 +749,63 @@ bool RequestHandler::isDirectory(const std::string& path) {
 }
 
 // Read file content
-std::string RequestHandler::readFile(const std::string& path) {
+bool RequestHandler::readFile(const std::string& path, std::string& content) {
 	std::ifstream file(path.c_str(), std::ios::binary);
 	if (!file.is_open()) {
-		return "";
+		return false;
 	}
 
 	std::ostringstream buffer;
 	buffer << file.rdbuf();
+	if (file.bad()) {
+		return false;
+	}
 	file.close();
 
-	return buffer.str();
+	content = buffer.str();
+	return true;
 }
 
-// Generate directory listing HTML
-std::string RequestHandler::generateDirectoryListing(const std::string& dirPath, const std::string& requestPath) {
-	std::ostringstream html;
-
-	html << "<!DOCTYPE html>\n"
-	     << "<html>\n"
-	     << "<head><title>Index of " << requestPath << "</title></head>\n"
-	     << "<body>\n"
-	     << "<h1>Index of " << requestPath << "</h1>\n"
-	     << "<hr>\n"
-	     << "<ul>\n";
-
-	// Add parent directory link if not root
-	if (requestPath != "/") {
-		html << "<li><a href=\"../\">../</a></li>\n";
+// Directory listing: one page of the cached listing, sorted and paged by
+// the query string (sort=name|type, order=asc|desc, offset, limit)
+Response RequestHandler::directoryListing(const Request& request, const Route* route, const std::string& dirPath) {
+	struct stat dirStat;
+	if (stat(dirPath.c_str(), &dirStat) != 0) {
+		return notFound(dirPath);
 	}
 
-	// Open directory
-	DIR* dir = opendir(dirPath.c_str());
-	if (dir) {
-		struct dirent* entry;
-		while ((entry = readdir(dir)) != NULL) {
-			std::string name = entry->d_name;
-
-			// Skip . and ..
-			if (name == "." || name == "..") {
-				continue;
-			}
-
-			// Check if it's a directory
-			std::string fullPath = dirPath;
-			if (fullPath[fullPath.length() - 1] != '/') {
-				fullPath += "/";
-			}
-			fullPath += name;
-
-			if (isDirectory(fullPath)) {
-				html << "<li><a href=\"" << name << "/\">" << name << "/</a></li>\n";
-			} else {
-				html << "<li><a href=\"" << name << "\">" << name << "</a></li>\n";
-			}
+	DirectoryIndex::Page page;
+	std::map<std::string, std::string> params = request.getQueryParams();
+	std::map<std::string, std::string>::const_iterator it;
+	if ((it = params.find("sort")) != params.end() && it->second == "type") {
+		page.sort = DirectoryIndex::SORT_TYPE;
+	}
+	if ((it = params.find("order")) != params.end() && it->second == "desc") {
+		page.descending = true;
+	}
+	if ((it = params.find("offset")) != params.end()) {
+		page.offset = std::strtoul(it->second.c_str(), NULL, 10);
+	}
+	if ((it = params.find("limit")) != params.end()) {
+		size_t limit = std::strtoul(it->second.c_str(), NULL, 10);
+		if (limit > 0) {
+			page.limit = std::min(limit, DirectoryIndex::MAX_LIMIT);
 		}
-		closedir(dir);
 	}
 
-	html << "</ul>\n"
-	     << "<hr>\n"
-	     << "<p><em>webserv/1.0</em></p>\n"
-	     << "</body>\n"
-	     << "</html>\n";
+	Response response;
+	response.setStatus(200);
+	DirectoryIndex::Format format = route->isDirectoryListingJson() ? DirectoryIndex::FORMAT_JSON
+	                                                                : DirectoryIndex::FORMAT_HTML;
+	if (!Instance::Get<DirectoryIndex>()->render(dirPath, dirStat, request.getPath(), format, page, response)) {
+		return forbidden("Cannot read directory: " + dirPath);
+	}
+	return response;
+}
 
-	return html.str();
+// Check if a resolved path is a CGI script for this route
+bool RequestHandler::isCgiScript(const std::string& filePath, const Route* route) {
+	return route->isCgiEnabled() && route->matchesCgiExtension(filePath);
 }
 
 // Check write permission
@@ -622,6 +831,30 @@ std::string RequestHandler::generateETag(const std::string& filePath) {
 	return etag.str();
 }
 
+// Get the gzip variant of a file, compressing each file version only once
+bool RequestHandler::gzipVariant(const std::string& filePath, const struct stat& fileStat,
+                                 int level, SharedBuffer& compressed) {
+	GzipCache* cache = Instance::Get<GzipCache>();
+
+	if (cache->find(fileStat, level, compressed)) {
+		return true;
+	}
+
+	// A failed or short read (file changed under us) must not be cached
+	std::string content;
+	if (!readFile(filePath, content) || content.size() != static_cast<size_t>(fileStat.st_size)) {
+		return false;
+	}
+
+	std::string output;
+	if (!GzipCache::compress(content, output, level)) {
+		return false;
+	}
+	compressed.adopt(output);
+	cache->insert(fileStat, level, compressed);
+	return true;
+}
+
 // Save uploaded file
 std::string RequestHandler::saveUploadedFile(const std::string& content, const std::string& filename, const std::string& uploadDir) {
 	// Create upload directory if it doesn't exist
@@ -641,7 +874,7 @@ std::string RequestHandler::saveUploadedFile(const std::string& content, const s
 	// Write file
 	std::ofstream file(fullPath.c_str(), std::ios::binary);
 	if (!file.is_open()) {
-		Logger::error << "Failed to create file: " << fullPath << std::endl;
+		LOG_ERROR << "Failed to create file: " << fullPath << std::endl;
 		return "";
 	}
 
@@ -741,7 +974,7 @@ std::vector<RequestHandler::UploadedFile> RequestHandler::parseMultipartData(con
 			file.content = content;
 			files.push_back(file);
 
-			Logger::debug << "Parsed file: " << filename << " (" << content.length() << " bytes)" << std::endl;
+			LOG_DEBUG << "Parsed file: " << filename << " (" << content.length() << " bytes)" << std::endl;
 		}
 
 		pos = nextPos;
@@ -752,7 +985,12 @@ std::vector<RequestHandler::UploadedFile> RequestHandler::parseMultipartData(con
 
 // Handle CGI request
 Response RequestHandler::handleCGI(const Request& request, const Route* route, const std::string& scriptPath) {
-	Logger::info << "Executing CGI script: " << scriptPath << std::endl;
+	LOG_INFO << "Executing CGI script: " << scriptPath << std::endl;
+
+	// cgi_cache: answered from the cache when possible
+	if (route->getCgiCache().enabled) {
+		return Instance::Get<CGI::Cache>()->serve(request, _server, route, scriptPath);
+	}
 
 	// Create CGI executor
 	CGI::Executor executor;
@@ -761,131 +999,35 @@ Response RequestHandler::handleCGI(const Request& request, const Route* route, c
 	return executor.execute(request, _server, route, scriptPath);
 }
 
-// Error responses
+// Prepared error page for this server (error_page file or the built-in one)
+Response RequestHandler::errorPage(int status) {
+	return Instance::Get<ErrorPages>()->get(_server, status);
+}
+
+// Error responses (the details only go to the log: the pages are shared)
 Response RequestHandler::notFound(const std::string& path) {
-	// Check if custom error page is configured
-	std::string errorPage = _server->getErrorPage(404);
-	if (!errorPage.empty()) {
-		// Find matching route to resolve the error page path
-		const Route* route = _server->matchRoute("/");
-		if (route) {
-			std::string errorFilePath = resolveFilePath(errorPage, route);
-			if (fileExists(errorFilePath)) {
-				std::string content = readFile(errorFilePath);
-				if (!content.empty()) {
-					Response response;
-					response.setStatus(404);
-					response.setContentType("text/html");
-					response.setBody(content);
-					response.setKeepAlive(false);
-					Logger::info << "Serving custom 404 page: " << errorFilePath << std::endl;
-					return response;
-				}
-			}
-		}
-	}
-	// Fallback to generic error page
-	return Response::errorResponse(404, "The requested URL " + path + " was not found on this server.");
+	LOG_DEBUG << "404: " << path << std::endl;
+	return errorPage(404);
 }
 
 Response RequestHandler::forbidden(const std::string& message) {
-	// Check if custom error page is configured
-	std::string errorPage = _server->getErrorPage(403);
-	if (!errorPage.empty()) {
-		const Route* route = _server->matchRoute("/");
-		if (route) {
-			std::string errorFilePath = resolveFilePath(errorPage, route);
-			if (fileExists(errorFilePath)) {
-				std::string content = readFile(errorFilePath);
-				if (!content.empty()) {
-					Response response;
-					response.setStatus(403);
-					response.setContentType("text/html");
-					response.setBody(content);
-					response.setKeepAlive(false);
-					Logger::info << "Serving custom 403 page: " << errorFilePath << std::endl;
-					return response;
-				}
-			}
-		}
-	}
-	// Fallback to generic error page
-	return Response::errorResponse(403, message);
+	LOG_DEBUG << "403: " << message << std::endl;
+	return errorPage(403);
 }
 
 Response RequestHandler::methodNotAllowed(const std::string& method) {
-	// Check if custom error page is configured
-	std::string errorPage = _server->getErrorPage(405);
-	if (!errorPage.empty()) {
-		const Route* route = _server->matchRoute("/");
-		if (route) {
-			std::string errorFilePath = resolveFilePath(errorPage, route);
-			if (fileExists(errorFilePath)) {
-				std::string content = readFile(errorFilePath);
-				if (!content.empty()) {
-					Response response;
-					response.setStatus(405);
-					response.setContentType("text/html");
-					response.setBody(content);
-					response.setKeepAlive(false);
-					Logger::info << "Serving custom 405 page: " << errorFilePath << std::endl;
-					return response;
-				}
-			}
-		}
-	}
-	// Fallback to generic error page
-	return Response::errorResponse(405, "Method " + method + " is not allowed for this resource.");
+	LOG_DEBUG << "405: " << method << std::endl;
+	return errorPage(405);
 }
 
 Response RequestHandler::notImplemented(const std::string& method) {
-	// Check if custom error page is configured
-	std::string errorPage = _server->getErrorPage(501);
-	if (!errorPage.empty()) {
-		const Route* route = _server->matchRoute("/");
-		if (route) {
-			std::string errorFilePath = resolveFilePath(errorPage, route);
-			if (fileExists(errorFilePath)) {
-				std::string content = readFile(errorFilePath);
-				if (!content.empty()) {
-					Response response;
-					response.setStatus(501);
-					response.setContentType("text/html");
-					response.setBody(content);
-					response.setKeepAlive(false);
-					Logger::info << "Serving custom 501 page: " << errorFilePath << std::endl;
-					return response;
-				}
-			}
-		}
-	}
-	// Fallback to generic error page
-	return Response::errorResponse(501, "Method " + method + " is not implemented.");
+	LOG_DEBUG << "501: " << method << std::endl;
+	return errorPage(501);
 }
 
 Response RequestHandler::internalServerError(const std::string& message) {
-	// Check if custom error page is configured
-	std::string errorPage = _server->getErrorPage(500);
-	if (!errorPage.empty()) {
-		const Route* route = _server->matchRoute("/");
-		if (route) {
-			std::string errorFilePath = resolveFilePath(errorPage, route);
-			if (fileExists(errorFilePath)) {
-				std::string content = readFile(errorFilePath);
-				if (!content.empty()) {
-					Response response;
-					response.setStatus(500);
-					response.setContentType("text/html");
-					response.setBody(content);
-					response.setKeepAlive(false);
-					Logger::info << "Serving custom 500 page: " << errorFilePath << std::endl;
-					return response;
-				}
-			}
-		}
-	}
-	// Fallback to generic error page
-	return Response::errorResponse(500, message);
+	LOG_DEBUG << "500: " << message << std::endl;
+	return errorPage(500);
 }
 
 } // namespace HTTP
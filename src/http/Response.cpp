@@ -17,62 +17,215 @@
 #include "includes/http/Response.hpp"
 #include "includes/core/Settings.hpp"
 #include "includes/core/Instance.hpp"
-#include <sstream>
+#include "includes/utils/Clock.hpp"
 #include <ctime>
-#include <iomanip>
+#include <cstring>
+#include <strings.h>
 
 namespace HTTP {
 
+namespace {
+	struct StatusLine {
+		int code;
+		const char* line;
+		size_t length;
+	};
+
+	#define STATUS_LINE(code, text) { code, "HTTP/1.1 " #code " " text "\r\n", sizeof("HTTP/1.1 " #code " " text "\r\n") - 1 }
+
+	// Same reason phrases as Settings::httpStatusCode, without the map lookup
+	const StatusLine STATUS_LINES[] = {
+		STATUS_LINE(200, "OK"),
+		STATUS_LINE(201, "Created"),
+		STATUS_LINE(204, "No Content"),
+		STATUS_LINE(206, "Partial Content"),
+		STATUS_LINE(301, "Moved Permanently"),
+		STATUS_LINE(302, "Found"),
+		STATUS_LINE(304, "Not Modified"),
+		STATUS_LINE(400, "Bad Request"),
+		STATUS_LINE(401, "Unauthorized"),
+		STATUS_LINE(403, "Forbidden"),
+		STATUS_LINE(404, "Not Found"),
+		STATUS_LINE(405, "Method Not Allowed"),
+		STATUS_LINE(408, "Request Timeout"),
+		STATUS_LINE(413, "Payload Too Large"),
+		STATUS_LINE(414, "URI Too Long"),
+		STATUS_LINE(416, "Range Not Satisfiable"),
+		STATUS_LINE(429, "Too Many Requests"),
+		STATUS_LINE(500, "Internal Server Error"),
+		STATUS_LINE(501, "Not Implemented"),
+		STATUS_LINE(502, "Bad Gateway"),
+		STATUS_LINE(503, "Service Unavailable"),
+		STATUS_LINE(504, "Gateway Timeout"),
+		STATUS_LINE(505, "HTTP Version Not Supported")
+	};
+
+	#undef STATUS_LINE
+
+	const size_t STATUS_LINE_COUNT = sizeof(STATUS_LINES) / sizeof(STATUS_LINES[0]);
+	const size_t STATUS_PREFIX = sizeof("HTTP/1.1 200 ") - 1;   // Reason phrase offset
+
+	const StatusLine* findStatusLine(int code) {
+		for (size_t i = 0; i < STATUS_LINE_COUNT; ++i) {
+			if (STATUS_LINES[i].code == code) {
+				return &STATUS_LINES[i];
+			}
+		}
+		return NULL;
+	}
+
+	const char DATE_PREFIX[] = "Date: ";
+	const char KEEP_ALIVE_LINE[] = "Connection: keep-alive\r\n";
+	const char CLOSE_LINE[] = "Connection: close\r\n";
+	const char CONTENT_LENGTH_PREFIX[] = "Content-Length: ";
+	const size_t MAX_DIGITS = 20;   // 2^64 - 1
+
+	// Decimal/hex formatting without iostreams
+	void appendNumber(std::string& out, unsigned long long value, unsigned int base = 10) {
+		char digits[MAX_DIGITS];
+		size_t pos = sizeof(digits);
+		do {
+			digits[--pos] = "0123456789abcdef"[value % base];
+			value /= base;
+		} while (value);
+		out.append(digits + pos, sizeof(digits) - pos);
+	}
+
+	bool sameName(const char* a, size_t aLength, const char* b, size_t bLength) {
+		return aLength == bLength && strncasecmp(a, b, aLength) == 0;
+	}
+}
+
 // Constructor
 Response::Response()
 	: _statusCode(200)
-	, _statusMessage("OK")
-	, _body("")
-	, _chunked(false) {
+	, _statusLine(STATUS_LINES[0].line)
+	, _statusLineLength(STATUS_LINES[0].length)
+	, _contentLength(0)
+	, _hasContentLength(false)
+	, _connection(CONNECTION_NONE)
+	, _hasDate(false)
+	, _chunked(false)
+	, _segmentsLength(0)
+	, _cgiSpawned(0)
+	, _cgiExited(0)
+	, _prepared(NULL)
+	, _dateOffset(std::string::npos) {
 }
 
 Response::~Response() {}
 
+// CGI timing
+void Response::setCgiTiming(double spawned, double exited) {
+	_cgiSpawned = spawned;
+	_cgiExited = exited;
+}
+
+double Response::getCgiSpawned() const {
+	return _cgiSpawned;
+}
+
+double Response::getCgiExited() const {
+	return _cgiExited;
+}
+
 // Set status
 void Response::setStatus(int code) {
+	detach();
 	_statusCode = code;
-	_statusMessage = getStatusMessage(code);
+	const StatusLine* status = findStatusLine(code);
+	if (status) {
+		_statusLine = status->line;
+		_statusLineLength = status->length;
+		_statusMessage.clear();
+	} else {
+		_statusLine = NULL;
+		_statusMessage = getStatusMessage(code);
+	}
 }
 
 void Response::setStatus(int code, const std::string& message) {
+	detach();
 	_statusCode = code;
+	_statusLine = NULL;
 	_statusMessage = message;
 }
 
 // Set header
 void Response::setHeader(const std::string& name, const std::string& value) {
-	_headers[name] = value;
+	setHeader(name.data(), name.length(), value.data(), value.length());
+}
+
+// Content-Length and Connection are kept apart so build() can format them
+void Response::setHeader(const char* name, size_t nameLength, const char* value, size_t valueLength) {
+	detach();
+	if (sameName(name, nameLength, HeaderName::CONTENT_LENGTH, sizeof(HeaderName::CONTENT_LENGTH) - 1)) {
+		size_t length = 0;
+		for (size_t i = 0; i < valueLength && value[i] >= '0' && value[i] <= '9'; ++i) {
+			length = length * 10 + (value[i] - '0');
+		}
+		setContentLength(length);
+		return;
+	}
+	if (sameName(name, nameLength, HeaderName::CONNECTION, sizeof(HeaderName::CONNECTION) - 1)) {
+		setKeepAlive(valueLength == 10 && strncasecmp(value, "keep-alive", 10) == 0);
+		return;
+	}
+
+	if (sameName(name, nameLength, HeaderName::DATE, sizeof(HeaderName::DATE) - 1)) {
+		_hasDate = true;
+	}
+
+	size_t pos = findHeader(name, nameLength);
+	if (pos != std::string::npos) {
+		size_t end = _headers.find("\r\n", pos) + 2;
+		_headers.erase(pos, end - pos);
+	}
+	_headers.append(name, nameLength);
+	_headers.append(": ", 2);
+	_headers.append(value, valueLength);
+	_headers.append("\r\n", 2);
+}
+
+// Offset of the "Name: value\r\n" line for name, npos if absent
+size_t Response::findHeader(const char* name, size_t nameLength) const {
+	size_t pos = 0;
+	while (pos < _headers.size()) {
+		size_t colon = _headers.find(':', pos);
+		if (sameName(_headers.data() + pos, colon - pos, name, nameLength)) {
+			return pos;
+		}
+		pos = _headers.find("\r\n", colon) + 2;
+	}
+	return std::string::npos;
 }
 
 void Response::setContentType(const std::string& contentType) {
-	setHeader("Content-Type", contentType);
+	setHeader(HeaderName::CONTENT_TYPE, contentType);
 }
 
 void Response::setContentLength(size_t length) {
-	std::ostringstream oss;
-	oss << length;
-	setHeader("Content-Length", oss.str());
+	detach();
+	_contentLength = length;
+	_hasContentLength = true;
 }
 
 void Response::setLastModified(time_t mtime) {
-	setHeader("Last-Modified", formatHttpDate(mtime));
+	setHeader(HeaderName::LAST_MODIFIED, sizeof(HeaderName::LAST_MODIFIED) - 1,
+	          Clock::httpDate(mtime), Clock::HTTP_DATE_LENGTH);
 }
 
 void Response::setETag(const std::string& etag) {
-	setHeader("ETag", "\"" + etag + "\"");
+	setHeader(HeaderName::ETAG, "\"" + etag + "\"");
 }
 
 void Response::setCacheControl(const std::string& cacheControl) {
-	setHeader("Cache-Control", cacheControl);
+	setHeader(HeaderName::CACHE_CONTROL, cacheControl);
 }
 
 // Set body
 void Response::setBody(const std::string& body) {
+	detach();
 	_body = body;
 	if (!_chunked) {
 		setContentLength(_body.length());
@@ -80,85 +233,209 @@ void Response::setBody(const std::string& body) {
 }
 
 void Response::appendBody(const std::string& chunk) {
+	detach();
 	_body += chunk;
 	if (!_chunked) {
 		setContentLength(_body.length());
 	}
 }
 
+// File-backed body: the connection streams these segments after the head
+void Response::setFile(const std::string& path) {
+	detach();
+	_filePath = path;
+	_body.clear();
+	_segments.clear();
+	_segmentsLength = 0;
+	setContentLength(0);
+}
+
+void Response::appendFileRange(off_t offset, size_t length) {
+	detach();
+	Segment segment;
+	segment.fromFile = true;
+	segment.offset = offset;
+	segment.length = length;
+	_segments.push_back(segment);
+	_segmentsLength += length;
+	setContentLength(_segmentsLength);
+}
+
+void Response::appendSegment(const std::string& data) {
+	detach();
+	Segment segment;
+	segment.fromFile = false;
+	segment.offset = 0;
+	segment.length = data.length();
+	segment.data = data;
+	_segments.push_back(segment);
+	_segmentsLength += data.length();
+	setContentLength(_segmentsLength);
+}
+
+void Response::appendSegment(const SharedBuffer& data) {
+	detach();
+	Segment segment;
+	segment.fromFile = false;
+	segment.offset = 0;
+	segment.length = data.size();
+	segment.shared = data;
+	_segments.push_back(segment);
+	_segmentsLength += data.size();
+	setContentLength(_segmentsLength);
+}
+
+const char* Response::Segment::bytes() const {
+	return shared.empty() ? data.data() : shared.data();
+}
+
+bool Response::hasFileBody() const {
+	return !_filePath.empty();
+}
+
+const std::string& Response::getFilePath() const {
+	return _filePath;
+}
+
+const std::vector<Response::Segment>& Response::getSegments() const {
+	return _segments;
+}
+
 void Response::setChunked(bool chunked) {
+	detach();
 	_chunked = chunked;
 	if (_chunked) {
-		setHeader("Transfer-Encoding", "chunked");
+		setHeader(HeaderName::TRANSFER_ENCODING, "chunked");
 		// Remove Content-Length if present (incompatible with chunked)
-		_headers.erase("Content-Length");
+		_hasContentLength = false;
 	}
 }
 
 // Set keep-alive
 void Response::setKeepAlive(bool keepAlive) {
-	if (keepAlive) {
-		setHeader("Connection", "keep-alive");
-	} else {
-		setHeader("Connection", "close");
-	}
+	detach();
+	_connection = keepAlive ? CONNECTION_KEEP_ALIVE : CONNECTION_CLOSE;
 }
 
-// Build response string
-std::string Response::build() const {
-	if (_chunked) {
-		return buildChunkedResponse();
+// Status line and headers, up to and including the empty line
+size_t Response::headLength() const {
+	size_t length = _statusLine ? _statusLineLength
+	                            : STATUS_PREFIX + _statusMessage.length() + 2;
+	length += _headers.size() + 2;
+	if (!_hasDate) {
+		length += sizeof(DATE_PREFIX) - 1 + Clock::HTTP_DATE_LENGTH + 2;
 	}
-
-	std::ostringstream response;
-
-	// Status line
-	response << "HTTP/1.1 " << _statusCode << " " << _statusMessage << "\r\n";
-
-	// Headers
-	for (std::map<std::string, std::string>::const_iterator it = _headers.begin();
-	     it != _headers.end(); ++it) {
-		response << it->first << ": " << it->second << "\r\n";
+	if (_hasContentLength) {
+		length += sizeof(CONTENT_LENGTH_PREFIX) - 1 + MAX_DIGITS + 2;
 	}
-
-	// Empty line separating headers from body
-	response << "\r\n";
-
-	// Body
-	if (!_body.empty()) {
-		response << _body;
+	if (_connection != CONNECTION_NONE) {
+		length += sizeof(KEEP_ALIVE_LINE) - 1;
 	}
+	return length;
+}
 
-	return response.str();
+void Response::appendHead(std::string& out) const {
+	if (_statusLine) {
+		out.append(_statusLine, _statusLineLength);
+	} else {
+		out.append("HTTP/1.1 ", 9);
+		appendNumber(out, _statusCode);
+		out += ' ';
+		out += _statusMessage;
+		out.append("\r\n", 2);
+	}
+	if (!_hasDate) {
+		out.append(DATE_PREFIX, sizeof(DATE_PREFIX) - 1);
+		out.append(Clock::httpDate(), Clock::HTTP_DATE_LENGTH);
+		out.append("\r\n", 2);
+	}
+	out += _headers;
+	if (_hasContentLength) {
+		out.append(CONTENT_LENGTH_PREFIX, sizeof(CONTENT_LENGTH_PREFIX) - 1);
+		appendNumber(out, _contentLength);
+		out.append("\r\n", 2);
+	}
+	if (_connection == CONNECTION_KEEP_ALIVE) {
+		out.append(KEEP_ALIVE_LINE, sizeof(KEEP_ALIVE_LINE) - 1);
+	} else if (_connection == CONNECTION_CLOSE) {
+		out.append(CLOSE_LINE, sizeof(CLOSE_LINE) - 1);
+	}
+	// Empty line separating headers from body
+	out.append("\r\n", 2);
 }
 
-// Build chunked response
-std::string Response::buildChunkedResponse() const {
-	std::ostringstream response;
+// Build response string (sized up front: one allocation)
+std::string Response::build() const {
+	std::string response;
+	buildInto(response);
+	return response;
+}
 
-	// Status line
-	response << "HTTP/1.1 " << _statusCode << " " << _statusMessage << "\r\n";
+void Response::buildInto(std::string& out) const {
+	if (_prepared) {
+		out.assign(_prepared->_serialized);
+		if (_prepared->_dateOffset != std::string::npos) {
+			std::memcpy(&out[_prepared->_dateOffset], Clock::httpDate(), Clock::HTTP_DATE_LENGTH);
+		}
+		return;
+	}
 
-	// Headers (Transfer-Encoding: chunked already set)
-	for (std::map<std::string, std::string>::const_iterator it = _headers.begin();
-	     it != _headers.end(); ++it) {
-		response << it->first << ": " << it->second << "\r\n";
+	out.clear();
+	if (_chunked) {
+		out.reserve(headLength() + _body.length() + MAX_DIGITS + 2 + 2 + 5);
+		appendHead(out);
+
+		// Chunked body
+		if (!_body.empty()) {
+			// Send body in chunks (we'll send it all as one chunk for simplicity)
+			appendNumber(out, _body.length(), 16);
+			out.append("\r\n", 2);
+			out += _body;
+			out.append("\r\n", 2);
+		}
+
+		// Last chunk (size 0)
+		out.append("0\r\n\r\n", 5);
+		return;
 	}
 
-	// Empty line separating headers from body
-	response << "\r\n";
+	out.reserve(headLength() + _body.length());
+	appendHead(out);
+	out += _body;
+}
 
-	// Chunked body
-	if (!_body.empty()) {
-		// Send body in chunks (we'll send it all as one chunk for simplicity)
-		response << std::hex << _body.length() << "\r\n";
-		response << _body << "\r\n";
-	}
+// Serialize once; handles from prepared() copy these bytes
+void Response::prepare() {
+	detach();
+	_serialized.clear();
+	buildInto(_serialized);
+	_dateOffset = _hasDate ? std::string::npos : _serialized.find("\r\n") + 2 + sizeof(DATE_PREFIX) - 1;
+}
 
-	// Last chunk (size 0)
-	response << "0\r\n\r\n";
+Response Response::prepared(const Response& page) {
+	Response response;
+	response._statusCode = page._statusCode;
+	response._prepared = &page;
+	return response;
+}
 
-	return response.str();
+// A handle about to change gets its own copy of the page
+void Response::detach() {
+	if (!_prepared) {
+		return;
+	}
+	const Response& page = *_prepared;
+	_prepared = NULL;
+	_statusLine = page._statusLine;
+	_statusLineLength = page._statusLineLength;
+	_statusMessage = page._statusMessage;
+	_headers = page._headers;
+	_contentLength = page._contentLength;
+	_hasContentLength = page._hasContentLength;
+	_connection = page._connection;
+	_hasDate = page._hasDate;
+	_body = page._body;
+	_chunked = page._chunked;
 }
 
 // Getters
@@ -167,21 +444,78 @@ int Response::getStatusCode() const {
 }
 
 const std::string& Response::getBody() const {
+	if (_prepared) {
+		return _prepared->_body;
+	}
 	return _body;
 }
 
+std::string Response::getHeader(const std::string& name) const {
+	if (_prepared) {
+		return _prepared->getHeader(name);
+	}
+	if (sameName(name.data(), name.length(), HeaderName::CONTENT_LENGTH, sizeof(HeaderName::CONTENT_LENGTH) - 1)) {
+		std::string value;
+		if (_hasContentLength) {
+			appendNumber(value, _contentLength);
+		}
+		return value;
+	}
+	if (!_hasDate && sameName(name.data(), name.length(), HeaderName::DATE, sizeof(HeaderName::DATE) - 1)) {
+		return Clock::httpDate();
+	}
+	if (sameName(name.data(), name.length(), HeaderName::CONNECTION, sizeof(HeaderName::CONNECTION) - 1)) {
+		return _connection == CONNECTION_NONE ? "" : _connection == CONNECTION_KEEP_ALIVE ? "keep-alive" : "close";
+	}
+
+	size_t pos = findHeader(name.data(), name.length());
+	if (pos == std::string::npos) {
+		return "";
+	}
+	size_t value = pos + name.length() + 2;
+	return _headers.substr(value, _headers.find("\r\n", value) - value);
+}
+
+// Every header as a name/value pair (HTTP/2 encodes them separately)
+void Response::getHeaders(std::vector<std::pair<std::string, std::string> >& fields) const {
+	if (_prepared) {
+		_prepared->getHeaders(fields);
+		return;
+	}
+	if (!_hasDate) {
+		fields.push_back(std::make_pair(std::string(HeaderName::DATE), std::string(Clock::httpDate())));
+	}
+	size_t pos = 0;
+	while (pos < _headers.size()) {
+		size_t colon = _headers.find(':', pos);
+		size_t end = _headers.find("\r\n", colon);
+		fields.push_back(std::make_pair(_headers.substr(pos, colon - pos),
+		                                _headers.substr(colon + 2, end - colon - 2)));
+		pos = end + 2;
+	}
+	if (_hasContentLength) {
+		fields.push_back(std::make_pair(std::string(HeaderName::CONTENT_LENGTH),
+		                                getHeader(HeaderName::CONTENT_LENGTH)));
+	}
+	if (_connection != CONNECTION_NONE) {
+		fields.push_back(std::make_pair(std::string(HeaderName::CONNECTION),
+		                                getHeader(HeaderName::CONNECTION)));
+	}
+}
+
 // Get status message for code
 std::string Response::getStatusMessage(int code) const {
+	const StatusLine* status = findStatusLine(code);
+	if (status) {
+		return std::string(status->line + STATUS_PREFIX, status->length - STATUS_PREFIX - 2);
+	}
 	Settings* settings = Instance::Get<Settings>();
 	return settings->httpStatusCode(code);
 }
 
 // Format time as HTTP date (RFC 7231)
-std::string Response::formatHttpDate(time_t time) const {
-	char buffer[128];
-	struct tm* tm_info = gmtime(&time);
-	strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", tm_info);
-	return std::string(buffer);
+std::string Response::formatHttpDate(time_t time) {
+	return std::string(Clock::httpDate(time), Clock::HTTP_DATE_LENGTH);
 }
 
 // Common responses
@@ -190,23 +524,37 @@ Response Response::errorResponse(int code, const std::string& message) {
 	response.setStatus(code);
 	response.setContentType("text/html");
 
-	std::ostringstream body;
-	body << "<!DOCTYPE html>\n"
-	     << "<html>\n"
-	     << "<head><title>" << code << " " << response.getStatusMessage(code) << "</title></head>\n"
-	     << "<body>\n"
-	     << "<h1>" << code << " " << response.getStatusMessage(code) << "</h1>\n";
+	// "404 Not Found", straight from the status line when there is one
+	std::string title;
+	if (response._statusLine) {
+		title.assign(response._statusLine + 9, response._statusLineLength - 9 - 2);
+	} else {
+		appendNumber(title, code);
+		title += ' ';
+		title += response._statusMessage;
+	}
+
+	std::string body;
+	body.reserve(160 + 2 * title.length() + message.length());
+	body += "<!DOCTYPE html>\n<html>\n<head><title>";
+	body += title;
+	body += "</title></head>\n<body>\n<h1>";
+	body += title;
+	body += "</h1>\n";
 
 	if (!message.empty()) {
-		body << "<p>" << message << "</p>\n";
+		body += "<p>";
+		body += message;
+		body += "</p>\n";
 	}
 
-	body << "<hr>\n"
-	     << "<p><em>webserv/1.0</em></p>\n"
-	     << "</body>\n"
-	     << "</html>\n";
+	body += "<hr>\n"
+	        "<p><em>webserv/1.0</em></p>\n"
+	        "</body>\n"
+	        "</html>\n";
 
-	response.setBody(body.str());
+	response._body.swap(body);
+	response.setContentLength(response._body.length());
 	response.setKeepAlive(false);
 
 	return response;
@@ -215,20 +563,26 @@ Response Response::errorResponse(int code, const std::string& message) {
 Response Response::redirect(const std::string& location, int code) {
 	Response response;
 	response.setStatus(code);
-	response.setHeader("Location", location);
+	response.setHeader(HeaderName::LOCATION, location);
 	response.setContentType("text/html");
 
-	std::ostringstream body;
-	body << "<!DOCTYPE html>\n"
-	     << "<html>\n"
-	     << "<head><title>Redirecting...</title></head>\n"
-	     << "<body>\n"
-	     << "<h1>Redirecting...</h1>\n"
-	     << "<p>You are being redirected to <a href=\"" << location << "\">" << location << "</a></p>\n"
-	     << "</body>\n"
-	     << "</html>\n";
-
-	response.setBody(body.str());
+	std::string body;
+	body.reserve(160 + 2 * location.length());
+	body += "<!DOCTYPE html>\n"
+	        "<html>\n"
+	        "<head><title>Redirecting...</title></head>\n"
+	        "<body>\n"
+	        "<h1>Redirecting...</h1>\n"
+	        "<p>You are being redirected to <a href=\"";
+	body += location;
+	body += "\">";
+	body += location;
+	body += "</a></p>\n"
+	        "</body>\n"
+	        "</html>\n";
+
+	response._body.swap(body);
+	response.setContentLength(response._body.length());
 
 	return response;
 }
@@ -236,10 +590,24 @@ Response Response::redirect(const std::string& location, int code) {
 // Clear response
 void Response::clear() {
 	_statusCode = 200;
-	_statusMessage = "OK";
+	_statusLine = STATUS_LINES[0].line;
+	_statusLineLength = STATUS_LINES[0].length;
+	_statusMessage.clear();
 	_headers.clear();
+	_contentLength = 0;
+	_hasContentLength = false;
+	_connection = CONNECTION_NONE;
+	_hasDate = false;
 	_body.clear();
 	_chunked = false;
+	_filePath.clear();
+	_segments.clear();
+	_segmentsLength = 0;
+	_cgiSpawned = 0;
+	_cgiExited = 0;
+	_prepared = NULL;
+	_serialized.clear();
+	_dateOffset = std::string::npos;
 }
 
 } // namespace HTTP
@@ -15,7 +15,19 @@
  * Implementation of HTTP Server Manager
  */
 #include "includes/http/ServerManager.hpp"
+#include "includes/http/GzipCache.hpp"
+#include "includes/http/DirectoryIndex.hpp"
+#include "includes/http/ErrorPages.hpp"
+#include "includes/http/RateLimiter.hpp"
+#include "includes/http/Upstreams.hpp"
+#include "includes/core/Settings.hpp"
+#include "includes/cgi/Environment.hpp"
+#include "includes/cgi/Cache.hpp"
+#include "includes/http/AccessLog.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/network/TrafficCapture.hpp"
 #include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
 #include <cstring>
 #include <cerrno>
 #include <algorithm>
@@ -28,7 +40,11 @@ namespace HTTP {
 // Constructor
 ServerManager::ServerManager()
 	: _running(false)
-	, _timeout(60) {
+	, _timeout(60)
+	, _nextResume(0)
+	, _upstreamStart(0)
+	, _nextUpstreamTimeout(0)
+	, _refreshStart(0) {
 	// Ignore SIGPIPE (broken pipe) - we'll handle write errors instead
 	signal(SIGPIPE, SIG_IGN);
 }
@@ -37,6 +53,17 @@ ServerManager::ServerManager()
 ServerManager::~ServerManager() {
 	cleanupAllConnections();
 
+	// Release TLS contexts (reporting their handshake counters)
+	for (std::map<int, TlsContext*>::iterator it = _tlsContexts.begin();
+	     it != _tlsContexts.end(); ++it) {
+		TlsContext* tls = it->second;
+		LOG_INFO << "TLS listener (fd: " << it->first << "): " << tls->getHandshakes()
+		         << " handshakes, " << tls->getResumed() << " resumed, "
+		         << tls->getFailures() << " failed" << std::endl;
+		delete tls;
+	}
+	_tlsContexts.clear();
+
 	// Close listening sockets
 	for (size_t i = 0; i < _listeningSockets.size(); ++i) {
 		delete _listeningSockets[i];
@@ -46,16 +73,58 @@ ServerManager::~ServerManager() {
 
 // Initialize with configuration
 bool ServerManager::init(const Config& config) {
-	Logger::info << "Initializing server manager..." << std::endl;
+	LOG_INFO << "Initializing server manager..." << std::endl;
 
 	_config = config;
 
+	// Size the compressed-variant cache shared by all servers
+	Instance::Get<GzipCache>()->setCapacity(_config.getGzipCacheSize());
+
+	// And the directory listing cache
+	Instance::Get<DirectoryIndex>()->setCapacity(_config.getAutoindexCacheSize());
+
+	// And the CGI response cache
+	Instance::Get<CGI::Cache>()->setCapacity(_config.getCgiCacheSize());
+
+	// MIME types from the types blocks (or the built-in list)
+	Instance::Get<Settings>()->setMimeTypes(_config.getMimeTypes(), _config.getDefaultType());
+
+	// Error responses, serialized once per server
+	Instance::Get<ErrorPages>()->open(_config);
+
+	// limit_req / limit_conn zones
+	Instance::Get<RateLimiter>()->open(_config);
+
+	// proxy_pass upstream groups (peer addresses resolved once, here)
+	if (!Instance::Get<Upstreams>()->open(_config)) {
+		return false;
+	}
+
+	// CGI variables that are the same for every request to a location
+	Instance::Get<CGI::Environment>()->open(_config);
+
+	// One latency histogram per location
+	Instance::Get<Metrics>()->open(_config);
+
+	// Open the access logs (ids were assigned by Config::compile())
+	if (!Instance::Get<AccessLogs>()->open(_config.getAccessLogs())) {
+		LOG_ERROR << "Failed to open access logs" << std::endl;
+		return false;
+	}
+
+	// Record inbound traffic for replay (capture directive)
+	if (!_config.getCapturePath().empty() &&
+	    !Instance::Get<TrafficCapture>()->open(_config.getCapturePath(), _config.getCaptureSample(),
+	                                           _config.getCaptureMaxSize())) {
+		return false;
+	}
+
 	if (!setupListeningSockets()) {
-		Logger::error << "Failed to setup listening sockets" << std::endl;
+		LOG_ERROR << "Failed to setup listening sockets" << std::endl;
 		return false;
 	}
 
-	Logger::success << "Server manager initialized successfully!" << std::endl;
+	LOG_SUCCESS << "Server manager initialized successfully!" << std::endl;
 	return true;
 }
 
@@ -81,26 +150,41 @@ bool ServerManager::setupListeningSockets() {
 
 			// Skip if we already have a socket for this binding
 			if (uniqueBindings.find(bindingKey) != uniqueBindings.end()) {
-				Logger::debug << "Socket already exists for " << bindingKey << std::endl;
+				LOG_DEBUG << "Socket already exists for " << bindingKey << std::endl;
 				continue;
 			}
 
 			// Create listening socket
 			Socket* sock = createListeningSocket(host, port);
 			if (!sock) {
-				Logger::error << "Failed to create listening socket for " << host << ":" << port << std::endl;
+				LOG_ERROR << "Failed to create listening socket for " << host << ":" << port << std::endl;
 				return false;
 			}
 
 			_listeningSockets.push_back(sock);
 			uniqueBindings[bindingKey] = true;
 
-			Logger::success << "Listening on " << host << ":" << port << std::endl;
+			// Name-based virtual hosts sharing this socket
+			_virtualHosts[sock->getFd()].build(servers, host, port);
+
+			// "listen ... ssl": the server that declares the binding provides the certificate
+			if (server.isSslPort(port)) {
+				TlsContext* tls = new TlsContext();
+				if (!tls->init(server)) {
+					delete tls;
+					LOG_ERROR << "Failed to set up TLS for " << host << ":" << port << std::endl;
+					return false;
+				}
+				_tlsContexts[sock->getFd()] = tls;
+			}
+
+			LOG_SUCCESS << "Listening on " << host << ":" << port
+			            << (server.isSslPort(port) ? " (ssl)" : "") << std::endl;
 		}
 	}
 
 	if (_listeningSockets.empty()) {
-		Logger::error << "No listening sockets created!" << std::endl;
+		LOG_ERROR << "No listening sockets created!" << std::endl;
 		return false;
 	}
 
@@ -119,7 +203,7 @@ Socket* ServerManager::createListeningSocket(const std::string& host, int port)
 
 	// Configure socket
 	if (!sock->setReuseAddr()) {
-		Logger::warning << "Failed to set SO_REUSEADDR" << std::endl;
+		LOG_WARNING << "Failed to set SO_REUSEADDR" << std::endl;
 	}
 
 	sock->setReusePort(); // May not be available on all systems
@@ -147,15 +231,15 @@ Socket* ServerManager::createListeningSocket(const std::string& host, int port)
 
 // Start the server (blocking loop)
 bool ServerManager::run() {
-	Logger::info << "Starting server..." << std::endl;
+	LOG_INFO << "Starting server..." << std::endl;
 	_running = true;
 
 	// Build initial poll fds
 	rebuildPollFds();
 
-	Logger::success << "Server running! Press Ctrl+C to stop." << std::endl;
+	LOG_SUCCESS << "Server running! Press Ctrl+C to stop." << std::endl;
 	std::cout << std::endl;
-	Logger::info << "Listening on:" << std::endl;
+	LOG_INFO << "Listening on:" << std::endl;
 	for (size_t i = 0; i < _listeningSockets.size(); ++i) {
 		std::string host = _listeningSockets[i]->getHost();
 		int port = _listeningSockets[i]->getPort();
@@ -173,21 +257,42 @@ bool ServerManager::run() {
 
 	// Main event loop
 	while (_running) {
-		// Poll with 1 second timeout
-		int pollResult = poll(&_pollFds[0], _pollFds.size(), 1000);
+		// Poll with 1 second timeout (less if a delayed request or an
+		// upstream timeout is due sooner)
+		int timeout = 1000;
+		double due = _nextResume;
+		if (_nextUpstreamTimeout > 0 && (due == 0 || _nextUpstreamTimeout < due)) {
+			due = _nextUpstreamTimeout;
+		}
+		if (due > 0) {
+			double wait = (due - Clock::monotonic()) * 1000;
+			timeout = (wait <= 0) ? 0 : (wait < 1000 ? static_cast<int>(wait) + 1 : 1000);
+		}
+		int pollResult = poll(&_pollFds[0], _pollFds.size(), timeout);
+		Clock::update();
+
+		// Access logs: periodic flush and reopen after SIGUSR1
+		Instance::Get<AccessLogs>()->tick();
+		Instance::Get<TrafficCapture>()->tick();
+		Instance::Get<Upstreams>()->tick();
+		Instance::Get<CGI::Cache>()->tick();
 
 		if (pollResult < 0) {
 			if (errno == EINTR) {
 				// Interrupted by signal, continue
 				continue;
 			}
-			Logger::error << "poll() failed: " << std::strerror(errno) << std::endl;
+			LOG_ERROR << "poll() failed: " << std::strerror(errno) << std::endl;
 			break;
 		}
 
+		resumeDelayedConnections();
+		expireUpstreams();
+
 		if (pollResult == 0) {
 			// Timeout - check for timed out connections
 			cleanupTimedOutConnections();
+			rebuildPollFds();
 			continue;
 		}
 
@@ -201,6 +306,18 @@ bool ServerManager::run() {
 
 			--pollResult; // Count down events processed
 
+			// cgi_cache refreshes come last, after the upstream sockets
+			if (i >= _refreshStart) {
+				Instance::Get<CGI::Cache>()->handle(pfd.fd, pfd.revents);
+				continue;
+			}
+
+			// proxy_pass upstream sockets come after the client connections
+			if (i >= _upstreamStart) {
+				handleUpstreamSocket(i, pfd.revents);
+				continue;
+			}
+
 			// Check if this is a listening socket
 			bool isListening = false;
 			for (size_t j = 0; j < _listeningSockets.size(); ++j) {
@@ -222,13 +339,18 @@ bool ServerManager::run() {
 		rebuildPollFds();
 	}
 
-	Logger::info << "Server stopped." << std::endl;
+	// Log the requests still in flight while the access logs are open
+	cleanupAllConnections();
+	Instance::Get<AccessLogs>()->flush();
+	Instance::Get<TrafficCapture>()->flush();
+
+	LOG_INFO << "Server stopped." << std::endl;
 	return true;
 }
 
 // Stop the server
 void ServerManager::stop() {
-	Logger::info << "Stopping server..." << std::endl;
+	LOG_INFO << "Stopping server..." << std::endl;
 	_running = false;
 }
 
@@ -250,25 +372,55 @@ void ServerManager::rebuildPollFds() {
 		_pollFds.push_back(pfd);
 	}
 
-	// Add client connections
+	// Add client connections (counted by state for the metrics)
+	_nextResume = 0;
+	size_t reading = 0;
+	size_t writing = 0;
+	size_t http2 = 0;
 	for (std::map<int, Connection*>::iterator it = _connections.begin();
 	     it != _connections.end(); ++it) {
 		Connection* conn = it->second;
+		if (conn->isHttp2()) {
+			++http2;
+		} else if (conn->getState() == Connection::READING_REQUEST) {
+			++reading;
+		} else if (conn->getState() == Connection::DELAYED) {
+			if (_nextResume == 0 || conn->getResumeTime() < _nextResume) {
+				_nextResume = conn->getResumeTime();
+			}
+		} else {
+			++writing;
+		}
+
 		struct pollfd pfd;
 		pfd.fd = conn->getFd();
 		pfd.revents = 0;
 
 		// Monitor based on connection state
-		if (conn->getState() == Connection::READING_REQUEST) {
-			pfd.events = POLLIN;  // Monitor for read
-		} else if (conn->getState() == Connection::WRITING_RESPONSE) {
-			pfd.events = POLLOUT; // Monitor for write
-		} else {
-			pfd.events = POLLIN | POLLOUT; // Monitor both
-		}
+		pfd.events = conn->getPollEvents();
 
 		_pollFds.push_back(pfd);
 	}
+	Instance::Get<Metrics>()->setConnections(reading, writing, http2);
+
+	// Then the upstream sockets of the proxied requests
+	_upstreamStart = _pollFds.size();
+	_upstreamOwners.clear();
+	_nextUpstreamTimeout = 0;
+	for (std::map<int, Connection*>::iterator it = _connections.begin();
+	     it != _connections.end(); ++it) {
+		Connection* conn = it->second;
+		conn->getUpstreamPollFds(_pollFds);
+		_upstreamOwners.resize(_pollFds.size() - _upstreamStart, it->first);
+		double deadline = conn->getUpstreamDeadline();
+		if (deadline > 0 && (_nextUpstreamTimeout == 0 || deadline < _nextUpstreamTimeout)) {
+			_nextUpstreamTimeout = deadline;
+		}
+	}
+
+	// And the outputs of the cgi_cache background refreshes
+	_refreshStart = _pollFds.size();
+	Instance::Get<CGI::Cache>()->getPollFds(_pollFds);
 }
 
 // Handle listening socket (new connection)
@@ -283,7 +435,7 @@ void ServerManager::handleListeningSocket(int fd) {
 	}
 
 	if (!listenSocket) {
-		Logger::error << "Listening socket not found for fd: " << fd << std::endl;
+		LOG_ERROR << "Listening socket not found for fd: " << fd << std::endl;
 		return;
 	}
 
@@ -302,26 +454,25 @@ void ServerManager::handleListeningSocket(int fd) {
 			fcntl(clientFd, F_SETFL, flags | O_NONBLOCK);
 		}
 
-		Logger::debug << "Socket set to non-blocking mode (fd: " << clientFd << ")" << std::endl;
-
-		// Find the server configuration for this socket
-		const Server* server = _config.getDefaultServer(
-			listenSocket->getHost(),
-			listenSocket->getPort()
-		);
+		LOG_DEBUG << "Socket set to non-blocking mode (fd: " << clientFd << ")" << std::endl;
 
-		if (!server) {
-			Logger::warning << "No server configuration found for connection" << std::endl;
+		// Virtual hosts for this socket (the Host header picks one per request)
+		std::map<int, VirtualHostTable>::const_iterator vhosts = _virtualHosts.find(fd);
+		if (vhosts == _virtualHosts.end() || !vhosts->second.getDefault()) {
+			LOG_WARNING << "No server configuration found for connection" << std::endl;
 			close(clientFd);
 			continue;
 		}
 
-		// Create connection object
-		Connection* conn = new Connection(clientFd, clientAddr, server);
+		// Create connection object (TLS listeners hand over their context)
+		std::map<int, TlsContext*>::iterator tls = _tlsContexts.find(fd);
+		Connection* conn = new Connection(clientFd, clientAddr, &vhosts->second,
+			tls != _tlsContexts.end() ? tls->second : NULL);
 		_connections[clientFd] = conn;
+		Instance::Get<Metrics>()->connectionAccepted();
 
-		Logger::info << "Accepted new connection (fd: " << clientFd
-		             << "), total connections: " << _connections.size() << std::endl;
+		LOG_INFO << "Accepted new connection (fd: " << clientFd
+		         << "), total connections: " << _connections.size() << std::endl;
 	}
 }
 
@@ -330,7 +481,7 @@ void ServerManager::handleClientSocket(int fd, short revents) {
 	// Find connection
 	std::map<int, Connection*>::iterator it = _connections.find(fd);
 	if (it == _connections.end()) {
-		Logger::warning << "Connection not found for fd: " << fd << std::endl;
+		LOG_WARNING << "Connection not found for fd: " << fd << std::endl;
 		return;
 	}
 
@@ -338,7 +489,7 @@ void ServerManager::handleClientSocket(int fd, short revents) {
 
 	// Check for errors
 	if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
-		Logger::debug << "Connection error/hangup (fd: " << fd << ")" << std::endl;
+		LOG_DEBUG << "Connection error/hangup (fd: " << fd << ")" << std::endl;
 		closeConnection(fd);
 		return;
 	}
@@ -346,7 +497,7 @@ void ServerManager::handleClientSocket(int fd, short revents) {
 	// Handle reading
 	if (revents & POLLIN) {
 		if (!conn->readRequest()) {
-			Logger::debug << "Error reading request (fd: " << fd << ")" << std::endl;
+			LOG_DEBUG << "Error reading request (fd: " << fd << ")" << std::endl;
 			closeConnection(fd);
 			return;
 		}
@@ -354,12 +505,10 @@ void ServerManager::handleClientSocket(int fd, short revents) {
 
 	// Handle writing
 	if (revents & POLLOUT) {
-		if (conn->getState() == Connection::WRITING_RESPONSE) {
-			if (!conn->writeResponse()) {
-				Logger::debug << "Error writing response (fd: " << fd << ")" << std::endl;
-				closeConnection(fd);
-				return;
-			}
+		if (!conn->writeResponse()) {
+			LOG_DEBUG << "Error writing response (fd: " << fd << ")" << std::endl;
+			closeConnection(fd);
+			return;
 		}
 	}
 
@@ -373,7 +522,7 @@ void ServerManager::handleClientSocket(int fd, short revents) {
 void ServerManager::closeConnection(int fd) {
 	std::map<int, Connection*>::iterator it = _connections.find(fd);
 	if (it != _connections.end()) {
-		Logger::debug << "Closing connection (fd: " << fd << ")" << std::endl;
+		LOG_DEBUG << "Closing connection (fd: " << fd << ")" << std::endl;
 		delete it->second;
 		_connections.erase(it);
 	}
@@ -386,7 +535,7 @@ void ServerManager::cleanupTimedOutConnections() {
 	for (std::map<int, Connection*>::iterator it = _connections.begin();
 	     it != _connections.end(); ++it) {
 		if (it->second->isTimedOut(_timeout)) {
-			Logger::warning << "Connection timed out (fd: " << it->first << ")" << std::endl;
+			LOG_WARNING << "Connection timed out (fd: " << it->first << ")" << std::endl;
 			toClose.push_back(it->first);
 		}
 	}
@@ -396,6 +545,71 @@ void ServerManager::cleanupTimedOutConnections() {
 	}
 }
 
+// Serve the requests held back by limit_req whose delay is over
+void ServerManager::resumeDelayedConnections() {
+	double now = Clock::monotonic();
+	if (_nextResume == 0 || now < _nextResume) {
+		return;
+	}
+
+	std::vector<int> toClose;
+	for (std::map<int, Connection*>::iterator it = _connections.begin();
+	     it != _connections.end(); ++it) {
+		Connection* conn = it->second;
+		if (conn->getState() == Connection::DELAYED && conn->getResumeTime() <= now) {
+			conn->resume();
+			if (conn->shouldClose()) {
+				toClose.push_back(it->first);
+			}
+		}
+	}
+	for (size_t i = 0; i < toClose.size(); ++i) {
+		closeConnection(toClose[i]);
+	}
+	_nextResume = 0; // Recomputed by rebuildPollFds()
+}
+
+// Upstream socket event: handed to the connection that proxies through it
+// (unless it was closed earlier in this round)
+void ServerManager::handleUpstreamSocket(size_t index, short revents) {
+	int fd = _upstreamOwners[index - _upstreamStart];
+	std::map<int, Connection*>::iterator it = _connections.find(fd);
+	if (it == _connections.end()) {
+		return;
+	}
+
+	Connection* conn = it->second;
+	conn->handleUpstream(_pollFds[index].fd, revents);
+	if (conn->shouldClose()) {
+		closeConnection(fd);
+	}
+}
+
+// Upstream connects / reads that took longer than proxy_*_timeout
+void ServerManager::expireUpstreams() {
+	double now = Clock::monotonic();
+	if (_nextUpstreamTimeout == 0 || now < _nextUpstreamTimeout) {
+		return;
+	}
+
+	std::vector<int> toClose;
+	for (std::map<int, Connection*>::iterator it = _connections.begin();
+	     it != _connections.end(); ++it) {
+		Connection* conn = it->second;
+		double deadline = conn->getUpstreamDeadline();
+		if (deadline > 0 && deadline <= now) {
+			conn->checkUpstreamTimeouts(now);
+			if (conn->shouldClose()) {
+				toClose.push_back(it->first);
+			}
+		}
+	}
+	for (size_t i = 0; i < toClose.size(); ++i) {
+		closeConnection(toClose[i]);
+	}
+	_nextUpstreamTimeout = 0; // Recomputed by rebuildPollFds()
+}
+
 // Cleanup all connections
 void ServerManager::cleanupAllConnections() {
 	for (std::map<int, Connection*>::iterator it = _connections.begin();
@@ -0,0 +1,73 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   SharedBuffer.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:20:05 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 14:20:06 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * SharedBuffer.cpp
+ * Implementation of the reference-counted buffer
+ */
+#include "includes/http/SharedBuffer.hpp"
+
+namespace HTTP {
+
+SharedBuffer::SharedBuffer()
+	: _block(NULL) {
+}
+
+SharedBuffer::SharedBuffer(const SharedBuffer& other)
+	: _block(other._block) {
+	if (_block) {
+		++_block->refs;
+	}
+}
+
+SharedBuffer& SharedBuffer::operator=(const SharedBuffer& other) {
+	if (_block != other._block) {
+		release();
+		_block = other._block;
+		if (_block) {
+			++_block->refs;
+		}
+	}
+	return *this;
+}
+
+SharedBuffer::~SharedBuffer() {
+	release();
+}
+
+void SharedBuffer::adopt(std::string& data) {
+	release();
+	_block = new Block();
+	_block->bytes.swap(data);
+	_block->refs = 1;
+}
+
+void SharedBuffer::release() {
+	if (_block && --_block->refs == 0) {
+		delete _block;
+	}
+	_block = NULL;
+}
+
+const char* SharedBuffer::data() const {
+	return _block ? _block->bytes.data() : "";
+}
+
+size_t SharedBuffer::size() const {
+	return _block ? _block->bytes.size() : 0;
+}
+
+bool SharedBuffer::empty() const {
+	return size() == 0;
+}
+
+} // namespace HTTP
@@ -0,0 +1,355 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Upstreams.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 17:52:40 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 17:52:41 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Upstreams.cpp
+ * Implementation of the proxy_pass peers and their connection pools
+ */
+
+#include "includes/http/Upstreams.hpp"
+#include "includes/config/Config.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+namespace HTTP {
+
+Upstreams::Upstreams()
+	: _lastTick(0)
+	, _connects(0)
+	, _reused(0)
+	, _failures(0) {
+}
+
+Upstreams::~Upstreams() {
+	closeIdle();
+}
+
+bool Upstreams::open(const Config& config) {
+	closeIdle();
+	_upstreams.clear();
+
+	const std::vector<UpstreamSettings>& settings = config.getUpstreams();
+	_upstreams.resize(settings.size());
+	for (size_t i = 0; i < settings.size(); ++i) {
+		Upstream& upstream = _upstreams[i];
+		upstream.name = settings[i].name;
+		upstream.balance = settings[i].balance;
+		upstream.hashUri = settings[i].hashUri;
+		upstream.keepalive = settings[i].keepalive;
+		upstream.keepaliveTimeout = settings[i].keepaliveTimeout;
+
+		for (size_t j = 0; j < settings[i].peers.size(); ++j) {
+			const UpstreamPeerSettings& peerSettings = settings[i].peers[j];
+			std::ostringstream name;
+			name << peerSettings.host << ":" << peerSettings.port;
+
+			// Resolved once, at startup (IPv4, like the listeners)
+			struct addrinfo hints;
+			std::memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+			struct addrinfo* result = NULL;
+			int error = getaddrinfo(peerSettings.host.c_str(), NULL, &hints, &result);
+			if (error != 0 || !result) {
+				LOG_ERROR << "Upstream " << upstream.name << ": can't resolve "
+				          << Logger::param(peerSettings.host) << ": " << gai_strerror(error) << std::endl;
+				return false;
+			}
+
+			Peer peer;
+			peer.name = name.str();
+			std::memcpy(&peer.addr, result->ai_addr, sizeof(peer.addr));
+			peer.addr.sin_port = htons(static_cast<unsigned short>(peerSettings.port));
+			freeaddrinfo(result);
+			peer.weight = peerSettings.weight;
+			peer.maxFails = peerSettings.maxFails;
+			peer.failTimeout = peerSettings.failTimeout;
+			peer.currentWeight = 0;
+			peer.active = 0;
+			peer.fails = 0;
+			peer.failedAt = 0;
+			peer.downUntil = 0;
+			upstream.peers.push_back(peer);
+		}
+		LOG_DEBUG << "Upstream " << upstream.name << ": " << upstream.peers.size()
+		          << " server(s), keepalive " << upstream.keepalive << std::endl;
+	}
+	return true;
+}
+
+// Marked down by max_fails? (a single peer is always tried, as in nginx)
+bool Upstreams::isAvailable(const Upstream& upstream, const Peer& peer, double now) const {
+	return upstream.peers.size() == 1 || peer.downUntil <= now;
+}
+
+int Upstreams::select(int upstream, const std::string& clientAddress, const std::string& uri,
+                      const std::vector<bool>& tried) {
+	Upstream& group = _upstreams[upstream];
+	double now = Clock::monotonic();
+	switch (group.balance) {
+		case UpstreamSettings::BALANCE_LEAST_CONN:
+			return selectLeastConn(group, tried, now);
+		case UpstreamSettings::BALANCE_HASH:
+			return selectHash(group, group.hashUri ? uri : clientAddress, tried, now);
+		default:
+			return selectRoundRobin(group, tried, now);
+	}
+}
+
+// Smooth weighted round-robin (nginx): every pick adds each peer's weight
+// to its current weight and takes the highest, which then pays the total
+int Upstreams::selectRoundRobin(Upstream& upstream, const std::vector<bool>& tried, double now) {
+	int best = -1;
+	int total = 0;
+	for (size_t i = 0; i < upstream.peers.size(); ++i) {
+		Peer& peer = upstream.peers[i];
+		if (tried[i] || !isAvailable(upstream, peer, now)) {
+			continue;
+		}
+		peer.currentWeight += peer.weight;
+		total += peer.weight;
+		if (best < 0 || peer.currentWeight > upstream.peers[best].currentWeight) {
+			best = static_cast<int>(i);
+		}
+	}
+	if (best >= 0) {
+		upstream.peers[best].currentWeight -= total;
+	}
+	return best;
+}
+
+// Fewest requests in progress relative to the weight; ties go round-robin
+int Upstreams::selectLeastConn(Upstream& upstream, const std::vector<bool>& tried, double now) {
+	int best = -1;
+	size_t ties = 0;
+	for (size_t i = 0; i < upstream.peers.size(); ++i) {
+		const Peer& peer = upstream.peers[i];
+		if (tried[i] || !isAvailable(upstream, peer, now)) {
+			continue;
+		}
+		if (best >= 0) {
+			const Peer& current = upstream.peers[best];
+			unsigned long mine = static_cast<unsigned long>(peer.active) * current.weight;
+			unsigned long theirs = static_cast<unsigned long>(current.active) * peer.weight;
+			if (mine > theirs) {
+				continue;
+			}
+			if (mine == theirs) {
+				++ties;
+				continue;
+			}
+		}
+		best = static_cast<int>(i);
+		ties = 0;
+	}
+	if (best < 0 || ties == 0) {
+		return best;
+	}
+
+	// Several peers equally loaded: round-robin among them
+	std::vector<bool> others(tried);
+	const Peer& chosen = upstream.peers[best];
+	for (size_t i = 0; i < upstream.peers.size(); ++i) {
+		const Peer& peer = upstream.peers[i];
+		if (static_cast<unsigned long>(peer.active) * chosen.weight !=
+		    static_cast<unsigned long>(chosen.active) * peer.weight) {
+			others[i] = true;
+		}
+	}
+	return selectRoundRobin(upstream, others, now);
+}
+
+// FNV-1a of the key picks the peer; if it is down (or already tried) the
+// next one in order takes its requests, so the other keys don't move
+int Upstreams::selectHash(Upstream& upstream, const std::string& key, const std::vector<bool>& tried,
+                          double now) {
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < key.length(); ++i) {
+		hash ^= static_cast<unsigned char>(key[i]);
+		hash *= 16777619u;
+	}
+	size_t count = upstream.peers.size();
+	for (size_t i = 0; i < count; ++i) {
+		size_t index = (hash + i) % count;
+		if (!tried[index] && isAvailable(upstream, upstream.peers[index], now)) {
+			return static_cast<int>(index);
+		}
+	}
+	return -1;
+}
+
+int Upstreams::connect(int upstream, int peer, bool& reused) {
+	Upstream& group = _upstreams[upstream];
+	Peer& target = group.peers[peer];
+
+	// Most recently released connection to this peer that is still open:
+	// an idle connection has nothing to read unless the peer closed it
+	reused = false;
+	std::list<Idle>::iterator it = group.idle.begin();
+	while (it != group.idle.end()) {
+		if (it->peer != peer) {
+			++it;
+			continue;
+		}
+		int fd = it->fd;
+		it = group.idle.erase(it);
+		char byte;
+		ssize_t peeked = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+		if (peeked < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			reused = true;
+			++target.active;
+			++_reused;
+			return fd;
+		}
+		::close(fd);
+	}
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		LOG_ERROR << "Upstream socket() failed: " << Logger::errstr() << std::endl;
+		return -1;
+	}
+	int flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	int enable = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+	if (::connect(fd, reinterpret_cast<const struct sockaddr*>(&target.addr), sizeof(target.addr)) < 0 &&
+	    errno != EINPROGRESS) {
+		LOG_WARNING << "connect() to upstream " << target.name << " failed: "
+		            << Logger::errstr() << std::endl;
+		::close(fd);
+		return -1;
+	}
+	++target.active;
+	++_connects;
+	return fd;
+}
+
+void Upstreams::release(int upstream, int peer, int fd, bool keepAlive) {
+	Upstream& group = _upstreams[upstream];
+	Peer& target = group.peers[peer];
+	if (target.active > 0) {
+		--target.active;
+	}
+	if (fd < 0) {
+		return;
+	}
+	if (!keepAlive || group.keepalive == 0) {
+		::close(fd);
+		return;
+	}
+
+	Idle idle;
+	idle.fd = fd;
+	idle.peer = peer;
+	idle.since = Clock::monotonic();
+	group.idle.push_front(idle);
+
+	// Pool full: the connection idle for the longest goes
+	if (group.idle.size() > group.keepalive) {
+		::close(group.idle.back().fd);
+		group.idle.pop_back();
+	}
+}
+
+void Upstreams::failed(int upstream, int peer) {
+	Upstream& group = _upstreams[upstream];
+	Peer& target = group.peers[peer];
+	double now = Clock::monotonic();
+	++_failures;
+
+	// Failures older than fail_timeout no longer count
+	if (now - target.failedAt > target.failTimeout) {
+		target.fails = 0;
+	}
+	++target.fails;
+	target.failedAt = now;
+
+	if (target.maxFails > 0 && target.fails >= target.maxFails && group.peers.size() > 1) {
+		target.downUntil = now + target.failTimeout;
+		target.fails = 0;
+		LOG_WARNING << "Upstream " << group.name << ": " << target.name
+		            << " marked down for " << target.failTimeout << "s" << std::endl;
+	}
+}
+
+void Upstreams::succeeded(int upstream, int peer) {
+	_upstreams[upstream].peers[peer].fails = 0;
+}
+
+const std::string& Upstreams::getName(int upstream) const {
+	return _upstreams[upstream].name;
+}
+
+bool Upstreams::keepsAlive(int upstream) const {
+	return _upstreams[upstream].keepalive > 0;
+}
+
+size_t Upstreams::getPeerCount(int upstream) const {
+	return _upstreams[upstream].peers.size();
+}
+
+const std::string& Upstreams::getPeerName(int upstream, int peer) const {
+	return _upstreams[upstream].peers[peer].name;
+}
+
+void Upstreams::tick() {
+	double now = Clock::monotonic();
+	if (now - _lastTick < 1) {
+		return;
+	}
+	_lastTick = now;
+
+	// Oldest at the back
+	for (size_t i = 0; i < _upstreams.size(); ++i) {
+		std::list<Idle>& idle = _upstreams[i].idle;
+		while (!idle.empty() && now - idle.back().since > _upstreams[i].keepaliveTimeout) {
+			::close(idle.back().fd);
+			idle.pop_back();
+		}
+	}
+}
+
+void Upstreams::closeIdle() {
+	for (size_t i = 0; i < _upstreams.size(); ++i) {
+		std::list<Idle>& idle = _upstreams[i].idle;
+		for (std::list<Idle>::iterator it = idle.begin(); it != idle.end(); ++it) {
+			::close(it->fd);
+		}
+		idle.clear();
+	}
+}
+
+// Statistics
+size_t Upstreams::getConnects() const {
+	return _connects;
+}
+
+size_t Upstreams::getReused() const {
+	return _reused;
+}
+
+size_t Upstreams::getFailures() const {
+	return _failures;
+}
+
+} // namespace HTTP
@@ -0,0 +1,451 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Hpack.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:05:12 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 13:05:13 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Hpack.cpp
+ * Implementation of the HPACK decoder and encoder
+ */
+#include "includes/http2/Hpack.hpp"
+
+namespace HTTP2 {
+
+namespace {
+
+struct StaticEntry {
+	const char* name;
+	const char* value;
+};
+
+// RFC 7541 Appendix A (index 1 is the first entry)
+const StaticEntry STATIC_TABLE[] = {
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+};
+const size_t STATIC_TABLE_SIZE = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+struct HuffmanCode {
+	unsigned int code;
+	int bits;
+};
+
+// RFC 7541 Appendix B, indexed by symbol (256 is EOS)
+const HuffmanCode HUFFMAN_CODES[257] = {
+	{ 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+	{ 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+	{ 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+	{ 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+	{ 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+	{ 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+	{ 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+	{ 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+	{ 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+	{ 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+	{ 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+	{ 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+	{ 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+	{ 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+	{ 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+	{ 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+	{ 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+	{ 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+	{ 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+	{ 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+	{ 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+	{ 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+	{ 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+	{ 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+	{ 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+	{ 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+	{ 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+	{ 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+	{ 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+	{ 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+	{ 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+	{ 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+	{ 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+	{ 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+	{ 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+	{ 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+	{ 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+	{ 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+	{ 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+	{ 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+	{ 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+	{ 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+	{ 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+	{ 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+	{ 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+	{ 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+	{ 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+	{ 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+	{ 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+	{ 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+	{ 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+	{ 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+	{ 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+	{ 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+	{ 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+	{ 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+	{ 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+	{ 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+	{ 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+	{ 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+	{ 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+	{ 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+	{ 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+	{ 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+	{ 0x3fffffff, 30 },
+};
+
+// Binary decoding tree built from the code table on first use
+struct HuffmanNode {
+	short child[2];   // Node indices, 0 = none (the root is never a child)
+	short symbol;     // Leaf symbol, -1 for inner nodes
+};
+
+HuffmanNode huffmanTree[512];
+bool huffmanTreeBuilt = false;
+
+void buildHuffmanTree() {
+	int nodeCount = 1;
+	huffmanTree[0].child[0] = 0;
+	huffmanTree[0].child[1] = 0;
+	huffmanTree[0].symbol = -1;
+
+	for (int symbol = 0; symbol < 257; ++symbol) {
+		int node = 0;
+		for (int bit = HUFFMAN_CODES[symbol].bits - 1; bit >= 0; --bit) {
+			int branch = (HUFFMAN_CODES[symbol].code >> bit) & 1;
+			if (huffmanTree[node].child[branch] == 0) {
+				huffmanTree[nodeCount].child[0] = 0;
+				huffmanTree[nodeCount].child[1] = 0;
+				huffmanTree[nodeCount].symbol = -1;
+				huffmanTree[node].child[branch] = static_cast<short>(nodeCount++);
+			}
+			node = huffmanTree[node].child[branch];
+		}
+		huffmanTree[node].symbol = static_cast<short>(symbol);
+	}
+	huffmanTreeBuilt = true;
+}
+
+// Entry size as defined by RFC 7541 section 4.1
+size_t entrySize(const Header& header) {
+	return header.first.length() + header.second.length() + 32;
+}
+
+bool decodeString(const unsigned char*& pos, const unsigned char* end, std::string& out) {
+	if (pos >= end) {
+		return false;
+	}
+	bool huffman = (*pos & 0x80) != 0;
+	size_t length;
+	if (!decodeInteger(pos, end, 7, length) || length > static_cast<size_t>(end - pos)) {
+		return false;
+	}
+
+	out.clear();
+	if (huffman) {
+		if (!huffmanDecode(pos, length, out)) {
+			return false;
+		}
+	} else {
+		out.assign(reinterpret_cast<const char*>(pos), length);
+	}
+	pos += length;
+	return true;
+}
+
+} // namespace
+
+// Primitive representations
+bool decodeInteger(const unsigned char*& pos, const unsigned char* end, int prefixBits, size_t& value) {
+	if (pos >= end) {
+		return false;
+	}
+	size_t limit = (1u << prefixBits) - 1;
+	value = *pos++ & limit;
+	if (value < limit) {
+		return true;
+	}
+
+	int shift = 0;
+	while (pos < end) {
+		unsigned char byte = *pos++;
+		if (shift > 28) {
+			return false; // Larger than anything we'd accept
+		}
+		value += static_cast<size_t>(byte & 0x7f) << shift;
+		shift += 7;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void encodeInteger(std::string& out, unsigned char firstByte, int prefixBits, size_t value) {
+	size_t limit = (1u << prefixBits) - 1;
+	if (value < limit) {
+		out += static_cast<char>(firstByte | value);
+		return;
+	}
+	out += static_cast<char>(firstByte | limit);
+	value -= limit;
+	while (value >= 0x80) {
+		out += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	out += static_cast<char>(value);
+}
+
+bool huffmanDecode(const unsigned char* data, size_t length, std::string& out) {
+	if (!huffmanTreeBuilt) {
+		buildHuffmanTree();
+	}
+
+	int node = 0;
+	int pendingBits = 0;     // Bits read since the last complete symbol
+	bool pendingOnes = true; // ...and whether they were all 1s
+
+	for (size_t i = 0; i < length; ++i) {
+		for (int bit = 7; bit >= 0; --bit) {
+			int branch = (data[i] >> bit) & 1;
+			node = huffmanTree[node].child[branch];
+			if (node == 0) {
+				return false;
+			}
+			++pendingBits;
+			pendingOnes = pendingOnes && branch;
+
+			if (huffmanTree[node].symbol >= 0) {
+				if (huffmanTree[node].symbol == 256) {
+					return false; // EOS inside a string is an error
+				}
+				out += static_cast<char>(huffmanTree[node].symbol);
+				node = 0;
+				pendingBits = 0;
+				pendingOnes = true;
+			}
+		}
+	}
+
+	// Padding must be a prefix of EOS (all 1s) and shorter than a byte
+	return pendingBits < 8 && pendingOnes;
+}
+
+// Decoder
+HpackDecoder::HpackDecoder()
+	: _tableSize(0)
+	, _tableCapacity(4096)
+	, _maxTableSize(4096) {
+}
+
+void HpackDecoder::setMaxTableSize(size_t size) {
+	_maxTableSize = size;
+	if (_tableCapacity > size) {
+		_tableCapacity = size;
+		evict(size);
+	}
+}
+
+bool HpackDecoder::decode(const std::string& block, HeaderList& headers) {
+	const unsigned char* pos = reinterpret_cast<const unsigned char*>(block.data());
+	const unsigned char* end = pos + block.length();
+	size_t listSize = 0;
+	bool headerSeen = false;
+
+	while (pos < end) {
+		unsigned char first = *pos;
+		Header header;
+
+		if (first & 0x80) {
+			// Indexed header field
+			size_t index;
+			if (!decodeInteger(pos, end, 7, index) || !lookup(index, header)) {
+				return false;
+			}
+		} else if ((first & 0xe0) == 0x20) {
+			// Dynamic table size update, only allowed before the first field
+			size_t size;
+			if (headerSeen || !decodeInteger(pos, end, 5, size) || size > _maxTableSize) {
+				return false;
+			}
+			_tableCapacity = size;
+			evict(size);
+			continue;
+		} else {
+			// Literal: with incremental indexing (01), without (0000) or never indexed (0001)
+			bool indexing = (first & 0xc0) == 0x40;
+			size_t index;
+			if (!decodeInteger(pos, end, indexing ? 6 : 4, index)) {
+				return false;
+			}
+			if (index == 0) {
+				if (!decodeString(pos, end, header.first)) {
+					return false;
+				}
+			} else {
+				Header named;
+				if (!lookup(index, named)) {
+					return false;
+				}
+				header.first = named.first;
+			}
+			if (!decodeString(pos, end, header.second)) {
+				return false;
+			}
+			if (indexing) {
+				insert(header);
+			}
+		}
+
+		headerSeen = true;
+		listSize += entrySize(header);
+		if (listSize > MAX_HEADER_LIST_SIZE) {
+			return false;
+		}
+		headers.push_back(header);
+	}
+	return true;
+}
+
+bool HpackDecoder::lookup(size_t index, Header& header) const {
+	if (index == 0) {
+		return false;
+	}
+	if (index <= STATIC_TABLE_SIZE) {
+		header.first = STATIC_TABLE[index - 1].name;
+		header.second = STATIC_TABLE[index - 1].value;
+		return true;
+	}
+	index -= STATIC_TABLE_SIZE + 1;
+	if (index >= _table.size()) {
+		return false;
+	}
+	header = _table[index];
+	return true;
+}
+
+void HpackDecoder::insert(const Header& header) {
+	size_t size = entrySize(header);
+	if (size > _tableCapacity) {
+		// Too large for the table: it just empties it (RFC 7541 section 4.4)
+		_table.clear();
+		_tableSize = 0;
+		return;
+	}
+	evict(_tableCapacity - size);
+	_table.push_front(header);
+	_tableSize += size;
+}
+
+// Drop the oldest entries until the table fits in `capacity`
+void HpackDecoder::evict(size_t capacity) {
+	while (!_table.empty() && _tableSize > capacity) {
+		_tableSize -= entrySize(_table.back());
+		_table.pop_back();
+	}
+}
+
+// Encoder
+void HpackEncoder::encode(const HeaderList& headers, std::string& block) const {
+	for (HeaderList::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+		size_t nameIndex = 0;
+		size_t fullIndex = 0;
+		for (size_t i = 0; i < STATIC_TABLE_SIZE && !fullIndex; ++i) {
+			if (it->first == STATIC_TABLE[i].name) {
+				if (!nameIndex) {
+					nameIndex = i + 1;
+				}
+				if (it->second == STATIC_TABLE[i].value) {
+					fullIndex = i + 1;
+				}
+			}
+		}
+
+		if (fullIndex) {
+			encodeInteger(block, 0x80, 7, fullIndex);
+			continue;
+		}
+
+		// Literal header field without indexing
+		encodeInteger(block, 0x00, 4, nameIndex);
+		if (!nameIndex) {
+			encodeInteger(block, 0x00, 7, it->first.length());
+			block += it->first;
+		}
+		encodeInteger(block, 0x00, 7, it->second.length());
+		block += it->second;
+	}
+}
+
+} // namespace HTTP2
@@ -0,0 +1,1185 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Session.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:05:12 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 13:05:13 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Session.cpp
+ * Implementation of the HTTP/2 session
+ */
+#include "includes/http2/Session.hpp"
+#include "includes/http/RequestHandler.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/http/ErrorPages.hpp"
+#include "includes/config/Server.hpp"
+#include "includes/config/VirtualHostTable.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/core/Instance.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sstream>
+#include <cctype>
+
+namespace HTTP2 {
+
+const char Session::PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+namespace {
+
+const long MAX_WINDOW_SIZE = 0x7fffffff;
+const long DEFAULT_WINDOW_SIZE = 65535;
+
+unsigned long readUint32(const std::string& data, size_t pos) {
+	return (static_cast<unsigned long>(static_cast<unsigned char>(data[pos])) << 24) |
+	       (static_cast<unsigned long>(static_cast<unsigned char>(data[pos + 1])) << 16) |
+	       (static_cast<unsigned long>(static_cast<unsigned char>(data[pos + 2])) << 8) |
+	       static_cast<unsigned long>(static_cast<unsigned char>(data[pos + 3]));
+}
+
+void appendUint32(std::string& out, unsigned long value) {
+	out += static_cast<char>((value >> 24) & 0xff);
+	out += static_cast<char>((value >> 16) & 0xff);
+	out += static_cast<char>((value >> 8) & 0xff);
+	out += static_cast<char>(value & 0xff);
+}
+
+void appendSetting(std::string& out, int id, unsigned long value) {
+	out += static_cast<char>((id >> 8) & 0xff);
+	out += static_cast<char>(id & 0xff);
+	appendUint32(out, value);
+}
+
+// 9-byte frame header (RFC 7540 section 4.1)
+void putFrameHeader(char* out, size_t length, int type, int flags, unsigned int streamId) {
+	out[0] = static_cast<char>((length >> 16) & 0xff);
+	out[1] = static_cast<char>((length >> 8) & 0xff);
+	out[2] = static_cast<char>(length & 0xff);
+	out[3] = static_cast<char>(type);
+	out[4] = static_cast<char>(flags);
+	out[5] = static_cast<char>((streamId >> 24) & 0x7f);
+	out[6] = static_cast<char>((streamId >> 16) & 0xff);
+	out[7] = static_cast<char>((streamId >> 8) & 0xff);
+	out[8] = static_cast<char>(streamId & 0xff);
+}
+
+// HTTP2-Settings carries a base64url SETTINGS payload without padding
+bool decodeBase64Url(const std::string& input, std::string& output) {
+	unsigned long buffer = 0;
+	int bits = 0;
+
+	output.clear();
+	for (size_t i = 0; i < input.length(); ++i) {
+		char c = input[i];
+		int value;
+		if (c >= 'A' && c <= 'Z') value = c - 'A';
+		else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+		else if (c >= '0' && c <= '9') value = c - '0' + 52;
+		else if (c == '-' || c == '+') value = 62;
+		else if (c == '_' || c == '/') value = 63;
+		else if (c == '=') break;
+		else return false;
+
+		buffer = (buffer << 6) | value;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			output += static_cast<char>((buffer >> bits) & 0xff);
+		}
+	}
+	return true;
+}
+
+std::string toString(size_t value) {
+	std::ostringstream oss;
+	oss << value;
+	return oss.str();
+}
+
+// Does a comma-separated header value contain `token`? (case-insensitive)
+bool hasToken(const std::string& value, const std::string& token) {
+	size_t start = 0;
+	while (start <= value.length()) {
+		size_t end = value.find(',', start);
+		if (end == std::string::npos) {
+			end = value.length();
+		}
+		size_t first = start;
+		size_t last = end;
+		while (first < last && (value[first] == ' ' || value[first] == '\t')) ++first;
+		while (last > first && (value[last - 1] == ' ' || value[last - 1] == '\t')) --last;
+		if (last - first == token.length()) {
+			size_t i = 0;
+			while (i < token.length() && std::tolower(value[first + i]) == token[i]) ++i;
+			if (i == token.length()) {
+				return true;
+			}
+		}
+		start = end + 1;
+	}
+	return false;
+}
+
+// Hop-by-hop fields have no meaning in HTTP/2 (RFC 7540 section 8.1.2.2)
+bool isConnectionSpecific(const std::string& name) {
+	return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+	       name == "transfer-encoding" || name == "upgrade";
+}
+
+} // namespace
+
+// Stream
+Session::Stream::Stream(unsigned int streamId, long window)
+	: id(streamId)
+	, remoteClosed(false)
+	, endStreamPending(false)
+	, trailers(false)
+	, pendingReset(-1)
+	, responding(false)
+	, discardBody(false)
+	, server(NULL)
+	, sendWindow(window)
+	, recvUnacked(0)
+	, segmentIndex(0)
+	, segmentOffset(0)
+	, fileFd(-1)
+	, proxy(NULL) {
+	record.mark(HTTP::RequestRecord::PHASE_FIRST_BYTE);
+}
+
+// Constructor
+Session::Session(int fd, const VirtualHostTable* virtualHosts, const std::string& clientHost,
+                 in_addr_t clientAddress, bool secure)
+	: _fd(fd)
+	, _virtualHosts(virtualHosts)
+	, _clientHost(clientHost)
+	, _clientAddress(clientAddress)
+	, _secure(secure)
+	, _prefaceReceived(false)
+	, _settingsSent(false)
+	, _settingsReceived(false)
+	, _goawaySent(false)
+	, _goawayReceived(false)
+	, _lastStreamId(0)
+	, _continuationStream(0)
+	, _lastServed(0)
+	, _connSendWindow(DEFAULT_WINDOW_SIZE)
+	, _peerInitialWindow(DEFAULT_WINDOW_SIZE)
+	, _peerMaxFrameSize(16384)
+	, _connRecvUnacked(0) {
+
+	LOG_DEBUG << "HTTP/2 session started (fd: " << _fd << ")" << std::endl;
+}
+
+Session::~Session() {
+	while (!_streams.empty()) {
+		closeStream(_streams.begin()->first);
+	}
+}
+
+// Upgrade from HTTP/1.1
+bool Session::isUpgradeRequest(const HTTP::Request& request) {
+	std::string settings;
+	return request.getVersion() == "HTTP/1.1" &&
+	       hasToken(request.getHeader("upgrade"), "h2c") &&
+	       hasToken(request.getHeader("connection"), "http2-settings") &&
+	       decodeBase64Url(request.getHeader("http2-settings"), settings) &&
+	       request.getBody().empty() && request.getContentLength() == 0 && !request.isChunked();
+}
+
+void Session::upgrade(const HTTP::Request& request) {
+	std::string settings;
+	decodeBase64Url(request.getHeader("http2-settings"), settings);
+
+	LOG_INFO << "Upgrading connection to h2c (fd: " << _fd << ")" << std::endl;
+	_out += "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+	writeSettings();
+	if (!applySettings(settings)) {
+		return;
+	}
+
+	// The upgraded request becomes stream 1, already half-closed by the client
+	Stream* stream = new Stream(1, _peerInitialWindow);
+	stream->record.remoteAddr = _clientHost;
+	stream->remoteClosed = true;
+	stream->server = selectServer(request.getHeader("host"));
+	_streams[1] = stream;
+	_lastStreamId = 1;
+	serve(stream, request);
+}
+
+// Input
+void Session::receive(const char* data, size_t length) {
+	if (_goawaySent) {
+		return; // Nothing is processed after a connection error
+	}
+	_in.append(data, length);
+
+	if (!_prefaceReceived) {
+		size_t compared = _in.size() < PREFACE_LENGTH ? _in.size() : PREFACE_LENGTH;
+		if (_in.compare(0, compared, PREFACE, compared) != 0) {
+			connectionError(PROTOCOL_ERROR, "invalid connection preface");
+			return;
+		}
+		if (_in.size() < PREFACE_LENGTH) {
+			return;
+		}
+		_in.erase(0, PREFACE_LENGTH);
+		_prefaceReceived = true;
+		if (!_settingsSent) {
+			writeSettings();
+		}
+	}
+
+	size_t pos = 0;
+	while (_in.size() - pos >= 9) {
+		const unsigned char* header = reinterpret_cast<const unsigned char*>(_in.data() + pos);
+		size_t frameLength = (header[0] << 16) | (header[1] << 8) | header[2];
+		int type = header[3];
+		int flags = header[4];
+		unsigned int streamId = static_cast<unsigned int>(readUint32(_in, pos + 5) & 0x7fffffff);
+
+		if (frameLength > MAX_FRAME_SIZE) {
+			connectionError(FRAME_SIZE_ERROR, "frame larger than SETTINGS_MAX_FRAME_SIZE");
+			return;
+		}
+		if (_in.size() - pos - 9 < frameLength) {
+			break; // Incomplete frame
+		}
+
+		std::string payload = _in.substr(pos + 9, frameLength);
+		pos += 9 + frameLength;
+		if (!processFrame(type, flags, streamId, payload)) {
+			_in.clear();
+			return;
+		}
+	}
+	_in.erase(0, pos);
+}
+
+bool Session::processFrame(int type, int flags, unsigned int streamId, const std::string& payload) {
+	LOG_DEBUG << "HTTP/2 frame type " << type << " flags 0x" << std::hex << flags << std::dec
+	          << " stream " << streamId << " length " << payload.size()
+	          << " (fd: " << _fd << ")" << std::endl;
+
+	if (!_settingsReceived && type != SETTINGS) {
+		return connectionError(PROTOCOL_ERROR, "first frame is not SETTINGS");
+	}
+	if (_continuationStream && type != CONTINUATION) {
+		return connectionError(PROTOCOL_ERROR, "header block interrupted");
+	}
+
+	switch (type) {
+	case DATA:
+		return handleData(flags, streamId, payload);
+	case HEADERS:
+		return handleHeaders(flags, streamId, payload);
+	case CONTINUATION:
+		return handleContinuation(flags, streamId, payload);
+	case SETTINGS:
+		return handleSettings(flags, streamId, payload);
+	case WINDOW_UPDATE:
+		return handleWindowUpdate(streamId, payload);
+	case RST_STREAM:
+		return handleRstStream(streamId, payload);
+	case PRIORITY:
+		// Prioritization is advisory, streams are served round-robin
+		if (streamId == 0) {
+			return connectionError(PROTOCOL_ERROR, "PRIORITY on stream 0");
+		}
+		if (payload.size() != 5) {
+			resetStream(streamId, FRAME_SIZE_ERROR);
+		}
+		return true;
+	case PUSH_PROMISE:
+		return connectionError(PROTOCOL_ERROR, "client sent PUSH_PROMISE");
+	case PING:
+		if (streamId != 0) {
+			return connectionError(PROTOCOL_ERROR, "PING on a stream");
+		}
+		if (payload.size() != 8) {
+			return connectionError(FRAME_SIZE_ERROR, "invalid PING length");
+		}
+		if (!(flags & FLAG_ACK)) {
+			writeFrame(PING, FLAG_ACK, 0, payload);
+		}
+		return true;
+	case GOAWAY:
+		if (streamId != 0) {
+			return connectionError(PROTOCOL_ERROR, "GOAWAY on a stream");
+		}
+		LOG_DEBUG << "Client sent GOAWAY (fd: " << _fd << ")" << std::endl;
+		_goawayReceived = true;
+		return true;
+	default:
+		return true; // Unknown frame types are ignored
+	}
+}
+
+bool Session::handleHeaders(int flags, unsigned int streamId, const std::string& payload) {
+	if (streamId == 0 || !(streamId & 1)) {
+		return connectionError(PROTOCOL_ERROR, "HEADERS on an invalid stream");
+	}
+
+	std::string fragment = payload;
+	if (!stripPadding(fragment, flags, (flags & FLAG_PRIORITY) ? 5 : 0)) {
+		return connectionError(PROTOCOL_ERROR, "invalid HEADERS padding");
+	}
+
+	Stream* stream = findStream(streamId);
+	if (stream) {
+		// A second header block on an open stream carries trailers
+		if (stream->remoteClosed) {
+			return connectionError(STREAM_CLOSED, "HEADERS on a half-closed stream");
+		}
+		if (!(flags & FLAG_END_STREAM)) {
+			return connectionError(PROTOCOL_ERROR, "trailers without END_STREAM");
+		}
+		stream->trailers = true;
+	} else {
+		stream = new Stream(streamId, _peerInitialWindow);
+		stream->record.remoteAddr = _clientHost;
+		if (streamId <= _lastStreamId) {
+			// Already closed on our side; decode anyway to keep HPACK in sync
+			stream->pendingReset = STREAM_CLOSED;
+		} else {
+			_lastStreamId = streamId;
+			if (_streams.size() >= MAX_CONCURRENT_STREAMS) {
+				stream->pendingReset = REFUSED_STREAM;
+			}
+		}
+		_streams[streamId] = stream;
+	}
+
+	stream->headerBlock = fragment;
+	stream->endStreamPending = (flags & FLAG_END_STREAM) != 0;
+	if (stream->headerBlock.size() > MAX_HEADER_BLOCK) {
+		return connectionError(ENHANCE_YOUR_CALM, "header block too large");
+	}
+	if (!(flags & FLAG_END_HEADERS)) {
+		_continuationStream = streamId;
+		return true;
+	}
+	return finishHeaderBlock(stream);
+}
+
+bool Session::handleContinuation(int flags, unsigned int streamId, const std::string& payload) {
+	Stream* stream = findStream(streamId);
+	if (streamId == 0 || streamId != _continuationStream || !stream) {
+		return connectionError(PROTOCOL_ERROR, "unexpected CONTINUATION");
+	}
+
+	stream->headerBlock += payload;
+	if (stream->headerBlock.size() > MAX_HEADER_BLOCK) {
+		return connectionError(ENHANCE_YOUR_CALM, "header block too large");
+	}
+	if (!(flags & FLAG_END_HEADERS)) {
+		return true;
+	}
+	return finishHeaderBlock(stream);
+}
+
+// A complete header block arrived: decode it and start (or finish) the request
+bool Session::finishHeaderBlock(Stream* stream) {
+	_continuationStream = 0;
+
+	HeaderList headers;
+	if (!_decoder.decode(stream->headerBlock, headers)) {
+		return connectionError(COMPRESSION_ERROR, "HPACK decoding failed");
+	}
+	stream->headerBlock.clear();
+
+	if (stream->pendingReset >= 0) {
+		resetStream(stream->id, static_cast<ErrorCode>(stream->pendingReset));
+		return true;
+	}
+	if (stream->endStreamPending) {
+		stream->remoteClosed = true;
+	}
+
+	if (stream->trailers) {
+		// Trailer fields are not passed on to the handler
+		if (!stream->discardBody) {
+			dispatch(stream);
+		}
+		return true;
+	}
+
+	stream->headers.swap(headers);
+	stream->record.mark(HTTP::RequestRecord::PHASE_HEADERS);
+	for (HeaderList::const_iterator it = stream->headers.begin(); it != stream->headers.end(); ++it) {
+		if (it->first == ":authority" || it->first == "host") {
+			stream->server = selectServer(it->second);
+			break;
+		}
+	}
+	if (!stream->server) {
+		stream->server = selectServer("");
+	}
+	if (stream->remoteClosed) {
+		dispatch(stream);
+		return true;
+	}
+
+	// A body follows: reject it now if the handler won't take it
+	HTTP::Request request;
+	if (!buildRequest(stream, request)) {
+		LOG_WARNING << "Malformed HTTP/2 request on stream " << stream->id << std::endl;
+		resetStream(stream->id, PROTOCOL_ERROR);
+		return true;
+	}
+	HTTP::RequestHandler handler(stream->server);
+	HTTP::Response rejection;
+	if (!handler.acceptsBody(request, rejection)) {
+		stream->record.setRequest(request);
+		stream->record.routeId = handler.getRoute() ? handler.getRoute()->getMetricsId() : -1;
+		LOG_INFO << "Rejected " << request.getMethod() << " " << request.getPath()
+		         << " before body transfer (status " << rejection.getStatusCode()
+		         << ", stream " << stream->id << ")" << std::endl;
+		stream->discardBody = true;
+		respond(stream, rejection);
+	}
+	return true;
+}
+
+bool Session::handleData(int flags, unsigned int streamId, const std::string& payload) {
+	if (streamId == 0) {
+		return connectionError(PROTOCOL_ERROR, "DATA on stream 0");
+	}
+	if (streamId > _lastStreamId) {
+		return connectionError(PROTOCOL_ERROR, "DATA on an idle stream");
+	}
+
+	// Flow control counts the whole payload, padding included
+	if (_connRecvUnacked + payload.size() > static_cast<size_t>(CONNECTION_WINDOW_SIZE)) {
+		return connectionError(FLOW_CONTROL_ERROR, "connection window exceeded");
+	}
+
+	Stream* stream = findStream(streamId);
+	if (!stream || stream->remoteClosed) {
+		// Frames still in flight for a stream we closed
+		acknowledgeData(NULL, payload.size());
+		if (stream) {
+			resetStream(streamId, STREAM_CLOSED);
+		}
+		return true;
+	}
+	if (stream->recvUnacked + payload.size() > static_cast<size_t>(INITIAL_WINDOW_SIZE)) {
+		acknowledgeData(NULL, payload.size());
+		resetStream(streamId, FLOW_CONTROL_ERROR);
+		return true;
+	}
+
+	std::string data = payload;
+	if (!stripPadding(data, flags, 0)) {
+		return connectionError(PROTOCOL_ERROR, "invalid DATA padding");
+	}
+
+	bool endStream = (flags & FLAG_END_STREAM) != 0;
+	acknowledgeData(endStream ? NULL : stream, payload.size());
+
+	if (!stream->discardBody) {
+		stream->body += data;
+		if (stream->body.size() > stream->server->getMaxBodySize()) {
+			LOG_WARNING << "Request body too large on stream " << streamId << ": more than "
+			            << stream->server->getMaxBodySize() << " bytes" << std::endl;
+			stream->discardBody = true;
+			stream->body.clear();
+			respond(stream, Instance::Get<HTTP::ErrorPages>()->get(stream->server, 413));
+			stream = findStream(streamId);
+		}
+	}
+
+	if (endStream && stream) {
+		stream->remoteClosed = true;
+		if (!stream->discardBody) {
+			dispatch(stream);
+		}
+	}
+	return true;
+}
+
+bool Session::handleSettings(int flags, unsigned int streamId, const std::string& payload) {
+	if (streamId != 0) {
+		return connectionError(PROTOCOL_ERROR, "SETTINGS on a stream");
+	}
+	if (flags & FLAG_ACK) {
+		if (!payload.empty()) {
+			return connectionError(FRAME_SIZE_ERROR, "SETTINGS ACK with payload");
+		}
+		return true;
+	}
+	if (!applySettings(payload)) {
+		return false;
+	}
+	_settingsReceived = true;
+	writeFrame(SETTINGS, FLAG_ACK, 0, "");
+	return true;
+}
+
+bool Session::applySettings(const std::string& payload) {
+	if (payload.size() % 6 != 0) {
+		return connectionError(FRAME_SIZE_ERROR, "invalid SETTINGS length");
+	}
+
+	for (size_t pos = 0; pos < payload.size(); pos += 6) {
+		int id = (static_cast<unsigned char>(payload[pos]) << 8) | static_cast<unsigned char>(payload[pos + 1]);
+		unsigned long value = readUint32(payload, pos + 2);
+
+		switch (id) {
+		case 0x2: // SETTINGS_ENABLE_PUSH (we never push)
+			if (value > 1) {
+				return connectionError(PROTOCOL_ERROR, "invalid SETTINGS_ENABLE_PUSH");
+			}
+			break;
+		case 0x4: { // SETTINGS_INITIAL_WINDOW_SIZE applies to open streams too
+			if (value > static_cast<unsigned long>(MAX_WINDOW_SIZE)) {
+				return connectionError(FLOW_CONTROL_ERROR, "invalid SETTINGS_INITIAL_WINDOW_SIZE");
+			}
+			long delta = static_cast<long>(value) - _peerInitialWindow;
+			for (std::map<unsigned int, Stream*>::iterator it = _streams.begin(); it != _streams.end(); ++it) {
+				it->second->sendWindow += delta;
+				if (it->second->sendWindow > MAX_WINDOW_SIZE) {
+					return connectionError(FLOW_CONTROL_ERROR, "stream window overflow");
+				}
+			}
+			_peerInitialWindow = static_cast<long>(value);
+			break;
+		}
+		case 0x5: // SETTINGS_MAX_FRAME_SIZE
+			if (value < 16384 || value > 16777215) {
+				return connectionError(PROTOCOL_ERROR, "invalid SETTINGS_MAX_FRAME_SIZE");
+			}
+			_peerMaxFrameSize = value;
+			break;
+		default:
+			// HEADER_TABLE_SIZE: our encoder never uses the dynamic table
+			break;
+		}
+	}
+	return true;
+}
+
+bool Session::handleWindowUpdate(unsigned int streamId, const std::string& payload) {
+	if (payload.size() != 4) {
+		return connectionError(FRAME_SIZE_ERROR, "invalid WINDOW_UPDATE length");
+	}
+	long increment = static_cast<long>(readUint32(payload, 0) & 0x7fffffff);
+
+	if (streamId == 0) {
+		if (increment == 0) {
+			return connectionError(PROTOCOL_ERROR, "zero WINDOW_UPDATE increment");
+		}
+		_connSendWindow += increment;
+		if (_connSendWindow > MAX_WINDOW_SIZE) {
+			return connectionError(FLOW_CONTROL_ERROR, "connection window overflow");
+		}
+		return true;
+	}
+
+	Stream* stream = findStream(streamId);
+	if (!stream) {
+		if (streamId > _lastStreamId) {
+			return connectionError(PROTOCOL_ERROR, "WINDOW_UPDATE on an idle stream");
+		}
+		return true;
+	}
+	if (increment == 0) {
+		resetStream(streamId, PROTOCOL_ERROR);
+		return true;
+	}
+	stream->sendWindow += increment;
+	if (stream->sendWindow > MAX_WINDOW_SIZE) {
+		resetStream(streamId, FLOW_CONTROL_ERROR);
+	}
+	return true;
+}
+
+bool Session::handleRstStream(unsigned int streamId, const std::string& payload) {
+	if (streamId == 0 || streamId > _lastStreamId) {
+		return connectionError(PROTOCOL_ERROR, "RST_STREAM on an idle stream");
+	}
+	if (payload.size() != 4) {
+		return connectionError(FRAME_SIZE_ERROR, "invalid RST_STREAM length");
+	}
+	LOG_DEBUG << "Client reset stream " << streamId << " (error " << readUint32(payload, 0)
+	          << ")" << std::endl;
+	closeStream(streamId);
+	return true;
+}
+
+// Send GOAWAY and stop processing; streams in progress are abandoned
+bool Session::connectionError(ErrorCode code, const char* reason) {
+	LOG_WARNING << "HTTP/2 connection error (fd: " << _fd << "): " << reason << std::endl;
+
+	std::string payload;
+	appendUint32(payload, _lastStreamId);
+	appendUint32(payload, code);
+	writeFrame(GOAWAY, 0, 0, payload);
+	_goawaySent = true;
+
+	while (!_streams.empty()) {
+		closeStream(_streams.begin()->first);
+	}
+	return false;
+}
+
+// Remove padding (and `prefix` bytes of fixed fields) from a frame payload
+bool Session::stripPadding(std::string& payload, int flags, size_t prefix) {
+	size_t start = 0;
+	size_t padLength = 0;
+	if (flags & FLAG_PADDED) {
+		if (payload.empty()) {
+			return false;
+		}
+		padLength = static_cast<unsigned char>(payload[0]);
+		start = 1;
+	}
+	start += prefix;
+	if (start + padLength > payload.size()) {
+		return false;
+	}
+	payload = payload.substr(start, payload.size() - start - padLength);
+	return true;
+}
+
+// Streams
+Session::Stream* Session::findStream(unsigned int streamId) {
+	std::map<unsigned int, Stream*>::iterator it = _streams.find(streamId);
+	return it == _streams.end() ? NULL : it->second;
+}
+
+void Session::closeStream(unsigned int streamId) {
+	std::map<unsigned int, Stream*>::iterator it = _streams.find(streamId);
+	if (it == _streams.end()) {
+		return;
+	}
+	if (it->second->fileFd >= 0) {
+		::close(it->second->fileFd);
+	}
+	delete it->second->proxy;
+	if (!it->second->limitSlots.empty()) {
+		Instance::Get<HTTP::RateLimiter>()->release(it->second->limitSlots);
+	}
+	HTTP::RequestRecord& record = it->second->record;
+	if (record.status != 0 && !record.logged) {
+		record.logged = true;
+		Instance::Get<HTTP::Metrics>()->recordRequest(record);
+		Instance::Get<HTTP::AccessLogs>()->write(it->second->server, record);
+	}
+	delete it->second;
+	_streams.erase(it);
+}
+
+void Session::resetStream(unsigned int streamId, ErrorCode code) {
+	std::string payload;
+	appendUint32(payload, code);
+	writeFrame(RST_STREAM, 0, streamId, payload);
+	closeStream(streamId);
+}
+
+// Response fully framed: the stream is done on our side
+void Session::completeStream(Stream* stream) {
+	stream->record.mark(HTTP::RequestRecord::PHASE_LAST_SENT);
+	if (!stream->remoteClosed) {
+		// Answered before the body ended: ask the client to stop sending it
+		resetStream(stream->id, NO_ERROR);
+		return;
+	}
+	closeStream(stream->id);
+}
+
+void Session::dispatch(Stream* stream) {
+	HTTP::Request request;
+	if (!buildRequest(stream, request)) {
+		LOG_WARNING << "Malformed HTTP/2 request on stream " << stream->id << std::endl;
+		resetStream(stream->id, PROTOCOL_ERROR);
+		return;
+	}
+	serve(stream, request);
+}
+
+void Session::serve(Stream* stream, const HTTP::Request& request) {
+	LOG_DEBUG << "HTTP/2 stream " << stream->id << ": " << request.getMethod() << " "
+	          << request.getUri() << " (fd: " << _fd << ")" << std::endl;
+
+	stream->record.setRequest(request);
+	stream->record.mark(HTTP::RequestRecord::PHASE_BODY);
+
+	// Per-client limits; the session has no timers, so a request limit_req
+	// would delay is served right away (it still counts towards the burst)
+	HTTP::RateLimiter* limiter = Instance::Get<HTTP::RateLimiter>();
+	if (limiter->enabled()) {
+		const Route* route = stream->server->matchRoute(request.getPath());
+		const LimitSettings& limits = route ? route->getLimits() : stream->server->getLimits();
+		double delay;
+		int status = limiter->limitRequest(limits, _clientAddress, delay);
+		if (!status) {
+			status = limiter->acquire(limits, _clientAddress, stream->limitSlots);
+		}
+		if (status) {
+			stream->record.routeId = route ? route->getMetricsId() : -1;
+			respond(stream, Instance::Get<HTTP::ErrorPages>()->get(stream->server, status));
+			return;
+		}
+	}
+
+	// proxy_pass: answered as the upstream response comes in
+	const Route* route = stream->server->matchRoute(request.getPath());
+	if (route && route->isProxy() && route->isMethodAllowed(request.getMethod())) {
+		startProxy(stream, request, *route);
+		return;
+	}
+
+	stream->record.mark(HTTP::RequestRecord::PHASE_HANDLER_START);
+	HTTP::RequestHandler handler(stream->server);
+	HTTP::Response response = handler.handle(request);
+	stream->record.handled(response);
+	stream->record.routeId = handler.getRoute() ? handler.getRoute()->getMetricsId() : -1;
+	if (stream->server->hasServerTiming()) {
+		response.setHeader("Server-Timing", stream->record.serverTiming());
+	}
+	respond(stream, response);
+}
+
+void Session::startProxy(Stream* stream, const HTTP::Request& request, const Route& route) {
+	stream->record.routeId = route.getMetricsId();
+	stream->record.mark(HTTP::RequestRecord::PHASE_HANDLER_START);
+	stream->proxy = new HTTP::Proxy(route, request, _clientHost, _secure);
+	stream->proxy->start();
+	proxyProgress(stream);
+}
+
+// Upstream exchange moved on: HEADERS once its response head is in, an
+// error page if none could be obtained, a reset if the body was cut short
+void Session::proxyProgress(Stream* stream) {
+	HTTP::Proxy* proxy = stream->proxy;
+	if (stream->responding) {
+		if (proxy->hasFailed() && proxy->size() == 0) {
+			resetStream(stream->id, INTERNAL_ERROR);
+		}
+		return;
+	}
+
+	if (proxy->hasHead()) {
+		stream->record.mark(HTTP::RequestRecord::PHASE_HANDLER_END);
+		bool endStream = proxy->isComplete() && proxy->size() == 0;
+		writeHeaders(stream, proxy->getStatus(), proxy->getHeaders(), endStream);
+		if (endStream) {
+			completeStream(stream);
+			return;
+		}
+		stream->responding = true;
+	} else if (proxy->hasFailed()) {
+		int status = proxy->getErrorStatus();
+		delete proxy;
+		stream->proxy = NULL;
+		stream->record.mark(HTTP::RequestRecord::PHASE_HANDLER_END);
+		respond(stream, Instance::Get<HTTP::ErrorPages>()->get(stream->server, status));
+	}
+}
+
+// Upstream sockets
+void Session::getUpstreamPollFds(std::vector<struct pollfd>& fds) const {
+	for (std::map<unsigned int, Stream*>::const_iterator it = _streams.begin(); it != _streams.end(); ++it) {
+		const HTTP::Proxy* proxy = it->second->proxy;
+		if (proxy && proxy->getFd() >= 0) {
+			struct pollfd pfd;
+			pfd.fd = proxy->getFd();
+			pfd.events = proxy->getPollEvents();
+			pfd.revents = 0;
+			fds.push_back(pfd);
+		}
+	}
+}
+
+void Session::handleUpstream(int fd, short revents) {
+	for (std::map<unsigned int, Stream*>::iterator it = _streams.begin(); it != _streams.end(); ++it) {
+		Stream* stream = it->second;
+		if (stream->proxy && stream->proxy->getFd() == fd) {
+			stream->proxy->handleEvent(revents);
+			proxyProgress(stream);
+			return;
+		}
+	}
+}
+
+double Session::getUpstreamDeadline() const {
+	double earliest = 0;
+	for (std::map<unsigned int, Stream*>::const_iterator it = _streams.begin(); it != _streams.end(); ++it) {
+		double deadline = it->second->proxy ? it->second->proxy->getDeadline() : 0;
+		if (deadline > 0 && (earliest == 0 || deadline < earliest)) {
+			earliest = deadline;
+		}
+	}
+	return earliest;
+}
+
+void Session::checkUpstreamTimeouts(double now) {
+	// proxyProgress() may close streams: walk a copy of the ids
+	std::vector<unsigned int> ids;
+	for (std::map<unsigned int, Stream*>::const_iterator it = _streams.begin(); it != _streams.end(); ++it) {
+		if (it->second->proxy) {
+			ids.push_back(it->first);
+		}
+	}
+	for (size_t i = 0; i < ids.size(); ++i) {
+		Stream* stream = findStream(ids[i]);
+		if (stream && stream->proxy) {
+			stream->proxy->checkTimeout(now);
+			proxyProgress(stream);
+		}
+	}
+}
+
+// Virtual host for a Host / :authority value (the listener's default if none matches)
+const Server* Session::selectServer(const std::string& host) const {
+	return _virtualHosts->find(host);
+}
+
+// Queue the response HEADERS; the body is framed later by produceData()
+void Session::respond(Stream* stream, const HTTP::Response& response) {
+	std::vector<HTTP::Response::Segment> segments;
+	int fileFd = -1;
+
+	if (response.hasFileBody()) {
+		fileFd = open(response.getFilePath().c_str(), O_RDONLY);
+		if (fileFd < 0) {
+			LOG_ERROR << "Failed to open " << response.getFilePath() << ": "
+			          << Logger::errstr() << std::endl;
+			respond(stream, Instance::Get<HTTP::ErrorPages>()->get(stream->server, 500));
+			return;
+		}
+	}
+	if (!response.getBody().empty()) {
+		HTTP::Response::Segment segment;
+		segment.fromFile = false;
+		segment.offset = 0;
+		segment.length = response.getBody().length();
+		segment.data = response.getBody();
+		segments.push_back(segment);
+	}
+	segments.insert(segments.end(), response.getSegments().begin(), response.getSegments().end());
+
+	std::vector<std::pair<std::string, std::string> > fields;
+	response.getHeaders(fields);
+	bool endStream = segments.empty();
+	writeHeaders(stream, response.getStatusCode(), fields, endStream);
+
+	if (endStream) {
+		completeStream(stream);
+		return;
+	}
+	if (stream->fileFd >= 0) {
+		::close(stream->fileFd);
+	}
+	stream->fileFd = fileFd;
+	stream->segments.swap(segments);
+	stream->segmentIndex = 0;
+	stream->segmentOffset = 0;
+	stream->responding = true;
+}
+
+// Queue HEADERS (+ CONTINUATION) with the status and the fields that are
+// not connection-specific, lowercased as HTTP/2 requires
+void Session::writeHeaders(Stream* stream, int status,
+                           const std::vector<std::pair<std::string, std::string> >& fields,
+                           bool endStream) {
+	HeaderList headers;
+	headers.push_back(Header(":status", toString(status)));
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = fields.begin();
+	     it != fields.end(); ++it) {
+		std::string name = it->first;
+		for (size_t i = 0; i < name.length(); ++i) {
+			name[i] = std::tolower(name[i]);
+		}
+		if (!isConnectionSpecific(name)) {
+			headers.push_back(Header(name, it->second));
+		}
+	}
+
+	std::string block;
+	_encoder.encode(headers, block);
+
+	stream->record.status = status;
+	stream->record.headerBytes = block.size();
+	stream->record.bytesSent += block.size();
+	stream->record.mark(HTTP::RequestRecord::PHASE_FIRST_SENT); // Queued, HTTP/2 frames are interleaved
+
+	// Split the header block over HEADERS + CONTINUATION frames
+	size_t pos = 0;
+	while (pos < block.size()) {
+		size_t chunk = block.size() - pos;
+		if (chunk > _peerMaxFrameSize) {
+			chunk = _peerMaxFrameSize;
+		}
+		int flags = (pos + chunk >= block.size()) ? FLAG_END_HEADERS : 0;
+		if (pos == 0 && endStream) {
+			flags |= FLAG_END_STREAM;
+		}
+		writeFrame(pos == 0 ? HEADERS : CONTINUATION, flags, stream->id, block.substr(pos, chunk));
+		pos += chunk;
+	}
+}
+
+// Map a stream's header list onto an HTTP::Request (RFC 7540 section 8.1.2)
+bool Session::buildRequest(const Stream* stream, HTTP::Request& request) const {
+	std::string method;
+	std::string path;
+	std::string authority;
+	bool hasHost = false;
+	bool regularSeen = false;
+	HeaderList fields;
+
+	for (HeaderList::const_iterator it = stream->headers.begin(); it != stream->headers.end(); ++it) {
+		const std::string& name = it->first;
+		for (size_t i = 0; i < name.length(); ++i) {
+			if (std::isupper(name[i])) {
+				return false; // Field names must be lowercase
+			}
+		}
+
+		if (!name.empty() && name[0] == ':') {
+			if (regularSeen) {
+				return false; // Pseudo-headers come first
+			}
+			if (name == ":method") method = it->second;
+			else if (name == ":path") path = it->second;
+			else if (name == ":authority") authority = it->second;
+			else if (name != ":scheme") return false;
+			continue;
+		}
+
+		regularSeen = true;
+		if (isConnectionSpecific(name) || (name == "te" && it->second != "trailers")) {
+			return false;
+		}
+		if (name == "host") {
+			hasHost = true;
+		}
+		fields.push_back(*it);
+	}
+
+	if (method.empty() || path.empty()) {
+		return false;
+	}
+	// Virtual hosts and CGI expect Host, HTTP/2 clients send :authority instead
+	if (!hasHost && !authority.empty()) {
+		fields.push_back(Header("host", authority));
+	}
+	if (!request.assign(method, path, "HTTP/2.0", fields, stream->body)) {
+		return false;
+	}
+	request.setRemoteAddr(_clientHost);
+	return true;
+}
+
+// Output
+const std::string& Session::pending() {
+	produceData();
+	return _out;
+}
+
+void Session::consume(size_t bytes) {
+	_out.erase(0, bytes);
+}
+
+bool Session::wantsWrite() const {
+	return !_out.empty() || hasSendableData();
+}
+
+bool Session::isFinished() const {
+	return _out.empty() && (_goawaySent || (_goawayReceived && _streams.empty()));
+}
+
+void Session::writeFrame(int type, int flags, unsigned int streamId, const std::string& payload) {
+	size_t pos = _out.size();
+	_out.resize(pos + 9);
+	putFrameHeader(&_out[pos], payload.size(), type, flags, streamId);
+	_out += payload;
+}
+
+// Server connection preface: our SETTINGS plus a larger connection window
+void Session::writeSettings() {
+	std::string payload;
+	appendSetting(payload, 0x3, MAX_CONCURRENT_STREAMS);
+	appendSetting(payload, 0x4, INITIAL_WINDOW_SIZE);
+	appendSetting(payload, 0x6, MAX_HEADER_BLOCK);
+	writeFrame(SETTINGS, 0, 0, payload);
+	writeWindowUpdate(0, CONNECTION_WINDOW_SIZE - DEFAULT_WINDOW_SIZE);
+	_settingsSent = true;
+}
+
+void Session::writeWindowUpdate(unsigned int streamId, size_t increment) {
+	std::string payload;
+	appendUint32(payload, increment & 0x7fffffff);
+	writeFrame(WINDOW_UPDATE, 0, streamId, payload);
+}
+
+// Return consumed DATA to the peer's windows once half of a window is used
+void Session::acknowledgeData(Stream* stream, size_t length) {
+	_connRecvUnacked += length;
+	if (_connRecvUnacked >= static_cast<size_t>(CONNECTION_WINDOW_SIZE / 2)) {
+		writeWindowUpdate(0, _connRecvUnacked);
+		_connRecvUnacked = 0;
+	}
+	if (stream) {
+		stream->recvUnacked += length;
+		if (stream->recvUnacked >= static_cast<size_t>(INITIAL_WINDOW_SIZE / 2)) {
+			writeWindowUpdate(stream->id, stream->recvUnacked);
+			stream->recvUnacked = 0;
+		}
+	}
+}
+
+// Frame response bodies as DATA, one frame per stream per round, until the
+// output buffer is full or the flow-control windows are exhausted
+void Session::produceData() {
+	while (_out.size() < OUTPUT_HIGH_WATER && _connSendWindow > 0) {
+		std::vector<unsigned int> ready;
+		std::map<unsigned int, Stream*>::iterator start = _streams.upper_bound(_lastServed);
+		for (std::map<unsigned int, Stream*>::iterator it = start; it != _streams.end(); ++it) {
+			if (hasDataReady(it->second)) {
+				ready.push_back(it->first);
+			}
+		}
+		for (std::map<unsigned int, Stream*>::iterator it = _streams.begin(); it != start; ++it) {
+			if (hasDataReady(it->second)) {
+				ready.push_back(it->first);
+			}
+		}
+		if (ready.empty()) {
+			return;
+		}
+
+		for (size_t i = 0; i < ready.size(); ++i) {
+			if (_out.size() >= OUTPUT_HIGH_WATER || _connSendWindow <= 0) {
+				return;
+			}
+			Stream* stream = findStream(ready[i]);
+			_lastServed = ready[i];
+			if (stream) {
+				writeData(stream);
+			}
+		}
+	}
+}
+
+bool Session::writeData(Stream* stream) {
+	if (stream->proxy) {
+		return writeProxyData(stream);
+	}
+
+	std::vector<HTTP::Response::Segment>& segments = stream->segments;
+	size_t pos = _out.size();
+	size_t chunk = 0;
+
+	_out.resize(pos + 9);
+	if (stream->segmentIndex < segments.size()) {
+		const HTTP::Response::Segment& segment = segments[stream->segmentIndex];
+		chunk = segment.length - stream->segmentOffset;
+		if (chunk > _peerMaxFrameSize) chunk = _peerMaxFrameSize;
+		if (static_cast<long>(chunk) > stream->sendWindow) chunk = stream->sendWindow;
+		if (static_cast<long>(chunk) > _connSendWindow) chunk = _connSendWindow;
+
+		if (!segment.fromFile) {
+			_out.append(segment.bytes() + stream->segmentOffset, chunk);
+		} else if (chunk > 0) {
+			_out.resize(pos + 9 + chunk);
+			ssize_t bytesRead = pread(stream->fileFd, &_out[pos + 9], chunk,
+			                          segment.offset + static_cast<off_t>(stream->segmentOffset));
+			if (bytesRead <= 0) {
+				// File shrank under us: the promised Content-Length can't be met
+				LOG_ERROR << "Response file truncated while sending (stream " << stream->id
+				          << ", fd: " << _fd << ")" << std::endl;
+				_out.resize(pos);
+				resetStream(stream->id, INTERNAL_ERROR);
+				return false;
+			}
+			chunk = bytesRead;
+			_out.resize(pos + 9 + chunk);
+		}
+		stream->segmentOffset += chunk;
+		stream->record.bytesSent += chunk;
+	}
+
+	// Skip finished (and empty) segments
+	while (stream->segmentIndex < segments.size() &&
+	       stream->segmentOffset >= segments[stream->segmentIndex].length) {
+		++stream->segmentIndex;
+		stream->segmentOffset = 0;
+	}
+
+	bool last = stream->segmentIndex >= segments.size();
+	putFrameHeader(&_out[pos], chunk, DATA, last ? FLAG_END_STREAM : 0, stream->id);
+	stream->sendWindow -= chunk;
+	_connSendWindow -= chunk;
+
+	if (last) {
+		completeStream(stream);
+	}
+	return true;
+}
+
+// DATA from a proxied body: what the upstream has delivered so far
+bool Session::writeProxyData(Stream* stream) {
+	HTTP::Proxy* proxy = stream->proxy;
+	if (proxy->hasFailed() && proxy->size() == 0) {
+		// Upstream went away mid-body: the response can't be completed
+		resetStream(stream->id, INTERNAL_ERROR);
+		return false;
+	}
+
+	size_t chunk = proxy->size();
+	if (chunk > _peerMaxFrameSize) chunk = _peerMaxFrameSize;
+	if (static_cast<long>(chunk) > stream->sendWindow) chunk = stream->sendWindow;
+	if (static_cast<long>(chunk) > _connSendWindow) chunk = _connSendWindow;
+
+	bool last = proxy->isComplete() && chunk == proxy->size();
+	if (chunk == 0 && !last) {
+		return true;
+	}
+
+	size_t pos = _out.size();
+	_out.resize(pos + 9);
+	_out.append(proxy->data(), chunk);
+	proxy->consume(chunk);
+	putFrameHeader(&_out[pos], chunk, DATA, last ? FLAG_END_STREAM : 0, stream->id);
+	stream->record.bytesSent += chunk;
+	stream->sendWindow -= chunk;
+	_connSendWindow -= chunk;
+
+	if (last) {
+		completeStream(stream);
+	}
+	return true;
+}
+
+bool Session::hasSendableData() const {
+	if (_connSendWindow <= 0) {
+		return false;
+	}
+	for (std::map<unsigned int, Stream*>::const_iterator it = _streams.begin(); it != _streams.end(); ++it) {
+		if (hasDataReady(it->second)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Body to frame and window to frame it in (a proxied body may still be on its way)
+bool Session::hasDataReady(const Stream* stream) {
+	if (!stream->responding || stream->sendWindow <= 0) {
+		return false;
+	}
+	const HTTP::Proxy* proxy = stream->proxy;
+	return !proxy || proxy->size() > 0 || proxy->isComplete() || proxy->hasFailed();
+}
+
+} // namespace HTTP2
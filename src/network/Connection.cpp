@@ -17,45 +17,107 @@
 #include "includes/network/Connection.hpp"
 #include "includes/network/Socket.hpp"
 #include "includes/config/Server.hpp"
+#include "includes/config/VirtualHostTable.hpp"
 #include "includes/http/RequestHandler.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/http/ErrorPages.hpp"
+#include "includes/http/RateLimiter.hpp"
+#include "includes/network/TrafficCapture.hpp"
 #include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include "includes/core/Instance.hpp"
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
 #include <cstring>
 #include <cerrno>
-#include <ctime>
 #include <sstream>
 #include <cstdlib>
+#include <cctype>
+#include <openssl/err.h>
 
 // Constructors
-Connection::Connection(int fd, const struct sockaddr_in& addr, const Server* server)
+Connection::Connection(int fd, const struct sockaddr_in& addr, const VirtualHostTable* virtualHosts,
+                       TlsContext* tls)
 	: _fd(fd)
 	, _addr(addr)
 	, _clientHost(Socket::getHostString(addr))
 	, _clientPort(Socket::getPortNumber(addr))
-	, _server(server)
+	, _virtualHosts(virtualHosts)
+	, _server(virtualHosts->getDefault())
+	, _serverSelected(false)
 	, _state(READING_REQUEST)
-	, _lastActivity(std::time(NULL))
+	, _lastActivity(Clock::now())
 	, _responseOffset(0)
+	, _segmentIndex(0)
+	, _segmentOffset(0)
+	, _fileFd(-1)
 	, _keepAlive(false)
-	, _shouldClose(false) {
-
-	Logger::info << "New connection from " << _clientHost << ":" << _clientPort
-	             << " (fd: " << _fd << ")" << std::endl;
+	, _shouldClose(false)
+	, _continueHandled(false)
+	, _http2(NULL)
+	, _tls(tls)
+	, _ssl(NULL)
+	, _tlsEstablished(false)
+	, _tlsWantWrite(false)
+	, _captureId(Instance::Get<TrafficCapture>()->begin(fd, tls != NULL))
+	, _limitChecked(false)
+	, _resumeAt(0)
+	, _proxy(NULL)
+	, _proxyHeadQueued(false)
+	, _proxyChunked(false) {
+
+	_record.remoteAddr = _clientHost;
+	_record.mark(HTTP::RequestRecord::PHASE_ACCEPT);
+	LOG_INFO << "New connection from " << _clientHost << ":" << _clientPort
+	         << " (fd: " << _fd << (_tls ? ", tls" : "") << ")" << std::endl;
+
+	if (_tls) {
+		_ssl = _tls->createSession(_fd);
+		if (!_ssl) {
+			_shouldClose = true;
+		}
+	}
 }
 
 Connection::~Connection() {
+	logRequest(); // Response cut short by the client or a timeout
+	if (_captureId) {
+		Instance::Get<TrafficCapture>()->end(_captureId);
+	}
+	delete _http2;
+	delete _proxy;
+	closeResponseFile();
+	if (!_limitSlots.empty()) {
+		Instance::Get<HTTP::RateLimiter>()->release(_limitSlots);
+	}
+	if (_ssl) {
+		if (_tlsEstablished) {
+			SSL_shutdown(_ssl); // Best effort close_notify, never waits for the peer
+		}
+		SSL_free(_ssl);
+	}
 	if (_fd >= 0) {
 		::close(_fd);
-		Logger::debug << "Connection closed (fd: " << _fd << ")" << std::endl;
+		LOG_DEBUG << "Connection closed (fd: " << _fd << ")" << std::endl;
 	}
 }
 
 // I/O operations
 bool Connection::readRequest() {
-	const size_t BUFFER_SIZE = 4096;
+	// Room for a whole TLS record, so no decrypted bytes stay buffered
+	// inside OpenSSL where poll() can't see them
+	const size_t BUFFER_SIZE = 16384 + 1;
 	char buffer[BUFFER_SIZE];
 
-	ssize_t bytesRead = recv(_fd, buffer, BUFFER_SIZE - 1, 0);
+	if (_ssl && !_tlsEstablished) {
+		return continueHandshake();
+	}
+
+	ssize_t bytesRead = receiveBytes(buffer, BUFFER_SIZE - 1);
 
 	if (bytesRead < 0) {
 		// Non-blocking socket: would block means no data available
@@ -65,27 +127,51 @@ bool Connection::readRequest() {
 
 	if (bytesRead == 0) {
 		// Client closed connection
-		Logger::debug << "Client closed connection (fd: " << _fd << ")" << std::endl;
+		LOG_DEBUG << "Client closed connection (fd: " << _fd << ")" << std::endl;
 		_shouldClose = true;
 		return false;
 	}
 
+	updateActivity();
+	Instance::Get<HTTP::Metrics>()->bytesIn(bytesRead);
+	if (_captureId) {
+		Instance::Get<TrafficCapture>()->data(_captureId, buffer, bytesRead);
+	}
+
+	if (_http2) {
+		_http2->receive(buffer, bytesRead);
+		_shouldClose = _http2->isFinished();
+		return true;
+	}
+
+	_record.mark(HTTP::RequestRecord::PHASE_FIRST_BYTE);
+
 	// Append to request buffer
 	buffer[bytesRead] = '\0';
 	_requestBuffer.append(buffer, bytesRead);
-	updateActivity();
 
-	Logger::debug << "Read " << bytesRead << " bytes from connection (fd: " << _fd
-	              << "), total: " << _requestBuffer.size() << " bytes" << std::endl;
+	LOG_DEBUG << "Read " << bytesRead << " bytes from connection (fd: " << _fd
+	          << "), total: " << _requestBuffer.size() << " bytes" << std::endl;
+
+	// Prior-knowledge HTTP/2 starts with the connection preface instead
+	if (detectHttp2Preface()) {
+		return true;
+	}
 
 	// Check if we have received at least the headers (look for \r\n\r\n)
 	size_t headerEndPos = _requestBuffer.find("\r\n\r\n");
 	if (headerEndPos != std::string::npos) {
 		// Headers received, now check if we need to wait for body
+		_record.mark(HTTP::RequestRecord::PHASE_HEADERS);
 		size_t bodyStartPos = headerEndPos + 4; // +4 for "\r\n\r\n"
 
 		// Extract headers to check Content-Length
 		std::string headersOnly = _requestBuffer.substr(0, headerEndPos);
+
+		// Pick the virtual host first: body limits depend on it
+		if (!_serverSelected) {
+			selectServer(headersOnly);
+		}
 		size_t contentLength = 0;
 		bool hasContentLength = false;
 
@@ -95,53 +181,53 @@ bool Connection::readRequest() {
 			clPos = headersOnly.find("content-length:");
 		}
 		if (clPos != std::string::npos) {
+			// The last header line has no "\r\n" left in headersOnly
 			size_t lineEnd = headersOnly.find("\r\n", clPos);
-			if (lineEnd != std::string::npos) {
-				std::string clLine = headersOnly.substr(clPos, lineEnd - clPos);
-				size_t colonPos = clLine.find(':');
-				if (colonPos != std::string::npos) {
-					std::string clValue = clLine.substr(colonPos + 1);
-					// Trim whitespace
-					while (!clValue.empty() && (clValue[0] == ' ' || clValue[0] == '\t')) {
-						clValue = clValue.substr(1);
-					}
-					contentLength = static_cast<size_t>(atoi(clValue.c_str()));
-					hasContentLength = true;
+			if (lineEnd == std::string::npos) {
+				lineEnd = headersOnly.length();
+			}
+			std::string clLine = headersOnly.substr(clPos, lineEnd - clPos);
+			size_t colonPos = clLine.find(':');
+			if (colonPos != std::string::npos) {
+				std::string clValue = clLine.substr(colonPos + 1);
+				// Trim whitespace
+				while (!clValue.empty() && (clValue[0] == ' ' || clValue[0] == '\t')) {
+					clValue = clValue.substr(1);
 				}
+				contentLength = static_cast<size_t>(atoi(clValue.c_str()));
+				hasContentLength = true;
 			}
 		}
 
 		// Check against max body size limit FIRST
 		if (hasContentLength && contentLength > _server->getMaxBodySize()) {
-			Logger::warning << "Request body too large: " << contentLength
-			                << " bytes (max: " << _server->getMaxBodySize() << " bytes)" << std::endl;
-			HTTP::Response errorResp = HTTP::Response::errorResponse(413,
-				"Request entity too large. Maximum allowed size is " +
-				std::string(static_cast<std::ostringstream&>(std::ostringstream() << _server->getMaxBodySize()).str()) +
-				" bytes.");
-			_responseBuffer = errorResp.build();
-			_responseOffset = 0;
-			_state = WRITING_RESPONSE;
-			_shouldClose = true;
+			LOG_WARNING << "Request body too large: " << contentLength
+			            << " bytes (max: " << _server->getMaxBodySize() << " bytes)" << std::endl;
+			queueResponse(Instance::Get<HTTP::ErrorPages>()->get(_server, 413));
 			return true;
 		}
 
 		// Check if request buffer size already exceeds max (for safety)
 		if (_requestBuffer.size() > _server->getMaxBodySize() + 8192) { // +8192 for headers overhead
-			Logger::warning << "Request buffer too large: " << _requestBuffer.size() << " bytes" << std::endl;
-			HTTP::Response errorResp = HTTP::Response::errorResponse(413, "Request entity too large");
-			_responseBuffer = errorResp.build();
-			_responseOffset = 0;
-			_state = WRITING_RESPONSE;
-			_shouldClose = true;
+			LOG_WARNING << "Request buffer too large: " << _requestBuffer.size() << " bytes" << std::endl;
+			queueResponse(Instance::Get<HTTP::ErrorPages>()->get(_server, 413));
 			return true;
 		}
 
+		// Answer "Expect: 100-continue" (or reject) before any body bytes move
+		if (hasContentLength && !_continueHandled &&
+		    _requestBuffer.size() - bodyStartPos < contentLength) {
+			_continueHandled = true;
+			if (handleExpectContinue(bodyStartPos)) {
+				return true;
+			}
+		}
+
 		// If we have Content-Length, check if body is complete
 		bool bodyComplete = false;
 		if (hasContentLength) {
 			size_t bodyReceived = _requestBuffer.size() - bodyStartPos;
-			Logger::debug << "Body progress: " << bodyReceived << "/" << contentLength << " bytes" << std::endl;
+			LOG_DEBUG << "Body progress: " << bodyReceived << "/" << contentLength << " bytes" << std::endl;
 			bodyComplete = (bodyReceived >= contentLength);
 		} else {
 			// No Content-Length, assume body is complete (or not expected)
@@ -150,55 +236,147 @@ bool Connection::readRequest() {
 
 		// Only process if body is complete
 		if (bodyComplete) {
-			Logger::debug << "Complete request received (fd: " << _fd << ")" << std::endl;
-			_state = PROCESSING;
-
-			// Parse HTTP request
-			HTTP::Request request;
-			if (!request.parse(_requestBuffer)) {
-				Logger::error << "Failed to parse HTTP request" << std::endl;
-				HTTP::Response errorResp = HTTP::Response::errorResponse(400, "Bad Request");
-				_responseBuffer = errorResp.build();
-				_responseOffset = 0;
-				_state = WRITING_RESPONSE;
-				_shouldClose = true;
-				return true;
-			}
+			LOG_DEBUG << "Complete request received (fd: " << _fd << ")" << std::endl;
+			_record.mark(HTTP::RequestRecord::PHASE_BODY);
+			processRequest();
+		} else {
+			// Body not complete yet, keep reading
+			LOG_DEBUG << "Waiting for more body data (fd: " << _fd << ")" << std::endl;
+		}
+	}
 
-			// Debug: print request
-			if (Logger::debug << "") {
-				request.print();
-			}
+	return true;
+}
 
-			// Handle request
-			HTTP::RequestHandler handler(_server);
-			HTTP::Response response = handler.handle(request);
+// Parse and answer the complete request in _requestBuffer
+void Connection::processRequest() {
+	_state = PROCESSING;
 
-			// Build response
-			_responseBuffer = response.build();
-			_responseOffset = 0;
-			_state = WRITING_RESPONSE;
-			// Don't set _shouldClose here - let writeResponse handle it
-		} else {
-			// Body not complete yet, keep reading
-			Logger::debug << "Waiting for more body data (fd: " << _fd << ")" << std::endl;
+	// Parse HTTP request
+	HTTP::Request request;
+	if (!request.parse(_requestBuffer)) {
+		LOG_ERROR << "Failed to parse HTTP request" << std::endl;
+		queueResponse(Instance::Get<HTTP::ErrorPages>()->get(_server, 400));
+		return;
+	}
+	request.setRemoteAddr(_clientHost);
+
+	_record.setRequest(request);
+
+	// Debug: print request
+	if (LOG_DEBUG_ENABLED) {
+		request.print();
+	}
+
+	// Switch to HTTP/2 if asked to; the request is answered on stream 1
+	if (HTTP2::Session::isUpgradeRequest(request)) {
+		_requestBuffer.clear();
+		_http2 = new HTTP2::Session(_fd, _virtualHosts, _clientHost, _addr.sin_addr.s_addr,
+		                            _ssl != NULL);
+		_http2->upgrade(request);
+		_state = READING_REQUEST;
+		return;
+	}
+
+	// Per-client limits (may hold the request back or answer it right away)
+	if (applyLimits(request)) {
+		return;
+	}
+
+	// proxy_pass: answered as the upstream response comes in
+	const Route* route = _server->matchRoute(request.getPath());
+	if (route && route->isProxy() && route->isMethodAllowed(request.getMethod())) {
+		startProxy(request, *route);
+		return;
+	}
+
+	// Handle request
+	HTTP::RequestHandler handler(_server);
+	_record.mark(HTTP::RequestRecord::PHASE_HANDLER_START);
+	HTTP::Response response = handler.handle(request);
+	_record.handled(response);
+	_record.routeId = handler.getRoute() ? handler.getRoute()->getMetricsId() : -1;
+	if (_server->hasServerTiming()) {
+		response.setHeader("Server-Timing", _record.serverTiming());
+	}
+
+	// Build response
+	queueResponse(response);
+}
+
+// limit_req / limit_conn of the location (or server) the request is for
+// Returns true if the request was rejected or held back
+bool Connection::applyLimits(const HTTP::Request& request) {
+	HTTP::RateLimiter* limiter = Instance::Get<HTTP::RateLimiter>();
+	if (!limiter->enabled()) {
+		return false;
+	}
+
+	const Route* route = _server->matchRoute(request.getPath());
+	const LimitSettings& limits = route ? route->getLimits() : _server->getLimits();
+	if (limits.empty()) {
+		return false;
+	}
+
+	in_addr_t address = _addr.sin_addr.s_addr;
+	int status = 0;
+	if (!_limitChecked) {
+		_limitChecked = true;
+		double delay;
+		status = limiter->limitRequest(limits, address, delay);
+		if (!status && delay > 0) {
+			_state = DELAYED;
+			_resumeAt = Clock::monotonic() + delay;
+			updateActivity();
+			return true;
 		}
 	}
+	if (!status) {
+		status = limiter->acquire(limits, address, _limitSlots);
+	}
+	if (!status) {
+		return false;
+	}
 
+	_record.routeId = route ? route->getMetricsId() : -1;
+	queueResponse(Instance::Get<HTTP::ErrorPages>()->get(_server, status));
 	return true;
 }
 
 bool Connection::writeResponse() {
-	if (_responseBuffer.empty() || _responseOffset >= _responseBuffer.size()) {
-		// Nothing to write or already written everything
-		_shouldClose = true;
+	if (_ssl && !_tlsEstablished) {
+		return continueHandshake();
+	}
+	if (_http2) {
+		return writeHttp2();
+	}
+	if (_state == PROXYING) {
+		return writeProxy();
+	}
+	if (_state != WRITING_RESPONSE) {
+		return true;
+	}
+
+	if (_responseOffset >= _responseBuffer.size()) {
+		// Head and in-memory body written, continue with the file segments
+		if (!writeSegments()) {
+			return false;
+		}
+		if (_segmentIndex >= _segments.size()) {
+			LOG_INFO << "Response complete (fd: " << _fd << ")" << std::endl;
+			closeResponseFile();
+			_shouldClose = true;
+			_state = CLOSING;
+			_record.mark(HTTP::RequestRecord::PHASE_LAST_SENT);
+			logRequest();
+		}
 		return true;
 	}
 
 	const char* data = _responseBuffer.c_str() + _responseOffset;
 	size_t remaining = _responseBuffer.size() - _responseOffset;
 
-	ssize_t bytesWritten = send(_fd, data, remaining, 0);
+	ssize_t bytesWritten = sendBytes(data, remaining);
 
 	if (bytesWritten < 0) {
 		// Non-blocking socket: would block means socket not ready
@@ -207,22 +385,185 @@ bool Connection::writeResponse() {
 	}
 
 	_responseOffset += bytesWritten;
+	_record.bytesSent += bytesWritten;
+	_record.mark(HTTP::RequestRecord::PHASE_FIRST_SENT);
+	Instance::Get<HTTP::Metrics>()->bytesOut(bytesWritten);
 	updateActivity();
 
-	Logger::debug << "Wrote " << bytesWritten << " bytes to connection (fd: " << _fd
-	              << "), total: " << _responseOffset << "/" << _responseBuffer.size()
-	              << " bytes" << std::endl;
+	LOG_DEBUG << "Wrote " << bytesWritten << " bytes to connection (fd: " << _fd
+	          << "), total: " << _responseOffset << "/" << _responseBuffer.size()
+	          << " bytes" << std::endl;
 
 	// Check if response is complete
-	if (_responseOffset >= _responseBuffer.size()) {
-		Logger::info << "Response complete (fd: " << _fd << ")" << std::endl;
+	if (_responseOffset >= _responseBuffer.size() && _segmentIndex >= _segments.size()) {
+		LOG_INFO << "Response complete (fd: " << _fd << ")" << std::endl;
 		_shouldClose = true;
 		_state = CLOSING;
+		_record.mark(HTTP::RequestRecord::PHASE_LAST_SENT);
+		logRequest();
 	}
 
 	return true;
 }
 
+// Write the current body segment: in-memory data as is, file ranges
+// through sendFileRange() (zero-copy where available)
+bool Connection::writeSegments() {
+	if (_segmentIndex >= _segments.size()) {
+		return true;
+	}
+
+	const HTTP::Response::Segment& segment = _segments[_segmentIndex];
+	size_t remaining = segment.length - _segmentOffset;
+	ssize_t bytesWritten;
+
+	if (!segment.fromFile) {
+		bytesWritten = sendBytes(segment.bytes() + _segmentOffset, remaining);
+	} else {
+		off_t offset = segment.offset + static_cast<off_t>(_segmentOffset);
+		bytesWritten = sendFileRange(offset, remaining);
+		if (bytesWritten == 0 && remaining > 0) {
+			// File shrank under us: the promised Content-Length can't be met
+			LOG_ERROR << "Response file truncated while sending (fd: " << _fd << ")" << std::endl;
+			return false;
+		}
+	}
+
+	if (bytesWritten < 0) {
+		return true; // Socket not ready, try again later
+	}
+
+	_segmentOffset += bytesWritten;
+	_record.bytesSent += bytesWritten;
+	_record.mark(HTTP::RequestRecord::PHASE_FIRST_SENT);
+	Instance::Get<HTTP::Metrics>()->bytesOut(bytesWritten);
+	updateActivity();
+
+	LOG_DEBUG << "Wrote " << bytesWritten << " body bytes to connection (fd: " << _fd
+	          << "), segment " << (_segmentIndex + 1) << "/" << _segments.size() << std::endl;
+
+	if (_segmentOffset >= segment.length) {
+		++_segmentIndex;
+		_segmentOffset = 0;
+	}
+	return true;
+}
+
+// Send part of the response file: sendfile() for plain TCP, SSL_sendfile()
+// when kernel TLS is active, otherwise a copy through userspace
+ssize_t Connection::sendFileRange(off_t offset, size_t length) {
+	if (_ssl) {
+		if (TlsContext::usesKtlsSend(_ssl)) {
+			ossl_ssize_t sent = SSL_sendfile(_ssl, _fileFd, offset, length, 0);
+			if (sent < 0 && SSL_get_error(_ssl, static_cast<int>(sent)) != SSL_ERROR_WANT_WRITE) {
+				LOG_DEBUG << "SSL_sendfile failed (fd: " << _fd << "): " << TlsContext::lastError() << std::endl;
+				_shouldClose = true;
+			}
+			return sent;
+		}
+		char buffer[16384];
+		ssize_t bytesRead = pread(_fileFd, buffer, length < sizeof(buffer) ? length : sizeof(buffer), offset);
+		if (bytesRead <= 0) {
+			return bytesRead;
+		}
+		return sendBytes(buffer, bytesRead);
+	}
+
+#ifdef __linux__
+	return sendfile(_fd, _fileFd, &offset, length);
+#else
+	char buffer[65536];
+	ssize_t bytesRead = pread(_fileFd, buffer, length < sizeof(buffer) ? length : sizeof(buffer), offset);
+	if (bytesRead <= 0) {
+		return bytesRead;
+	}
+	return send(_fd, buffer, bytesRead, 0);
+#endif
+}
+
+// Read from the socket, decrypting when TLS is active
+// Returns the byte count, 0 once the peer closed, -1 if nothing is available
+ssize_t Connection::receiveBytes(char* buffer, size_t size) {
+	if (!_ssl) {
+		return recv(_fd, buffer, size, 0);
+	}
+
+	int result = SSL_read(_ssl, buffer, static_cast<int>(size));
+	if (result > 0) {
+		return result;
+	}
+	int error = SSL_get_error(_ssl, result);
+	if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+		return -1;
+	}
+	if (error != SSL_ERROR_ZERO_RETURN) {
+		LOG_DEBUG << "TLS read failed (fd: " << _fd << "): " << TlsContext::lastError() << std::endl;
+	}
+	return 0;
+}
+
+// Write to the socket, encrypting when TLS is active
+// Returns the byte count, or -1 if the socket isn't ready (or failed)
+ssize_t Connection::sendBytes(const char* data, size_t size) {
+	if (!_ssl) {
+		return send(_fd, data, size, 0);
+	}
+	if (size == 0) {
+		return 0;
+	}
+
+	int result = SSL_write(_ssl, data, static_cast<int>(size));
+	if (result > 0) {
+		return result;
+	}
+	int error = SSL_get_error(_ssl, result);
+	if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+		LOG_DEBUG << "TLS write failed (fd: " << _fd << "): " << TlsContext::lastError() << std::endl;
+		_shouldClose = true;
+	}
+	return -1;
+}
+
+// Drive the non-blocking TLS handshake from the poll loop
+// Returns false if the handshake failed
+bool Connection::continueHandshake() {
+	ERR_clear_error();
+	int result = SSL_do_handshake(_ssl);
+
+	if (result != 1) {
+		int error = SSL_get_error(_ssl, result);
+		if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+			_tlsWantWrite = (error == SSL_ERROR_WANT_WRITE);
+			return true;
+		}
+		_tls->recordFailure();
+		LOG_WARNING << "TLS handshake failed (fd: " << _fd << "): " << TlsContext::lastError() << std::endl;
+		return false;
+	}
+
+	_tlsEstablished = true;
+	updateActivity();
+	bool resumed = SSL_session_reused(_ssl) == 1;
+	_tls->recordHandshake(resumed);
+
+	const unsigned char* alpn = NULL;
+	unsigned int alpnLength = 0;
+	SSL_get0_alpn_selected(_ssl, &alpn, &alpnLength);
+	bool h2 = (alpnLength == 2 && std::memcmp(alpn, "h2", 2) == 0);
+
+	LOG_DEBUG << "TLS handshake complete (fd: " << _fd << ", " << SSL_get_version(_ssl)
+	          << ", " << SSL_get_cipher_name(_ssl) << (resumed ? ", resumed" : "")
+	          << (TlsContext::usesKtlsSend(_ssl) ? ", ktls" : "") << (h2 ? ", h2" : "")
+	          << ")" << std::endl;
+
+	// ALPN picked HTTP/2: the client starts with the connection preface
+	if (h2) {
+		_http2 = new HTTP2::Session(_fd, _virtualHosts, _clientHost, _addr.sin_addr.s_addr,
+		                            _ssl != NULL);
+	}
+	return true;
+}
+
 // State management
 Connection::State Connection::getState() const {
 	return _state;
@@ -232,6 +573,38 @@ void Connection::setState(State state) {
 	_state = state;
 }
 
+// Events to poll for: HTTP/2 reads continuously and writes whenever
+// frames are ready, HTTP/1.1 alternates between the two
+short Connection::getPollEvents() const {
+	if (_ssl && !_tlsEstablished) {
+		return _tlsWantWrite ? POLLOUT : POLLIN;
+	}
+	if (_http2) {
+		return _http2->wantsWrite() ? (POLLIN | POLLOUT) : POLLIN;
+	}
+	if (_state == READING_REQUEST) {
+		return POLLIN;
+	}
+	if (_state == WRITING_RESPONSE) {
+		return POLLOUT;
+	}
+	if (_state == DELAYED) {
+		return 0; // Only hangups and errors until the delay is over
+	}
+	if (_state == PROXYING) {
+		// Writable once there is something of the upstream response to send
+		bool ready = _proxyHeadQueued &&
+		             (_responseOffset < _responseBuffer.size() || !_proxy || _proxy->size() > 0 ||
+		              _proxy->isComplete() || _proxy->hasFailed());
+		return ready ? POLLOUT : 0;
+	}
+	return POLLIN | POLLOUT;
+}
+
+bool Connection::isHttp2() const {
+	return _http2 != NULL;
+}
+
 // Getters
 int Connection::getFd() const {
 	return _fd;
@@ -255,7 +628,157 @@ bool Connection::shouldClose() const {
 
 // Timeout check
 bool Connection::isTimedOut(time_t timeout) const {
-	return (std::time(NULL) - _lastActivity) > timeout;
+	return (Clock::now() - _lastActivity) > timeout;
+}
+
+// Delayed request (limit_req)
+double Connection::getResumeTime() const {
+	return _resumeAt;
+}
+
+void Connection::resume() {
+	if (_state != DELAYED) {
+		return;
+	}
+	LOG_DEBUG << "Resuming delayed request (fd: " << _fd << ")" << std::endl;
+	processRequest();
+}
+
+// proxy_pass
+void Connection::startProxy(const HTTP::Request& request, const Route& route) {
+	_record.routeId = route.getMetricsId();
+	_record.mark(HTTP::RequestRecord::PHASE_HANDLER_START);
+	_proxy = new HTTP::Proxy(route, request, _clientHost, _ssl != NULL);
+	_proxyHeadQueued = false;
+	_proxyChunked = request.getVersion() == "HTTP/1.1";
+	_state = PROXYING;
+	_proxy->start();
+	proxyProgress();
+}
+
+// Upstream exchange moved on: queue the response head once it is in, or
+// an error page if none could be obtained
+void Connection::proxyProgress() {
+	updateActivity();
+	if (_proxyHeadQueued) {
+		return;
+	}
+
+	if (_proxy->hasHead()) {
+		_record.mark(HTTP::RequestRecord::PHASE_HANDLER_END);
+		_proxyChunked = _proxyChunked && !_proxy->hasKnownLength();
+		_proxy->buildHead(_responseBuffer, _proxyChunked);
+		_responseOffset = 0;
+		_proxyHeadQueued = true;
+		_record.status = _proxy->getStatus();
+		_record.headerBytes = _responseBuffer.size();
+	} else if (_proxy->hasFailed()) {
+		int status = _proxy->getErrorStatus();
+		delete _proxy;
+		_proxy = NULL;
+		_record.mark(HTTP::RequestRecord::PHASE_HANDLER_END);
+		queueResponse(Instance::Get<HTTP::ErrorPages>()->get(_server, status));
+	}
+}
+
+// Relay the proxied response: the head, then the body as the upstream
+// delivers it (as chunks when its length is unknown)
+bool Connection::writeProxy() {
+	if (_responseOffset >= _responseBuffer.size() && _proxy) {
+		_responseBuffer.clear();
+		_responseOffset = 0;
+		size_t length = _proxy->size();
+		if (length > 0) {
+			if (_proxyChunked) {
+				std::ostringstream size;
+				size << std::hex << length << "\r\n";
+				_responseBuffer += size.str();
+			}
+			_responseBuffer.append(_proxy->data(), length);
+			if (_proxyChunked) {
+				_responseBuffer += "\r\n";
+			}
+			_proxy->consume(length);
+		}
+		if (_proxy->isComplete()) {
+			if (_proxyChunked) {
+				_responseBuffer += "0\r\n\r\n";
+			}
+			delete _proxy;
+			_proxy = NULL;
+		} else if (_proxy->hasFailed() && _responseBuffer.empty()) {
+			// The client can only tell from the connection closing early
+			LOG_ERROR << "Upstream response cut short (fd: " << _fd << ")" << std::endl;
+			return false;
+		}
+	}
+
+	if (_responseOffset < _responseBuffer.size()) {
+		ssize_t bytesWritten = sendBytes(_responseBuffer.data() + _responseOffset,
+		                                 _responseBuffer.size() - _responseOffset);
+		if (bytesWritten < 0) {
+			return true; // Socket not ready, try again later
+		}
+		_responseOffset += bytesWritten;
+		_record.bytesSent += bytesWritten;
+		_record.mark(HTTP::RequestRecord::PHASE_FIRST_SENT);
+		Instance::Get<HTTP::Metrics>()->bytesOut(bytesWritten);
+		updateActivity();
+	}
+
+	if (_responseOffset >= _responseBuffer.size() && !_proxy) {
+		LOG_INFO << "Response complete (fd: " << _fd << ")" << std::endl;
+		_shouldClose = true;
+		_state = CLOSING;
+		_record.mark(HTTP::RequestRecord::PHASE_LAST_SENT);
+		logRequest();
+	}
+	return true;
+}
+
+// Upstream sockets (of the HTTP/2 streams, or of the HTTP/1.1 request)
+void Connection::getUpstreamPollFds(std::vector<struct pollfd>& fds) const {
+	if (_http2) {
+		_http2->getUpstreamPollFds(fds);
+		return;
+	}
+	if (_proxy && _proxy->getFd() >= 0) {
+		struct pollfd pfd;
+		pfd.fd = _proxy->getFd();
+		pfd.events = _proxy->getPollEvents();
+		pfd.revents = 0;
+		fds.push_back(pfd);
+	}
+}
+
+void Connection::handleUpstream(int fd, short revents) {
+	if (_http2) {
+		_http2->handleUpstream(fd, revents);
+		updateActivity();
+		return;
+	}
+	if (_proxy && _proxy->getFd() == fd) {
+		_proxy->handleEvent(revents);
+		proxyProgress();
+	}
+}
+
+double Connection::getUpstreamDeadline() const {
+	if (_http2) {
+		return _http2->getUpstreamDeadline();
+	}
+	return _proxy ? _proxy->getDeadline() : 0;
+}
+
+void Connection::checkUpstreamTimeouts(double now) {
+	if (_http2) {
+		_http2->checkUpstreamTimeouts(now);
+		return;
+	}
+	if (_proxy) {
+		_proxy->checkTimeout(now);
+		proxyProgress();
+	}
 }
 
 // Buffer management
@@ -269,5 +792,154 @@ void Connection::clearRequestBuffer() {
 
 // Helper methods
 void Connection::updateActivity() {
-	_lastActivity = std::time(NULL);
+	_lastActivity = Clock::now();
+}
+
+// Queue a response for writing; file-backed bodies are opened here,
+// in-memory body segments (directory listings) are sent after the head
+void Connection::queueResponse(const HTTP::Response& response) {
+	closeResponseFile();
+	_segments.clear();
+	_segmentIndex = 0;
+	_segmentOffset = 0;
+
+	if (response.hasFileBody()) {
+		_fileFd = open(response.getFilePath().c_str(), O_RDONLY);
+		if (_fileFd < 0) {
+			LOG_ERROR << "Failed to open " << response.getFilePath() << ": "
+			          << Logger::errstr() << std::endl;
+			queueResponse(Instance::Get<HTTP::ErrorPages>()->get(_server, 500));
+			return;
+		}
+	}
+	_segments = response.getSegments();
+
+	response.buildInto(_responseBuffer);
+	_responseOffset = 0;
+	_state = WRITING_RESPONSE;
+
+	_record.status = response.getStatusCode();
+	size_t headEnd = _responseBuffer.find("\r\n\r\n");
+	_record.headerBytes = (headEnd == std::string::npos) ? _responseBuffer.size() : headEnd + 4;
+}
+
+// Hand the finished request to the access log and the metrics (once)
+void Connection::logRequest() {
+	if (_record.status == 0 || _record.logged) {
+		return;
+	}
+	_record.logged = true;
+	Instance::Get<HTTP::Metrics>()->recordRequest(_record);
+	Instance::Get<HTTP::AccessLogs>()->write(_server, _record);
+}
+
+void Connection::closeResponseFile() {
+	if (_fileFd >= 0) {
+		::close(_fileFd);
+		_fileFd = -1;
+	}
+}
+
+// Handle "Expect: 100-continue" once the headers are in
+// Returns true if the request was rejected and an error response is queued
+bool Connection::handleExpectContinue(size_t bodyStartPos) {
+	HTTP::Request request;
+	if (!request.parse(_requestBuffer.substr(0, bodyStartPos))) {
+		return false; // Let the full parse report the error
+	}
+
+	std::string expect = request.getHeader("expect");
+	for (size_t i = 0; i < expect.length(); ++i) {
+		expect[i] = std::tolower(expect[i]);
+	}
+	if (expect != "100-continue" || request.getVersion() != "HTTP/1.1") {
+		return false;
+	}
+
+	HTTP::RequestHandler handler(_server);
+	HTTP::Response rejection;
+	if (!handler.acceptsBody(request, rejection)) {
+		_record.setRequest(request);
+		_record.routeId = handler.getRoute() ? handler.getRoute()->getMetricsId() : -1;
+		LOG_INFO << "Rejected " << request.getMethod() << " " << request.getPath()
+		         << " before body transfer (status " << rejection.getStatusCode()
+		         << ", fd: " << _fd << ")" << std::endl;
+		queueResponse(rejection);
+		return true;
+	}
+
+	// Interim response: tell the client to go ahead and send the body
+	static const char continueLine[] = "HTTP/1.1 100 Continue\r\n\r\n";
+	ssize_t sent = sendBytes(continueLine, sizeof(continueLine) - 1);
+	if (sent != static_cast<ssize_t>(sizeof(continueLine) - 1)) {
+		// Client will send the body after its own timeout anyway
+		LOG_WARNING << "Failed to send 100 Continue (fd: " << _fd << ")" << std::endl;
+	} else {
+		LOG_DEBUG << "Sent 100 Continue (fd: " << _fd << ")" << std::endl;
+	}
+	return false;
+}
+
+// Choose the server block from the Host header (once per request)
+void Connection::selectServer(const std::string& headers) {
+	_serverSelected = true;
+
+	size_t pos = 0;
+	while ((pos = headers.find('\n', pos)) != std::string::npos) {
+		++pos;
+		if (headers.length() - pos >= 5 &&
+		    std::tolower(headers[pos]) == 'h' && std::tolower(headers[pos + 1]) == 'o' &&
+		    std::tolower(headers[pos + 2]) == 's' && std::tolower(headers[pos + 3]) == 't' &&
+		    headers[pos + 4] == ':') {
+			size_t end = headers.find('\r', pos);
+			if (end == std::string::npos) {
+				end = headers.length();
+			}
+			_server = _virtualHosts->find(headers.substr(pos + 5, end - pos - 5));
+			LOG_DEBUG << "Virtual host for fd " << _fd << ": "
+			          << (_server->getServerNames().empty() ? "(default)" : _server->getServerNames()[0])
+			          << std::endl;
+			return;
+		}
+	}
+}
+
+// Start an HTTP/2 session when the buffer begins with the client preface
+// Returns true while the buffer may still turn out to be (or is) HTTP/2
+bool Connection::detectHttp2Preface() {
+	const size_t length = HTTP2::Session::PREFACE_LENGTH;
+	size_t compared = _requestBuffer.size() < length ? _requestBuffer.size() : length;
+	if (_requestBuffer.compare(0, compared, HTTP2::Session::PREFACE, compared) != 0) {
+		return false;
+	}
+	if (compared < length) {
+		return true; // Wait for the rest of the preface
+	}
+
+	LOG_INFO << "HTTP/2 prior-knowledge connection (fd: " << _fd << ")" << std::endl;
+	_http2 = new HTTP2::Session(_fd, _virtualHosts, _clientHost, _addr.sin_addr.s_addr,
+	                            _ssl != NULL);
+	_http2->receive(_requestBuffer.data(), _requestBuffer.size());
+	_requestBuffer.clear();
+	_shouldClose = _http2->isFinished();
+	return true;
+}
+
+// Send framed HTTP/2 output; the session decides when the connection is done
+bool Connection::writeHttp2() {
+	const std::string& output = _http2->pending();
+	if (!output.empty()) {
+		ssize_t bytesWritten = sendBytes(output.data(), output.size());
+		if (bytesWritten < 0) {
+			return true; // Socket not ready, try again later
+		}
+		_http2->consume(bytesWritten);
+		updateActivity();
+		Instance::Get<HTTP::Metrics>()->bytesOut(bytesWritten);
+
+		LOG_DEBUG << "Wrote " << bytesWritten << " HTTP/2 bytes to connection (fd: " << _fd
+		          << ")" << std::endl;
+	}
+	_shouldClose = _http2->isFinished();
+	return true;
 }
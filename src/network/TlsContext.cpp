@@ -0,0 +1,161 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TlsContext.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:40:21 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 13:40:22 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * TlsContext.cpp
+ * Implementation of TlsContext
+ */
+#include "includes/network/TlsContext.hpp"
+#include "includes/config/Server.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/core/Instance.hpp"
+#include <openssl/err.h>
+#include <cstring>
+
+// Constructors
+TlsContext::TlsContext()
+	: _ctx(NULL)
+	, _handshakes(0)
+	, _resumed(0)
+	, _failures(0) {
+}
+
+TlsContext::~TlsContext() {
+	if (_ctx) {
+		SSL_CTX_free(_ctx);
+	}
+}
+
+bool TlsContext::init(const Server& server) {
+	_ctx = SSL_CTX_new(TLS_server_method());
+	if (!_ctx) {
+		LOG_ERROR << "SSL_CTX_new failed: " << lastError() << std::endl;
+		return false;
+	}
+
+	SSL_CTX_set_min_proto_version(_ctx, TLS1_2_VERSION);
+
+	if (SSL_CTX_use_certificate_chain_file(_ctx, server.getSslCertificate().c_str()) != 1) {
+		LOG_ERROR << "Failed to load certificate " << server.getSslCertificate() << ": "
+		          << lastError() << std::endl;
+		return false;
+	}
+	if (SSL_CTX_use_PrivateKey_file(_ctx, server.getSslCertificateKey().c_str(), SSL_FILETYPE_PEM) != 1 ||
+	    SSL_CTX_check_private_key(_ctx) != 1) {
+		LOG_ERROR << "Failed to load key " << server.getSslCertificateKey() << ": "
+		          << lastError() << std::endl;
+		return false;
+	}
+
+	// Writes may be partial and retried from a different address
+	// (the response buffers grow while a write is pending)
+	SSL_CTX_set_mode(_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+	                       SSL_MODE_RELEASE_BUFFERS);
+
+	// Resumption: server-side session cache (session IDs, stateful TLS 1.3
+	// tickets) and/or stateless tickets encrypted with per-context keys
+	static const unsigned char sessionContext[] = "webserv";
+	SSL_CTX_set_session_id_context(_ctx, sessionContext, sizeof(sessionContext) - 1);
+	SSL_CTX_set_timeout(_ctx, server.getSslSessionTimeout());
+	if (server.getSslSessionCache() > 0) {
+		SSL_CTX_set_session_cache_mode(_ctx, SSL_SESS_CACHE_SERVER);
+		SSL_CTX_sess_set_cache_size(_ctx, server.getSslSessionCache());
+	} else {
+		SSL_CTX_set_session_cache_mode(_ctx, SSL_SESS_CACHE_OFF);
+	}
+	if (!server.getSslSessionTickets()) {
+		SSL_CTX_set_options(_ctx, SSL_OP_NO_TICKET);
+	}
+
+#ifdef SSL_OP_ENABLE_KTLS
+	// Kernel TLS: record encryption moves into the kernel, so the static
+	// file path can keep using sendfile (SSL_sendfile) under encryption
+	SSL_CTX_set_options(_ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+	SSL_CTX_set_alpn_select_cb(_ctx, selectAlpn, NULL);
+	return true;
+}
+
+SSL* TlsContext::createSession(int fd) const {
+	SSL* ssl = SSL_new(_ctx);
+	if (!ssl) {
+		LOG_ERROR << "SSL_new failed: " << lastError() << std::endl;
+		return NULL;
+	}
+	if (SSL_set_fd(ssl, fd) != 1) {
+		LOG_ERROR << "SSL_set_fd failed: " << lastError() << std::endl;
+		SSL_free(ssl);
+		return NULL;
+	}
+	SSL_set_accept_state(ssl);
+	return ssl;
+}
+
+// Handshake accounting
+void TlsContext::recordHandshake(bool resumed) {
+	++_handshakes;
+	if (resumed) {
+		++_resumed;
+	}
+	Instance::Get<HTTP::Metrics>()->tlsHandshake(resumed);
+}
+
+void TlsContext::recordFailure() {
+	++_failures;
+	Instance::Get<HTTP::Metrics>()->tlsFailure();
+}
+
+size_t TlsContext::getHandshakes() const { return _handshakes; }
+size_t TlsContext::getResumed() const { return _resumed; }
+size_t TlsContext::getFailures() const { return _failures; }
+
+bool TlsContext::usesKtlsSend(SSL* ssl) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+	return BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0;
+#else
+	(void)ssl;
+	return false;
+#endif
+}
+
+std::string TlsContext::lastError() {
+	unsigned long code = ERR_get_error();
+	ERR_clear_error();
+	if (code == 0) {
+		return "unknown error";
+	}
+	char buffer[256];
+	ERR_error_string_n(code, buffer, sizeof(buffer));
+	return buffer;
+}
+
+int TlsContext::selectAlpn(SSL* ssl, const unsigned char** out, unsigned char* outLength,
+                           const unsigned char* in, unsigned int inLength, void* arg) {
+	(void)ssl;
+	(void)arg;
+	static const char* preferred[] = { "h2", "http/1.1" };
+
+	for (size_t p = 0; p < sizeof(preferred) / sizeof(preferred[0]); ++p) {
+		size_t length = std::strlen(preferred[p]);
+		for (unsigned int i = 0; i < inLength; i += in[i] + 1) {
+			if (in[i] == length && i + 1 + length <= inLength &&
+			    std::memcmp(in + i + 1, preferred[p], length) == 0) {
+				*out = in + i + 1;
+				*outLength = static_cast<unsigned char>(length);
+				return SSL_TLSEXT_ERR_OK;
+			}
+		}
+	}
+	return SSL_TLSEXT_ERR_NOACK;
+}
@@ -0,0 +1,174 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TrafficCapture.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:30:11 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 18:30:12 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * TrafficCapture.cpp
+ * Implementation of the inbound traffic capture
+ */
+#include "includes/network/TrafficCapture.hpp"
+#include "includes/utils/Logger.hpp"
+#include "includes/utils/Clock.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+
+const char TrafficCapture::MAGIC[] = "WSCAP001";
+
+namespace {
+	// Write out once this much is buffered
+	const size_t FLUSH_SIZE = 64 * 1024;
+}
+
+TrafficCapture::TrafficCapture()
+	: _fd(-1)
+	, _sample(1)
+	, _maxSize(0)
+	, _written(0)
+	, _accepted(0)
+	, _nextId(1)
+	, _last(0)
+	, _lastFlush(0) {
+}
+
+TrafficCapture::~TrafficCapture() {
+	if (_fd >= 0) {
+		flush();
+		::close(_fd);
+	}
+}
+
+bool TrafficCapture::open(const std::string& path, unsigned int sample, size_t maxSize) {
+	_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		LOG_ERROR << "Cannot open capture file " << Logger::param(path) << ": "
+		          << Logger::errstr() << std::endl;
+		return false;
+	}
+	_sample = sample ? sample : 1;
+	_maxSize = maxSize;
+	_last = now();
+	_lastFlush = Clock::now();
+	_buffer.append(MAGIC, MAGIC_LENGTH);
+
+	LOG_INFO << "Capturing 1 in " << _sample << " connections to " << Logger::param(path) << std::endl;
+	return true;
+}
+
+unsigned long TrafficCapture::start(int fd, bool tls) {
+	if (_accepted++ % _sample != 0) {
+		return 0;
+	}
+
+	// The listener port tells the replayer which server block was hit
+	struct sockaddr_in local;
+	socklen_t length = sizeof(local);
+	unsigned long port = 0;
+	if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&local), &length) == 0) {
+		port = ntohs(local.sin_port);
+	}
+
+	unsigned long id = _nextId++;
+	if (!record('O', id, 4)) {
+		return 0;
+	}
+	putVarint(port);
+	_buffer += static_cast<char>(tls ? 1 : 0);
+	return id;
+}
+
+void TrafficCapture::data(unsigned long id, const char* bytes, size_t length) {
+	if (!record('D', id, length + 10)) {
+		return;
+	}
+	putVarint(length);
+	_buffer.append(bytes, length);
+	if (_buffer.size() >= FLUSH_SIZE) {
+		flush();
+	}
+}
+
+void TrafficCapture::end(unsigned long id) {
+	record('C', id, 0);
+}
+
+// Record header; false once capturing has stopped (or would exceed max_size)
+bool TrafficCapture::record(char type, unsigned long id, size_t extra) {
+	if (_fd < 0) {
+		return false;
+	}
+	if (_maxSize && _written + _buffer.size() + extra + 21 > _maxSize) {
+		stop("max_size reached");
+		return false;
+	}
+
+	unsigned long long current = now();
+	_buffer += type;
+	putVarint(current - _last);
+	putVarint(id);
+	_last = current;
+	return true;
+}
+
+void TrafficCapture::putVarint(unsigned long long value) {
+	while (value >= 0x80) {
+		_buffer += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	_buffer += static_cast<char>(value);
+}
+
+void TrafficCapture::tick() {
+	if (!_buffer.empty() && Clock::now() - _lastFlush >= 1) {
+		flush();
+	}
+}
+
+void TrafficCapture::flush() {
+	_lastFlush = Clock::now();
+	if (_buffer.empty() || _fd < 0) {
+		return;
+	}
+
+	size_t offset = 0;
+	while (offset < _buffer.size()) {
+		ssize_t written = ::write(_fd, _buffer.data() + offset, _buffer.size() - offset);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			_buffer.clear();
+			stop("write failed");
+			return;
+		}
+		offset += written;
+	}
+	_written += _buffer.size();
+	_buffer.clear();
+}
+
+// Stop recording for good (connections already captured end without 'C')
+void TrafficCapture::stop(const char* reason) {
+	LOG_WARNING << "Traffic capture stopped: " << reason << " (" << _written + _buffer.size()
+	            << " bytes written)" << std::endl;
+	flush();
+	::close(_fd);
+	_fd = -1;
+}
+
+unsigned long long TrafficCapture::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long long>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
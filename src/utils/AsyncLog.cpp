@@ -0,0 +1,298 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AsyncLog.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:02:11 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 15:02:12 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * AsyncLog.cpp
+ * Implementation of the asynchronous log writer
+ */
+#include "includes/utils/AsyncLog.hpp"
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+namespace Logger {
+
+	namespace {
+		// writev completo (retoma as escritas parciais); saída inutilizável: descartar
+		void writeAll(int fd, struct iovec* iov, int count) {
+			while (count > 0) {
+				ssize_t written = ::writev(fd, iov, count);
+				if (written < 0 && errno == EINTR)
+					continue;
+				if (written <= 0)
+					return;
+				size_t left = static_cast<size_t>(written);
+				while (count > 0 && left >= iov->iov_len) {
+					left -= iov->iov_len;
+					++iov;
+					--count;
+				}
+				if (count > 0) {
+					iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+					iov->iov_len -= left;
+				}
+			}
+		}
+	}
+
+	// RingBuffer
+	RingBuffer::RingBuffer(size_t capacity)
+		: _data(NULL), _capacity(1), _mask(0), _head(0), _tail(0) {
+		while (_capacity < capacity)
+			_capacity <<= 1;
+		_mask = _capacity - 1;
+		_data = new char[_capacity];
+	}
+
+	RingBuffer::~RingBuffer() {
+		delete[] _data;
+	}
+
+	void RingBuffer::copyIn(size_t position, const char* data, size_t length) {
+		size_t offset = position & _mask;
+		size_t first = _capacity - offset;
+		if (first > length)
+			first = length;
+		std::memcpy(_data + offset, data, first);
+		std::memcpy(_data, data + first, length - first);
+	}
+
+	void RingBuffer::copyOut(size_t position, char* data, size_t length) const {
+		size_t offset = position & _mask;
+		size_t first = _capacity - offset;
+		if (first > length)
+			first = length;
+		std::memcpy(data, _data + offset, first);
+		std::memcpy(data + first, _data, length - first);
+	}
+
+	bool RingBuffer::push(int channel, const char* data, size_t length, bool& wasEmpty) {
+		size_t head = _head;
+		size_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+		if (HEADER + length > _capacity - (head - tail))
+			return false;
+
+		char header[HEADER];
+		unsigned int size = static_cast<unsigned int>(length);
+		header[0] = static_cast<char>(channel);
+		std::memcpy(header + 1, &size, sizeof(size));
+		copyIn(head, header, HEADER);
+		copyIn(head + HEADER, data, length);
+		__atomic_store_n(&_head, head + HEADER + length, __ATOMIC_RELEASE);
+
+		// Par com empty(): ou o consumidor vê o novo _head, ou aqui se vê
+		// que ele já tinha chegado ao fim (e vai dormir)
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		wasEmpty = (__atomic_load_n(&_tail, __ATOMIC_ACQUIRE) == head);
+		return true;
+	}
+
+	bool RingBuffer::empty() const {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) == _tail;
+	}
+
+	size_t RingBuffer::drain(const int* fds) {
+		size_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+		size_t tail = _tail;
+		size_t total = head - tail;
+
+		while (tail != head) {
+			// Registos seguidos do mesmo canal: um só writev
+			struct iovec iov[MAX_IOV];
+			int count = 0;
+			int channel = -1;
+			size_t end = tail;
+			while (end != head && count <= MAX_IOV - 2) {
+				char header[HEADER];
+				unsigned int size;
+				copyOut(end, header, HEADER);
+				std::memcpy(&size, header + 1, sizeof(size));
+				if (channel >= 0 && header[0] != channel)
+					break;
+				channel = header[0];
+
+				size_t offset = (end + HEADER) & _mask;
+				size_t first = _capacity - offset;
+				if (first > size)
+					first = size;
+				iov[count].iov_base = _data + offset;
+				iov[count++].iov_len = first;
+				if (size > first) {
+					iov[count].iov_base = _data;
+					iov[count++].iov_len = size - first;
+				}
+				end += HEADER + size;
+			}
+			writeAll(fds[channel], iov, count);
+			tail = end;
+		}
+
+		__atomic_store_n(&_tail, tail, __ATOMIC_RELEASE);
+		return total;
+	}
+
+	// Estado do writer assíncrono
+	namespace {
+		RingBuffer* ring = NULL;
+		int outputs[2] = { STDOUT_FILENO, STDERR_FILENO };	// Destino de cada canal
+		int wakeup[2] = { -1, -1 };				// Pipe que acorda a thread de escrita
+		pthread_t writer;
+		pthread_t producer;						// Única thread que escreve no ring
+		int running = 0;
+		int async = 0;
+		unsigned long dropped = 0;
+		bool atforkInstalled = false;
+
+		int channelFor(int fd) {
+			return fd == STDERR_FILENO ? 1 : 0;
+		}
+
+		void wake() {
+			char byte = 0;
+			ssize_t ignored = ::write(wakeup[1], &byte, 1);	// Pipe cheio: já vai acordar
+			(void)ignored;
+		}
+
+		void* writerLoop(void*) {
+			while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+				if (ring->drain(outputs) > 0 || !ring->empty())
+					continue;
+
+				struct pollfd pfd;
+				pfd.fd = wakeup[0];
+				pfd.events = POLLIN;
+				pfd.revents = 0;
+				if (poll(&pfd, 1, -1) > 0) {
+					char bytes[64];
+					while (::read(wakeup[0], bytes, sizeof(bytes)) > 0) {
+					}
+				}
+			}
+			ring->drain(outputs);
+			return NULL;
+		}
+
+		// O processo filho não herda a thread: volta à escrita síncrona
+		void afterForkChild() {
+			async = 0;
+			running = 0;
+		}
+
+		void writeDirect(int fd, const char* data, size_t length) {
+			while (length > 0) {
+				ssize_t written = ::write(fd, data, length);
+				if (written < 0 && errno == EINTR)
+					continue;
+				if (written <= 0)
+					return;
+				data += written;
+				length -= static_cast<size_t>(written);
+			}
+		}
+
+		void closeWakeup() {
+			close(wakeup[0]);
+			close(wakeup[1]);
+			wakeup[0] = wakeup[1] = -1;
+		}
+	}
+
+	bool startAsync(size_t capacity) {
+		if (async)
+			return true;
+
+		if (!atforkInstalled) {
+			pthread_atfork(NULL, NULL, afterForkChild);
+			atforkInstalled = true;
+		}
+
+		if (pipe(wakeup) < 0)
+			return false;
+		for (int i = 0; i < 2; ++i) {
+			fcntl(wakeup[i], F_SETFL, fcntl(wakeup[i], F_GETFL) | O_NONBLOCK);
+			fcntl(wakeup[i], F_SETFD, FD_CLOEXEC);
+		}
+
+		ring = new RingBuffer(capacity);
+		producer = pthread_self();
+		__atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+
+		if (pthread_create(&writer, NULL, writerLoop, NULL) != 0) {
+			running = 0;
+			delete ring;
+			ring = NULL;
+			closeWakeup();
+			return false;
+		}
+		async = 1;
+		return true;
+	}
+
+	void stopAsync() {
+		if (!async)
+			return;
+
+		__atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+		wake();
+		pthread_join(writer, NULL);
+		async = 0;
+
+		delete ring;
+		ring = NULL;
+		closeWakeup();
+
+		if (dropped > 0) {
+			char notice[96];
+			int length = std::snprintf(notice, sizeof(notice),
+			                           "[logger] %lu log records dropped (buffer full)\n", dropped);
+			if (length > 0)
+				writeDirect(STDERR_FILENO, notice, static_cast<size_t>(length));
+		}
+	}
+
+	bool isAsync() {
+		return async != 0;
+	}
+
+	unsigned long droppedRecords() {
+		return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+	}
+
+	void redirectOutput(int fd) {
+		outputs[0] = fd;
+		outputs[1] = fd;
+	}
+
+	void writeRecord(int fd, const char* data, size_t length) {
+		if (length == 0)
+			return;
+
+		// Outras threads (e o modo síncrono) escrevem diretamente
+		int channel = channelFor(fd);
+		if (!async || !pthread_equal(pthread_self(), producer)) {
+			writeDirect(outputs[channel], data, length);
+			return;
+		}
+
+		bool wasEmpty;
+		if (!ring->push(channel, data, length, wasEmpty))
+			__atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+		else if (wasEmpty)
+			wake();
+	}
+}
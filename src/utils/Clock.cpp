@@ -0,0 +1,160 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Clock.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:10:42 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 19:10:43 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * Clock.cpp
+ * Implementação do relógio do event loop
+ */
+#include "includes/utils/Clock.hpp"
+#include <cstring>
+
+namespace Clock {
+
+	namespace {
+		struct timespec wall = { 0, 0 };
+		struct timespec mono = { 0, 0 };
+
+		// Cada string guarda o segundo a que corresponde
+		char date[HTTP_DATE_LENGTH + 1] = "";
+		time_t dateSecond = -1;
+		char log[32] = "";
+		time_t logSecond = -1;
+		char local[64] = "";
+		time_t localSecond = -1;
+		char iso[64] = "";
+		time_t isoSecond = -1;
+
+		// Última data pedida por httpDate(time_t)
+		char other[HTTP_DATE_LENGTH + 1] = "";
+		time_t otherSecond = -1;
+
+		const char DAYS[] = "SunMonTueWedThuFriSat";
+		const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+		void ensure() {
+			if (wall.tv_sec == 0)
+				update();
+		}
+
+		void putNumber(char* out, int value, int digits) {
+			while (digits-- > 0) {
+				out[digits] = '0' + value % 10;
+				value /= 10;
+			}
+		}
+
+		// "Mon, 19 Oct 2026 15:02:11 GMT" sem strftime
+		void formatHttpDate(time_t time, char* out) {
+			struct tm tm;
+			gmtime_r(&time, &tm);
+			std::memcpy(out, DAYS + tm.tm_wday * 3, 3);
+			out[3] = ',';
+			out[4] = ' ';
+			putNumber(out + 5, tm.tm_mday, 2);
+			out[7] = ' ';
+			std::memcpy(out + 8, MONTHS + tm.tm_mon * 3, 3);
+			out[11] = ' ';
+			putNumber(out + 12, tm.tm_year + 1900, 4);
+			out[16] = ' ';
+			putNumber(out + 17, tm.tm_hour, 2);
+			out[19] = ':';
+			putNumber(out + 20, tm.tm_min, 2);
+			out[22] = ':';
+			putNumber(out + 23, tm.tm_sec, 2);
+			std::memcpy(out + 25, " GMT", 4);
+			out[HTTP_DATE_LENGTH] = '\0';
+		}
+	}
+
+	void update() {
+		clock_gettime(CLOCK_REALTIME, &wall);
+		clock_gettime(CLOCK_MONOTONIC, &mono);
+	}
+
+	time_t now() {
+		ensure();
+		return wall.tv_sec;
+	}
+
+	unsigned long long nowMilliseconds() {
+		ensure();
+		return static_cast<unsigned long long>(wall.tv_sec) * 1000 + wall.tv_nsec / 1000000;
+	}
+
+	double monotonic() {
+		ensure();
+		return mono.tv_sec + mono.tv_nsec / 1e9;
+	}
+
+	const char* httpDate() {
+		time_t second = now();
+		if (second != dateSecond) {
+			formatHttpDate(second, date);
+			dateSecond = second;
+		}
+		return date;
+	}
+
+	const char* httpDate(time_t time) {
+		if (time == now())
+			return httpDate();
+		if (time != otherSecond) {
+			formatHttpDate(time, other);
+			otherSecond = time;
+		}
+		return other;
+	}
+
+	const char* logTime() {
+		time_t second = now();
+		if (second != logSecond) {
+			char buffer[32];
+			if (ctime_r(&second, buffer)) {
+				size_t length = std::strlen(buffer);
+				if (length > 0 && buffer[length - 1] == '\n')
+					buffer[length - 1] = '\0';
+				std::memcpy(log, buffer, sizeof(log));
+			}
+			logSecond = second;
+		}
+		return log;
+	}
+
+	const char* timeLocal() {
+		time_t second = now();
+		if (second != localSecond) {
+			struct tm tm;
+			localtime_r(&second, &tm);
+			strftime(local, sizeof(local), "%d/%b/%Y:%H:%M:%S %z", &tm);
+			localSecond = second;
+		}
+		return local;
+	}
+
+	const char* timeIso8601() {
+		time_t second = now();
+		if (second != isoSecond) {
+			struct tm tm;
+			localtime_r(&second, &tm);
+			size_t length = strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%S%z", &tm);
+			// +0000 -> +00:00
+			if (length >= 5 && length + 1 < sizeof(iso)) {
+				iso[length + 1] = '\0';
+				iso[length] = iso[length - 1];
+				iso[length - 1] = iso[length - 2];
+				iso[length - 2] = ':';
+			}
+			isoSecond = second;
+		}
+		return iso;
+	}
+}
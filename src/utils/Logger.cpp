@@ -15,58 +15,154 @@
  * Implementation of Logger utility
  */
 #include "includes/utils/Logger.hpp"
-#include <ctime>
+#include "includes/utils/Clock.hpp"
+#include <unistd.h>
+#include <fcntl.h>
 
 namespace Logger {
+    Level threshold = LEVEL_DEBUG;
+    bool colors = true;
+
+    // Levels
+    void setLevel(Level level) {
+        threshold = level;
+    }
+
+    bool parseLevel(const std::string& name, Level& level) {
+        if (name == "debug")
+            level = LEVEL_DEBUG;
+        else if (name == "info" || name == "notice")
+            level = LEVEL_INFO;
+        else if (name == "warn" || name == "warning")
+            level = LEVEL_WARN;
+        else if (name == "error" || name == "crit" || name == "alert" || name == "emerg")
+            level = LEVEL_ERROR;
+        else
+            return false;
+        return true;
+    }
+
+    namespace {
+        std::string logPath;    // Ficheiro do error_log ("" = terminal)
+        int logFd = -1;
+    }
+
+    bool setLogFile(const std::string& path) {
+        if (path == "stderr") {
+            redirectOutput(STDERR_FILENO);
+            colors = isatty(STDERR_FILENO);
+            return true;
+        }
+
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        redirectOutput(fd);
+        colors = false;
+        logPath = path;
+        logFd = fd;
+        return true;
+    }
+
+    bool reopenLogFile() {
+        if (logFd < 0)
+            return true;
+
+        // Mesmo descritor: a thread de escrita não dá pela troca
+        int fd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        dup2(fd, logFd);
+        close(fd);
+        return true;
+    }
+
+    // RecordBuffer
+    RecordBuffer::RecordBuffer(int fd)
+        : fd(fd) {
+        setp(area, area + INLINE_SIZE);
+    }
+
+    int RecordBuffer::getFd() const {
+        return fd;
+    }
+
+    void RecordBuffer::reset() {
+        spill.clear();
+        setp(area, area + INLINE_SIZE);
+    }
+
+    // Inline area full: move it to spill and keep going
+    int RecordBuffer::overflow(int c) {
+        spill.append(pbase(), pptr() - pbase());
+        setp(area, area + INLINE_SIZE);
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    // Record complete: hand it over in one piece
+    int RecordBuffer::sync() {
+        if (spill.empty()) {
+            writeRecord(fd, pbase(), pptr() - pbase());
+        } else {
+            spill.append(pbase(), pptr() - pbase());
+            writeRecord(fd, spill.data(), spill.length());
+        }
+        reset();
+        return 0;
+    }
 
     // Stream constructor with custom output stream
-    Stream::Stream(std::ostream& out, const std::string& header, const std::string& color, bool enabled)
-        : header(header), out(out), color(color), enabled(enabled) {}
+    Stream::Stream(std::ostream& out, const std::string& header, const std::string& color,
+                   Level level, bool enabled)
+        : header(header), color(color), level(level), enabled(enabled)
+        , buffer(&out == &std::cerr ? STDERR_FILENO : STDOUT_FILENO)
+        , record(&buffer), disabled(NULL) {}
 
     // Stream constructor with default std::cout
-    Stream::Stream(const std::string& header, const std::string& color, bool enabled)
-        : header(header), out(std::cout), color(color), enabled(enabled) {}
+    Stream::Stream(const std::string& header, const std::string& color, Level level, bool enabled)
+        : header(header), color(color), level(level), enabled(enabled)
+        , buffer(STDOUT_FILENO), record(&buffer), disabled(NULL) {}
 
     // Destructor
     Stream::~Stream() {}
 
-    // Copy constructor
+    // Copy constructor (the record in progress is not copied)
     Stream::Stream(const Stream& other)
-        : header(other.header), out(other.out), color(other.color), enabled(other.enabled) {}
+        : header(other.header), color(other.color), level(other.level), enabled(other.enabled)
+        , buffer(other.buffer.getFd()), record(&buffer), disabled(NULL) {}
 
     // Assignment operator
     Stream& Stream::operator=(const Stream& other) {
         if (this != &other) {
             header = other.header;
             color = other.color;
+            level = other.level;
             enabled = other.enabled;
-            // Note: out is a reference and cannot be reassigned
+            // Note: the output descriptor is fixed at construction
         }
         return *this;
     }
 
-    // Build header with timestamp and formatting
-    std::string Stream::buildHeader() const {
-        return color + "[" + getTime() + "] " + header + RESET;
-    }
-
-    // Get current timestamp
-    std::string Stream::getTime() const {
-        time_t now = time(0);
-        char* timeStr = ctime(&now);
-        std::string result(timeStr);
-        // Remove trailing newline
-        if (!result.empty() && result[result.length() - 1] == '\n') {
-            result.erase(result.length() - 1);
-        }
-        return result;
+    // Start a record with timestamp and formatting
+    // An unterminated record (e.g. `if (Logger::debug << "")`) is discarded
+    void Stream::writeHeader() {
+        buffer.reset();
+        record.clear();
+        if (colors)
+            record << color << "[" << Clock::logTime() << "] " << header << RESET << " ";
+        else
+            record << "[" << Clock::logTime() << "] " << header << " ";
     }
 
     // Pre-defined logger instances
-    Stream info(std::cout, "INFO", BLUE, true);
-    Stream debug(std::cout, "DEBUG", DARK_GRAY, true);
-    Stream warning(std::cout, "WARNING", DARK_YELLOW, true);
-    Stream error(std::cerr, "ERROR", RED, true);
-    Stream success(std::cout, "SUCCESS", GREEN, true);
-    Stream child(std::cout, "CHILD", CYAN, true);
+    Stream info(std::cout, "INFO", BLUE, LEVEL_INFO, true);
+    Stream debug(std::cout, "DEBUG", DARK_GRAY, LEVEL_DEBUG, true);
+    Stream warning(std::cout, "WARNING", DARK_YELLOW, LEVEL_WARN, true);
+    Stream error(std::cerr, "ERROR", RED, LEVEL_ERROR, true);
+    Stream success(std::cout, "SUCCESS", GREEN, LEVEL_INFO, true);
+    Stream child(std::cout, "CHILD", CYAN, LEVEL_INFO, true);
 }
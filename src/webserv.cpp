@@ -15,16 +15,35 @@
 
 // Global pointer to server manager for signal handling
 HTTP::ServerManager* g_serverManager = NULL;
+volatile sig_atomic_t g_signal = 0;
 
+// Only flags the stop: logging from a signal handler could interleave
+// with a record being written by the event loop
 void signalHandler(int signal) {
-	(void)signal;
-	std::cout << std::endl;
-	Logger::warning << "Received interrupt signal, stopping server..." << std::endl;
+	g_signal = signal;
 	if (g_serverManager) {
 		g_serverManager->stop();
 	}
 }
 
+// Free the singletons and flush the log writer (on every exit after
+// startup; a new singleton is added here only)
+static void cleanup() {
+	Instance::Destroy<Settings>();
+	Instance::Destroy<HTTP::GzipCache>();
+	Instance::Destroy<HTTP::DirectoryIndex>();
+	Instance::Destroy<HTTP::AccessLogs>();
+	Instance::Destroy<HTTP::Metrics>();
+	Instance::Destroy<HTTP::ErrorPages>();
+	Instance::Destroy<HTTP::RateLimiter>();
+	Instance::Destroy<HTTP::Upstreams>();
+	Instance::Destroy<CGI::Environment>();
+	Instance::Destroy<CGI::Cache>();
+	Instance::Destroy<TrafficCapture>();
+
+	Logger::stopAsync();
+}
+
 int	main(int ac, char **av, char **env)
 {
 	(void)env;
@@ -38,49 +57,84 @@ int	main(int ac, char **av, char **env)
 	// Initialize settings
 	Settings* settings = Instance::Get<Settings>();
 	if (!settings->isValid()) {
-		Logger::error << "Failed to load settings" << std::endl;
+		LOG_ERROR << "Failed to load settings" << std::endl;
 		return 1;
 	}
 
-	// Determine config file path
-	std::string configFile = (ac > 1) ? av[1] : "config/default.conf";
-	Logger::info << "Loading configuration from: " << Logger::param(configFile) << std::endl;
+	// Command line: webserv [-l level] [config file]
+	std::string configFile = "config/default.conf";
+	std::string levelOverride;
+	for (int i = 1; i < ac; ++i) {
+		std::string arg = av[i];
+		if (arg == "-l") {
+			Logger::Level level;
+			if (i + 1 >= ac || !Logger::parseLevel(av[i + 1], level)) {
+				LOG_ERROR << "Usage: " << av[0] << " [-l debug|info|warn|error] [config file]" << std::endl;
+				return 1;
+			}
+			levelOverride = av[++i];
+			Logger::setLevel(level);
+		} else {
+			configFile = arg;
+		}
+	}
+	LOG_INFO << "Loading configuration from: " << Logger::param(configFile) << std::endl;
 
 	// Parse configuration
 	Config config;
 	ConfigParser parser;
 
 	if (!parser.parse(configFile, config)) {
-		Logger::error << parser.getError() << std::endl;
+		LOG_ERROR << parser.getError() << std::endl;
 		return 1;
 	}
 
-	Logger::success << "Configuration loaded successfully!" << std::endl;
+	LOG_SUCCESS << "Configuration loaded successfully!" << std::endl;
 	std::cout << std::endl;
 
+	// error_log: destination and level (-l on the command line wins)
+	if (!config.getErrorLogPath().empty() && !Logger::setLogFile(config.getErrorLogPath())) {
+		LOG_ERROR << "Failed to open error_log " << config.getErrorLogPath() << ": "
+		          << Logger::errstr() << std::endl;
+		return 1;
+	}
+	Logger::Level level;
+	if (levelOverride.empty() && Logger::parseLevel(config.getErrorLogLevel(), level)) {
+		Logger::setLevel(level);
+	}
+
+	// From here on log records are written by a background thread
+	if (!Logger::startAsync()) {
+		LOG_WARNING << "Failed to start the log writer thread, logging synchronously" << std::endl;
+	}
+
 	// Initialize server manager
 	HTTP::ServerManager serverManager;
 	g_serverManager = &serverManager;
 
 	if (!serverManager.init(config)) {
-		Logger::error << "Failed to initialize server manager" << std::endl;
+		LOG_ERROR << "Failed to initialize server manager" << std::endl;
+		cleanup();
 		return 1;
 	}
 
 	// Setup signal handlers
 	signal(SIGINT, signalHandler);  // Ctrl+C
 	signal(SIGTERM, signalHandler); // kill
+	signal(SIGUSR1, HTTP::AccessLogs::requestReopen); // logrotate: reopen log files
 
 	std::cout << std::endl;
 
 	// Start server (blocking)
 	serverManager.run();
 
-	std::cout << std::endl;
-	Logger::success << "Server shutdown complete." << std::endl;
+	if (g_signal) {
+		LOG_WARNING << "Received interrupt signal, stopping server..." << std::endl;
+	}
+	LOG_SUCCESS << "Server shutdown complete." << std::endl;
 
 	// Clean up singleton instances to avoid memory leaks
-	Instance::Destroy<Settings>();
+	cleanup();
 
 	return 0;
 }
@@ -0,0 +1,583 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   loadgen.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 17:05:12 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 17:05:13 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * loadgen.cpp
+ * HTTP load generator used by "make bench"
+ * Runs one scenario file: N concurrent connections issuing the same request
+ * for a fixed duration (keep-alive when the server allows it, a new
+ * connection otherwise), optionally writing the request in small slow
+ * chunks. Prints one JSON object: requests/sec, latency percentiles, errors
+ * and the server's RSS (-p pid)
+ *
+ * Usage: loadgen [-p pid] [-d seconds] [-c connections] scenario.conf
+ *        loadgen -w host:port   (wait until the server accepts connections)
+ */
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+
+struct Scenario {
+	std::string name;
+	std::string host;
+	int port;
+	int connections;
+	double duration;
+	bool keepAlive;
+	std::string method;
+	std::string path;          // "%n" is replaced by a request counter
+	std::string contentType;
+	size_t bodySize;           // Generated request body (0 = none)
+	bool multipart;            // Send the body as a multipart/form-data file upload
+	size_t writeChunk;         // Slow client: bytes per write (0 = all at once)
+	int writeDelayMs;          // Slow client: pause between writes
+	std::vector<std::string> headers;   // Extra request headers ("Name: value")
+
+	Scenario()
+		: host("127.0.0.1"), port(8090), connections(16), duration(5), keepAlive(true),
+		  method("GET"), path("/"), bodySize(0), multipart(false), writeChunk(0),
+		  writeDelayMs(0) {}
+};
+
+struct Client {
+	enum State { IDLE, CONNECTING, SENDING, READING };
+
+	int fd;
+	State state;
+	std::string request;
+	size_t sent;
+	double nextWrite;
+	std::string response;
+	size_t headerEnd;          // 0 until the response head is complete
+	long contentLength;        // -1: read until the server closes
+	bool serverCloses;
+	bool reused;               // Kept alive after an earlier response
+	double start;
+
+	Client()
+		: fd(-1), state(IDLE), sent(0), nextWrite(0), headerEnd(0), contentLength(-1),
+		  serverCloses(false), reused(false), start(0) {}
+};
+
+struct Results {
+	unsigned long requests;
+	unsigned long errors;
+	unsigned long connects;
+	std::map<int, unsigned long> statuses;
+	unsigned long long bytesIn;
+	std::vector<double> latencies;  // Milliseconds
+	long rssPeakKb;
+
+	Results() : requests(0), errors(0), connects(0), bytesIn(0), rssPeakKb(0) {}
+};
+
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::string trim(const std::string& value) {
+	size_t start = value.find_first_not_of(" \t\r");
+	if (start == std::string::npos) {
+		return "";
+	}
+	size_t end = value.find_last_not_of(" \t\r");
+	return value.substr(start, end - start + 1);
+}
+
+// "key = value" lines, '#' starts a comment
+bool loadScenario(const char* file, Scenario& scenario) {
+	std::ifstream in(file);
+	if (!in.is_open()) {
+		std::cerr << "loadgen: cannot open " << file << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(in, line)) {
+		size_t hash = line.find('#');
+		if (hash != std::string::npos) {
+			line.erase(hash);
+		}
+		size_t equals = line.find('=');
+		if (trim(line).empty()) {
+			continue;
+		}
+		if (equals == std::string::npos) {
+			std::cerr << "loadgen: " << file << ": expected key = value: " << line << std::endl;
+			return false;
+		}
+		std::string key = trim(line.substr(0, equals));
+		std::string value = trim(line.substr(equals + 1));
+
+		if (key == "name") scenario.name = value;
+		else if (key == "host") scenario.host = value;
+		else if (key == "port") scenario.port = std::atoi(value.c_str());
+		else if (key == "connections") scenario.connections = std::atoi(value.c_str());
+		else if (key == "duration") scenario.duration = std::atof(value.c_str());
+		else if (key == "keepalive") scenario.keepAlive = (value == "on");
+		else if (key == "method") scenario.method = value;
+		else if (key == "path") scenario.path = value;
+		else if (key == "content_type") scenario.contentType = value;
+		else if (key == "body_size") scenario.bodySize = std::strtoul(value.c_str(), NULL, 10);
+		else if (key == "multipart") scenario.multipart = (value == "on");
+		else if (key == "write_chunk") scenario.writeChunk = std::strtoul(value.c_str(), NULL, 10);
+		else if (key == "write_delay_ms") scenario.writeDelayMs = std::atoi(value.c_str());
+		else if (key == "header") scenario.headers.push_back(value);
+		else {
+			std::cerr << "loadgen: " << file << ": unknown key " << key << std::endl;
+			return false;
+		}
+	}
+	if (scenario.name.empty()) {
+		scenario.name = file;
+	}
+	return true;
+}
+
+std::string buildBody(const Scenario& scenario, std::string& contentType) {
+	std::string data(scenario.bodySize, 'x');
+	for (size_t i = 0; i < data.size(); i += 61) {
+		data[i] = '\n';
+	}
+	contentType = scenario.contentType;
+	if (!scenario.multipart) {
+		return data;
+	}
+
+	const std::string boundary = "----loadgen7MA4YWxkTrZu0gW";
+	contentType = "multipart/form-data; boundary=" + boundary;
+	return "--" + boundary + "\r\n"
+	       "Content-Disposition: form-data; name=\"file\"; filename=\"loadgen.bin\"\r\n"
+	       "Content-Type: application/octet-stream\r\n\r\n" +
+	       data + "\r\n--" + boundary + "--\r\n";
+}
+
+std::string buildRequest(const Scenario& scenario, const std::string& body,
+                         const std::string& contentType, unsigned long counter) {
+	std::string path = scenario.path;
+	size_t pos = path.find("%n");
+	if (pos != std::string::npos) {
+		std::ostringstream number;
+		number << counter;
+		path.replace(pos, 2, number.str());
+	}
+
+	std::ostringstream request;
+	request << scenario.method << " " << path << " HTTP/1.1\r\n"
+	        << "Host: " << scenario.host << ":" << scenario.port << "\r\n"
+	        << "User-Agent: webserv-loadgen\r\n"
+	        << "Accept: */*\r\n"
+	        << "Connection: " << (scenario.keepAlive ? "keep-alive" : "close") << "\r\n";
+	for (size_t i = 0; i < scenario.headers.size(); ++i) {
+		request << scenario.headers[i] << "\r\n";
+	}
+	if (!body.empty()) {
+		request << "Content-Type: " << contentType << "\r\n"
+		        << "Content-Length: " << body.size() << "\r\n";
+	}
+	request << "\r\n" << body;
+	return request.str();
+}
+
+int openConnection(const Scenario& scenario) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(scenario.port);
+	inet_pton(AF_INET, scenario.host.c_str(), &addr.sin_addr);
+
+	if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 &&
+	    errno != EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void closeClient(Client& client) {
+	if (client.fd >= 0) {
+		close(client.fd);
+	}
+	client.fd = -1;
+	client.state = Client::IDLE;
+}
+
+// A kept-alive connection the server closed before answering is simply
+// reopened (as browsers do); anything else counts as an error
+void failClient(Client& client, Results& results) {
+	if (!client.reused || !client.response.empty()) {
+		++results.errors;
+	}
+	closeClient(client);
+}
+
+// Parse the status line and the framing headers once the head is in
+void parseHead(Client& client) {
+	const std::string& response = client.response;
+	client.contentLength = -1;
+	client.serverCloses = false;
+
+	size_t lineEnd = response.find("\r\n");
+	size_t pos = lineEnd + 2;
+	while (pos < client.headerEnd - 2) {
+		size_t end = response.find("\r\n", pos);
+		std::string name = response.substr(pos, response.find(':', pos) - pos);
+		std::string value = trim(response.substr(pos + name.size() + 1, end - pos - name.size() - 1));
+		for (size_t i = 0; i < name.size(); ++i) {
+			name[i] = std::tolower(name[i]);
+		}
+		for (size_t i = 0; i < value.size(); ++i) {
+			value[i] = std::tolower(value[i]);
+		}
+		if (name == "content-length") {
+			client.contentLength = std::atol(value.c_str());
+		} else if (name == "connection" && value == "close") {
+			client.serverCloses = true;
+		}
+		pos = end + 2;
+	}
+}
+
+int statusOf(const std::string& response) {
+	if (response.size() < 12 || response.compare(0, 5, "HTTP/") != 0) {
+		return 0;
+	}
+	return std::atoi(response.c_str() + 9);
+}
+
+long readRssKb(int pid, const char* field) {
+	if (pid <= 0) {
+		return 0;
+	}
+	char path[64];
+	std::snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.compare(0, std::strlen(field), field) == 0) {
+			return std::atol(line.c_str() + std::strlen(field) + 1);
+		}
+	}
+	return 0;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+void run(const Scenario& scenario, int serverPid, Results& results) {
+	std::string contentType;
+	std::string body = buildBody(scenario, contentType);
+	std::vector<Client> clients(scenario.connections);
+	std::vector<struct pollfd> pollFds;
+	std::vector<size_t> pollClients;
+	unsigned long counter = 0;
+	double deadline = now() + scenario.duration;
+	double nextRssSample = 0;
+
+	while (true) {
+		double current = now();
+		if (current >= deadline) {
+			break;
+		}
+		if (current >= nextRssSample) {
+			long rss = readRssKb(serverPid, "VmRSS:");
+			results.rssPeakKb = std::max(results.rssPeakKb, rss);
+			nextRssSample = current + 0.1;
+		}
+
+		pollFds.clear();
+		pollClients.clear();
+		for (size_t i = 0; i < clients.size(); ++i) {
+			Client& client = clients[i];
+			if (client.state == Client::IDLE) {
+				client.fd = openConnection(scenario);
+				if (client.fd < 0) {
+					++results.errors;
+					continue;
+				}
+				++results.connects;
+				client.state = Client::CONNECTING;
+				client.request = buildRequest(scenario, body, contentType, counter++);
+				client.sent = 0;
+				client.nextWrite = 0;
+				client.response.clear();
+				client.headerEnd = 0;
+				client.reused = false;
+				client.start = current;
+			}
+			if (client.state == Client::SENDING && client.nextWrite > current) {
+				continue; // Slow client between two writes
+			}
+			struct pollfd pfd;
+			pfd.fd = client.fd;
+			pfd.events = (client.state == Client::READING) ? POLLIN : POLLOUT;
+			pfd.revents = 0;
+			pollFds.push_back(pfd);
+			pollClients.push_back(i);
+		}
+
+		int timeout = scenario.writeDelayMs > 0 ? 1 : 10;
+		if (poll(pollFds.empty() ? NULL : &pollFds[0], pollFds.size(), timeout) < 0 && errno != EINTR) {
+			break;
+		}
+		current = now();
+
+		for (size_t p = 0; p < pollFds.size(); ++p) {
+			Client& client = clients[pollClients[p]];
+			short revents = pollFds[p].revents;
+			if (revents == 0) {
+				continue;
+			}
+
+			if (client.state == Client::CONNECTING) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(client.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+				if (error != 0) {
+					failClient(client, results);
+					continue;
+				}
+				client.state = Client::SENDING;
+			}
+
+			if (client.state == Client::SENDING) {
+				size_t remaining = client.request.size() - client.sent;
+				if (scenario.writeChunk > 0 && remaining > scenario.writeChunk) {
+					remaining = scenario.writeChunk;
+				}
+				ssize_t written = send(client.fd, client.request.data() + client.sent, remaining, MSG_NOSIGNAL);
+				if (written < 0) {
+					if (errno != EAGAIN) {
+						failClient(client, results);
+					}
+					continue;
+				}
+				client.sent += written;
+				client.nextWrite = current + scenario.writeDelayMs / 1000.0;
+				if (client.sent >= client.request.size()) {
+					client.state = Client::READING;
+				}
+				continue;
+			}
+
+			// READING
+			char buffer[65536];
+			ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+			if (received < 0) {
+				if (errno != EAGAIN) {
+					failClient(client, results);
+				}
+				continue;
+			}
+			results.bytesIn += received;
+
+			bool complete = false;
+			if (received == 0) {
+				// Closed by the server: complete only if nothing was still expected
+				complete = client.headerEnd > 0 && client.contentLength < 0;
+				if (!complete) {
+					failClient(client, results);
+					continue;
+				}
+			} else {
+				// Keep the head, count body bytes without storing them
+				size_t headerEnd = client.headerEnd;
+				if (headerEnd == 0) {
+					client.response.append(buffer, received);
+					size_t end = client.response.find("\r\n\r\n");
+					if (end != std::string::npos) {
+						client.headerEnd = end + 4;
+						parseHead(client);
+					}
+				} else {
+					client.response.append(static_cast<size_t>(received), '\0');
+				}
+				if (client.headerEnd > 0 && client.contentLength >= 0 &&
+				    client.response.size() >= client.headerEnd + client.contentLength) {
+					complete = true;
+				}
+			}
+
+			if (complete) {
+				++results.requests;
+				++results.statuses[statusOf(client.response)];
+				results.latencies.push_back((current - client.start) * 1000);
+
+				if (received > 0 && scenario.keepAlive && !client.serverCloses) {
+					client.state = Client::SENDING;
+					client.request = buildRequest(scenario, body, contentType, counter++);
+					client.sent = 0;
+					client.nextWrite = 0;
+					client.response.clear();
+					client.headerEnd = 0;
+					client.reused = true;
+					client.start = current;
+				} else {
+					closeClient(client);
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < clients.size(); ++i) {
+		closeClient(clients[i]);
+	}
+}
+
+void printJson(const Scenario& scenario, Results& results, double elapsed, int serverPid) {
+	std::sort(results.latencies.begin(), results.latencies.end());
+	double max = results.latencies.empty() ? 0 : results.latencies.back();
+	unsigned long non2xx = 0;
+	for (std::map<int, unsigned long>::const_iterator it = results.statuses.begin();
+	     it != results.statuses.end(); ++it) {
+		if (it->first < 200 || it->first >= 300) {
+			non2xx += it->second;
+		}
+	}
+
+	std::printf("{\"scenario\":\"%s\",\"connections\":%d,\"duration_s\":%.2f,"
+	            "\"requests\":%lu,\"rps\":%.1f,\"errors\":%lu,\"non_2xx\":%lu,"
+	            "\"connects\":%lu,\"bytes_in\":%llu,"
+	            "\"latency_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f},"
+	            "\"statuses\":{",
+	            scenario.name.c_str(), scenario.connections, elapsed,
+	            results.requests, results.requests / elapsed, results.errors, non2xx,
+	            results.connects, results.bytesIn,
+	            percentile(results.latencies, 0.50), percentile(results.latencies, 0.99),
+	            percentile(results.latencies, 0.999), max);
+	for (std::map<int, unsigned long>::const_iterator it = results.statuses.begin();
+	     it != results.statuses.end(); ++it) {
+		std::printf("%s\"%d\":%lu", it == results.statuses.begin() ? "" : ",", it->first, it->second);
+	}
+	std::printf("},\"rss_kb\":%ld,\"rss_peak_kb\":%ld}\n",
+	            readRssKb(serverPid, "VmRSS:"), results.rssPeakKb);
+}
+
+// -w host:port: wait up to 5 seconds for the server to accept connections
+int waitForServer(const std::string& target) {
+	Scenario scenario;
+	size_t colon = target.find(':');
+	if (colon != std::string::npos) {
+		scenario.host = target.substr(0, colon);
+		scenario.port = std::atoi(target.c_str() + colon + 1);
+	}
+
+	for (int attempt = 0; attempt < 50; ++attempt) {
+		int fd = openConnection(scenario);
+		if (fd >= 0) {
+			struct pollfd pfd;
+			pfd.fd = fd;
+			pfd.events = POLLOUT;
+			pfd.revents = 0;
+			int error = 0;
+			socklen_t length = sizeof(error);
+			if (poll(&pfd, 1, 100) == 1 &&
+			    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+				close(fd);
+				return 0;
+			}
+			close(fd);
+		}
+		usleep(100000);
+	}
+	std::cerr << "loadgen: " << target << " is not accepting connections" << std::endl;
+	return 1;
+}
+
+void usage() {
+	std::cerr << "Usage: loadgen [-p pid] [-d seconds] [-c connections] scenario.conf" << std::endl
+	          << "       loadgen -w host:port" << std::endl;
+}
+
+}
+
+int main(int ac, char** av) {
+	int serverPid = 0;
+	double duration = 0;
+	int connections = 0;
+	const char* file = NULL;
+
+	signal(SIGPIPE, SIG_IGN);
+	for (int i = 1; i < ac; ++i) {
+		std::string arg = av[i];
+		if (arg == "-w" && i + 1 < ac) {
+			return waitForServer(av[i + 1]);
+		} else if (arg == "-p" && i + 1 < ac) {
+			serverPid = std::atoi(av[++i]);
+		} else if (arg == "-d" && i + 1 < ac) {
+			duration = std::atof(av[++i]);
+		} else if (arg == "-c" && i + 1 < ac) {
+			connections = std::atoi(av[++i]);
+		} else if (!file && arg[0] != '-') {
+			file = av[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (!file) {
+		usage();
+		return 1;
+	}
+
+	Scenario scenario;
+	if (!loadScenario(file, scenario)) {
+		return 1;
+	}
+	if (duration > 0) {
+		scenario.duration = duration;
+	}
+	if (connections > 0) {
+		scenario.connections = connections;
+	}
+
+	Results results;
+	double start = now();
+	run(scenario, serverPid, results);
+	printJson(scenario, results, now() - start, serverPid);
+	return 0;
+}
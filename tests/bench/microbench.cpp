@@ -0,0 +1,567 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   microbench.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 17:48:03 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 17:48:04 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * microbench.cpp
+ * Microbenchmarks for the request parser, response builder and the helpers
+ * on the request path, and CGI process start-up as the process grows
+ * ("make microbench")
+ * Each benchmark runs until it has taken at least -t seconds and reports
+ * ns/op, heap allocations/op and bytes allocated/op (counted by the
+ * operator new below) and bytes copied/op (memcpy/memmove, interposed
+ * below as well). Before the benchmarks, the route trie is checked against
+ * the linear matcher on randomized route sets
+ *
+ * Usage: microbench [-t seconds] [name-filter ...]
+ */
+#include "includes/http/Request.hpp"
+#include "includes/http/Response.hpp"
+#include "includes/http/RequestHandler.hpp"
+#include "includes/http/ErrorPages.hpp"
+#include "includes/http/Metrics.hpp"
+#include "includes/cgi/CGIExecutor.hpp"
+#include "includes/cgi/Environment.hpp"
+#include "includes/config/Config.hpp"
+#include "includes/config/Server.hpp"
+#include "includes/config/Route.hpp"
+#include "includes/config/VirtualHostTable.hpp"
+#include "includes/core/Instance.hpp"
+#include "includes/core/Settings.hpp"
+#include "includes/utils/Logger.hpp"
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* Instrumentation ---------------------------------------------------------- */
+
+namespace {
+
+bool counting = false;
+unsigned long long allocations = 0;
+unsigned long long allocatedBytes = 0;
+unsigned long long copiedBytes = 0;
+
+// Read through a volatile so the compiler can't fold the _chk calls below
+// back into memcpy/memmove (which would call the wrappers recursively)
+volatile size_t unlimited = static_cast<size_t>(-1);
+
+void* allocate(size_t size) {
+	if (counting) {
+		++allocations;
+		allocatedBytes += size;
+	}
+	void* ptr = std::malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+}
+
+// Not inlined: GCC would otherwise pair the inlined free() with the
+// operator new call site and warn about mismatched allocation functions
+__attribute__((noinline)) void* operator new(size_t size) throw(std::bad_alloc) { return allocate(size); }
+__attribute__((noinline)) void* operator new[](size_t size) throw(std::bad_alloc) { return allocate(size); }
+__attribute__((noinline)) void operator delete(void* ptr) throw() { std::free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr) throw() { std::free(ptr); }
+
+// std::string and std::vector copy through memcpy/memmove (libstdc++ calls
+// them through the PLT, so these definitions win); the glibc _chk variants
+// do the actual copy
+extern "C" void* __memcpy_chk(void* dst, const void* src, size_t length, size_t dstLength);
+extern "C" void* __memmove_chk(void* dst, const void* src, size_t length, size_t dstLength);
+
+extern "C" void* memcpy(void* __restrict dst, const void* __restrict src, size_t length) throw() {
+	if (counting) {
+		copiedBytes += length;
+	}
+	return __memcpy_chk(dst, src, length, unlimited);
+}
+
+extern "C" void* memmove(void* dst, const void* src, size_t length) throw() {
+	if (counting) {
+		copiedBytes += length;
+	}
+	return __memmove_chk(dst, src, length, unlimited);
+}
+
+/* Harness ------------------------------------------------------------------ */
+
+namespace {
+
+typedef void (*BenchFunction)(size_t iterations);
+
+struct Benchmark {
+	const char* name;
+	BenchFunction run;
+};
+
+// Results go here so the optimizer keeps the work
+volatile size_t sink = 0;
+
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::string number(size_t value) {
+	std::ostringstream out;
+	out << value;
+	return out.str();
+}
+
+// Double the iterations until one run takes at least minTime, report that run
+void runBenchmark(const Benchmark& bench, double minTime) {
+	bench.run(1); // Warm up (lazy initialisation, caches)
+
+	size_t iterations = 1;
+	while (true) {
+		allocations = 0;
+		allocatedBytes = 0;
+		copiedBytes = 0;
+		counting = true;
+		double start = now();
+		bench.run(iterations);
+		double elapsed = now() - start;
+		counting = false;
+
+		if (elapsed >= minTime || iterations >= (static_cast<size_t>(1) << 40)) {
+			double n = static_cast<double>(iterations);
+			std::printf("%-30s %12.1f %12.2f %14.1f %14.1f %12lu\n", bench.name,
+			            elapsed * 1e9 / n, allocations / n, allocatedBytes / n, copiedBytes / n,
+			            static_cast<unsigned long>(iterations));
+			return;
+		}
+		// Aim straight for minTime once the run is long enough to measure
+		if (elapsed > minTime / 100) {
+			size_t target = static_cast<size_t>(iterations * minTime / elapsed * 1.1) + 1;
+			iterations = target > iterations * 2 ? target : iterations * 2;
+		} else {
+			iterations *= 2;
+		}
+	}
+}
+
+/* Fixtures ----------------------------------------------------------------- */
+
+// Chrome-like request for a stylesheet, with cookies and validators
+const char* const BROWSER_REQUEST =
+	"GET /static/css/main.css?v=1729331234 HTTP/1.1\r\n"
+	"Host: www.example.com\r\n"
+	"Connection: keep-alive\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"129\", \"Not=A?Brand\";v=\"8\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+	"Chrome/129.0.0.0 Safari/537.36\r\n"
+	"Accept: text/css,*/*;q=0.1\r\n"
+	"Sec-Fetch-Site: same-origin\r\n"
+	"Sec-Fetch-Mode: no-cors\r\n"
+	"Sec-Fetch-Dest: style\r\n"
+	"Referer: https://www.example.com/products/index.html\r\n"
+	"Accept-Encoding: gzip, deflate, br, zstd\r\n"
+	"Accept-Language: en-US,en;q=0.9,pt-PT;q=0.8,pt;q=0.7\r\n"
+	"Cookie: session=9f8e7d6c5b4a39281706f5e4d3c2b1a0; _ga=GA1.1.1234567890.1729331234; "
+	"prefs=theme%3Ddark%26lang%3Den; cart=3\r\n"
+	"If-None-Match: \"5f3a-1a2b3c4d\"\r\n"
+	"If-Modified-Since: Sat, 19 Oct 2024 08:15:00 GMT\r\n"
+	"\r\n";
+
+struct Fixtures {
+	std::string browserRequest;
+	std::string formRequest;
+	std::string encoded;              // Percent-encoded text for urlDecode
+	HTTP::Request largeQuery;         // 200 query parameters
+	std::string multipartBody;
+	std::string multipartBoundary;
+	HTTP::Response response;
+	std::vector<std::string> extensions;
+	Server routes200;
+	std::vector<std::string> routeLookups200;
+	Server routeSets[3];              // 10, 100, 1000 routes
+	std::vector<std::string> routeLookups[3];
+	VirtualHostTable vhosts;
+	std::vector<Server> vhostServers;
+	std::vector<std::string> hostLookups;
+	Server cgiServer;
+	Route cgiRoute;
+	HTTP::Request cgiRequest;
+	std::string cgiScript;            // Shell script printing a small response
+};
+
+const size_t CGI_BALLAST = static_cast<size_t>(512) << 20;
+char* ballast = NULL;                 // Touched memory the CGI benchmarks run with
+
+Fixtures* fixtures = NULL;
+
+// "/svc<k>" and "/svc<k>/ep<j>" locations plus "/", "count" in total
+void buildRoutes(Server& server, std::vector<std::string>& lookups, size_t count) {
+	server.addRoute(Route("/"));
+	for (size_t i = 1; i < count; ++i) {
+		std::string path = "/svc" + number(i / 10);
+		if (i % 10 != 0) {
+			path += "/ep" + number(i % 10);
+		}
+		Route route(path);
+		route.setRoot("./www");
+		server.addRoute(route);
+
+		lookups.push_back(path);
+		lookups.push_back(path + "/items/42.json");
+	}
+	lookups.push_back("/");
+	lookups.push_back("/missing/page.html");
+	lookups.push_back("/svc1x/ep1");
+	server.compile();
+}
+
+void setUpFixtures() {
+	fixtures = new Fixtures();
+	Fixtures& f = *fixtures;
+
+	f.browserRequest = BROWSER_REQUEST;
+
+	std::string form;
+	for (int i = 0; form.size() < 2048; ++i) {
+		form += (i ? "&" : "") + std::string("field") + number(i) + "=some+value+%C3%A9%26more";
+	}
+	f.formRequest = "POST /test/form HTTP/1.1\r\n"
+	                "Host: www.example.com\r\n"
+	                "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Firefox/131.0\r\n"
+	                "Accept: text/html,application/xhtml+xml\r\n"
+	                "Content-Type: application/x-www-form-urlencoded\r\n"
+	                "Content-Length: " + number(form.size()) + "\r\n"
+	                "\r\n" + form;
+
+	for (int i = 0; f.encoded.size() < 2048; ++i) {
+		f.encoded += "caf%C3%A9+na+esquina%2C+n%C2%BA" + number(i) + "%2Fdois+";
+	}
+
+	std::string query;
+	for (int i = 0; i < 200; ++i) {
+		query += (i ? "&" : "") + std::string("key") + number(i) + "=value%20" + number(i) + "%2Fx+y";
+	}
+	f.largeQuery.parse("GET /search?" + query + " HTTP/1.1\r\nHost: www.example.com\r\n\r\n");
+
+	// A plain field (skipped by the parser) and two files
+	f.multipartBoundary = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+	std::string text;
+	while (text.size() < 16384) {
+		text += "Lorem ipsum dolor sit amet, consectetur adipiscing elit.\r\n";
+	}
+	std::string binary;
+	for (size_t i = 0; i < 49152; ++i) {
+		binary += static_cast<char>((i * 131 + 7) % 251);
+	}
+	const std::string delimiter = "--" + f.multipartBoundary + "\r\n";
+	f.multipartBody = delimiter +
+		"Content-Disposition: form-data; name=\"description\"\r\n\r\n"
+		"Quarterly report\r\n" + delimiter +
+		"Content-Disposition: form-data; name=\"notes\"; filename=\"notes.txt\"\r\n"
+		"Content-Type: text/plain\r\n\r\n" + text + "\r\n" + delimiter +
+		"Content-Disposition: form-data; name=\"data\"; filename=\"data.bin\"\r\n"
+		"Content-Type: application/octet-stream\r\n\r\n" + binary + "\r\n"
+		"--" + f.multipartBoundary + "--\r\n";
+
+	f.response.setStatus(200);
+	f.response.setContentType("text/html; charset=utf-8");
+	f.response.setLastModified(1729331234);
+	f.response.setETag("\"5f3a-1a2b3c4d\"");
+	f.response.setCacheControl("public, max-age=3600");
+	f.response.setBody(std::string(4096, 'x'));
+	Instance::Get<HTTP::ErrorPages>()->open(Config());
+
+	const char* extensions[] = { "html", "css", "js", "png", "jpg", "svg", "woff2", "json",
+	                             "txt", "pdf", "mp4", "unknownext" };
+	f.extensions.assign(extensions, extensions + sizeof(extensions) / sizeof(extensions[0]));
+
+	buildRoutes(f.routes200, f.routeLookups200, 200);
+	const size_t sizes[3] = { 10, 100, 1000 };
+	for (int i = 0; i < 3; ++i) {
+		buildRoutes(f.routeSets[i], f.routeLookups[i], sizes[i]);
+	}
+
+	// 10k exact names, 1k left and 1k right wildcards, a few servers behind them
+	f.vhostServers.resize(16);
+	f.vhosts.setDefault(&f.vhostServers[0]);
+	for (int i = 0; i < 10000; ++i) {
+		f.vhosts.add("site" + number(i) + ".example.com", &f.vhostServers[i % 16]);
+	}
+	for (int i = 0; i < 1000; ++i) {
+		f.vhosts.add("*.tenant" + number(i) + ".example.net", &f.vhostServers[i % 16]);
+		f.vhosts.add("www.shop" + number(i) + ".*", &f.vhostServers[i % 16]);
+	}
+	const char* hosts[] = { "site4711.example.com", "site42.example.com:8080", "SITE9999.Example.COM",
+	                        "api.tenant77.example.net", "www.shop500.co.uk", "unknown.invalid",
+	                        "site1.example.com.", "127.0.0.1:8080" };
+	f.hostLookups.assign(hosts, hosts + sizeof(hosts) / sizeof(hosts[0]));
+
+	f.cgiScript = "/tmp/webserv-microbench-cgi.sh";
+	std::ofstream script(f.cgiScript.c_str());
+	script << "printf 'Content-Type: text/plain\\r\\n\\r\\nok\\n'\n";
+	f.cgiServer.addPort(8080);
+	f.cgiRoute.setCgiEnabled(true);
+	f.cgiRoute.setCgiPath("/bin/sh");
+	f.cgiRequest.parse("GET /cgi-bin/bench.sh?id=42 HTTP/1.1\r\nHost: www.example.com\r\n"
+	                   "User-Agent: microbench\r\nAccept: */*\r\n\r\n");
+}
+
+/* Benchmarks --------------------------------------------------------------- */
+
+void benchParseBrowser(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		HTTP::Request request;
+		request.parse(fixtures->browserRequest);
+		sink += request.getHeaders().size();
+	}
+}
+
+void benchParseForm(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		HTTP::Request request;
+		request.parse(fixtures->formRequest);
+		sink += request.getBody().size();
+	}
+}
+
+void benchUrlDecode(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += HTTP::Request::urlDecode(fixtures->encoded).size();
+	}
+}
+
+void benchQueryParams(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += fixtures->largeQuery.getQueryParams().size();
+	}
+}
+
+void benchMultipart(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += HTTP::RequestHandler::parseMultipartData(fixtures->multipartBody,
+		                                                 fixtures->multipartBoundary).size();
+	}
+}
+
+void benchResponseBuild(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += fixtures->response.build().size();
+	}
+}
+
+void benchErrorResponse(size_t iterations) {
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += HTTP::Response::errorResponse(404).build().size();
+	}
+}
+
+// Prepared page copied into a reused buffer, as Connection::queueResponse does
+void benchErrorPage(size_t iterations) {
+	const HTTP::ErrorPages* pages = Instance::Get<HTTP::ErrorPages>();
+	std::string buffer;
+	for (size_t i = 0; i < iterations; ++i) {
+		pages->get(NULL, 404).buildInto(buffer);
+		sink += buffer.size();
+	}
+}
+
+void benchMimeType(size_t iterations) {
+	const Settings* settings = Instance::Get<Settings>();
+	const std::vector<std::string>& extensions = fixtures->extensions;
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += settings->httpMimeType(extensions[i % extensions.size()]).size();
+	}
+}
+
+void matchRoutes(const Server& server, const std::vector<std::string>& lookups, size_t iterations,
+                 bool linear) {
+	for (size_t i = 0; i < iterations; ++i) {
+		const std::string& path = lookups[i % lookups.size()];
+		const Route* route = linear ? server.matchRouteLinear(path) : server.matchRoute(path);
+		sink += reinterpret_cast<size_t>(route);
+	}
+}
+
+void benchMatchRoute200(size_t n) { matchRoutes(fixtures->routes200, fixtures->routeLookups200, n, false); }
+void benchMatchRoute10(size_t n) { matchRoutes(fixtures->routeSets[0], fixtures->routeLookups[0], n, false); }
+void benchMatchRoute100(size_t n) { matchRoutes(fixtures->routeSets[1], fixtures->routeLookups[1], n, false); }
+void benchMatchRoute1000(size_t n) { matchRoutes(fixtures->routeSets[2], fixtures->routeLookups[2], n, false); }
+void benchLinearRoute10(size_t n) { matchRoutes(fixtures->routeSets[0], fixtures->routeLookups[0], n, true); }
+void benchLinearRoute100(size_t n) { matchRoutes(fixtures->routeSets[1], fixtures->routeLookups[1], n, true); }
+void benchLinearRoute1000(size_t n) { matchRoutes(fixtures->routeSets[2], fixtures->routeLookups[2], n, true); }
+
+void benchVirtualHost(size_t iterations) {
+	const std::vector<std::string>& hosts = fixtures->hostLookups;
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += reinterpret_cast<size_t>(fixtures->vhosts.find(hosts[i % hosts.size()]));
+	}
+}
+
+// Whole CGI request: environment, start-up, output collected, child reaped
+void runCgi(size_t iterations) {
+	CGI::Executor executor;
+	for (size_t i = 0; i < iterations; ++i) {
+		HTTP::Response response = executor.execute(fixtures->cgiRequest, &fixtures->cgiServer,
+		                                           &fixtures->cgiRoute, fixtures->cgiScript);
+		sink += response.getBody().size();
+	}
+}
+
+// Resident memory the size of a server with warm caches
+void growResident() {
+	if (!ballast) {
+		ballast = static_cast<char*>(std::malloc(CGI_BALLAST));
+		std::memset(ballast, 1, CGI_BALLAST);
+	}
+}
+
+void benchCgiSpawn(size_t n) { runCgi(n); }
+void benchCgiSpawnLarge(size_t n) { growResident(); runCgi(n); }
+
+// Reference: what fork() + execve costs at the same size
+void benchForkExecLarge(size_t iterations) {
+	growResident();
+	char* argv[] = { const_cast<char*>("/bin/true"), NULL };
+	char* envp[] = { NULL };
+	for (size_t i = 0; i < iterations; ++i) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			execve(argv[0], argv, envp);
+			_exit(127);
+		}
+		int status;
+		waitpid(pid, &status, 0);
+		sink += status;
+	}
+}
+
+const Benchmark BENCHMARKS[] = {
+	{ "request_parse_browser", benchParseBrowser },
+	{ "request_parse_form_2k", benchParseForm },
+	{ "url_decode_2k", benchUrlDecode },
+	{ "query_params_200", benchQueryParams },
+	{ "multipart_parse_64k", benchMultipart },
+	{ "response_build_4k", benchResponseBuild },
+	{ "response_error_404", benchErrorResponse },
+	{ "response_error_page_404", benchErrorPage },
+	{ "mime_type", benchMimeType },
+	{ "match_route_200", benchMatchRoute200 },
+	{ "match_route_10", benchMatchRoute10 },
+	{ "match_route_100", benchMatchRoute100 },
+	{ "match_route_1000", benchMatchRoute1000 },
+	{ "match_route_linear_10", benchLinearRoute10 },
+	{ "match_route_linear_100", benchLinearRoute100 },
+	{ "match_route_linear_1000", benchLinearRoute1000 },
+	{ "vhost_find_10k", benchVirtualHost },
+	{ "cgi_spawn", benchCgiSpawn },           // Keep the CGI ones last: they grow the process
+	{ "cgi_spawn_rss_512m", benchCgiSpawnLarge },
+	{ "fork_exec_rss_512m", benchForkExecLarge },
+};
+
+/* Route trie check --------------------------------------------------------- */
+
+std::string randomPath(int maxSegments, bool allowTrailingSlash) {
+	static const char* segments[] = { "a", "b", "ab", "api", "v1", "v2", "static", "img", "a.b" };
+	int count = std::rand() % (maxSegments + 1);
+	std::string path;
+	for (int i = 0; i < count; ++i) {
+		path += "/";
+		path += segments[std::rand() % 9];
+	}
+	if (path.empty() || (allowTrailingSlash && std::rand() % 4 == 0)) {
+		path += "/";
+	}
+	return path;
+}
+
+// The trie must pick the same location as the linear longest-prefix match
+bool checkRouteTrie() {
+	std::srand(42);
+	size_t lookups = 0;
+	size_t mismatches = 0;
+
+	for (int set = 0; set < 500; ++set) {
+		Server server;
+		int routes = 1 + std::rand() % 40;
+		for (int i = 0; i < routes; ++i) {
+			server.addRoute(Route(randomPath(3, true)));
+		}
+		server.compile();
+
+		for (int i = 0; i < 200; ++i) {
+			std::string path = randomPath(5, true);
+			if (std::rand() % 8 == 0) {
+				path += "x"; // Partial last segment
+			}
+			++lookups;
+			if (server.matchRoute(path) != server.matchRouteLinear(path)) {
+				if (++mismatches <= 5) {
+					std::fprintf(stderr, "route trie mismatch: set %d, path %s\n", set, path.c_str());
+				}
+			}
+		}
+	}
+	std::printf("check route_trie: %lu lookups, %lu mismatches\n",
+	            static_cast<unsigned long>(lookups), static_cast<unsigned long>(mismatches));
+	return mismatches == 0;
+}
+
+}
+
+int main(int ac, char** av) {
+	double minTime = 0.5;
+	std::vector<std::string> filters;
+	for (int i = 1; i < ac; ++i) {
+		if (std::strcmp(av[i], "-t") == 0 && i + 1 < ac) {
+			minTime = std::atof(av[++i]);
+		} else {
+			filters.push_back(av[i]);
+		}
+	}
+
+	Logger::setLevel(Logger::LEVEL_ERROR);
+	if (!checkRouteTrie()) {
+		return 1;
+	}
+	setUpFixtures();
+
+	std::printf("\n%-30s %12s %12s %14s %14s %12s\n", "benchmark", "ns/op", "allocs/op",
+	            "alloc B/op", "copied B/op", "iterations");
+	for (size_t i = 0; i < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); ++i) {
+		bool selected = filters.empty();
+		for (size_t f = 0; f < filters.size() && !selected; ++f) {
+			selected = std::strstr(BENCHMARKS[i].name, filters[f].c_str()) != NULL;
+		}
+		if (selected) {
+			runBenchmark(BENCHMARKS[i], minTime);
+		}
+	}
+
+	unlink(fixtures->cgiScript.c_str());
+	std::free(ballast);
+	delete fixtures;
+	Instance::Destroy<HTTP::ErrorPages>();
+	Instance::Destroy<CGI::Environment>();
+	Instance::Destroy<HTTP::Metrics>();
+	Instance::Destroy<Settings>();
+	return static_cast<int>(sink & 0);
+}
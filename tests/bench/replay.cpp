@@ -0,0 +1,500 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   replay.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tborges- <tborges-@student.42lisboa.com    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:52:40 by tborges-          #+#    #+#             */
+/*   Updated: 2026/10/19 18:52:41 by tborges-         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * replay.cpp
+ * Replays a capture file (capture directive) against a running webserv
+ * Every captured connection is opened again and sent the same bytes with
+ * the same timing, scaled by -s (1 = real time, N = N times faster,
+ * 0 = as fast as possible, each connection's bytes back to back). Latency
+ * is measured from the last byte of each chunk sent to the first response
+ * byte after it. Prints one JSON object; with -b, also a comparison against
+ * an earlier run (another build) on stderr
+ *
+ * Usage: replay [-s speed] [-c max-connections] [-t host:port] [-i idle-seconds]
+ *               [-b baseline.json] capture.wscap
+ * TLS connections are replayed in cleartext: point -t at a plain listener
+ */
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+
+const char MAGIC[] = "WSCAP001";
+
+// A connection with nothing left to send is closed once no response bytes
+// arrived for this long
+const double QUIET = 0.1;
+
+struct Chunk {
+	double time;               // Seconds since the start of the capture
+	std::string bytes;
+};
+
+struct CapturedConnection {
+	double openTime;
+	double closeTime;          // < 0: no close record
+	int port;
+	bool tls;
+	std::vector<Chunk> chunks;
+};
+
+struct Replay {
+	enum State { PENDING, CONNECTING, ACTIVE, DONE };
+
+	State state;
+	int fd;
+	double started;            // When the replay connection was opened
+	size_t chunk;              // Next chunk to send
+	size_t sent;               // Bytes of that chunk already sent
+	double lastSent;           // When the last chunk was fully sent
+	double lastReceived;       // When the last response bytes arrived
+	bool awaiting;             // Waiting for a response to the last chunk
+
+	Replay()
+		: state(PENDING), fd(-1), started(0), chunk(0), sent(0), lastSent(0), lastReceived(0),
+		  awaiting(false) {}
+};
+
+struct Results {
+	unsigned long connections;
+	unsigned long chunks;
+	unsigned long errors;
+	unsigned long timeouts;
+	unsigned long long bytesOut;
+	unsigned long long bytesIn;
+	std::vector<double> latencies;  // Milliseconds
+
+	Results() : connections(0), chunks(0), errors(0), timeouts(0), bytesOut(0), bytesIn(0) {}
+};
+
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool readVarint(const std::string& data, size_t& pos, unsigned long long& value) {
+	value = 0;
+	for (int shift = 0; pos < data.size() && shift < 64; shift += 7) {
+		unsigned char byte = data[pos++];
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Parse the whole capture; a truncated last record is ignored
+bool loadCapture(const char* file, std::vector<CapturedConnection>& connections) {
+	std::ifstream in(file, std::ios::binary);
+	if (!in.is_open()) {
+		std::cerr << "replay: cannot open " << file << std::endl;
+		return false;
+	}
+	std::ostringstream content;
+	content << in.rdbuf();
+	const std::string data = content.str();
+	if (data.compare(0, sizeof(MAGIC) - 1, MAGIC) != 0) {
+		std::cerr << "replay: " << file << " is not a webserv capture" << std::endl;
+		return false;
+	}
+
+	std::vector<long> index;   // Capture id -> position in connections (-1: unknown)
+	unsigned long long micros = 0;
+	size_t pos = sizeof(MAGIC) - 1;
+	while (pos < data.size()) {
+		char type = data[pos++];
+		unsigned long long delta;
+		unsigned long long id;
+		if (!readVarint(data, pos, delta) || !readVarint(data, pos, id)) {
+			break;
+		}
+		micros += delta;
+		double time = micros / 1e6;
+		if (id >= index.size()) {
+			index.resize(id + 1, -1);
+		}
+
+		if (type == 'O') {
+			unsigned long long port;
+			if (!readVarint(data, pos, port) || pos >= data.size()) {
+				break;
+			}
+			CapturedConnection connection;
+			connection.openTime = time;
+			connection.closeTime = -1;
+			connection.port = static_cast<int>(port);
+			connection.tls = data[pos++] != 0;
+			index[id] = connections.size();
+			connections.push_back(connection);
+		} else if (type == 'D') {
+			unsigned long long length;
+			if (!readVarint(data, pos, length) || pos + length > data.size()) {
+				break;
+			}
+			if (index[id] >= 0) {
+				Chunk chunk;
+				chunk.time = time;
+				chunk.bytes = data.substr(pos, length);
+				connections[index[id]].chunks.push_back(chunk);
+			}
+			pos += length;
+		} else if (type == 'C') {
+			if (index[id] >= 0) {
+				connections[index[id]].closeTime = time;
+			}
+		} else {
+			std::cerr << "replay: unknown record type at offset " << pos - 1 << std::endl;
+			return false;
+		}
+	}
+
+	// Time zero is the first captured connection, not the server start
+	double first = connections.empty() ? 0 : connections[0].openTime;
+	for (size_t i = 0; i < connections.size(); ++i) {
+		connections[i].openTime -= first;
+		if (connections[i].closeTime >= 0) {
+			connections[i].closeTime -= first;
+		}
+		for (size_t j = 0; j < connections[i].chunks.size(); ++j) {
+			connections[i].chunks[j].time -= first;
+		}
+	}
+	return true;
+}
+
+int openConnection(const std::string& host, int port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+	if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 &&
+	    errno != EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void finish(Replay& replay) {
+	if (replay.fd >= 0) {
+		close(replay.fd);
+	}
+	replay.fd = -1;
+	replay.state = Replay::DONE;
+}
+
+void run(const std::vector<CapturedConnection>& captured, double speed, size_t maxActive,
+         const std::string& host, int portOverride, double idleTimeout, Results& results) {
+	std::vector<Replay> replays(captured.size());
+	std::vector<struct pollfd> pollFds;
+	std::vector<size_t> pollIndex;
+	size_t nextOpen = 0;
+	size_t active = 0;
+	double start = now();
+	char buffer[65536];
+
+	while (nextOpen < captured.size() || active > 0) {
+		double current = now();
+
+		// Open the connections that are due
+		while (nextOpen < captured.size() && active < maxActive &&
+		       (speed <= 0 || start + captured[nextOpen].openTime / speed <= current)) {
+			Replay& replay = replays[nextOpen];
+			const CapturedConnection& connection = captured[nextOpen++];
+			replay.fd = openConnection(host, portOverride ? portOverride : connection.port);
+			if (replay.fd < 0) {
+				++results.errors;
+				replay.state = Replay::DONE;
+				continue;
+			}
+			replay.state = Replay::CONNECTING;
+			replay.started = current;
+			++results.connections;
+			++active;
+		}
+
+		pollFds.clear();
+		pollIndex.clear();
+		double wake = current + 0.05;
+		for (size_t i = 0; i < replays.size(); ++i) {
+			Replay& replay = replays[i];
+			if (replay.state != Replay::CONNECTING && replay.state != Replay::ACTIVE) {
+				continue;
+			}
+			const CapturedConnection& connection = captured[i];
+
+			// Nothing left to send: close once the last chunk was answered, the
+			// response has been quiet for QUIET seconds and the captured close
+			// time has passed. The server usually closes first
+			if (replay.state == Replay::ACTIVE && replay.chunk >= connection.chunks.size()) {
+				double closeAt = replay.lastReceived + QUIET;
+				if (speed > 0 && connection.closeTime >= 0) {
+					closeAt = std::max(closeAt, replay.started +
+					                   (connection.closeTime - connection.openTime) / speed);
+				}
+				if (replay.awaiting && current - replay.lastSent > idleTimeout) {
+					++results.timeouts;
+					finish(replay);
+					--active;
+					continue;
+				}
+				if (!replay.awaiting && current >= closeAt) {
+					finish(replay);
+					--active;
+					continue;
+				}
+				if (!replay.awaiting && closeAt < wake) {
+					wake = closeAt;
+				}
+			}
+
+			struct pollfd pfd;
+			pfd.fd = replay.fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			if (replay.state == Replay::CONNECTING) {
+				pfd.events = POLLOUT;
+			} else if (replay.chunk < connection.chunks.size()) {
+				double due = replay.started;
+				if (speed > 0) {
+					due += (connection.chunks[replay.chunk].time - connection.openTime) / speed;
+				}
+				if (due <= current) {
+					pfd.events |= POLLOUT;
+				} else if (due < wake) {
+					wake = due;
+				}
+			}
+			pollFds.push_back(pfd);
+			pollIndex.push_back(i);
+		}
+		if (nextOpen < captured.size() && active < maxActive) {
+			wake = std::min(wake, speed > 0 ? start + captured[nextOpen].openTime / speed : current);
+		}
+
+		int timeout = static_cast<int>((wake - current) * 1000);
+		timeout = timeout < 0 ? 0 : timeout;
+		if (poll(pollFds.empty() ? NULL : &pollFds[0], pollFds.size(), timeout) < 0 && errno != EINTR) {
+			break;
+		}
+		current = now();
+
+		for (size_t p = 0; p < pollFds.size(); ++p) {
+			Replay& replay = replays[pollIndex[p]];
+			const CapturedConnection& connection = captured[pollIndex[p]];
+			short revents = pollFds[p].revents;
+			if (revents == 0) {
+				continue;
+			}
+
+			if (replay.state == Replay::CONNECTING) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(replay.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+				if (error != 0) {
+					++results.errors;
+					finish(replay);
+					--active;
+					continue;
+				}
+				replay.state = Replay::ACTIVE;
+				continue;
+			}
+
+			if (revents & (POLLIN | POLLHUP | POLLERR)) {
+				ssize_t received = recv(replay.fd, buffer, sizeof(buffer), 0);
+				if (received > 0) {
+					results.bytesIn += received;
+					replay.lastReceived = current;
+					if (replay.awaiting) {
+						results.latencies.push_back((current - replay.lastSent) * 1000);
+						replay.awaiting = false;
+					}
+				} else if (received == 0 || errno != EAGAIN) {
+					// Closed by the server: an error only if bytes were still due
+					if (replay.chunk < connection.chunks.size() || replay.awaiting) {
+						++results.errors;
+					}
+					finish(replay);
+					--active;
+					continue;
+				}
+			}
+
+			if ((revents & POLLOUT) && replay.chunk < connection.chunks.size()) {
+				const std::string& bytes = connection.chunks[replay.chunk].bytes;
+				ssize_t written = send(replay.fd, bytes.data() + replay.sent, bytes.size() - replay.sent,
+				                       MSG_NOSIGNAL);
+				if (written < 0) {
+					if (errno != EAGAIN) {
+						++results.errors;
+						finish(replay);
+						--active;
+					}
+					continue;
+				}
+				results.bytesOut += written;
+				replay.sent += written;
+				if (replay.sent == bytes.size()) {
+					++results.chunks;
+					++replay.chunk;
+					replay.sent = 0;
+					replay.lastSent = current;
+					replay.awaiting = true;
+				}
+			}
+		}
+	}
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	return sorted[static_cast<size_t>(p * (sorted.size() - 1) + 0.5)];
+}
+
+// Number after "key": in a flat JSON document (0 if missing)
+double jsonNumber(const std::string& json, const std::string& key) {
+	size_t pos = json.find("\"" + key + "\":");
+	if (pos == std::string::npos) {
+		return 0;
+	}
+	return std::strtod(json.c_str() + pos + key.size() + 3, NULL);
+}
+
+void compare(const char* baselineFile, const std::string& current) {
+	std::ifstream in(baselineFile);
+	if (!in.is_open()) {
+		std::cerr << "replay: cannot open baseline " << baselineFile << std::endl;
+		return;
+	}
+	std::ostringstream content;
+	content << in.rdbuf();
+	const std::string baseline = content.str();
+
+	static const char* keys[] = { "rps", "p50", "p99", "p999", "max", "errors", "timeouts" };
+	std::fprintf(stderr, "%-10s %14s %14s %10s\n", "", "baseline", "current", "change");
+	for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+		double before = jsonNumber(baseline, keys[i]);
+		double after = jsonNumber(current, keys[i]);
+		std::fprintf(stderr, "%-10s %14.3f %14.3f", keys[i], before, after);
+		if (before != 0) {
+			std::fprintf(stderr, " %+9.1f%%", (after - before) / before * 100);
+		}
+		std::fprintf(stderr, "\n");
+	}
+}
+
+void usage() {
+	std::cerr << "Usage: replay [-s speed] [-c max-connections] [-t host:port] [-i idle-seconds]" << std::endl
+	          << "              [-b baseline.json] capture.wscap" << std::endl;
+}
+
+}
+
+int main(int ac, char** av) {
+	double speed = 1;
+	size_t maxActive = 64;
+	std::string host = "127.0.0.1";
+	int port = 0;
+	double idleTimeout = 10;
+	const char* baseline = NULL;
+	const char* file = NULL;
+
+	signal(SIGPIPE, SIG_IGN);
+	for (int i = 1; i < ac; ++i) {
+		std::string arg = av[i];
+		if (arg == "-s" && i + 1 < ac) {
+			speed = std::atof(av[++i]);
+		} else if (arg == "-c" && i + 1 < ac) {
+			maxActive = std::strtoul(av[++i], NULL, 10);
+		} else if (arg == "-t" && i + 1 < ac) {
+			std::string target = av[++i];
+			size_t colon = target.find(':');
+			host = target.substr(0, colon);
+			port = colon == std::string::npos ? 0 : std::atoi(target.c_str() + colon + 1);
+		} else if (arg == "-i" && i + 1 < ac) {
+			idleTimeout = std::atof(av[++i]);
+		} else if (arg == "-b" && i + 1 < ac) {
+			baseline = av[++i];
+		} else if (!file && arg[0] != '-') {
+			file = av[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (!file || maxActive == 0) {
+		usage();
+		return 1;
+	}
+
+	std::vector<CapturedConnection> captured;
+	if (!loadCapture(file, captured)) {
+		return 1;
+	}
+
+	Results results;
+	double start = now();
+	run(captured, speed, maxActive, host, port, idleTimeout, results);
+	double elapsed = now() - start;
+
+	std::sort(results.latencies.begin(), results.latencies.end());
+	char json[1024];
+	std::snprintf(json, sizeof(json),
+	              "{\"capture\":\"%s\",\"speed\":%g,\"connections\":%lu,\"chunks\":%lu,"
+	              "\"responses\":%lu,\"errors\":%lu,\"timeouts\":%lu,\"duration_s\":%.3f,"
+	              "\"rps\":%.1f,\"bytes_out\":%llu,\"bytes_in\":%llu,"
+	              "\"latency_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}}",
+	              file, speed, results.connections, results.chunks,
+	              static_cast<unsigned long>(results.latencies.size()), results.errors,
+	              results.timeouts, elapsed, results.latencies.size() / elapsed,
+	              results.bytesOut, results.bytesIn,
+	              percentile(results.latencies, 0.50), percentile(results.latencies, 0.99),
+	              percentile(results.latencies, 0.999),
+	              results.latencies.empty() ? 0 : results.latencies.back());
+	std::printf("%s\n", json);
+	if (baseline) {
+		compare(baseline, json);
+	}
+	return 0;
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+# Runs the bench scenarios against a freshly started webserv (make bench)
+#   BENCH_SCENARIOS="small_static cgi_get"   subset of tests/bench/scenarios
+#   BENCH_DURATION=10                        seconds per scenario
+#   BENCH_OUT=results.json                   output file
+# Results: one JSON document, bench-results/<date>.json by default
+
+set -e
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+REPO_DIR=$(cd "$BENCH_DIR/../.." && pwd)
+LOADGEN="$BENCH_DIR/loadgen"
+SERVER="$REPO_DIR/webserv"
+STAMP=$(date +%Y%m%d-%H%M%S)
+OUT=${BENCH_OUT:-"$REPO_DIR/bench-results/$STAMP.json"}
+
+if [ -z "$BENCH_SCENARIOS" ]; then
+	BENCH_SCENARIOS=$(cd "$BENCH_DIR/scenarios" && ls *.conf | sed 's/\.conf$//')
+fi
+
+WORK=$(mktemp -d /tmp/webserv-bench.XXXXXX)
+PID=
+cleanup() {
+	[ -n "$PID" ] && kill "$PID" 2>/dev/null && wait "$PID" 2>/dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT INT TERM
+
+# Document root: a small page, a large file, a large compressible script,
+# the upload directory and the CGI scripts
+mkdir -p "$WORK/www/assets" "$WORK/uploads" "$WORK/cgi-bin"
+head -c 1024 /dev/zero | tr '\0' 'a' > "$WORK/www/small.html"
+head -c 8388608 /dev/urandom > "$WORK/www/large.bin"
+for i in $(seq 1 20000); do
+	echo "function handler$i(event) { return event.target.value + $i; }"
+done > "$WORK/www/assets/app.js"
+cp "$REPO_DIR/www/cgi-bin/test.py" "$REPO_DIR/www/cgi-bin/test_post.py" "$WORK/cgi-bin/"
+sed "s|@ROOT@|$WORK|g" "$BENCH_DIR/bench.conf" > "$WORK/bench.conf"
+
+cd "$REPO_DIR"
+"$SERVER" -l error "$WORK/bench.conf" > /dev/null &
+PID=$!
+"$LOADGEN" -w 127.0.0.1:8090
+
+mkdir -p "$(dirname "$OUT")"
+{
+	printf '{"date":"%s","git":"%s","results":[\n' \
+		"$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$(git rev-parse --short HEAD 2>/dev/null || echo unknown)"
+	SEP=
+	for scenario in $BENCH_SCENARIOS; do
+		printf '%s' "$SEP"
+		"$LOADGEN" -p "$PID" ${BENCH_DURATION:+-d "$BENCH_DURATION"} "$BENCH_DIR/scenarios/$scenario.conf" | tee /dev/stderr
+		rm -f "$WORK"/uploads/*
+		SEP=,
+	done
+	printf ']}\n'
+} > "$OUT"
+
+echo "bench: results written to $OUT" >&2